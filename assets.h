@@ -0,0 +1,30 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+
+/*
+ * Dashboard files compiled into the binary. dashboard/embed.py turns every
+ * file of dashboard/static into an entry of xenoflow_assets at build time,
+ * with a gzip variant when that is smaller and an ETag per variant, so the
+ * HTTP server answers from memory without reading or compressing anything.
+ */
+
+/**
+ * @brief One embedded file
+ */
+typedef struct {
+	const char *path;		/* URL path, index.html is also "/" */
+	const char *content_type;
+	const char *etag;		/* quoted, of the uncompressed file */
+	const unsigned char *data;
+	size_t size;
+	const char *gzip_etag;		/* quoted, of the gzip variant */
+	const unsigned char *gzip;	/* NULL when compressing does not make it smaller */
+	size_t gzip_size;
+} XenoFlowAsset;
+
+extern const XenoFlowAsset xenoflow_assets[];
+extern const size_t xenoflow_nb_assets;
+
+#endif /* ASSETS_H */
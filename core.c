@@ -1,11 +1,17 @@
+#include <errno.h>
+#include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <pthread.h>
+#include <signal.h>
+#include <arpa/inet.h>
 
 #include <rte_byteorder.h>
 
@@ -15,10 +21,22 @@
 #include "flow_common.h"
 #include "http_server.h"
 #include "core.h"
+#include "devices.h"
+#include "evlog.h"
+#include "startup.h"
 
 DOCA_LOG_REGISTER(FLOW_HASH_PIPE);
 #define NB_ACTION_DESC (1)
 
+/* Outer headers of tunnels to backends */
+#define TUNNEL_TTL (64)
+#define TUNNEL_SRC_PORT_BASE (0xc000)	/* ephemeral range, 49152 and up */
+#define TUNNEL_SRC_PORT_MASK (0x3fff)
+#define ETHER_TYPE_TEB (0x6558)		/* transparent Ethernet bridging, GENEVE carrying frames */
+
+static doca_error_t queue_hash_entry(XenoFlow *xeno, XenoFlowService *service, const XenoFlowBackend *spec,
+				     uint32_t slot, xenoflow_backend_cb done, void *arg, XenoFlowOp **op);
+
 static uint32_t next_power_of_two(uint32_t value) {
 	if (value <= 1) {
 		return 1;
@@ -34,96 +52,207 @@ static uint32_t next_power_of_two(uint32_t value) {
 }
 
 
-void doca_try(doca_error_t result, char* message, int nb_ports, struct doca_flow_port** ports) {
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("%s: %s", message, doca_error_get_descr(result));
-		stop_doca_flow_ports(nb_ports, ports);
-		doca_flow_destroy();
-		exit(-1);
-	}
-}
+/*
+ * Built-in default pool, used when no --config is given
+ */
+static doca_error_t load_default_services(XenoFlowServices *services) {
+	XenoFlowService *service = xenoflow_service_create("default", NULL, NULL, 0);
+
+	if (service == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	/* NOTE: Hash pipe requires power-of-2 number of entries (1, 2, 4, 8, 16, ...) */
+	XenoFlowBackend* b1 = createBackend("fips2", "a0:88:c2:b5:f4:5a");
+	XenoFlowBackend* b2 = createBackend("fips1", "e8:eb:d3:9c:71:ac");
+
+	if (b1 == NULL || b2 == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	/* The first slot goes to the host instead of fips2 */
+	b1->host = 1;
+	configAddBackend(service->config, b1);
+	configAddBackend(service->config, b2);
 
-XenoFlowBackend* createBackend(const char* name, const char* mac_str) {
-	XenoFlowBackend* b = malloc(sizeof(XenoFlowBackend));
-	strcpy(b->name, name);
-	sscanf(mac_str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", 
-		   &b->mac_address[0], &b->mac_address[1], &b->mac_address[2],
-		   &b->mac_address[3], &b->mac_address[4], &b->mac_address[5]);
-	return b;
+	return xenoflow_services_add(services, service);
 }
 
-XenoFlowConfig* createConfig() {
-	XenoFlowConfig* config = malloc(sizeof(XenoFlowConfig));
-	config->numBackends = 0;
-	config->nextBackend = 0;
-	config->backends = calloc(MAX_BACKENDS, sizeof(XenoFlowBackend *));
-	return config;
+static doca_error_t load_services(const XenoFlowOptions *options, XenoFlowServices *services) {
+	doca_error_t result;
+
+	if (options->configPath[0] != '\0')
+		result = xenoflow_services_load(options->configPath, services);
+	else
+		result = load_default_services(services);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	DOCA_LOG_INFO("Loaded %d services", services->numServices);
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		XenoFlowConfig *c = service->config;
+		char vip[INET_ADDRSTRLEN];
+
+		xenoflow_service_vip_str(service, vip, sizeof(vip));
+		if (service->protocol == 0)
+			DOCA_LOG_INFO("Service %s (default): %d backends", service->name, c->numBackends);
+		else
+			DOCA_LOG_INFO("Service %s %s:%u/%s: %d backends", service->name, vip, service->port,
+				      xenoflow_service_protocol_name(service), c->numBackends);
+		for (int i = 0; i < c->numBackends; i++) {
+			DOCA_LOG_INFO("  %s -> %02x:%02x:%02x:%02x:%02x:%02x%s",
+				c->backends[i]->name,
+				c->backends[i]->mac_address[0], c->backends[i]->mac_address[1],
+				c->backends[i]->mac_address[2], c->backends[i]->mac_address[3],
+				c->backends[i]->mac_address[4], c->backends[i]->mac_address[5],
+				c->backends[i]->host ? " (host)" : "");
+		}
+	}
+
+	return DOCA_SUCCESS;
 }
 
-void configAddBackend(XenoFlowConfig* config, XenoFlowBackend* backend) {
-	if (config->numBackends >= MAX_BACKENDS) {
-		DOCA_LOG_ERR("Cannot add backend: maximum backends (%d) reached", MAX_BACKENDS);
+/*
+ * Outer headers of a tunnel to a backend. Without a backend every field is
+ * left to the entries, as the encap action templates of the hash pipe need.
+ */
+static void set_encap(struct doca_flow_actions *actions, uint8_t tunnel, const XenoFlowService *service,
+		      const XenoFlowBackend *backend)
+{
+	struct doca_flow_header_format *outer = &actions->encap_cfg.encap.outer;
+	struct doca_flow_tun *tun = &actions->encap_cfg.encap.tun;
+	uint32_t vni = backend != NULL ? BUILD_VNI(backend->vni) : UINT32_MAX;
+
+	actions->encap_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	actions->encap_cfg.is_l2 = tunnel != XENOFLOW_TUNNEL_IPIP;
+
+	if (backend != NULL) {
+		memcpy(outer->eth.src_mac, service->underlay_mac, sizeof(outer->eth.src_mac));
+		memcpy(outer->eth.dst_mac, service->underlay_gateway_mac, sizeof(outer->eth.dst_mac));
+	} else {
+		memset(outer->eth.src_mac, 0xff, sizeof(outer->eth.src_mac));
+		memset(outer->eth.dst_mac, 0xff, sizeof(outer->eth.dst_mac));
+	}
+	outer->eth.type = RTE_BE16(DOCA_FLOW_ETHER_TYPE_IPV4);
+	outer->l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	outer->ip4.src_ip = backend != NULL ? service->underlay_ip : UINT32_MAX;
+	outer->ip4.dst_ip = backend != NULL ? backend->remote : UINT32_MAX;
+	outer->ip4.ttl = backend != NULL ? TUNNEL_TTL : UINT8_MAX;
+
+	if (tunnel == XENOFLOW_TUNNEL_IPIP) {
+		outer->ip4.next_proto = IPPROTO_IPIP;
+		tun->type = DOCA_FLOW_TUN_IP_IN_IP;
 		return;
 	}
-	config->backends[config->numBackends] = backend;
-	config->numBackends += 1;
+
+	/* One source port per hash entry spreads the buckets over the underlay's ECMP paths */
+	outer->l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_UDP;
+	outer->udp.l4_port.src_port =
+		backend != NULL ? rte_cpu_to_be_16(TUNNEL_SRC_PORT_BASE | (backend->entry_index & TUNNEL_SRC_PORT_MASK))
+				: UINT16_MAX;
+	if (tunnel == XENOFLOW_TUNNEL_VXLAN) {
+		outer->udp.l4_port.dst_port = RTE_BE16(DOCA_FLOW_VXLAN_DEFAULT_PORT);
+		tun->type = DOCA_FLOW_TUN_VXLAN;
+		tun->vxlan_tun_id = vni;
+	} else {
+		outer->udp.l4_port.dst_port = RTE_BE16(DOCA_FLOW_GENEVE_DEFAULT_PORT);
+		tun->type = DOCA_FLOW_TUN_GENEVE;
+		tun->geneve.next_proto = RTE_BE16(ETHER_TYPE_TEB);
+		tun->geneve.vni = vni;
+	}
 }
 
-XenoFlowConfig* load_config() {
-	XenoFlowConfig* c = createConfig();
-	
-	/* NOTE: Hash pipe requires power-of-2 number of entries (1, 2, 4, 8, 16, ...) */
-	XenoFlowBackend* b1 = createBackend("fips2", "a0:88:c2:b5:f4:5a");
-	XenoFlowBackend* b2 = createBackend("fips1", "e8:eb:d3:9c:71:ac");
-	
-	configAddBackend(c, b1);
-	configAddBackend(c, b2);
-	
-	DOCA_LOG_INFO("Loaded %d backends", c->numBackends);
-	for (int i = 0; i < c->numBackends; i++) {
-		DOCA_LOG_INFO("  %s -> %02x:%02x:%02x:%02x:%02x:%02x", 
-			c->backends[i]->name,
-			c->backends[i]->mac_address[0], c->backends[i]->mac_address[1],
-			c->backends[i]->mac_address[2], c->backends[i]->mac_address[3],
-			c->backends[i]->mac_address[4], c->backends[i]->mac_address[5]);
+/*
+ * Header rewrites that send a packet to a backend, the same in its hash entry and in spill entries
+ */
+static void set_backend_actions(struct doca_flow_actions *actions, const XenoFlowService *service,
+				const XenoFlowBackend *backend)
+{
+	SET_MAC_ADDR(actions->outer.eth.dst_mac,
+		     backend->mac_address[0], backend->mac_address[1], backend->mac_address[2],
+		     backend->mac_address[3], backend->mac_address[4], backend->mac_address[5]);
+
+	if (backend->tunnel != XENOFLOW_TUNNEL_NONE) {
+		actions->action_idx = backend->tunnel;
+		set_encap(actions, backend->tunnel, service, backend);
+	}
+
+	if (service->nat) {
+		uint16_t port = backend->port ? backend->port : service->port;
+
+		actions->outer.ip4.dst_ip = backend->host ? service->vip : backend->ip;
+		actions->outer.transport.dst_port = rte_cpu_to_be_16(backend->host ? service->port : port);
 	}
-	
-	return c;
 }
 
+/*
+ * Create the hash pipe of a service, or with spill set its SPILL pipe: the same
+ * action templates, hashed on the source port too and without counter or meter.
+ */
 static doca_error_t create_hash_pipe(struct doca_flow_port *port,
-				       int port_id,
-				       int num_backends,
+				       const char *name,
+				       const XenoFlowService *service,
+				       const XenoFlowCounters *counters,
+				       const XenoFlowMeters *meters,
+				       int spill,
 				       struct doca_flow_pipe **pipe)
 {
 	struct doca_flow_match match_mask;
 	struct doca_flow_monitor monitor;
-	struct doca_flow_actions actions, *actions_arr[1];
-	struct doca_flow_action_descs descs;
-	struct doca_flow_action_descs *descs_arr[1];
-	struct doca_flow_action_desc desc_array[NB_ACTION_DESC] = {0};
+	struct doca_flow_actions templates[XENOFLOW_TUNNEL_MAX], *actions_arr[XENOFLOW_TUNNEL_MAX];
+	struct doca_flow_actions *actions = &templates[XENOFLOW_TUNNEL_NONE];
+	struct doca_flow_action_descs descs[XENOFLOW_TUNNEL_MAX];
+	struct doca_flow_action_descs *descs_arr[XENOFLOW_TUNNEL_MAX];
+	struct doca_flow_action_desc desc_array[XENOFLOW_TUNNEL_MAX][NB_ACTION_DESC] = {0};
+	/* Template i serves backends with tunnel i, the plain one always exists */
+	int nb_templates = service->underlay ? XENOFLOW_TUNNEL_MAX : 1;
 	struct doca_flow_fwd fwd;
 	struct doca_flow_pipe_cfg *pipe_cfg;
 	doca_error_t result;
 
 	memset(&match_mask, 0, sizeof(match_mask));
 	memset(&monitor, 0, sizeof(monitor));
-	memset(&actions, 0, sizeof(actions));
-	memset(&descs, 0, sizeof(descs));
+	memset(templates, 0, sizeof(templates));
+	memset(descs, 0, sizeof(descs));
 	memset(&fwd, 0, sizeof(fwd));
 
-	actions_arr[0] = &actions;
-	descs.nb_action_desc = NB_ACTION_DESC;
-	descs.desc_array = desc_array;
-	descs_arr[0] = &descs;
-
 	match_mask.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
 	match_mask.outer.ip4.src_ip = 0xffffffff;
+	/* One client's red packets spread over the spare backends */
+	if (spill) {
+		match_mask.outer.l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_TRANSPORT;
+		match_mask.outer.transport.src_port = 0xffff;
+	}
 
-	SET_MAC_ADDR(actions.outer.eth.dst_mac, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+	SET_MAC_ADDR(actions->outer.eth.dst_mac, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+
+	/* NAT entries also set the backend's address and port, the NIC fixes the checksums */
+	if (service->nat) {
+		actions->outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+		actions->outer.ip4.dst_ip = 0xffffffff;
+		actions->outer.l4_type_ext = service->protocol == DOCA_FLOW_PROTO_TCP ? DOCA_FLOW_L4_TYPE_EXT_TCP
+										       : DOCA_FLOW_L4_TYPE_EXT_UDP;
+		actions->outer.transport.dst_port = 0xffff;
+	}
 
+	/* Tunnel templates rewrite the same fields, then add the outer headers */
+	for (int i = 0; i < nb_templates; i++) {
+		if (i != XENOFLOW_TUNNEL_NONE) {
+			templates[i] = *actions;
+			templates[i].action_idx = i;
+			set_encap(&templates[i], i, service, NULL);
+		}
+		actions_arr[i] = &templates[i];
+		descs[i].nb_action_desc = NB_ACTION_DESC;
+		descs[i].desc_array = desc_array[i];
+		descs_arr[i] = &descs[i];
+	}
 
-	monitor.counter_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	/* Shared counter and meter ids are set per entry */
+	if (!spill) {
+		xenoflow_counters_monitor(counters, &monitor, UINT32_MAX);
+		if (service->spillover != XENOFLOW_SPILLOVER_NONE)
+			xenoflow_meters_monitor(meters, &monitor, UINT32_MAX);
+	}
 
 	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
 	if (result != DOCA_SUCCESS) {
@@ -131,13 +260,13 @@ static doca_error_t create_hash_pipe(struct doca_flow_port *port,
 		return result;
 	}
 
-	result = set_flow_pipe_cfg(pipe_cfg, "HASH_PIPE", DOCA_FLOW_PIPE_HASH, true);
+	result = set_flow_pipe_cfg(pipe_cfg, name, DOCA_FLOW_PIPE_HASH, false);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
 		goto destroy_pipe_cfg;
 	}
 
-	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, num_backends);
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, service->hash_pipe_entries);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
 		goto destroy_pipe_cfg;
@@ -155,14 +284,15 @@ static doca_error_t create_hash_pipe(struct doca_flow_port *port,
 		goto destroy_pipe_cfg;
 	}
 
-	result = doca_flow_pipe_cfg_set_actions(pipe_cfg, actions_arr, NULL, descs_arr, 1);
+	result = doca_flow_pipe_cfg_set_actions(pipe_cfg, actions_arr, NULL, descs_arr, nb_templates);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg actions: %s", doca_error_get_descr(result));
 		goto destroy_pipe_cfg;
 	}
 
+	/* Hash entries forward per entry, spill entries only to spare backends out of the port */
 	fwd.type = DOCA_FLOW_FWD_PORT;
-	fwd.port_id = 0xffff;
+	fwd.port_id = spill ? 0 : 0xffff;
 
 	result = doca_flow_pipe_create(pipe_cfg, &fwd, NULL, pipe);
 
@@ -171,322 +301,2202 @@ destroy_pipe_cfg:
 	return result;
 }
 
-struct doca_dev *open_doca_dev_by_pci(const char *pci_bdf)
+/*
+ * Create the COLOR pipe of a service: metered hash entries forward here and
+ * its one entry sends red packets to the spill pipe, or drops them without
+ * one. Everything else goes out of the port as the hash entry rewrote it.
+ */
+static doca_error_t create_color_pipe(struct doca_flow_port *port,
+				      const char *name,
+				      struct doca_flow_pipe *spill_pipe,
+				      struct doca_flow_pipe **pipe)
 {
-    struct doca_devinfo **list;
-    uint32_t nb;
-    doca_error_t err;
+	struct doca_flow_match match, match_mask;
+	struct doca_flow_fwd fwd, fwd_miss;
+	struct doca_flow_pipe_cfg *pipe_cfg;
+	doca_error_t result;
+
+	memset(&match, 0, sizeof(match));
+	memset(&match_mask, 0, sizeof(match_mask));
+	memset(&fwd, 0, sizeof(fwd));
+	memset(&fwd_miss, 0, sizeof(fwd_miss));
 
-    err = doca_devinfo_create_list(&list, &nb);
-    if (err != DOCA_SUCCESS) {
-        printf("devinfo_create_list failed\n");
-        return NULL;
-    }
+	match.parser_meta.meter_color = DOCA_FLOW_METER_COLOR_RED;
+	match_mask.parser_meta.meter_color = 0xff;
 
-    struct doca_dev *dev = NULL;
+	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		return result;
+	}
 
-    for (uint32_t i = 0; i < nb; i++) {
-        char pci[DOCA_DEVINFO_PCI_ADDR_SIZE] = {0};
-		uint8_t ipv4[4];
+	result = set_flow_pipe_cfg(pipe_cfg, name, DOCA_FLOW_PIPE_BASIC, false);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
 
-        if (doca_devinfo_get_pci_addr_str(list[i], pci) != DOCA_SUCCESS)
-            continue;
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, 1);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
 
-        if (strcmp(pci, pci_bdf) == 0) {
-			doca_devinfo_get_ipv4_addr(list[i], ipv4, DOCA_DEVINFO_IPV4_ADDR_SIZE);
-			DOCA_LOG_INFO("IPv4: %u.%u.%u.%u", ipv4[0], ipv4[1], ipv4[2], ipv4[3]);
-			err = doca_dev_open(list[i], &dev);
-            break;
-        }
-    }
+	result = doca_flow_pipe_cfg_set_match(pipe_cfg, &match, &match_mask);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
 
-    doca_devinfo_destroy_list(list);
-    return dev;
-}
+	if (spill_pipe != NULL) {
+		fwd.type = DOCA_FLOW_FWD_PIPE;
+		fwd.next_pipe = spill_pipe;
+	} else {
+		fwd.type = DOCA_FLOW_FWD_DROP;
+	}
+	fwd_miss.type = DOCA_FLOW_FWD_PORT;
+	fwd_miss.port_id = 0;
 
+	result = doca_flow_pipe_create(pipe_cfg, &fwd, &fwd_miss, pipe);
 
+destroy_pipe_cfg:
+	doca_flow_pipe_cfg_destroy(pipe_cfg);
+	return result;
+}
 
-doca_error_t xeno_flow(int nb_queues)
+/*
+ * Create the NAT_REVERSE pipe: replies from a NAT backend (source IP, protocol
+ * and port) get the VIP as source again and go to the service's gateway.
+ * Everything else goes on to miss_pipe, or is dropped.
+ */
+static doca_error_t create_nat_pipe(struct doca_flow_port *port,
+				    uint32_t nr_entries,
+				    struct doca_flow_pipe *miss_pipe,
+				    struct doca_flow_pipe **pipe)
 {
-	struct doca_flow_pipe *hash_pipe;
-	int nb_ports = 1;
-	struct flow_resources resource = {0};
-	uint32_t nr_shared_resources[SHARED_RESOURCE_NUM_VALUES] = {0};
-	struct doca_flow_port *ports[1];
-	struct doca_dev *dev_arr[nb_ports];
+	struct doca_flow_match match;
+	struct doca_flow_actions actions, *actions_arr[1];
+	struct doca_flow_fwd fwd, fwd_miss;
+	struct doca_flow_pipe_cfg *pipe_cfg;
 	doca_error_t result;
-	uint32_t action_mem[2] = {0};
 
-	XenoFlow *xeno = calloc(1, sizeof(XenoFlow));
-	XenoFlowConfig *config = load_config();
-	uint32_t hash_pipe_entries = next_power_of_two(config->numBackends);
-	DOCA_LOG_INFO("Number of backends: %d", config->numBackends);
+	memset(&match, 0, sizeof(match));
+	memset(&actions, 0, sizeof(actions));
+	memset(&fwd, 0, sizeof(fwd));
+	memset(&fwd_miss, 0, sizeof(fwd_miss));
+	actions_arr[0] = &actions;
 
+	match.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	match.outer.ip4.src_ip = 0xffffffff;
+	match.outer.ip4.next_proto = 0xff;
+	match.outer.l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_TRANSPORT;
+	match.outer.transport.src_port = 0xffff;
 
-	/* Start HTTP Server with config */
-	if (http_server_start(8080, config) != 0) {
-		DOCA_LOG_ERR("Failed to start HTTP server");
-		return DOCA_ERROR_INITIALIZATION;
+	SET_MAC_ADDR(actions.outer.eth.dst_mac, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff);
+	actions.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	actions.outer.ip4.src_ip = 0xffffffff;
+	actions.outer.l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_TRANSPORT;
+	actions.outer.transport.src_port = 0xffff;
+
+	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		return result;
 	}
 
-	resource.mode = DOCA_FLOW_RESOURCE_MODE_PORT;
-	resource.nr_counters = hash_pipe_entries;
+	result = set_flow_pipe_cfg(pipe_cfg, "NAT_REVERSE", DOCA_FLOW_PIPE_BASIC, false);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, nr_entries);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	result = doca_flow_pipe_cfg_set_match(pipe_cfg, &match, NULL);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
 
-	doca_try(init_doca_flow(nb_queues, "switch", &resource, nr_shared_resources), "Failed to init DOCA Flow", nb_ports, ports);
+	result = doca_flow_pipe_cfg_set_actions(pipe_cfg, actions_arr, NULL, NULL, 1);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg actions: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
 
-	struct doca_dev *dev = open_doca_dev_by_pci("0000:03:00.0");
+	fwd.type = DOCA_FLOW_FWD_PORT;
+	fwd.port_id = 0;
 
-	if (!dev) {
-		DOCA_LOG_INFO("Device not found");
-		return DOCA_ERROR_NOT_FOUND;
+	if (miss_pipe != NULL) {
+		fwd_miss.type = DOCA_FLOW_FWD_PIPE;
+		fwd_miss.next_pipe = miss_pipe;
 	} else {
-		DOCA_LOG_INFO("Device found!");
+		fwd_miss.type = DOCA_FLOW_FWD_DROP;
 	}
 
-	dev_arr[0] = dev;
+	result = doca_flow_pipe_create(pipe_cfg, &fwd, &fwd_miss, pipe);
 
-	ARRAY_INIT(action_mem, ACTIONS_MEM_SIZE(1));
+destroy_pipe_cfg:
+	doca_flow_pipe_cfg_destroy(pipe_cfg);
+	return result;
+}
 
-	doca_try(init_doca_flow_ports(1, ports, true, dev_arr, action_mem, &resource), "Failed to init DOCA ports", nb_ports, ports);
+/*
+ * Root pipe: match the VIP (dst IP, protocol, dst port) and forward to the
+ * service's hash pipe, the next pipe is set per entry. Traffic no VIP matches
+ * goes to the NAT reply pipe or the default service, or is dropped if there is none.
+ */
+static doca_error_t create_vip_pipe(struct doca_flow_port *port,
+				    uint32_t nr_entries,
+				    struct doca_flow_pipe *miss_pipe,
+				    struct doca_flow_pipe **pipe)
+{
+	struct doca_flow_match match;
+	struct doca_flow_fwd fwd, fwd_miss;
+	struct doca_flow_pipe_cfg *pipe_cfg;
+	doca_error_t result;
 
-	doca_try(create_hash_pipe(ports[0], 0, hash_pipe_entries, &hash_pipe), "Failed to create hash pipe", nb_ports, ports);
-	DOCA_LOG_INFO("Starting the load balancer with hash pipe");
+	memset(&match, 0, sizeof(match));
+	memset(&fwd, 0, sizeof(fwd));
+	memset(&fwd_miss, 0, sizeof(fwd_miss));
 
-	xeno->config = config;
-	xeno->ports[0] = ports[0];
-	xeno->hash_pipe = hash_pipe;
-	xeno->hash_pipe_entries = hash_pipe_entries;
-	memset(xeno->hash_entries, 0, sizeof(xeno->hash_entries));
-
-	int initial_backends = config->numBackends;
-	DOCA_LOG_INFO("Adding %d backends via helper", initial_backends);
-	config->numBackends = 0;
-	for (int i = 0; i < initial_backends; i++) {
-		char backend_name[64];
-		char backend_mac[18];
-
-		snprintf(backend_name, sizeof(backend_name), "%s", config->backends[i]->name);
-		snprintf(backend_mac, sizeof(backend_mac), "%02x:%02x:%02x:%02x:%02x:%02x",
-				config->backends[i]->mac_address[0], config->backends[i]->mac_address[1],
-				config->backends[i]->mac_address[2], config->backends[i]->mac_address[3],
-				config->backends[i]->mac_address[4], config->backends[i]->mac_address[5]);
-
-		free(config->backends[i]);
-		config->backends[i] = NULL;
-
-		if (i == 0) {
-			DOCA_LOG_INFO("Replacing %s with a host-target entry", backend_name);
-			doca_try(xenoflow_add_host_entry(xeno, 0, "to-host", backend_mac),
-				 "Failed to add host entry", nb_ports, ports);
-		} else {
-			doca_try(xenoflow_add_backend(xeno, backend_name, backend_mac),
-				 "Failed to add backend", nb_ports, ports);
-		}
+	match.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	match.outer.ip4.dst_ip = 0xffffffff;
+	match.outer.ip4.next_proto = 0xff;
+	/* Matches the destination port of either TCP or UDP */
+	match.outer.l4_type_ext = DOCA_FLOW_L4_TYPE_EXT_TRANSPORT;
+	match.outer.transport.dst_port = 0xffff;
 
-		/*doca_try(xenoflow_add_backend(xeno, backend_name, backend_mac),
-				 "Failed to add backend", nb_ports, ports);*/
+	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		return result;
 	}
 
-	DOCA_LOG_INFO("XenoFlow Load Balancer initialized with %d backends", config->numBackends);
-	
-	int statRefreshIntervall = 5000000;
-	uint64_t last_packets[config->numBackends];
-	memset(last_packets, 0, sizeof(last_packets));
-	
-  	while(1) {
-		DOCA_LOG_INFO("XenoFlow Load Balancer Status - %d backends", config->numBackends);
-		
-		for (int i = 0; i < config->numBackends; i++) {
-			struct doca_flow_resource_query query_stats;
-			doca_error_t query_result;
-			
-			query_result = doca_flow_resource_query_entry(config->backends[i]->entry, &query_stats);
-			
-			uint64_t packets = 0;
-			if (query_result == DOCA_SUCCESS) {
-				packets = query_stats.counter.total_pkts;
-			}
-			
-			DOCA_LOG_INFO("  Entry %d - %s: %lu packets (%lu new)",
-				i, config->backends[i]->name, packets, 
-				(packets > last_packets[i]) ? (packets - last_packets[i]) : 0);
-			
-			last_packets[i] = packets;
-		}
-		DOCA_LOG_INFO("============================================");
-		usleep(statRefreshIntervall);
+	result = set_flow_pipe_cfg(pipe_cfg, "VIP_PIPE", DOCA_FLOW_PIPE_BASIC, true);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	result = stop_doca_flow_ports(nb_ports, ports);
-	doca_flow_destroy();
-	return result;
-}
-
-doca_error_t xenoflow_add_backend(XenoFlow *xeno, char *name, char *mac) {
-	if (xeno == NULL || xeno->config == NULL || xeno->hash_pipe == NULL || xeno->ports[0] == NULL) {
-		DOCA_LOG_ERR("Cannot add backend: XenoFlow is not initialized");
-		return DOCA_ERROR_INVALID_VALUE;
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, nr_entries);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	if (xeno->hash_pipe_entries == 0) {
-		DOCA_LOG_ERR("Cannot add backend: hash pipe entries not initialized");
-		return DOCA_ERROR_INVALID_VALUE;
+	result = doca_flow_pipe_cfg_set_match(pipe_cfg, &match, NULL);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	if (xeno->config->numBackends >= MAX_BACKENDS) {
-		DOCA_LOG_ERR("Cannot add backend: maximum backends (%d) reached", MAX_BACKENDS);
-		return DOCA_ERROR_NO_MEMORY;
-	}
+	fwd.type = DOCA_FLOW_FWD_PIPE;
+	fwd.next_pipe = NULL;
 
-	int entry_index = xeno->config->numBackends;
-	if ((uint32_t)entry_index >= xeno->hash_pipe_entries) {
-		DOCA_LOG_ERR("Cannot add backend: entry index %d exceeds hash pipe size %u", entry_index, xeno->hash_pipe_entries);
-		return DOCA_ERROR_BAD_STATE;
+	if (miss_pipe != NULL) {
+		fwd_miss.type = DOCA_FLOW_FWD_PIPE;
+		fwd_miss.next_pipe = miss_pipe;
+	} else {
+		fwd_miss.type = DOCA_FLOW_FWD_DROP;
 	}
-	XenoFlowBackend *new_backend = createBackend(name, mac);
+
+	result = doca_flow_pipe_create(pipe_cfg, &fwd, &fwd_miss, pipe);
+
+destroy_pipe_cfg:
+	doca_flow_pipe_cfg_destroy(pipe_cfg);
+	return result;
+}
+
+/*
+ * Create the SAMPLE pipe of a service: its one entry mirrors 1 in rate packets
+ * to the sampler, every packet goes on to the hash pipe.
+ */
+static doca_error_t create_sample_pipe(struct doca_flow_port *port,
+				       const char *name,
+				       const XenoFlowSampler *sampler,
+				       struct doca_flow_pipe *hash_pipe,
+				       struct doca_flow_pipe **pipe)
+{
+	struct doca_flow_match match, match_mask;
+	struct doca_flow_monitor monitor;
+	struct doca_flow_fwd fwd, fwd_miss;
+	struct doca_flow_pipe_cfg *pipe_cfg;
 	doca_error_t result;
-	struct entries_status status = {0};
-	struct doca_flow_fwd fwd;
-	struct doca_flow_actions actions;
-	struct doca_flow_pipe_entry *entry = NULL;
 
+	memset(&match, 0, sizeof(match));
+	memset(&match_mask, 0, sizeof(match_mask));
+	memset(&monitor, 0, sizeof(monitor));
 	memset(&fwd, 0, sizeof(fwd));
-	memset(&actions, 0, sizeof(actions));
+	memset(&fwd_miss, 0, sizeof(fwd_miss));
 
-	SET_MAC_ADDR(actions.outer.eth.dst_mac,
-		     new_backend->mac_address[0], new_backend->mac_address[1], new_backend->mac_address[2],
-		     new_backend->mac_address[3], new_backend->mac_address[4], new_backend->mac_address[5]);
-
-	fwd.type = DOCA_FLOW_FWD_PORT;
-	fwd.port_id = 0;
+	xenoflow_sampler_match(sampler, &match, &match_mask);
+	xenoflow_sampler_monitor(sampler, &monitor);
 
-	result = doca_flow_pipe_hash_add_entry(0,
-							xeno->hash_pipe,
-							entry_index,
-							0,
-							&actions,
-							NULL,
-							&fwd,
-							0,
-							&status,
-							&entry);
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to add hash entry %d: %s", entry_index, doca_error_get_descr(result));
-		free(new_backend);
+	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
 		return result;
 	}
 
-	result = doca_flow_entries_process(xeno->ports[0], 0, DEFAULT_TIMEOUT_US, 1);
+	result = set_flow_pipe_cfg(pipe_cfg, name, DOCA_FLOW_PIPE_BASIC, false);
 	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to process hash entry %d: %s", entry_index, doca_error_get_descr(result));
-		free(new_backend);
-		return result;
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	if (status.failure || status.nb_processed != 1) {
-		DOCA_LOG_ERR("Hash entry %d was not fully processed (processed=%d failure=%d)",
-			     entry_index, status.nb_processed, status.failure);
-		free(new_backend);
-		return DOCA_ERROR_BAD_STATE;
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, 1);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	new_backend->entry = entry;
-	xeno->hash_entries[entry_index] = entry;
-	configAddBackend(xeno->config, new_backend);
-	DOCA_LOG_INFO("Added backend %s at hash entry %d", new_backend->name, entry_index);
-	return DOCA_SUCCESS;
-}
-
-doca_error_t xenoflow_add_host_entry(XenoFlow *xeno, uint32_t entry_index, char *name, char *mac) {
-	if (xeno == NULL || xeno->config == NULL || xeno->hash_pipe == NULL || xeno->ports[0] == NULL) {
-		DOCA_LOG_ERR("Cannot add host entry: XenoFlow is not initialized");
-		return DOCA_ERROR_INVALID_VALUE;
+	result = doca_flow_pipe_cfg_set_match(pipe_cfg, &match, &match_mask);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	if (xeno->hash_pipe_entries == 0) {
-		DOCA_LOG_ERR("Cannot add host entry: hash pipe entries not initialized");
-		return DOCA_ERROR_INVALID_VALUE;
+	result = doca_flow_pipe_cfg_set_monitor(pipe_cfg, &monitor);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg monitor: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
 	}
 
-	if (mac == NULL || name == NULL) {
-		DOCA_LOG_ERR("Cannot add host entry: missing name or mac");
-		return DOCA_ERROR_INVALID_VALUE;
-	}
+	fwd.type = DOCA_FLOW_FWD_PIPE;
+	fwd.next_pipe = hash_pipe;
+	fwd_miss.type = DOCA_FLOW_FWD_PIPE;
+	fwd_miss.next_pipe = hash_pipe;
 
-	if (entry_index >= xeno->hash_pipe_entries) {
-		DOCA_LOG_ERR("Cannot add host entry: entry index %u exceeds hash pipe size %u", entry_index, xeno->hash_pipe_entries);
-		return DOCA_ERROR_BAD_STATE;
-	}
+	result = doca_flow_pipe_create(pipe_cfg, &fwd, &fwd_miss, pipe);
 
-	if (xeno->config->numBackends >= MAX_BACKENDS) {
-		DOCA_LOG_ERR("Cannot add host entry: maximum backends (%d) reached", MAX_BACKENDS);
-		return DOCA_ERROR_NO_MEMORY;
-	}
+destroy_pipe_cfg:
+	doca_flow_pipe_cfg_destroy(pipe_cfg);
+	return result;
+}
+
+/* First pipe of a service, where the VIP pipe sends its traffic */
+static struct doca_flow_pipe *service_entry_pipe(const XenoFlowService *service)
+{
+	return service->sample_pipe != NULL ? service->sample_pipe : service->hash_pipe;
+}
+
+/* The VIP, sample or color entry of a service */
+typedef struct {
+	XenoFlowOp op;
+	XenoFlow *xeno;
+	XenoFlowService *service;
+	int res;			/* resource slot of the entry's pipe */
+} ServiceEntryOp;
+
+/* A failed service entry gives back what queue_service_entry() accounted for */
+static void service_entry_failed(ServiceEntryOp *sop)
+{
+	pthread_mutex_lock(&sop->xeno->lock);
+	xenoflow_resources_account_entry(&sop->xeno->resources, sop->res, -1);
+	pthread_mutex_unlock(&sop->xeno->lock);
+}
 
+static doca_error_t submit_vip_entry(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	ServiceEntryOp *vop = (ServiceEntryOp *)op;
+	XenoFlowService *service = vop->service;
+	struct doca_flow_match match;
 	struct doca_flow_fwd fwd;
-	struct doca_flow_actions actions;
-	struct doca_flow_pipe_entry *entry = NULL;
-	struct entries_status status = {0};
-	struct doca_flow_target *kernel_target = NULL;
-	doca_error_t result;
-	XenoFlowBackend *new_backend = createBackend(name, mac);
 
+	memset(&match, 0, sizeof(match));
 	memset(&fwd, 0, sizeof(fwd));
-	memset(&actions, 0, sizeof(actions));
 
-	result = doca_flow_get_target(DOCA_FLOW_TARGET_KERNEL, &kernel_target);
+	match.outer.ip4.dst_ip = service->vip;
+	match.outer.ip4.next_proto = service->protocol;
+	match.outer.transport.dst_port = rte_cpu_to_be_16(service->port);
+
+	fwd.type = DOCA_FLOW_FWD_PIPE;
+	fwd.next_pipe = service_entry_pipe(service);
+
+	return doca_flow_pipe_add_entry(queue, vop->xeno->vip_pipe, &match, NULL, NULL, &fwd, flags,
+					xenoflow_op_usr_ctx(op, NULL), &op->entry);
+}
+
+static void vip_entry_done(XenoFlowOp *op, doca_error_t result)
+{
+	ServiceEntryOp *vop = (ServiceEntryOp *)op;
+
 	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to get kernel target for host forwarding: %s", doca_error_get_descr(result));
-		free(new_backend);
-		return result;
+		DOCA_LOG_ERR("Failed to add VIP entry of service %s: %s", vop->service->name, doca_error_get_descr(result));
+		service_entry_failed(vop);
+		return;
 	}
 
-	if (xeno->hash_entries[entry_index] != NULL) {
-		DOCA_LOG_ERR("Hash entry %u already exists", entry_index);
-		free(new_backend);
-		return DOCA_ERROR_INVALID_VALUE;
-	}
+	xenoflow_evlog(XENOFLOW_EV_VIP_ADD, vop->service->counter_base, vop->service->vip,
+		       (uint64_t)vop->service->protocol << 16 | vop->service->port);
 
-	SET_MAC_ADDR(actions.outer.eth.dst_mac,
-		     new_backend->mac_address[0], new_backend->mac_address[1], new_backend->mac_address[2],
-		     new_backend->mac_address[3], new_backend->mac_address[4], new_backend->mac_address[5]);
+	pthread_mutex_lock(&vop->xeno->lock);
+	vop->service->vip_entry = op->entry;
+	pthread_mutex_unlock(&vop->xeno->lock);
+}
 
-	fwd.type = DOCA_FLOW_FWD_TARGET;
-	fwd.target = kernel_target;
+/* The sample entry has its match, mirror and forward from the pipe */
+static doca_error_t submit_sample_entry(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	ServiceEntryOp *sop = (ServiceEntryOp *)op;
 
-	result = doca_flow_pipe_hash_add_entry(0,
-							xeno->hash_pipe,
-							entry_index,
-							0,
-							&actions,
-							NULL,
-							&fwd,
-							0,
-							&status,
-							&entry);
-	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to add host entry %u: %s", entry_index, doca_error_get_descr(result));
-		free(new_backend);
-		return result;
-	}
+	return doca_flow_pipe_add_entry(queue, sop->service->sample_pipe, NULL, NULL, NULL, NULL, flags,
+					xenoflow_op_usr_ctx(op, NULL), &op->entry);
+}
+
+static void sample_entry_done(XenoFlowOp *op, doca_error_t result)
+{
+	ServiceEntryOp *sop = (ServiceEntryOp *)op;
 
-	result = doca_flow_entries_process(xeno->ports[0], 0, DEFAULT_TIMEOUT_US, 1);
 	if (result != DOCA_SUCCESS) {
-		DOCA_LOG_ERR("Failed to process host entry %u: %s", entry_index, doca_error_get_descr(result));
-		free(new_backend);
-		return result;
+		DOCA_LOG_ERR("Failed to add sample entry of service %s: %s", sop->service->name,
+			     doca_error_get_descr(result));
+		service_entry_failed(sop);
+		return;
 	}
 
-	if (status.failure || status.nb_processed != 1) {
-		DOCA_LOG_ERR("Host entry %u was not fully processed (processed=%d failure=%d)",
-			     entry_index, status.nb_processed, status.failure);
-		free(new_backend);
-		return DOCA_ERROR_BAD_STATE;
-	}
+	pthread_mutex_lock(&sop->xeno->lock);
+	sop->service->sample_entry = op->entry;
+	pthread_mutex_unlock(&sop->xeno->lock);
+}
 
-	new_backend->entry = entry;
-	xeno->hash_entries[entry_index] = entry;
-	configAddBackend(xeno->config, new_backend);
-	DOCA_LOG_INFO("Added host entry %u -> kernel target", entry_index);
-	return DOCA_SUCCESS;
+/* The color entry has its match and forward from the pipe too */
+static doca_error_t submit_color_entry(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	ServiceEntryOp *cop = (ServiceEntryOp *)op;
+
+	return doca_flow_pipe_add_entry(queue, cop->service->color_pipe, NULL, NULL, NULL, NULL, flags,
+					xenoflow_op_usr_ctx(op, NULL), &op->entry);
+}
+
+static void color_entry_done(XenoFlowOp *op, doca_error_t result)
+{
+	ServiceEntryOp *cop = (ServiceEntryOp *)op;
+
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to add color entry of service %s: %s", cop->service->name,
+			     doca_error_get_descr(result));
+		service_entry_failed(cop);
+		return;
+	}
+
+	pthread_mutex_lock(&cop->xeno->lock);
+	cop->service->color_entry = op->entry;
+	pthread_mutex_unlock(&cop->xeno->lock);
+}
+
+static doca_error_t queue_service_entry(XenoFlow *xeno, XenoFlowService *service, xenoflow_op_submit_fn submit,
+					xenoflow_op_done_fn done, int res, XenoFlowOp **op)
+{
+	ServiceEntryOp *vop = (ServiceEntryOp *)xenoflow_op_create(sizeof(ServiceEntryOp), submit, done, NULL, 0);
+	doca_error_t result;
+
+	if (vop == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	vop->xeno = xeno;
+	vop->service = service;
+	vop->res = res;
+
+	/* Accounted before the op can complete, given back by its done on failure */
+	pthread_mutex_lock(&xeno->lock);
+	xenoflow_resources_account_entry(&xeno->resources, res, 1);
+	result = xenoflow_ops_submit(&xeno->ops, &vop->op);
+	if (result != DOCA_SUCCESS)
+		xenoflow_resources_account_entry(&xeno->resources, res, -1);
+	pthread_mutex_unlock(&xeno->lock);
+	if (result != DOCA_SUCCESS) {
+		xenoflow_op_destroy(&vop->op);
+		return result;
+	}
+	*op = &vop->op;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Create the COLOR pipe of a service with spillover, and its SPILL pipe for rehash
+ */
+static doca_error_t create_spillover_pipes(XenoFlow *xeno, XenoFlowService *service)
+{
+	char pipe_name[32];
+	doca_error_t result;
+
+	if (service->spillover == XENOFLOW_SPILLOVER_REHASH) {
+		snprintf(pipe_name, sizeof(pipe_name), "SPILL_%s", service->name);
+		result = create_hash_pipe(xeno->ports[0], pipe_name, service, &xeno->counters, &xeno->meters, 1,
+					  &service->spill_pipe);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to create spill pipe of service %s: %s", service->name,
+				     doca_error_get_descr(result));
+			return result;
+		}
+		result = xenoflow_resources_add_pipe(&xeno->resources, pipe_name, service->spill_pipe,
+						     service->hash_pipe_entries, 0, 1, &service->spill_res);
+		if (result != DOCA_SUCCESS)
+			return result;
+	}
+
+	snprintf(pipe_name, sizeof(pipe_name), "COLOR_%s", service->name);
+	result = create_color_pipe(xeno->ports[0], pipe_name, service->spill_pipe, &service->color_pipe);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create color pipe of service %s: %s", service->name,
+			     doca_error_get_descr(result));
+		return result;
+	}
+	return xenoflow_resources_add_pipe(&xeno->resources, pipe_name, service->color_pipe, 1, 0, 0,
+					   &service->color_res);
+}
+
+/*
+ * Create the hash pipe of a service
+ */
+static doca_error_t create_service_pipe(XenoFlow *xeno, XenoFlowService *service)
+{
+	char pipe_name[32];
+	doca_error_t result;
+
+	/* Metered hash entries forward to the color pipe, so it and the spill pipe go first */
+	if (service->spillover != XENOFLOW_SPILLOVER_NONE) {
+		result = create_spillover_pipes(xeno, service);
+		if (result != DOCA_SUCCESS)
+			return result;
+	}
+
+	snprintf(pipe_name, sizeof(pipe_name), "HASH_%s", service->name);
+	result = create_hash_pipe(xeno->ports[0], pipe_name, service, &xeno->counters, &xeno->meters, 0,
+				  &service->hash_pipe);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create hash pipe of service %s: %s", service->name, doca_error_get_descr(result));
+		return result;
+	}
+
+	result = xenoflow_resources_add_pipe(&xeno->resources, pipe_name, service->hash_pipe,
+					     service->hash_pipe_entries, 1, 1, &service->hash_res);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	service->slots = calloc(service->hash_pipe_entries, sizeof(XenoFlowBackend *));
+	service->entries = calloc(service->hash_pipe_entries, sizeof(struct doca_flow_pipe_entry *));
+	service->entry_ctx = calloc(service->hash_pipe_entries, sizeof(XenoFlowEntryCtx));
+	service->nb_queued = calloc(service->hash_pipe_entries, sizeof(uint32_t));
+	if (service->slots == NULL || service->entries == NULL || service->entry_ctx == NULL ||
+	    service->nb_queued == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	if (xeno->sampler.rate == 0)
+		return DOCA_SUCCESS;
+
+	snprintf(pipe_name, sizeof(pipe_name), "SAMPLE_%s", service->name);
+	result = create_sample_pipe(xeno->ports[0], pipe_name, &xeno->sampler, service->hash_pipe,
+				    &service->sample_pipe);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create sample pipe of service %s: %s", service->name,
+			     doca_error_get_descr(result));
+		return result;
+	}
+	return xenoflow_resources_add_pipe(&xeno->resources, pipe_name, service->sample_pipe, 1, 0, 0,
+					   &service->sample_res);
+}
+
+/*
+ * Queue the configured backends of a service; they move from the loaded
+ * config into a fresh pool as their entries are queued.
+ */
+static doca_error_t queue_service_backends(XenoFlow *xeno, XenoFlowService *service, XenoFlowOp **ops, int *nb_ops)
+{
+	XenoFlowConfig *initial = service->config;
+	doca_error_t result = DOCA_SUCCESS;
+
+	service->config = createConfig();
+	if (service->config == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	DOCA_LOG_INFO("Adding %d backends to service %s", initial->numBackends, service->name);
+	for (int i = 0; i < initial->numBackends; i++) {
+		XenoFlowBackend *b = initial->backends[i];
+
+		if (b->host) {
+			DOCA_LOG_INFO("Replacing %s with a host-target entry", b->name);
+			strcpy(b->name, "to-host");
+		}
+		result = queue_hash_entry(xeno, service, b, UINT32_MAX, NULL, NULL, &ops[*nb_ops]);
+		if (result != DOCA_SUCCESS)
+			break;
+		(*nb_ops)++;
+	}
+
+	destroyConfig(initial);
+	return result;
+}
+
+/* One entry of a spill pipe, with a copy of the spare backend it sends to */
+typedef struct {
+	XenoFlowOp op;
+	XenoFlow *xeno;
+	XenoFlowService *service;
+	XenoFlowBackend backend;
+	uint32_t index;
+} SpillEntryOp;
+
+static doca_error_t submit_spill_entry(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	SpillEntryOp *sop = (SpillEntryOp *)op;
+	struct doca_flow_actions actions;
+
+	memset(&actions, 0, sizeof(actions));
+	set_backend_actions(&actions, sop->service, &sop->backend);
+
+	return doca_flow_pipe_hash_add_entry(queue, sop->service->spill_pipe, sop->index, sop->backend.tunnel,
+					     &actions, NULL, NULL, flags, xenoflow_op_usr_ctx(op, NULL), &op->entry);
+}
+
+static void spill_entry_done(XenoFlowOp *op, doca_error_t result)
+{
+	SpillEntryOp *sop = (SpillEntryOp *)op;
+
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to add spill entry %u of service %s: %s", sop->index, sop->service->name,
+			     doca_error_get_descr(result));
+		pthread_mutex_lock(&sop->xeno->lock);
+		xenoflow_resources_account_entry(&sop->xeno->resources, sop->service->spill_res, -1);
+		pthread_mutex_unlock(&sop->xeno->lock);
+	}
+}
+
+/*
+ * Fill the spill pipe of a service round robin with its backends that have no
+ * rate limit. It is only filled here, spares added later take a restart.
+ */
+static doca_error_t queue_spill_entries(XenoFlow *xeno, XenoFlowService *service, XenoFlowOp **ops, int *nb_ops)
+{
+	XenoFlowBackend **spares = calloc(service->hash_pipe_entries, sizeof(XenoFlowBackend *));
+	uint32_t nb_spares = 0;
+	doca_error_t result = DOCA_SUCCESS;
+
+	if (spares == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	pthread_mutex_lock(&xeno->lock);
+	for (int i = 0; i < service->config->numBackends; i++) {
+		XenoFlowBackend *b = service->config->backends[i];
+
+		if (b->rate_limit == 0 && !b->host && nb_spares < service->hash_pipe_entries)
+			spares[nb_spares++] = b;
+	}
+
+	for (uint32_t i = 0; nb_spares > 0 && i < service->hash_pipe_entries; i++) {
+		SpillEntryOp *sop = (SpillEntryOp *)xenoflow_op_create(sizeof(SpillEntryOp), submit_spill_entry,
+								       spill_entry_done, NULL, 0);
+
+		if (sop == NULL) {
+			result = DOCA_ERROR_NO_MEMORY;
+			break;
+		}
+		sop->xeno = xeno;
+		sop->service = service;
+		sop->backend = *spares[i % nb_spares];
+		sop->index = i;
+
+		result = xenoflow_ops_submit(&xeno->ops, &sop->op);
+		if (result != DOCA_SUCCESS) {
+			xenoflow_op_destroy(&sop->op);
+			break;
+		}
+		xenoflow_resources_account_entry(&xeno->resources, service->spill_res, 1);
+		ops[(*nb_ops)++] = &sop->op;
+	}
+	pthread_mutex_unlock(&xeno->lock);
+	free(spares);
+
+	if (nb_spares == 0)
+		DOCA_LOG_WARN("Service %s has no backend without a rate limit, its spill pipe drops", service->name);
+	else
+		DOCA_LOG_INFO("Service %s spills over %u backends", service->name, nb_spares);
+	return result;
+}
+
+/* A bucket of a service with buckets, handed to another backend */
+typedef struct {
+	XenoFlowOp op;
+	XenoFlow *xeno;
+	XenoFlowService *service;
+	uint32_t bucket;
+	XenoFlowBackend *backend;	/* new owner */
+	XenoFlowBackend *prev;		/* old owner, NULL if the bucket had none */
+	int add;			/* the bucket had no entry yet, accounted for when queued */
+} BucketOp;
+
+/* Adds the bucket's entry the first time, updates it after that */
+static doca_error_t submit_bucket(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	BucketOp *bop = (BucketOp *)op;
+	XenoFlowService *service = bop->service;
+	struct doca_flow_actions actions;
+	struct doca_flow_monitor monitor;
+	struct doca_flow_fwd fwd;
+	doca_error_t result;
+	void *usr_ctx;
+
+	memset(&actions, 0, sizeof(actions));
+	memset(&monitor, 0, sizeof(monitor));
+	memset(&fwd, 0, sizeof(fwd));
+
+	xenoflow_counters_monitor(&bop->xeno->counters, &monitor, service->counter_base + bop->bucket);
+	set_backend_actions(&actions, service, bop->backend);
+	/* Host entries never get more buckets and spillover is off, so it always goes out of the port */
+	fwd.type = DOCA_FLOW_FWD_PORT;
+	fwd.port_id = 0;
+
+	/* The update completes through the context the entry was added with */
+	usr_ctx = xenoflow_op_usr_ctx(op, op->entry_ctx);
+	op->entry = service->entries[bop->bucket];
+	if (op->entry != NULL)
+		result = doca_flow_pipe_update_entry(queue, service->hash_pipe, &actions, &monitor, &fwd, flags,
+						     op->entry);
+	else
+		result = doca_flow_pipe_hash_add_entry(queue, service->hash_pipe, bop->bucket, bop->backend->tunnel,
+						       &actions, &monitor, &fwd, flags, usr_ctx, &op->entry);
+	return result;
+}
+
+static void bucket_done(XenoFlowOp *op, doca_error_t result)
+{
+	BucketOp *bop = (BucketOp *)op;
+	XenoFlow *xeno = bop->xeno;
+	XenoFlowService *service = bop->service;
+
+	pthread_mutex_lock(&xeno->lock);
+	service->nb_queued[bop->bucket]--;
+	if (result == DOCA_SUCCESS && service->entries[bop->bucket] == NULL) {
+		service->entries[bop->bucket] = op->entry;
+		xenoflow_counters_set_entry(&xeno->counters, service->counter_base + bop->bucket, op->entry);
+	} else if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to move bucket %u of service %s to %s: %s", bop->bucket, service->name,
+			     bop->backend->name, doca_error_get_descr(result));
+		if (bop->add)
+			xenoflow_resources_account_entry(&xeno->resources, service->hash_res, -1);
+		/* Hardware still sends the bucket to the old owner, unless it moved on meanwhile */
+		if (service->slots[bop->bucket] == bop->backend) {
+			service->slots[bop->bucket] = bop->prev;
+			bop->backend->nb_buckets--;
+			if (bop->prev != NULL)
+				bop->prev->nb_buckets++;
+		}
+	}
+	pthread_mutex_unlock(&xeno->lock);
+}
+
+/*
+ * Hand a bucket to a backend, called with xeno->lock held. With op set the
+ * caller waits for it, otherwise the operation is detached.
+ */
+static doca_error_t queue_bucket(XenoFlow *xeno, XenoFlowService *service, uint32_t bucket, XenoFlowBackend *backend,
+				 XenoFlowOp **op)
+{
+	BucketOp *bop = (BucketOp *)xenoflow_op_create(sizeof(BucketOp), submit_bucket, bucket_done, NULL, op == NULL);
+	doca_error_t result;
+
+	if (bop == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	bop->xeno = xeno;
+	bop->service = service;
+	bop->bucket = bucket;
+	bop->backend = backend;
+	bop->prev = service->slots[bucket];
+	/* Slots are taken when queued, so a bucket without owner has no entry, added or on its way */
+	bop->add = bop->prev == NULL;
+	bop->op.entry_ctx = &service->entry_ctx[bucket];
+
+	result = xenoflow_ops_submit(&xeno->ops, &bop->op);
+	if (result != DOCA_SUCCESS) {
+		xenoflow_op_destroy(&bop->op);
+		return result;
+	}
+	if (bop->add)
+		xenoflow_resources_account_entry(&xeno->resources, service->hash_res, 1);
+	service->nb_queued[bucket]++;
+
+	service->slots[bucket] = backend;
+	backend->nb_buckets++;
+	if (bop->prev != NULL)
+		bop->prev->nb_buckets--;
+	if (op != NULL)
+		*op = &bop->op;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Deal the buckets no backend took at startup round robin to the backends,
+ * the rebalancer evens out their load from there
+ */
+static doca_error_t queue_spread_buckets(XenoFlow *xeno, XenoFlowService *service, XenoFlowOp **ops, int *nb_ops)
+{
+	XenoFlowConfig *config = service->config;
+	doca_error_t result = DOCA_SUCCESS;
+	int next = 0;
+
+	pthread_mutex_lock(&xeno->lock);
+	for (uint32_t i = 0; i < service->hash_pipe_entries && result == DOCA_SUCCESS; i++) {
+		XenoFlowBackend *owner = NULL;
+
+		if (service->slots[i] != NULL)
+			continue;
+		for (int tries = 0; tries < config->numBackends && owner == NULL; tries++, next++) {
+			if (!config->backends[next % config->numBackends]->host)
+				owner = config->backends[next % config->numBackends];
+		}
+		if (owner == NULL)
+			break;
+
+		result = queue_bucket(xeno, service, i, owner, &ops[*nb_ops]);
+		if (result == DOCA_SUCCESS)
+			(*nb_ops)++;
+	}
+	pthread_mutex_unlock(&xeno->lock);
+	return result;
+}
+
+/*
+ * Queue the backends of a service as a snapshot has them, each at its old hash
+ * entry, then hand every other bucket back to the backend that owned it
+ */
+static doca_error_t queue_restored_backends(XenoFlow *xeno, XenoFlowService *service,
+					    const XenoFlowSnapshotImage *image, int s, XenoFlowOp **ops, int *nb_ops)
+{
+	const XenoFlowSnapService *saved = &image->services[s];
+	doca_error_t result = DOCA_SUCCESS;
+	XenoFlowBackend spec;
+
+	/* The snapshot has the backends of the config plus those added at runtime */
+	destroyConfig(service->config);
+	service->config = createConfig();
+	if (service->config == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	DOCA_LOG_INFO("Restoring %u backends of service %s", saved->nb_backends, service->name);
+	for (uint32_t i = 0; i < saved->nb_backends && result == DOCA_SUCCESS; i++) {
+		const XenoFlowSnapBackend *b = &image->backends[saved->first_backend + i];
+
+		memset(&spec, 0, sizeof(spec));
+		memcpy(spec.name, b->name, sizeof(spec.name) - 1);
+		memcpy(spec.mac_address, b->mac_address, sizeof(spec.mac_address));
+		spec.host = b->host;
+		spec.tunnel = b->tunnel;
+		spec.ip = b->ip;
+		spec.port = b->port;
+		spec.remote = b->remote;
+		spec.vni = b->vni;
+		spec.rate_limit = b->rate_limit;
+		spec.burst = b->burst;
+
+		result = queue_hash_entry(xeno, service, &spec, b->entry_index, NULL, NULL, &ops[*nb_ops]);
+		if (result == DOCA_SUCCESS)
+			(*nb_ops)++;
+	}
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	pthread_mutex_lock(&xeno->lock);
+	for (uint32_t i = 0; i < service->hash_pipe_entries && result == DOCA_SUCCESS; i++) {
+		uint32_t owner = image->owners[service->counter_base + i];
+		XenoFlowBackend *backend;
+
+		if (owner == XENOFLOW_SNAPSHOT_NO_OWNER || service->slots[i] != NULL ||
+		    owner - saved->first_backend >= saved->nb_backends)
+			continue;
+		backend = service->slots[image->backends[owner].entry_index];
+		if (backend == NULL || backend->host)
+			continue;
+
+		result = queue_bucket(xeno, service, i, backend, &ops[*nb_ops]);
+		if (result == DOCA_SUCCESS)
+			(*nb_ops)++;
+	}
+	pthread_mutex_unlock(&xeno->lock);
+	return result;
+}
+
+void xenoflow_backend_stats(const XenoFlowBackend *backend, struct doca_flow_resource_query *stats,
+			    XenoFlowEntryRate *rate)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->counter.total_pkts = backend->pkts;
+	stats->counter.total_bytes = backend->bytes;
+	rate->pps = backend->pps;
+	rate->bps = backend->bps;
+}
+
+/*
+ * Collect the counters and sum them per backend, one pass over the hash
+ * entries of each service, so readers of the backend stats never query hardware
+ */
+static void collect_counters(XenoFlow *xeno)
+{
+	const XenoFlowCounters *counters = &xeno->counters;
+	XenoFlowServices *services = &xeno->services;
+
+	xenoflow_counters_collect(&xeno->counters);
+
+	pthread_mutex_lock(&xeno->lock);
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		XenoFlowConfig *config = service->config;
+
+		for (int i = 0; i < config->numBackends; i++) {
+			XenoFlowBackend *backend = config->backends[i];
+
+			backend->pkts = backend->bytes = 0;
+			backend->pps = backend->bps = 0;
+		}
+
+		/* Without buckets the only entry a backend owns is its home entry */
+		for (uint32_t i = 0; i < service->hash_pipe_entries; i++) {
+			XenoFlowBackend *backend = service->slots[i];
+			uint32_t idx = service->counter_base + i;
+
+			if (backend == NULL)
+				continue;
+			backend->pkts += counters->results[idx].counter.total_pkts;
+			backend->bytes += counters->results[idx].counter.total_bytes;
+			backend->pps += counters->rates[idx].pps;
+			backend->bps += counters->rates[idx].bps;
+		}
+	}
+	pthread_mutex_unlock(&xeno->lock);
+}
+
+/*
+ * Stats timer: one counter collection and a status line per backend
+ */
+static void print_status(uint64_t expirations, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	XenoFlowServices *services = &xeno->services;
+
+	if (expirations > 1)
+		DOCA_LOG_WARN("Status loop fell behind by %lu intervals", expirations - 1);
+
+	DOCA_LOG_INFO("XenoFlow Load Balancer Status - %d services", services->numServices);
+
+	/* One bulk query in shared mode, one query per entry otherwise */
+	collect_counters(xeno);
+
+	pthread_mutex_lock(&xeno->lock);
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		XenoFlowConfig *config = service->config;
+
+		DOCA_LOG_INFO("Service %s - %d backends", service->name, config->numBackends);
+		for (int i = 0; i < config->numBackends; i++) {
+			XenoFlowBackend *backend = config->backends[i];
+			struct doca_flow_resource_query stats;
+			XenoFlowEntryRate rate;
+
+			xenoflow_backend_stats(backend, &stats, &rate);
+
+			/* With an event log, samples go there instead of one log line per backend */
+			if (xenoflow_evlog_on) {
+				xenoflow_evlog(XENOFLOW_EV_COUNTER_SAMPLE, backend->counter_index, stats.counter.total_pkts,
+					       stats.counter.total_bytes);
+				continue;
+			}
+			DOCA_LOG_INFO("  Entry %u - %s: %lu packets, %lu bytes (%.0f pps, %.2f Mbit/s)",
+				backend->entry_index, backend->name,
+				stats.counter.total_pkts, stats.counter.total_bytes, rate.pps, rate.bps / 1e6);
+		}
+	}
+	pthread_mutex_unlock(&xeno->lock);
+
+	if (xeno->sampler.rate != 0)
+		DOCA_LOG_INFO("Sampling 1/%u: %" PRIu64 " samples, %u active flows, %" PRIu64 " records exported",
+			      xeno->sampler.rate, atomic_load(&xeno->sampler.nb_samples), xeno->sampler.cache.nb_active,
+			      atomic_load(&xeno->sampler.nb_flows));
+	for (uint16_t i = 0; i < xeno->slowpath.nb_queues; i++) {
+		XenoFlowSlowPathQueue *q = &xeno->slowpath.queues[i];
+
+		DOCA_LOG_INFO("Slow path queue %u: %" PRIu64 " packets, %" PRIu64 " bytes, %" PRIu64 " replies, %" PRIu64
+			      " unhandled, %" PRIu64 " TX drops",
+			      xeno->slowpath.queue_ids[i], atomic_load(&q->pkts), atomic_load(&q->bytes),
+			      atomic_load(&q->replies), atomic_load(&q->unhandled), atomic_load(&q->tx_drops));
+	}
+	DOCA_LOG_INFO("============================================");
+}
+
+/*
+ * Stream timer: one frame of every backend's counters, encoded once for all
+ * /api/stream subscribers, and nothing at all while there are none
+ */
+static void stream_round(uint64_t expirations, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	XenoFlowServices *services = &xeno->services;
+	XenoFlowStreamSample *samples;
+	uint32_t nb_samples = 0, max_samples = 0;
+
+	(void)expirations;
+	if (xenoflow_stream_subscribers(&xeno->stream) == 0)
+		return;
+	collect_counters(xeno);
+
+	/* Published under the lock, the samples point at the backend names */
+	pthread_mutex_lock(&xeno->lock);
+	for (int s = 0; s < services->numServices; s++)
+		max_samples += services->services[s]->config->numBackends;
+	samples = malloc((max_samples > 0 ? max_samples : 1) * sizeof(*samples));
+	if (samples != NULL) {
+		for (int s = 0; s < services->numServices; s++) {
+			XenoFlowService *service = services->services[s];
+			XenoFlowConfig *config = service->config;
+
+			for (int i = 0; i < config->numBackends; i++) {
+				XenoFlowBackend *backend = config->backends[i];
+				struct doca_flow_resource_query stats;
+				XenoFlowEntryRate rate;
+
+				xenoflow_backend_stats(backend, &stats, &rate);
+				samples[nb_samples++] = (XenoFlowStreamSample){
+					.key = backend,
+					.service = service->name,
+					.name = backend->name,
+					.pkts = stats.counter.total_pkts,
+					.bytes = stats.counter.total_bytes,
+				};
+			}
+		}
+		if (xenoflow_stream_publish(&xeno->stream, samples, nb_samples) != 0)
+			DOCA_LOG_WARN("Failed to publish a stream frame of %u backends", nb_samples);
+	}
+	pthread_mutex_unlock(&xeno->lock);
+	free(samples);
+}
+
+/*
+ * Rebalancing timer: collect the counters and move buckets of overloaded
+ * backends of every service with buckets, as the rebalancer plans them
+ */
+static void rebalance_round(uint64_t expirations, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	XenoFlowServices *services = &xeno->services;
+	uint32_t max_moves = xeno->options.rebalanceMoves;
+	XenoFlowBucketMove moves[max_moves];
+
+	(void)expirations;
+	collect_counters(xeno);
+
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		XenoFlowRebalancer *rb = &xeno->rebalancers[s];
+		XenoFlowConfig *config = service->config;
+		XenoFlowBackend **owners;
+		uint64_t *bytes;
+		uint32_t *owner_of, nb_owners = 0, nb_moves, nb_moved = 0;
+
+		if (rb->nb_buckets == 0)
+			continue;
+
+		bytes = calloc(rb->nb_buckets, sizeof(uint64_t));
+		owners = calloc(rb->nb_buckets, sizeof(XenoFlowBackend *));
+		pthread_mutex_lock(&xeno->lock);
+		owner_of = calloc(config->numBackends > 0 ? config->numBackends : 1, sizeof(uint32_t));
+		if (bytes == NULL || owners == NULL || owner_of == NULL) {
+			pthread_mutex_unlock(&xeno->lock);
+			free(bytes);
+			free(owners);
+			free(owner_of);
+			DOCA_LOG_ERR("Rebalance: out of memory");
+			return;
+		}
+
+		/* Planner owners are the backends buckets may move between, host entries keep theirs */
+		for (int i = 0; i < config->numBackends; i++) {
+			if (config->backends[i]->host) {
+				owner_of[i] = XENOFLOW_REBALANCE_PINNED;
+				continue;
+			}
+			owner_of[i] = nb_owners;
+			owners[nb_owners++] = config->backends[i];
+		}
+		for (uint32_t i = 0; i < rb->nb_buckets; i++) {
+			XenoFlowBackend *b = service->slots[i];
+
+			bytes[i] = xeno->counters.results[service->counter_base + i].counter.total_bytes;
+			rb->owner[i] = b != NULL ? owner_of[b->pool_index] : XENOFLOW_REBALANCE_PINNED;
+			/* A bucket with an op still queued moves once that is done */
+			rb->fixed[i] = (b != NULL && b->entry_index == i) || service->nb_queued[i] != 0;
+		}
+
+		nb_moves = xenoflow_rebalance_plan(rb, bytes, nb_owners, xeno->options.rebalanceThreshold, max_moves,
+						   moves);
+		for (uint32_t m = 0; m < nb_moves; m++) {
+			XenoFlowBackend *from = owners[moves[m].from], *to = owners[moves[m].to];
+
+			if (queue_bucket(xeno, service, moves[m].bucket, to, NULL) != DOCA_SUCCESS)
+				break;
+			nb_moved++;
+			xenoflow_evlog(XENOFLOW_EV_BUCKET_MOVE, service->counter_base + moves[m].bucket,
+				       from->counter_index, to->counter_index);
+		}
+		pthread_mutex_unlock(&xeno->lock);
+
+		if (nb_moved > 0)
+			DOCA_LOG_INFO("Rebalance %s: moved %u buckets, busiest backend at %.0f%% of the mean",
+				      service->name, nb_moved, rb->spread * 100);
+		free(bytes);
+		free(owners);
+		free(owner_of);
+	}
+}
+
+static void reload_backend_done(XenoFlowBackend *backend, doca_error_t result, void *arg)
+{
+	(void)arg;
+
+	if (result != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Reload: failed to add backend %s: %s", backend->name, doca_error_get_descr(result));
+}
+
+/*
+ * Re-read the config file and add the backends it has that are not running yet.
+ * Pipes are sized at startup, so new services and removed backends take a restart.
+ */
+static void reload_config(void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	XenoFlowServices loaded;
+	int added = 0;
+
+	if (xeno->options.configPath[0] == '\0') {
+		DOCA_LOG_WARN("Reload: running the built-in pool, there is no config file to reload");
+		return;
+	}
+
+	xenoflow_services_init(&loaded);
+	if (xenoflow_services_load(xeno->options.configPath, &loaded) != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Reload: failed to load %s, keeping the running config", xeno->options.configPath);
+		xenoflow_services_destroy(&loaded);
+		return;
+	}
+
+	for (int s = 0; s < loaded.numServices; s++) {
+		XenoFlowConfig *config = loaded.services[s]->config;
+		XenoFlowService *service = xenoflow_services_find(&xeno->services, loaded.services[s]->name);
+
+		if (service == NULL) {
+			DOCA_LOG_WARN("Reload: new service %s needs a restart", loaded.services[s]->name);
+			continue;
+		}
+
+		for (int i = 0; i < config->numBackends; i++) {
+			XenoFlowBackend *backend = config->backends[i];
+			int running;
+
+			/* The host entry runs as "to-host", found by its address */
+			pthread_mutex_lock(&xeno->lock);
+			running = configFindBackend(service->config, backend->name) != NULL ||
+				  configFindBackendByAddress(service->config, backend) != NULL;
+			pthread_mutex_unlock(&xeno->lock);
+			if (running)
+				continue;
+
+			if (xenoflow_add_backend_async(xeno, service, backend, reload_backend_done, NULL) == DOCA_SUCCESS)
+				added++;
+		}
+	}
+
+	xenoflow_evlog(XENOFLOW_EV_RELOAD, added, 0, 0);
+	DOCA_LOG_INFO("Reload: queued %d new backends from %s", added, xeno->options.configPath);
+	xenoflow_services_destroy(&loaded);
+}
+
+static void handle_signal(int signo, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	doca_error_t result;
+
+	if (signo == SIGHUP) {
+		DOCA_LOG_INFO("SIGHUP received, reloading %s", xeno->options.configPath);
+		reload_config(xeno);
+		return;
+	}
+
+	if (signo == SIGUSR1) {
+		/* A standby instance on the port gets the traffic from the moment this one disconnects */
+		result = doca_flow_port_operation_state_modify(xeno->ports[0], DOCA_FLOW_PORT_OPERATION_STATE_UNCONNECTED);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to hand the port over, still serving: %s", doca_error_get_descr(result));
+			return;
+		}
+		xeno->port_state = DOCA_FLOW_PORT_OPERATION_STATE_UNCONNECTED;
+		DOCA_LOG_INFO("SIGUSR1 received, port handed over, stopping");
+		xenoflow_loop_stop(&xeno->loop);
+		return;
+	}
+
+	DOCA_LOG_INFO("Signal %d received, stopping", signo);
+	xenoflow_loop_stop(&xeno->loop);
+}
+
+void xeno_flow_signals(sigset_t *signals)
+{
+	sigemptyset(signals);
+	sigaddset(signals, SIGINT);
+	sigaddset(signals, SIGTERM);
+	sigaddset(signals, SIGHUP);
+	sigaddset(signals, SIGUSR1);
+}
+
+/*
+ * Snapshot timer: fresh counters and the current mapping into the region not written last
+ */
+static void snapshot_round(uint64_t expirations, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+
+	(void)expirations;
+	collect_counters(xeno);
+	pthread_mutex_lock(&xeno->lock);
+	xenoflow_snapshot_write(&xeno->snapshot, &xeno->services, &xeno->counters);
+	pthread_mutex_unlock(&xeno->lock);
+}
+
+/*
+ * Replace the snapshot file with one of this instance and write it periodically from now on
+ */
+static doca_error_t start_snapshots(XenoFlow *xeno)
+{
+	doca_error_t result;
+
+	collect_counters(xeno);
+	pthread_mutex_lock(&xeno->lock);
+	result = xenoflow_snapshot_open(&xeno->snapshot, xeno->options.snapshotPath, &xeno->services,
+					&xeno->counters, xeno->config_version);
+	pthread_mutex_unlock(&xeno->lock);
+	if (result != DOCA_SUCCESS)
+		return result;
+	return xenoflow_loop_add_timer(&xeno->loop, xeno->options.snapshotIntervalMs, snapshot_round, xeno);
+}
+
+/*
+ * History timer: the traffic of every backend since the last round into the current second
+ */
+static void history_round(uint64_t expirations, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	XenoFlowServices *services = &xeno->services;
+	XenoFlowHistorySample *samples;
+	uint32_t nb_samples = 0, max_samples = 0;
+
+	(void)expirations;
+	collect_counters(xeno);
+
+	/* Appended under the lock, the samples point at the backend names */
+	pthread_mutex_lock(&xeno->lock);
+	for (int s = 0; s < services->numServices; s++)
+		max_samples += services->services[s]->config->numBackends;
+	samples = malloc((max_samples > 0 ? max_samples : 1) * sizeof(*samples));
+	if (samples != NULL) {
+		for (int s = 0; s < services->numServices; s++) {
+			XenoFlowService *service = services->services[s];
+			XenoFlowConfig *config = service->config;
+
+			for (int i = 0; i < config->numBackends; i++) {
+				XenoFlowBackend *backend = config->backends[i];
+				struct doca_flow_resource_query stats;
+				XenoFlowEntryRate rate;
+
+				xenoflow_backend_stats(backend, &stats, &rate);
+				samples[nb_samples++] = (XenoFlowHistorySample){
+					.key = backend,
+					.service = service->name,
+					.name = backend->name,
+					.pkts = stats.counter.total_pkts,
+					.bytes = stats.counter.total_bytes,
+				};
+			}
+		}
+		xenoflow_history_append(&xeno->history, (uint64_t)time(NULL), samples, nb_samples);
+	}
+	pthread_mutex_unlock(&xeno->lock);
+	free(samples);
+}
+
+/*
+ * Open the history file and append to it every second from now on
+ */
+static doca_error_t start_history(XenoFlow *xeno)
+{
+	doca_error_t result;
+
+	result = xenoflow_history_open(&xeno->history, xeno->options.historyPath, xeno->options.historySizeMb);
+	if (result != DOCA_SUCCESS)
+		return result;
+	return xenoflow_loop_add_timer(&xeno->loop, 1000, history_round, xeno);
+}
+
+/*
+ * The instance being taken over exited, the pidfd became readable
+ */
+static void takeover_done(int fd, uint32_t events, void *arg)
+{
+	XenoFlow *xeno = (XenoFlow *)arg;
+	doca_error_t result;
+
+	(void)events;
+	close(fd);
+	xeno->takeover_fd = -1;
+
+	/* Traffic is here since the old instance disconnected; going active lets the next upgrade take over from us */
+	result = doca_flow_port_operation_state_modify(xeno->ports[0], DOCA_FLOW_PORT_OPERATION_STATE_ACTIVE);
+	if (result != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Failed to make the port active: %s", doca_error_get_descr(result));
+	else
+		xeno->port_state = DOCA_FLOW_PORT_OPERATION_STATE_ACTIVE;
+	DOCA_LOG_INFO("PID %d exited, takeover complete", xeno->options.takeoverPid);
+	xenoflow_startup_ready("takeover");
+
+	/* The old instance held the HTTP port and wrote the snapshot and history until now */
+	if (http_server_start(8080, xeno) != 0)
+		DOCA_LOG_ERR("Failed to start HTTP server after the takeover");
+	if (xeno->options.snapshotPath[0] != '\0' && start_snapshots(xeno) != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Failed to start snapshots after the takeover");
+	if (xeno->options.historyPath[0] != '\0' && start_history(xeno) != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Failed to start the history after the takeover");
+}
+
+/*
+ * Watch the old instance and tell it to hand the port over, all entries of this one are installed
+ */
+static doca_error_t start_takeover(XenoFlow *xeno)
+{
+	doca_error_t result;
+
+	result = xenoflow_loop_add_fd(&xeno->loop, xeno->takeover_fd, EPOLLIN | EPOLLONESHOT, takeover_done, xeno);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	if (kill(xeno->options.takeoverPid, SIGUSR1) != 0) {
+		DOCA_LOG_ERR("Failed to signal PID %d: %s", xeno->options.takeoverPid, strerror(errno));
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+	DOCA_LOG_INFO("Standby ready, asked PID %d to hand the port over", xeno->options.takeoverPid);
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_request_reload(XenoFlow *xeno)
+{
+	return xenoflow_loop_post(&xeno->loop, reload_config, xeno);
+}
+
+/*
+ * Wait for queued operations, all of them, even after a failure
+ */
+static doca_error_t wait_ops(XenoFlowOp **ops, int nb_ops)
+{
+	doca_error_t result = DOCA_SUCCESS;
+
+	for (int i = 0; i < nb_ops; i++) {
+		doca_error_t op_result = xenoflow_op_wait(ops[i]);
+
+		if (op_result != DOCA_SUCCESS && result == DOCA_SUCCESS)
+			result = op_result;
+		xenoflow_op_destroy(ops[i]);
+	}
+	return result;
+}
+
+/*
+ * Device discovery walks every device of the host, so it runs while the config is parsed. With
+ * --device the device is opened there too, else it is only enumerated until the config names one.
+ */
+typedef struct {
+	pthread_t thread;
+	int started;		/* the thread runs, else the device is opened on join */
+	const char *selector;	/* NULL to only enumerate */
+	struct doca_dev *dev;
+} DeviceOpen;
+
+static void *device_open_thread(void *arg)
+{
+	DeviceOpen *open = (DeviceOpen *)arg;
+	int phase = xenoflow_phase_begin("devices", 1);
+
+	if (open->selector != NULL)
+		xenoflow_device_open(open->selector, &open->dev);
+	else
+		xenoflow_devices_enumerate();
+	xenoflow_phase_end(phase);
+	return NULL;
+}
+
+static void device_open_start(DeviceOpen *open, const char *selector)
+{
+	open->selector = selector;
+	open->dev = NULL;
+	open->started = pthread_create(&open->thread, NULL, device_open_thread, open) == 0;
+}
+
+/* Opens the device named by the config if the thread had none, NULL to only wait for the thread */
+static struct doca_dev *device_open_join(DeviceOpen *open, const char *config_selector)
+{
+	if (open->started)
+		pthread_join(open->thread, NULL);
+	else
+		device_open_thread(open);
+	open->started = 0;
+	if (open->dev == NULL && open->selector == NULL && config_selector != NULL)
+		xenoflow_device_open(config_selector[0] != '\0' ? config_selector : XENOFLOW_DEFAULT_DEVICE,
+				     &open->dev);
+	return open->dev;
+}
+
+void xeno_flow_options_init(XenoFlowOptions *options)
+{
+	memset(options, 0, sizeof(*options));
+	options->statsIntervalMs = DEFAULT_STATS_INTERVAL_MS;
+	options->rebalanceMoves = DEFAULT_REBALANCE_MOVES;
+	options->rebalanceThreshold = DEFAULT_REBALANCE_THRESHOLD;
+	options->snapshotIntervalMs = DEFAULT_SNAPSHOT_INTERVAL_MS;
+	options->streamIntervalMs = DEFAULT_STREAM_INTERVAL_MS;
+	options->historySizeMb = DEFAULT_HISTORY_SIZE_MB;
+	options->slowPathCpu = -1;
+}
+
+doca_error_t xeno_flow(int nb_queues, const XenoFlowOptions *options)
+{
+	int nb_ports = 1;
+	struct flow_resources resource = {0};
+	uint32_t nr_shared_resources[SHARED_RESOURCE_NUM_VALUES] = {0};
+	struct doca_flow_port *ports[1];
+	struct doca_dev *dev_arr[nb_ports];
+	struct doca_dev *dev = NULL;
+	doca_error_t result;
+	uint32_t action_mem[2] = {0};
+	uint32_t total_hash_entries = 0;
+	uint32_t nr_vip_services = 0;
+	uint32_t nr_nat_entries = 0;
+	uint32_t nr_metered_entries = 0;
+	uint32_t nr_spill_entries = 0;
+	struct doca_flow_pipe *vip_miss;
+
+	XenoFlow *xeno = calloc(1, sizeof(XenoFlow));
+	XenoFlowServices *services;
+	XenoFlowOp **init_ops;
+	int nb_init_ops = 0;
+	sigset_t signals;
+	XenoFlowSnapshotImage image = {0};
+	int warm = 0;
+	DeviceOpen device_open;
+	int phase, http_ok = 1;
+	int flow_queues;
+	/* What is up so far, the unwind stops it in reverse */
+	int device_opening = 0, flow_started = 0, ports_started = 0, ops_started = 0, loop_started = 0;
+
+	if (xeno == NULL) {
+		DOCA_LOG_ERR("Failed to allocate XenoFlow");
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	services = &xeno->services;
+	pthread_mutex_init(&xeno->lock, NULL);
+	xenoflow_services_init(services);
+	xenoflow_stream_init(&xeno->stream);
+	xeno->takeover_fd = -1;
+
+	if (options != NULL)
+		xeno->options = *options;
+	else
+		xeno_flow_options_init(&xeno->options);
+
+	/* The slow path's RX queues come after the ones DOCA Flow and the sampler use */
+	flow_queues = nb_queues - xeno->options.slowPathQueues;
+	if (flow_queues < 1) {
+		DOCA_LOG_ERR("%d queues leave none besides the %d of the slow path", nb_queues,
+			     xeno->options.slowPathQueues);
+		result = DOCA_ERROR_INVALID_VALUE;
+		goto unwind;
+	}
+
+	/* A takeover starts in standby: the port gets no traffic while the old instance is connected */
+	xeno->port_state = DOCA_FLOW_PORT_OPERATION_STATE_ACTIVE;
+	if (xeno->options.takeoverPid != 0) {
+		xeno->takeover_fd = (int)syscall(SYS_pidfd_open, xeno->options.takeoverPid, 0);
+		if (xeno->takeover_fd < 0) {
+			DOCA_LOG_ERR("Cannot take over from PID %d: %s", xeno->options.takeoverPid, strerror(errno));
+			result = DOCA_ERROR_NOT_FOUND;
+			goto unwind;
+		}
+		xeno->port_state = DOCA_FLOW_PORT_OPERATION_STATE_STANDBY;
+	}
+
+	if (xeno->options.evlogPath[0] != '\0' && xenoflow_evlog_start(xeno->options.evlogPath) != 0) {
+		result = DOCA_ERROR_IO_FAILED;
+		goto unwind;
+	}
+
+	device_open_start(&device_open, xeno->options.device[0] != '\0' ? xeno->options.device : NULL);
+	device_opening = 1;
+
+	phase = xenoflow_phase_begin("config", 0);
+	result = load_services(&xeno->options, services);
+	if (result != DOCA_SUCCESS)
+		goto unwind;
+
+	/* Each service's hash pipe gets its own, contiguous range of counters */
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+
+		service->hash_pipe_entries = next_power_of_two(service->config->numBackends > (int)service->buckets
+									? (uint32_t)service->config->numBackends
+									: service->buckets);
+		service->counter_base = total_hash_entries;
+		total_hash_entries += service->hash_pipe_entries;
+		if (service->protocol != 0)
+			nr_vip_services++;
+		if (service->nat)
+			nr_nat_entries += service->hash_pipe_entries;
+		if (service->spillover != XENOFLOW_SPILLOVER_NONE)
+			nr_metered_entries += service->hash_pipe_entries;
+		if (service->spillover == XENOFLOW_SPILLOVER_REHASH)
+			nr_spill_entries += service->hash_pipe_entries;
+	}
+	xeno->vip_pipe_entries = next_power_of_two(nr_vip_services);
+	xeno->nat_pipe_entries = nr_nat_entries;
+
+	xenoflow_phase_end(phase);
+
+	result = xenoflow_counters_init(&xeno->counters, xeno->options.sharedCounters, total_hash_entries);
+	if (result != DOCA_SUCCESS)
+		goto unwind;
+
+	/* A snapshot of this config gives back the runtime backends, the bucket owners and the counter totals */
+	xeno->config_version = xenoflow_snapshot_config_version(xeno->options.configPath);
+	if (xeno->options.snapshotPath[0] != '\0') {
+		phase = xenoflow_phase_begin("snapshot", 0);
+		if (xenoflow_snapshot_load(xeno->options.snapshotPath, services, total_hash_entries,
+					   xeno->config_version, &image) == DOCA_SUCCESS) {
+			warm = 1;
+			for (uint32_t i = 0; i < total_hash_entries; i++)
+				xenoflow_counters_set_baseline(&xeno->counters, i, image.counters[i].pkts,
+							       image.counters[i].bytes);
+		}
+		xenoflow_phase_end(phase);
+	}
+
+	/* Meter ids follow the counter indexes, so there is one per hash entry once any service meters */
+	result = xenoflow_meters_init(&xeno->meters, nr_metered_entries > 0 ? total_hash_entries : 0);
+	if (result == DOCA_SUCCESS)
+		/* Samples arrive on the last RX queue of port 0 before the slow path's */
+		result = xenoflow_sampler_init(&xeno->sampler, xeno->options.sampleRate, xeno->options.ipfixCollector,
+					       0, flow_queues - 1);
+	if (result == DOCA_SUCCESS)
+		result = xenoflow_slowpath_init(&xeno->slowpath, xeno->options.slowPathQueues, 0, flow_queues,
+						xeno->options.slowPathCpu);
+	if (result != DOCA_SUCCESS)
+		goto unwind;
+
+	resource.mode = DOCA_FLOW_RESOURCE_MODE_PORT;
+	if (xeno->options.sharedCounters)
+		nr_shared_resources[DOCA_FLOW_SHARED_RESOURCE_COUNTER] = total_hash_entries;
+	else
+		resource.nr_counters = total_hash_entries;
+	if (xeno->sampler.rate != 0)
+		nr_shared_resources[DOCA_FLOW_SHARED_RESOURCE_MIRROR] = 1;
+	nr_shared_resources[DOCA_FLOW_SHARED_RESOURCE_METER] = xeno->meters.nb_meters;
+
+	/* Entry completions are routed to the operation that queued the entry */
+	phase = xenoflow_phase_begin("flow_init", 0);
+	result = init_doca_flow_cb(flow_queues, "switch", &resource, nr_shared_resources, xenoflow_ops_entry_cb, NULL);
+	xenoflow_phase_end(phase);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to init DOCA Flow: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	flow_started = 1;
+
+	dev = device_open_join(&device_open, services->device);
+	device_opening = 0;
+	if (!dev) {
+		DOCA_LOG_INFO("Device not found");
+		result = DOCA_ERROR_NOT_FOUND;
+		goto unwind;
+	}
+
+	dev_arr[0] = dev;
+
+	/* Every hash, spill and NAT reply entry rewrites headers, so reserve action memory for all of them */
+	ARRAY_INIT(action_mem, ACTIONS_MEM_SIZE(total_hash_entries + nr_spill_entries + nr_nat_entries));
+
+	phase = xenoflow_phase_begin("ports", 0);
+	result = init_doca_flow_ports_with_op_state(1, ports, true, dev_arr, &xeno->port_state, action_mem, &resource);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to init DOCA ports: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	ports_started = 1;
+
+	result = xenoflow_counters_bind(&xeno->counters, ports[0]);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind shared counters: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	result = xenoflow_sampler_bind(&xeno->sampler, ports[0]);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind sample mirror: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	result = xenoflow_meters_bind(&xeno->meters, ports[0]);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind shared meters: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+
+	xeno->ports[0] = ports[0];
+	xenoflow_resources_init(&xeno->resources, total_hash_entries, action_mem[0]);
+	xenoflow_phase_end(phase);
+
+	/* All pipes first, their entries then go out in batches through the poller */
+	phase = xenoflow_phase_begin("pipes", 0);
+	for (int s = 0; s < services->numServices; s++) {
+		result = create_service_pipe(xeno, services->services[s]);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to create service: %s", doca_error_get_descr(result));
+			goto unwind;
+		}
+	}
+
+	/* VIP misses are either NAT replies or default service traffic */
+	vip_miss = services->defaultService ? service_entry_pipe(services->defaultService) : NULL;
+	if (nr_nat_entries > 0) {
+		result = create_nat_pipe(ports[0], nr_nat_entries, vip_miss, &xeno->nat_pipe);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to create NAT reverse pipe: %s", doca_error_get_descr(result));
+			goto unwind;
+		}
+		result = xenoflow_resources_add_pipe(&xeno->resources, "NAT_REVERSE", xeno->nat_pipe, nr_nat_entries,
+						     0, 1, &xeno->nat_res);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to track NAT reverse pipe resources: %s", doca_error_get_descr(result));
+			goto unwind;
+		}
+		vip_miss = xeno->nat_pipe;
+	}
+
+	result = create_vip_pipe(ports[0], xeno->vip_pipe_entries, vip_miss, &xeno->vip_pipe);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create VIP pipe: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	result = xenoflow_resources_add_pipe(&xeno->resources, "VIP_PIPE", xeno->vip_pipe, xeno->vip_pipe_entries, 0, 0,
+					     &xeno->vip_res);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to track VIP pipe resources: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+
+	xenoflow_phase_end(phase);
+
+	/* Queue 0 belongs to the poller from here on */
+	result = xenoflow_ops_start(&xeno->ops, ports[0], 0);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to start entry poller: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	ops_started = 1;
+	/* Calls the API posts before the loop runs wait in it */
+	result = xenoflow_loop_init(&xeno->loop);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create event loop: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	loop_started = 1;
+	phase = xenoflow_phase_begin("entries", 0);
+
+	/* Hash entries of backends and spread buckets, spill entries, plus a VIP, a sample and a color entry per service */
+	init_ops = calloc(total_hash_entries + nr_spill_entries + 3 * services->numServices, sizeof(XenoFlowOp *));
+	if (init_ops == NULL) {
+		DOCA_LOG_ERR("Failed to allocate init operations");
+		result = DOCA_ERROR_NO_MEMORY;
+		goto unwind;
+	}
+
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+
+		if (warm)
+			result = queue_restored_backends(xeno, service, &image, s, init_ops, &nb_init_ops);
+		else
+			result = queue_service_backends(xeno, service, init_ops, &nb_init_ops);
+		if (result == DOCA_SUCCESS && service->buckets != 0)
+			result = queue_spread_buckets(xeno, service, init_ops, &nb_init_ops);
+		if (result == DOCA_SUCCESS && service->protocol != 0) {
+			result = queue_service_entry(xeno, service, submit_vip_entry, vip_entry_done,
+						     xeno->vip_res, &init_ops[nb_init_ops]);
+			if (result == DOCA_SUCCESS)
+				nb_init_ops++;
+		}
+		if (result == DOCA_SUCCESS && service->sample_pipe != NULL) {
+			result = queue_service_entry(xeno, service, submit_sample_entry, sample_entry_done,
+						     service->sample_res, &init_ops[nb_init_ops]);
+			if (result == DOCA_SUCCESS)
+				nb_init_ops++;
+		}
+		if (result == DOCA_SUCCESS && service->color_pipe != NULL) {
+			result = queue_service_entry(xeno, service, submit_color_entry, color_entry_done,
+						     service->color_res, &init_ops[nb_init_ops]);
+			if (result == DOCA_SUCCESS)
+				nb_init_ops++;
+		}
+		if (result == DOCA_SUCCESS && service->spill_pipe != NULL)
+			result = queue_spill_entries(xeno, service, init_ops, &nb_init_ops);
+		if (result != DOCA_SUCCESS)
+			break;
+	}
+
+	/* The API comes up while the hardware works through the queue, every hash entry is reserved by now */
+	if (result == DOCA_SUCCESS && xeno->takeover_fd < 0) {
+		int http_phase = xenoflow_phase_begin("http", 0);
+
+		http_ok = http_server_start(8080, xeno) == 0;
+		xenoflow_phase_end(http_phase);
+	}
+
+	/* Everything queued so far must complete before the ops can be freed */
+	if (result == DOCA_SUCCESS)
+		result = wait_ops(init_ops, nb_init_ops);
+	else
+		wait_ops(init_ops, nb_init_ops);
+	free(init_ops);
+	xenoflow_snapshot_image_free(&image);
+	xenoflow_phase_end(phase);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to add initial entries: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	result = xenoflow_sampler_start(&xeno->sampler);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to start sampler: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+	result = xenoflow_slowpath_start(&xeno->slowpath);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to start slow path: %s", doca_error_get_descr(result));
+		goto unwind;
+	}
+
+	/* Services with buckets get a rebalancer, the others stay at nb_buckets 0 */
+	xeno->rebalancers = calloc(services->numServices, sizeof(XenoFlowRebalancer));
+	if (xeno->rebalancers == NULL) {
+		DOCA_LOG_ERR("Failed to allocate rebalancers");
+		result = DOCA_ERROR_NO_MEMORY;
+		goto unwind;
+	}
+	for (int s = 0; s < services->numServices && xeno->options.rebalanceIntervalMs > 0; s++) {
+		XenoFlowService *service = services->services[s];
+
+		if (service->buckets != 0 && xenoflow_rebalance_init(&xeno->rebalancers[s], service->hash_pipe_entries) != 0) {
+			DOCA_LOG_ERR("Failed to allocate rebalancer");
+			result = DOCA_ERROR_NO_MEMORY;
+			goto unwind;
+		}
+	}
+
+	/* After a takeover the HTTP server starts once the old instance is gone */
+	if (!http_ok) {
+		DOCA_LOG_ERR("Failed to start HTTP server");
+		result = DOCA_ERROR_INITIALIZATION;
+		goto unwind;
+	}
+
+	DOCA_LOG_INFO("XenoFlow Load Balancer initialized with %d services (%s counters)", services->numServices,
+		      xeno->options.sharedCounters ? "shared" : "per-entry");
+	xenoflow_resources_report(&xeno->resources);
+	if (xeno->takeover_fd < 0)
+		xenoflow_startup_ready(warm ? "warm" : "cold");
+	
+	/* From here on the main thread only reacts to events: stats timer, signals and posted calls */
+	xeno_flow_signals(&signals);
+	result = xenoflow_loop_add_signals(&xeno->loop, &signals, handle_signal, xeno);
+	if (result == DOCA_SUCCESS)
+		result = xenoflow_loop_add_timer(&xeno->loop, xeno->options.statsIntervalMs, print_status, xeno);
+	if (result == DOCA_SUCCESS && xeno->options.streamIntervalMs > 0)
+		result = xenoflow_loop_add_timer(&xeno->loop, xeno->options.streamIntervalMs, stream_round, xeno);
+	if (result == DOCA_SUCCESS && xeno->options.rebalanceIntervalMs > 0)
+		result = xenoflow_loop_add_timer(&xeno->loop, xeno->options.rebalanceIntervalMs, rebalance_round, xeno);
+	/* A takeover writes the snapshot and history files once the old instance stopped writing them */
+	if (result == DOCA_SUCCESS && xeno->options.snapshotPath[0] != '\0' && xeno->takeover_fd < 0)
+		result = start_snapshots(xeno);
+	if (result == DOCA_SUCCESS && xeno->options.historyPath[0] != '\0' && xeno->takeover_fd < 0)
+		result = start_history(xeno);
+	if (result == DOCA_SUCCESS && xeno->takeover_fd >= 0)
+		result = start_takeover(xeno);
+	if (result == DOCA_SUCCESS)
+		result = xenoflow_loop_run(&xeno->loop);
+	if (result != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Event loop failed: %s", doca_error_get_descr(result));
+
+	DOCA_LOG_INFO("Shutting down");
+
+	/* Shutdown and every failure above end here, only what was set up is taken down */
+unwind:
+	http_server_stop();
+	if (xeno->snapshot.map != NULL) {
+		/* The last totals, so a restart continues from here */
+		snapshot_round(1, xeno);
+		xenoflow_snapshot_close(&xeno->snapshot);
+	}
+	xenoflow_history_close(&xeno->history);
+	if (xeno->rebalancers != NULL) {
+		for (int s = 0; s < services->numServices; s++)
+			xenoflow_rebalance_destroy(&xeno->rebalancers[s]);
+		free(xeno->rebalancers);
+	}
+	xenoflow_slowpath_stop(&xeno->slowpath);
+	xenoflow_sampler_stop(&xeno->sampler);
+	if (loop_started)
+		xenoflow_loop_destroy(&xeno->loop);
+	if (ops_started)
+		xenoflow_ops_stop(&xeno->ops);
+	if (ports_started)
+		stop_doca_flow_ports(nb_ports, ports);
+	/* With --device the device thread opened the device, join it so that it is closed too */
+	if (device_opening)
+		dev = device_open_join(&device_open, NULL);
+	if (flow_started)
+		doca_flow_destroy();
+	if (dev != NULL)
+		doca_dev_close(dev);
+	xenoflow_devices_release();
+	xenoflow_meters_destroy(&xeno->meters);
+	xenoflow_snapshot_image_free(&image);
+	xenoflow_services_destroy(services);
+	xenoflow_evlog_stop();
+	if (xeno->takeover_fd >= 0)
+		close(xeno->takeover_fd);
+	xenoflow_stream_destroy(&xeno->stream);
+	pthread_mutex_destroy(&xeno->lock);
+	free(xeno);
+	return result;
+}
+
+typedef struct {
+	XenoFlowOp op;
+	XenoFlow *xeno;
+	XenoFlowService *service;
+	XenoFlowBackend *backend;
+	struct doca_flow_fwd fwd;
+	xenoflow_backend_cb done;
+	void *done_arg;
+	doca_error_t hash_error;	/* hash add failed after the NAT reply entry went out */
+	XenoFlowBackend *prev;		/* owner of the bucket the backend took over, NULL if it was free */
+	int update;			/* took the slot from prev, its entry is accounted for already */
+} HashEntryOp;
+
+/*
+ * NAT reply entry of a backend: its address and port back to the VIP, towards the gateway
+ */
+static doca_error_t submit_nat_entry(HashEntryOp *hop, uint16_t queue)
+{
+	XenoFlowService *service = hop->service;
+	XenoFlowBackend *backend = hop->backend;
+	struct doca_flow_match match;
+	struct doca_flow_actions actions;
+	uint8_t *gw = service->gateway_mac;
+
+	memset(&match, 0, sizeof(match));
+	memset(&actions, 0, sizeof(actions));
+
+	match.outer.ip4.src_ip = backend->ip;
+	match.outer.ip4.next_proto = service->protocol;
+	match.outer.transport.src_port = rte_cpu_to_be_16(backend->port ? backend->port : service->port);
+
+	SET_MAC_ADDR(actions.outer.eth.dst_mac, gw[0], gw[1], gw[2], gw[3], gw[4], gw[5]);
+	actions.outer.ip4.src_ip = service->vip;
+	actions.outer.transport.src_port = rte_cpu_to_be_16(service->port);
+
+	return doca_flow_pipe_add_entry(queue, hop->xeno->nat_pipe, &match, &actions, NULL, NULL,
+					DOCA_FLOW_WAIT_FOR_BATCH, xenoflow_op_usr_ctx(&hop->op, NULL), &backend->reverse_entry);
+}
+
+static doca_error_t submit_hash_entry(XenoFlowOp *op, uint16_t queue, uint32_t flags)
+{
+	HashEntryOp *hop = (HashEntryOp *)op;
+	XenoFlowBackend *backend = hop->backend;
+	struct doca_flow_actions actions;
+	struct doca_flow_monitor monitor;
+	void *usr_ctx;
+	doca_error_t result;
+
+	memset(&actions, 0, sizeof(actions));
+	memset(&monitor, 0, sizeof(monitor));
+
+	xenoflow_counters_monitor(&hop->xeno->counters, &monitor, backend->counter_index);
+
+	/* The slot's meter may still hold the limit of an earlier backend */
+	if (hop->service->spillover != XENOFLOW_SPILLOVER_NONE) {
+		result = xenoflow_meters_configure(&hop->xeno->meters, backend->counter_index, backend->rate_limit,
+						   backend->burst);
+		if (result != DOCA_SUCCESS)
+			return result;
+		xenoflow_meters_monitor(&hop->xeno->meters, &monitor, backend->counter_index);
+	}
+
+	set_backend_actions(&actions, hop->service, backend);
+
+	/* The reply entry goes first: once it is in flight the op must not complete early */
+	if (hop->service->nat && !backend->host) {
+		result = submit_nat_entry(hop, queue);
+		if (result != DOCA_SUCCESS)
+			return result;
+		op->nb_entries = 2;
+	}
+
+	/*
+	 * Both complete through the entry's own context, an update has no usr_ctx of its own.
+	 * Earlier ops on the entry completed by now, so whether it exists is known here.
+	 */
+	usr_ctx = xenoflow_op_usr_ctx(op, op->entry_ctx);
+	op->entry = hop->service->entries[backend->entry_index];
+	if (op->entry != NULL) {
+		result = doca_flow_pipe_update_entry(queue, hop->service->hash_pipe, &actions, &monitor, &hop->fwd,
+						     flags, op->entry);
+	} else {
+		result = doca_flow_pipe_hash_add_entry(queue,
+							hop->service->hash_pipe,
+							backend->entry_index,
+							backend->tunnel,
+							&actions,
+							&monitor,
+							&hop->fwd,
+							flags,
+							usr_ctx,
+							&op->entry);
+	}
+	if (result != DOCA_SUCCESS && op->nb_entries == 2) {
+		/* Wait for the reply entry and remove it again in hash_entry_done(), the entry sees no completion */
+		op->entry_ctx->op = NULL;
+		hop->hash_error = result;
+		op->nb_entries = 1;
+		return DOCA_SUCCESS;
+	}
+	return result;
+}
+
+/*
+ * Give back the slot and pool position reserved by queue_hash_entry(), called with xeno->lock held.
+ * A bucket taken over from prev goes back to it.
+ */
+static void release_slot(XenoFlowService *service, XenoFlowBackend *backend, XenoFlowBackend *prev)
+{
+	service->slots[backend->entry_index] = prev;
+	if (prev != NULL)
+		prev->nb_buckets++;
+	else if (backend->entry_index < service->nextFreeSlot)
+		service->nextFreeSlot = backend->entry_index;
+	configRemoveBackend(service->config, backend);
+}
+
+/*
+ * Resources of a hash entry op, called with xeno->lock held: the hash entry
+ * unless it updates one, and the NAT reply entry, which a failure rolls back
+ */
+static void account_hash_entry(XenoFlow *xeno, const HashEntryOp *hop, int delta)
+{
+	if (!hop->update)
+		xenoflow_resources_account_entry(&xeno->resources, hop->service->hash_res, delta);
+	if (hop->service->nat && !hop->backend->host)
+		xenoflow_resources_account_entry(&xeno->resources, xeno->nat_res, delta);
+}
+
+static void hash_entry_done(XenoFlowOp *op, doca_error_t result)
+{
+	HashEntryOp *hop = (HashEntryOp *)op;
+	XenoFlow *xeno = hop->xeno;
+	XenoFlowService *service = hop->service;
+	XenoFlowBackend *backend = hop->backend;
+
+	if (hop->hash_error != DOCA_SUCCESS)
+		result = hop->hash_error;
+
+	/* The poller owns the queue, so the half-added reply entry can go right here */
+	if (result != DOCA_SUCCESS && backend->reverse_entry != NULL) {
+		doca_flow_pipe_remove_entry(xeno->ops.queue, DOCA_FLOW_NO_WAIT, backend->reverse_entry);
+		backend->reverse_entry = NULL;
+	}
+
+	pthread_mutex_lock(&xeno->lock);
+	service->nb_queued[backend->entry_index]--;
+	if (result == DOCA_SUCCESS) {
+		backend->entry = op->entry;
+		if (service->entries[backend->entry_index] == NULL) {
+			service->entries[backend->entry_index] = op->entry;
+			xenoflow_counters_set_entry(&xeno->counters, backend->counter_index, op->entry);
+		}
+		if (xenoflow_evlog_on) {
+			xenoflow_evlog_name(backend->counter_index, backend->name);
+			xenoflow_evlog(XENOFLOW_EV_BACKEND_ADD, backend->counter_index,
+				       xenoflow_evlog_mac(backend->mac_address), xenoflow_evlog_now() - op->queued_ns);
+		} else {
+			DOCA_LOG_INFO("Added %s %s at hash entry %u of service %s", backend->host ? "host entry" : "backend",
+				      backend->name, backend->entry_index, service->name);
+		}
+	} else {
+		DOCA_LOG_ERR("Failed to add hash entry %u of service %s: %s", backend->entry_index, service->name,
+			     doca_error_get_descr(result));
+		xenoflow_evlog(XENOFLOW_EV_BACKEND_ADD_FAILED, backend->counter_index,
+			       xenoflow_evlog_mac(backend->mac_address), result);
+		account_hash_entry(xeno, hop, -1);
+		release_slot(service, backend, hop->prev);
+	}
+	pthread_mutex_unlock(&xeno->lock);
+
+	if (hop->done != NULL)
+		hop->done(backend, result, hop->done_arg);
+	if (result != DOCA_SUCCESS)
+		destroyBackend(backend);
+}
+
+/*
+ * Names and addresses are unique within a service, both are O(1) index lookups
+ */
+static doca_error_t check_unique(const XenoFlowService *service, const XenoFlowBackend *backend)
+{
+	const XenoFlowBackend *other;
+
+	if (configFindBackend(service->config, backend->name) != NULL) {
+		DOCA_LOG_ERR("Service %s already has a backend named %s", service->name, backend->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+
+	other = configFindBackendByAddress(service->config, backend);
+	if (other != NULL) {
+		DOCA_LOG_ERR("Service %s: address of %s is already used by %s", service->name, backend->name,
+			     other->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Bucket a new backend can take over from the backend with the most buckets,
+ * UINT32_MAX if every backend is down to its home bucket
+ */
+static uint32_t steal_bucket(const XenoFlowService *service)
+{
+	const XenoFlowBackend *richest = NULL;
+
+	for (int i = 0; i < service->config->numBackends; i++) {
+		const XenoFlowBackend *b = service->config->backends[i];
+
+		if (b->nb_buckets > 1 && (richest == NULL || b->nb_buckets > richest->nb_buckets))
+			richest = b;
+	}
+	if (richest == NULL)
+		return UINT32_MAX;
+
+	/* A bucket with an op queued would only wait for it */
+	for (uint32_t i = service->hash_pipe_entries; i-- > 0;)
+		if (service->slots[i] == richest && i != richest->entry_index && service->nb_queued[i] == 0)
+			return i;
+	return UINT32_MAX;
+}
+
+/*
+ * Reserve a slot and a pool position for a backend, called with xeno->lock held.
+ * slot UINT32_MAX takes the lowest free slot, or with buckets one of the
+ * backend that has the most; its old owner is returned in prev.
+ */
+static doca_error_t reserve_slot(XenoFlowService *service, XenoFlowBackend *backend, uint32_t slot,
+				 XenoFlowBackend **prev)
+{
+	doca_error_t result;
+
+	*prev = NULL;
+	if (slot == UINT32_MAX) {
+		slot = service->nextFreeSlot;
+		while (slot < service->hash_pipe_entries && service->slots[slot] != NULL)
+			slot++;
+		if (slot == service->hash_pipe_entries && service->buckets != 0) {
+			slot = steal_bucket(service);
+			if (slot != UINT32_MAX)
+				*prev = service->slots[slot];
+			else
+				slot = service->hash_pipe_entries;
+		}
+		if (slot == service->hash_pipe_entries) {
+			DOCA_LOG_ERR("Cannot add backend %s: hash pipe of service %s is full (%u entries)",
+				     backend->name, service->name, service->hash_pipe_entries);
+			return DOCA_ERROR_FULL;
+		}
+	} else if (slot >= service->hash_pipe_entries) {
+		DOCA_LOG_ERR("Cannot add backend %s: entry index %u exceeds hash pipe size %u of service %s",
+			     backend->name, slot, service->hash_pipe_entries, service->name);
+		return DOCA_ERROR_BAD_STATE;
+	} else if (service->slots[slot] != NULL) {
+		DOCA_LOG_ERR("Hash entry %u of service %s already exists", slot, service->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+
+	result = check_unique(service, backend);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	backend->entry_index = slot;
+	backend->counter_index = service->counter_base + slot;
+	backend->nb_buckets = 1;
+	result = configAddBackend(service->config, backend);
+	if (result != DOCA_SUCCESS) {
+		*prev = NULL;
+		return result;
+	}
+
+	service->slots[slot] = backend;
+	if (*prev != NULL)
+		(*prev)->nb_buckets--;
+	else if (slot == service->nextFreeSlot)
+		service->nextFreeSlot = slot + 1;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Queue the hash entry of a new backend. With op set the caller waits for it,
+ * otherwise the operation is detached and only done is called.
+ */
+static doca_error_t queue_hash_entry(XenoFlow *xeno, XenoFlowService *service, const XenoFlowBackend *spec,
+				     uint32_t slot, xenoflow_backend_cb done, void *arg, XenoFlowOp **op)
+{
+	struct doca_flow_target *kernel_target = NULL;
+	XenoFlowBackend *backend;
+	HashEntryOp *hop;
+	doca_error_t result;
+
+	if (xeno == NULL || service == NULL || service->hash_pipe == NULL || service->slots == NULL) {
+		DOCA_LOG_ERR("Cannot add backend: XenoFlow is not initialized");
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	if (service->nat && !spec->host && spec->ip == 0) {
+		DOCA_LOG_ERR("Cannot add backend %s: service %s is in NAT mode and needs the backend's ip",
+			     spec->name, service->name);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	if (spec->tunnel != XENOFLOW_TUNNEL_NONE && (!service->underlay || spec->host)) {
+		DOCA_LOG_ERR("Cannot add backend %s: %s", spec->name,
+			     spec->host ? "host entries cannot use a tunnel" : "the service has no underlay");
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	if (spec->rate_limit != 0 &&
+	    (service->spillover == XENOFLOW_SPILLOVER_NONE || spec->host ||
+	     (spec->tunnel != XENOFLOW_TUNNEL_NONE && service->spillover == XENOFLOW_SPILLOVER_REHASH))) {
+		DOCA_LOG_ERR("Cannot add backend %s: %s", spec->name,
+			     spec->host ? "host entries cannot have a rate limit" :
+			     spec->tunnel != XENOFLOW_TUNNEL_NONE ? "tunnel backends cannot spill over by rehash" :
+								     "the service has no spillover");
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	if (spec->host && xeno->slowpath.nb_queues == 0) {
+		result = doca_flow_get_target(DOCA_FLOW_TARGET_KERNEL, &kernel_target);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to get kernel target for host forwarding: %s", doca_error_get_descr(result));
+			return result;
+		}
+	}
+
+	backend = copyBackend(spec);
+	if (backend == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+
+	hop = (HashEntryOp *)xenoflow_op_create(sizeof(HashEntryOp), submit_hash_entry, hash_entry_done, NULL,
+						op == NULL);
+	if (hop == NULL) {
+		destroyBackend(backend);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	hop->xeno = xeno;
+	hop->service = service;
+	hop->backend = backend;
+	hop->done = done;
+	hop->done_arg = arg;
+	if (spec->host && xeno->slowpath.nb_queues != 0) {
+		xenoflow_slowpath_fwd(&xeno->slowpath, &hop->fwd);
+	} else if (spec->host) {
+		hop->fwd.type = DOCA_FLOW_FWD_TARGET;
+		hop->fwd.target = kernel_target;
+	} else if (spec->rate_limit != 0) {
+		/* Its packets go out of the port through the color pipe, unless red */
+		hop->fwd.type = DOCA_FLOW_FWD_PIPE;
+		hop->fwd.next_pipe = service->color_pipe;
+	} else {
+		hop->fwd.type = DOCA_FLOW_FWD_PORT;
+		hop->fwd.port_id = 0;
+	}
+
+	pthread_mutex_lock(&xeno->lock);
+	result = reserve_slot(service, backend, slot, &hop->prev);
+	if (result == DOCA_SUCCESS) {
+		/* As for buckets, a slot with an owner has its entry added or on its way */
+		hop->update = hop->prev != NULL;
+		hop->op.entry_ctx = &service->entry_ctx[backend->entry_index];
+		result = xenoflow_ops_submit(&xeno->ops, &hop->op);
+		if (result == DOCA_SUCCESS) {
+			account_hash_entry(xeno, hop, 1);
+			service->nb_queued[backend->entry_index]++;
+		} else
+			release_slot(service, backend, hop->prev);
+	}
+	pthread_mutex_unlock(&xeno->lock);
+
+	if (result != DOCA_SUCCESS) {
+		xenoflow_op_destroy(&hop->op);
+		destroyBackend(backend);
+		return result;
+	}
+
+	if (op != NULL)
+		*op = &hop->op;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_add_backend_async(XenoFlow *xeno, XenoFlowService *service, const XenoFlowBackend *spec,
+					xenoflow_backend_cb done, void *arg)
+{
+	return queue_hash_entry(xeno, service, spec, UINT32_MAX, done, arg, NULL);
+}
+
+/*
+ * Queue a hash entry and block until hardware completed it
+ */
+static doca_error_t add_hash_entry_sync(XenoFlow *xeno, XenoFlowService *service, const char *name, const char *mac,
+					int host, uint32_t slot)
+{
+	XenoFlowBackend *spec;
+	XenoFlowOp *op;
+	doca_error_t result;
+
+	spec = createBackend(name, mac);
+	if (spec == NULL)
+		return DOCA_ERROR_INVALID_VALUE;
+	spec->host = host;
+	result = queue_hash_entry(xeno, service, spec, slot, NULL, NULL, &op);
+	destroyBackend(spec);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = xenoflow_op_wait(op);
+	xenoflow_op_destroy(op);
+	return result;
+}
+
+doca_error_t xenoflow_add_backend(XenoFlow *xeno, XenoFlowService *service, char *name, char *mac) {
+	return add_hash_entry_sync(xeno, service, name, mac, 0, UINT32_MAX);
+}
+
+doca_error_t xenoflow_add_host_entry(XenoFlow *xeno, XenoFlowService *service, uint32_t entry_index, char *name, char *mac) {
+	return add_hash_entry_sync(xeno, service, name, mac, 1, entry_index);
 }
@@ -3,45 +3,147 @@
 #define CORE_H
 
 #include <doca_flow.h>
+#include <pthread.h>
 #include <stdint.h>
 
-/**
- * @brief Backend structure
- */
-typedef struct {
-	char name[64];
-	uint8_t mac_address[6];
-	struct doca_flow_pipe_entry *entry;
-
-} XenoFlowBackend;
+#include "counters.h"
+#include "eventloop.h"
+#include "history.h"
+#include "meters.h"
+#include "ops.h"
+#include "rebalance.h"
+#include "resources.h"
+#include "sampler.h"
+#include "services.h"
+#include "slowpath.h"
+#include "snapshot.h"
+#include "stream.h"
 
 /**
- * @brief XenoFlow configuration structure
+ * @brief Runtime options, filled from the command line
  */
 typedef struct {
-	XenoFlowBackend **backends;
-	int numBackends;
-	int nextBackend;
-} XenoFlowConfig;
+	int sharedCounters;   /* bind hash entries to shared counters and read them with one bulk query */
+	int statsIntervalMs;  /* interval of the status loop */
+	char configPath[256]; /* JSON service config, empty for the built-in default pool */
+	char evlogPath[256];  /* binary event log, empty to log per-entry events as text */
+	int sampleRate;	      /* mirror 1 in sampleRate packets to the flow exporter, 0 for no sampling */
+	char ipfixCollector[64]; /* ip:port the flow records are exported to */
+	int rebalanceIntervalMs; /* rebalancing round of services with buckets, 0 for none */
+	int rebalanceMoves;	 /* most buckets moved per service and round */
+	int rebalanceThreshold;	 /* load band around the mean that counts as balanced, percent */
+	int takeoverPid;	 /* running instance to take the port over from, 0 to start active */
+	char snapshotPath[256];	 /* state snapshot restored at start and written periodically, empty for none */
+	int snapshotIntervalMs;	 /* interval of the snapshot writes */
+	char device[64];	 /* PCI address, interface name or MAC of the device, empty for the config's */
+	int streamIntervalMs;	 /* interval of the /api/stream frames, 0 to turn the stream off */
+	char historyPath[256];	 /* counter history file, empty to keep none */
+	int historySizeMb;	 /* size of the history file */
+	int slowPathQueues;	 /* RX queues host entries are spread over, 0 to send them to the kernel */
+	int slowPathCpu;	 /* CPU of the first slow path worker, -1 to leave them unpinned */
+} XenoFlowOptions;
+
+#define DEFAULT_STATS_INTERVAL_MS 5000
+#define DEFAULT_REBALANCE_MOVES 16
+#define DEFAULT_REBALANCE_THRESHOLD 5
+#define DEFAULT_SNAPSHOT_INTERVAL_MS 1000
 
 typedef struct {
-	XenoFlowConfig *config;
-	struct doca_flow_pipe *hash_pipe;
-	uint32_t hash_pipe_entries;
-	struct doca_flow_pipe_entry *hash_entries[1024];
+	XenoFlowServices services;
+	XenoFlowOptions options;
+	struct doca_flow_pipe *vip_pipe;  /* root pipe, matches the VIP and forwards to the service's hash pipe */
+	uint32_t vip_pipe_entries;
+	struct doca_flow_pipe *nat_pipe;  /* NAT_REVERSE, rewrites replies of NAT backends back to the VIP */
+	uint32_t nat_pipe_entries;
+	int vip_res;			  /* resource slots of the VIP and NAT_REVERSE pipes */
+	int nat_res;
 	struct doca_flow_port *ports[2];
+	XenoFlowResources resources;
+	XenoFlowCounters counters;
+	XenoFlowMeters meters;		  /* hash entry meters, ids as the counters, none without spillover */
+	XenoFlowOps ops;		  /* entry operations, completed by the poller thread */
+	pthread_mutex_t lock;		  /* services, pools and resource accounting */
+	XenoFlowLoop loop;		  /* main thread event loop */
+	XenoFlowSampler sampler;	  /* SAMPLE pipe copies aggregated into IPFIX flow records */
+	XenoFlowSlowPath slowpath;	  /* worker pool of the host entries, nb_queues 0 for the kernel target */
+	XenoFlowRebalancer *rebalancers;  /* one per service, nb_buckets 0 for services without buckets */
+	enum doca_flow_port_operation_state port_state;
+	int takeover_fd;		  /* pidfd of the instance being taken over, -1 if none */
+	uint64_t config_version;	  /* hash of the config file, a snapshot only restores into the same */
+	XenoFlowSnapshot snapshot;	  /* unmapped until snapshots start */
+	XenoFlowStream stream;		  /* counter deltas for the /api/stream subscribers */
+	XenoFlowHistory history;	  /* unmapped without a history file */
 } XenoFlow;
 
-#define MAX_BACKENDS 1024
+/**
+ * @brief Completion of an asynchronous backend operation, called on the entry poller thread
+ * @param backend The backend, only valid during the call if result is not DOCA_SUCCESS
+ * @param result DOCA_SUCCESS if the hash entry is installed, error code otherwise
+ * @param arg Caller argument
+ */
+typedef void (*xenoflow_backend_cb)(XenoFlowBackend *backend, doca_error_t result, void *arg);
+
+/**
+ * @brief Set the default runtime options
+ * @param options Options to initialize
+ */
+void xeno_flow_options_init(XenoFlowOptions *options);
+
+/**
+ * @brief Signals handled by the XenoFlow event loop: SIGINT and SIGTERM stop, SIGHUP reloads the config,
+ * SIGUSR1 hands the port over to a standby instance and stops
+ *
+ * main() must block them with xenoflow_loop_block_signals() before any thread is started.
+ *
+ * @param signals Set to fill
+ */
+void xeno_flow_signals(sigset_t *signals);
+
+/**
+ * @brief Reload the config file on the event loop thread, callable from any thread
+ * @param xeno XenoFlow instance
+ * @return DOCA_SUCCESS if the reload is queued, error code otherwise
+ */
+doca_error_t xenoflow_request_reload(XenoFlow *xeno);
 
 /**
  * @brief Main XenoFlow function - initializes and runs the flow load balancer
- * @param nb_queues Number of queues to use
+ * @param nb_queues Number of queues to use, the last options->slowPathQueues of them for the slow path
+ * @param options Runtime options, NULL for defaults
  * @return DOCA_SUCCESS on success, error code otherwise
  */
-doca_error_t xeno_flow(int nb_queues);
+doca_error_t xeno_flow(int nb_queues, const XenoFlowOptions *options);
+
+/**
+ * @brief Queue a new backend on the lowest free hash entry of a service, returns without waiting for hardware
+ *
+ * Name, MAC and slot are checked and reserved before returning, so errors
+ * there are reported directly; hardware errors are reported through done.
+ *
+ * @param xeno XenoFlow instance
+ * @param service Service to add the backend to
+ * @param spec Name, MAC, host flag and, for NAT services, IP and port of the backend; copied
+ * @param done Completion callback, may be NULL
+ * @param arg Passed to done
+ * @return DOCA_SUCCESS if the entry was queued, error code otherwise
+ */
+doca_error_t xenoflow_add_backend_async(XenoFlow *xeno, XenoFlowService *service, const XenoFlowBackend *spec,
+					xenoflow_backend_cb done, void *arg);
+
+/**
+ * @brief Traffic of a backend from the last counter collection, summed over the hash entries it owns
+ *
+ * Every timer that collects the counters sums them per backend, so this reads
+ * no hardware counters. Call it with xeno->lock held.
+ *
+ * @param backend The backend
+ * @param stats Packets and bytes
+ * @param rate Packet and bit rates
+ */
+void xenoflow_backend_stats(const XenoFlowBackend *backend, struct doca_flow_resource_query *stats,
+			    XenoFlowEntryRate *rate);
 
-doca_error_t xenoflow_add_backend(XenoFlow *xeno, char *name, char *mac);
-doca_error_t xenoflow_add_host_entry(XenoFlow *xeno, uint32_t entry_index, char *name, char *mac);
+doca_error_t xenoflow_add_backend(XenoFlow *xeno, XenoFlowService *service, char *name, char *mac);
+doca_error_t xenoflow_add_host_entry(XenoFlow *xeno, XenoFlowService *service, uint32_t entry_index, char *name, char *mac);
 
 #endif /* CORE_H */
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <doca_log.h>
+
+#include "counters.h"
+
+DOCA_LOG_REGISTER(COUNTERS);
+
+doca_error_t xenoflow_counters_init(XenoFlowCounters *counters, int shared, uint32_t nb_counters)
+{
+	memset(counters, 0, sizeof(*counters));
+	counters->shared = shared;
+	counters->nb_counters = nb_counters;
+	counters->ids = calloc(nb_counters, sizeof(uint32_t));
+	counters->entries = calloc(nb_counters, sizeof(struct doca_flow_pipe_entry *));
+	counters->results = calloc(nb_counters, sizeof(struct doca_flow_resource_query));
+	counters->previous = calloc(nb_counters, sizeof(struct doca_flow_resource_query));
+	counters->rates = calloc(nb_counters, sizeof(XenoFlowEntryRate));
+	counters->baselines = calloc(nb_counters, sizeof(struct doca_flow_resource_query));
+	if (counters->ids == NULL || counters->entries == NULL || counters->results == NULL ||
+	    counters->previous == NULL || counters->rates == NULL || counters->baselines == NULL) {
+		DOCA_LOG_ERR("Failed to allocate %u counters", nb_counters);
+		free(counters->ids);
+		free(counters->entries);
+		free(counters->results);
+		free(counters->previous);
+		free(counters->rates);
+		free(counters->baselines);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+
+	for (uint32_t i = 0; i < nb_counters; i++)
+		counters->ids[i] = i;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_counters_bind(XenoFlowCounters *counters, struct doca_flow_port *port)
+{
+	struct doca_flow_shared_resource_cfg cfg = {.domain = DOCA_FLOW_PIPE_DOMAIN_DEFAULT};
+	doca_error_t result;
+
+	if (!counters->shared)
+		return DOCA_SUCCESS;
+
+	for (uint32_t i = 0; i < counters->nb_counters; i++) {
+		result = doca_flow_shared_resource_set_cfg(DOCA_FLOW_SHARED_RESOURCE_COUNTER, counters->ids[i], &cfg);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to configure shared counter %u: %s", i, doca_error_get_descr(result));
+			return result;
+		}
+	}
+
+	result = doca_flow_shared_resources_bind(DOCA_FLOW_SHARED_RESOURCE_COUNTER, counters->ids,
+						 counters->nb_counters, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind %u shared counters to port: %s", counters->nb_counters,
+			     doca_error_get_descr(result));
+		return result;
+	}
+
+	DOCA_LOG_INFO("Bound %u shared counters", counters->nb_counters);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_counters_monitor(const XenoFlowCounters *counters, struct doca_flow_monitor *monitor, uint32_t counter_id)
+{
+	if (counters->shared) {
+		monitor->counter_type = DOCA_FLOW_RESOURCE_TYPE_SHARED;
+		monitor->shared_counter.shared_counter_id = counter_id;
+	} else {
+		monitor->counter_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	}
+}
+
+void xenoflow_counters_set_entry(XenoFlowCounters *counters, uint32_t idx, struct doca_flow_pipe_entry *entry)
+{
+	if (idx < counters->nb_counters)
+		counters->entries[idx] = entry;
+}
+
+void xenoflow_counters_set_baseline(XenoFlowCounters *counters, uint32_t idx, uint64_t pkts, uint64_t bytes)
+{
+	if (idx >= counters->nb_counters)
+		return;
+	counters->baselines[idx].counter.total_pkts = pkts;
+	counters->baselines[idx].counter.total_bytes = bytes;
+	/* Totals read before the first collection already include it, and the first rates start from it */
+	counters->results[idx] = counters->baselines[idx];
+}
+
+static void add_baseline(const XenoFlowCounters *counters, uint32_t idx, struct doca_flow_resource_query *result)
+{
+	result->counter.total_pkts += counters->baselines[idx].counter.total_pkts;
+	result->counter.total_bytes += counters->baselines[idx].counter.total_bytes;
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void update_rates(XenoFlowCounters *counters, uint64_t now)
+{
+	double dt;
+
+	if (counters->last_collect_ns == 0 || now <= counters->last_collect_ns)
+		return;
+	dt = (now - counters->last_collect_ns) / 1e9;
+
+	for (uint32_t i = 0; i < counters->nb_counters; i++) {
+		uint64_t pkts = counters->results[i].counter.total_pkts;
+		uint64_t bytes = counters->results[i].counter.total_bytes;
+		uint64_t last_pkts = counters->previous[i].counter.total_pkts;
+		uint64_t last_bytes = counters->previous[i].counter.total_bytes;
+
+		/* A counter going backwards means the entry was replaced, start over */
+		counters->rates[i].pps = pkts >= last_pkts ? (pkts - last_pkts) / dt : 0;
+		counters->rates[i].bps = bytes >= last_bytes ? (bytes - last_bytes) * 8 / dt : 0;
+	}
+}
+
+doca_error_t xenoflow_counters_collect(XenoFlowCounters *counters)
+{
+	uint64_t now = monotonic_ns();
+	doca_error_t result = DOCA_SUCCESS;
+
+	memcpy(counters->previous, counters->results, counters->nb_counters * sizeof(*counters->results));
+
+	if (counters->shared) {
+		result = doca_flow_shared_resources_query(DOCA_FLOW_SHARED_RESOURCE_COUNTER, counters->ids,
+							  counters->results, counters->nb_counters);
+		if (result != DOCA_SUCCESS)
+			return result;
+		for (uint32_t i = 0; i < counters->nb_counters; i++)
+			add_baseline(counters, i, &counters->results[i]);
+	} else {
+		for (uint32_t i = 0; i < counters->nb_counters; i++) {
+			if (counters->entries[i] == NULL)
+				continue;
+			if (doca_flow_resource_query_entry(counters->entries[i], &counters->results[i]) != DOCA_SUCCESS)
+				memset(&counters->results[i], 0, sizeof(counters->results[i]));
+			add_baseline(counters, i, &counters->results[i]);
+		}
+	}
+
+	update_rates(counters, now);
+	counters->last_collect_ns = now;
+	return result;
+}
+
+doca_error_t xenoflow_counters_query(const XenoFlowCounters *counters, uint32_t idx,
+				     struct doca_flow_resource_query *result)
+{
+	doca_error_t status;
+
+	if (idx >= counters->nb_counters)
+		return DOCA_ERROR_INVALID_VALUE;
+
+	if (counters->shared)
+		status = doca_flow_shared_resources_query(DOCA_FLOW_SHARED_RESOURCE_COUNTER, &counters->ids[idx], result, 1);
+	else if (counters->entries[idx] == NULL)
+		return DOCA_ERROR_NOT_FOUND;
+	else
+		status = doca_flow_resource_query_entry(counters->entries[idx], result);
+	if (status == DOCA_SUCCESS)
+		add_baseline(counters, idx, result);
+	return status;
+}
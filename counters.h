@@ -0,0 +1,91 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <doca_flow.h>
+#include <stdint.h>
+
+/**
+ * @brief Counters of the hash pipe entries, indexed by hash entry index
+ *
+ * In non-shared mode every entry owns its counter and collecting means one
+ * doca_flow_resource_query_entry() per entry. In shared mode entry i is bound
+ * to shared counter i and all of them are read with a single
+ * doca_flow_shared_resources_query().
+ */
+typedef struct {
+	double pps; /* packets per second between the last two collections */
+	double bps; /* bits per second between the last two collections */
+} XenoFlowEntryRate;
+
+typedef struct {
+	int shared;			/* entries use shared counters */
+	uint32_t nb_counters;		/* one counter per hash entry */
+	uint32_t *ids;			/* shared counter ids 0..nb_counters-1, in query order */
+	struct doca_flow_pipe_entry **entries; /* entry owning counter i (non-shared mode) */
+	struct doca_flow_resource_query *results; /* last collected values */
+	struct doca_flow_resource_query *previous; /* values of the collection before */
+	XenoFlowEntryRate *rates;	/* per-entry rates derived from the last two collections */
+	struct doca_flow_resource_query *baselines; /* added to every reading, counts from before a warm start */
+	uint64_t last_collect_ns;	/* CLOCK_MONOTONIC time of the last collection */
+} XenoFlowCounters;
+
+/**
+ * @brief Allocate the counter table
+ * @param counters Counter table
+ * @param shared Use shared counters with bulk queries
+ * @param nb_counters Number of counters, one per hash entry
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NO_MEMORY otherwise
+ */
+doca_error_t xenoflow_counters_init(XenoFlowCounters *counters, int shared, uint32_t nb_counters);
+
+/**
+ * @brief Configure the shared counters and bind them to the port, no-op in non-shared mode
+ * @param counters Counter table
+ * @param port Port the hash pipe lives on
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_counters_bind(XenoFlowCounters *counters, struct doca_flow_port *port);
+
+/**
+ * @brief Fill the monitor of a pipe or entry for the configured counter mode
+ * @param counters Counter table
+ * @param monitor Monitor to fill
+ * @param counter_id Shared counter of the entry, or UINT32_MAX for the pipe template
+ */
+void xenoflow_counters_monitor(const XenoFlowCounters *counters, struct doca_flow_monitor *monitor, uint32_t counter_id);
+
+/**
+ * @brief Remember the entry owning counter idx
+ * @param counters Counter table
+ * @param idx Hash entry index
+ * @param entry The entry
+ */
+void xenoflow_counters_set_entry(XenoFlowCounters *counters, uint32_t idx, struct doca_flow_pipe_entry *entry);
+
+/**
+ * @brief Continue counter idx from a value, so totals survive a warm start
+ * @param counters Counter table
+ * @param idx Hash entry index
+ * @param pkts Packets counted before
+ * @param bytes Bytes counted before
+ */
+void xenoflow_counters_set_baseline(XenoFlowCounters *counters, uint32_t idx, uint64_t pkts, uint64_t bytes);
+
+/**
+ * @brief Read all counters into counters->results and update counters->rates
+ * @param counters Counter table
+ * @return DOCA_SUCCESS on success, error code of the bulk query otherwise
+ */
+doca_error_t xenoflow_counters_collect(XenoFlowCounters *counters);
+
+/**
+ * @brief Read a single counter
+ * @param counters Counter table
+ * @param idx Hash entry index
+ * @param result Counter value
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_counters_query(const XenoFlowCounters *counters, uint32_t idx,
+				     struct doca_flow_resource_query *result);
+
+#endif /* COUNTERS_H */
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+"""Compile the dashboard files into a C table of assets (see assets.h).
+
+Usage: embed.py <output.c> <static dir> <file>...
+
+Every file is stored as is and, when that is smaller, gzip compressed, each
+with a strong ETag derived from its contents. The output only changes when a
+file does, so the binary is rebuilt reproducibly.
+"""
+
+import gzip
+import hashlib
+import os
+import sys
+
+CONTENT_TYPES = {
+	".html": "text/html; charset=utf-8",
+	".js": "application/javascript; charset=utf-8",
+	".css": "text/css; charset=utf-8",
+	".json": "application/json",
+	".svg": "image/svg+xml",
+	".png": "image/png",
+	".ico": "image/x-icon",
+}
+
+
+def c_bytes(name, data):
+	lines = []
+	for i in range(0, len(data), 16):
+		lines.append("\t" + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+	return "static const unsigned char %s[%d] = {\n%s\n};\n" % (name, max(len(data), 1), "\n".join(lines))
+
+
+def etag(data):
+	return '"\\"%s\\""' % hashlib.sha256(data).hexdigest()[:16]
+
+
+def main():
+	if len(sys.argv) < 4:
+		sys.exit(__doc__)
+	out, root, files = sys.argv[1], sys.argv[2], sys.argv[3:]
+	arrays, entries = [], []
+
+	for i, path in enumerate(sorted(files)):
+		rel = os.path.relpath(path, root).replace(os.sep, "/")
+		with open(path, "rb") as f:
+			data = f.read()
+		packed = gzip.compress(data, compresslevel=9, mtime=0)
+		content_type = CONTENT_TYPES.get(os.path.splitext(rel)[1], "application/octet-stream")
+
+		arrays.append(c_bytes("asset_%d" % i, data))
+		if len(packed) < len(data):
+			arrays.append(c_bytes("asset_%d_gz" % i, packed))
+			gz = "%s, asset_%d_gz, %d" % (etag(packed), i, len(packed))
+		else:
+			gz = "NULL, NULL, 0"
+		urls = ["/" + rel]
+		if rel == "index.html":
+			urls.insert(0, "/")
+		for url in urls:
+			entries.append('\t{"%s", "%s", %s, asset_%d, %d, %s},' % (url, content_type, etag(data), i,
+										len(data), gz))
+
+	with open(out, "w") as f:
+		f.write("/* Generated by dashboard/embed.py, do not edit */\n\n")
+		f.write("#include \"assets.h\"\n\n")
+		f.write("\n".join(arrays))
+		f.write("\nconst XenoFlowAsset xenoflow_assets[] = {\n%s\n};\n\n" % "\n".join(entries))
+		f.write("const size_t xenoflow_nb_assets = sizeof(xenoflow_assets) / sizeof(xenoflow_assets[0]);\n")
+
+
+if __name__ == "__main__":
+	main()
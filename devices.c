@@ -0,0 +1,205 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <doca_log.h>
+
+#include "devices.h"
+
+DOCA_LOG_REGISTER(DEVICES);
+
+static pthread_mutex_t devices_lock = PTHREAD_MUTEX_INITIALIZER;
+static int devices_enumerated;
+static doca_error_t devices_result;
+static struct doca_devinfo **devinfo_list;
+static XenoFlowDevice *devices;
+static uint32_t nb_devices_found;
+
+doca_error_t xenoflow_devices_enumerate(void)
+{
+	doca_error_t result;
+	uint32_t nb;
+
+	pthread_mutex_lock(&devices_lock);
+	if (devices_enumerated) {
+		pthread_mutex_unlock(&devices_lock);
+		return devices_result;
+	}
+
+	result = doca_devinfo_create_list(&devinfo_list, &nb);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to list devices: %s", doca_error_get_descr(result));
+		goto out;
+	}
+
+	devices = calloc(nb > 0 ? nb : 1, sizeof(*devices));
+	if (devices == NULL) {
+		doca_devinfo_destroy_list(devinfo_list);
+		devinfo_list = NULL;
+		result = DOCA_ERROR_NO_MEMORY;
+		goto out;
+	}
+
+	/* Devices without a PCI address cannot back a flow port, so they are left out */
+	for (uint32_t i = 0; i < nb; i++) {
+		XenoFlowDevice *device = &devices[nb_devices_found];
+
+		if (doca_devinfo_get_pci_addr_str(devinfo_list[i], device->pci) != DOCA_SUCCESS)
+			continue;
+		if (doca_devinfo_get_iface_name(devinfo_list[i], device->iface, sizeof(device->iface)) != DOCA_SUCCESS)
+			device->iface[0] = '\0';
+		device->has_mac = doca_devinfo_get_mac_addr(devinfo_list[i], device->mac, sizeof(device->mac)) ==
+				  DOCA_SUCCESS;
+		device->devinfo = devinfo_list[i];
+		nb_devices_found++;
+	}
+	DOCA_LOG_INFO("Found %u devices", nb_devices_found);
+
+out:
+	devices_result = result;
+	devices_enumerated = 1;
+	pthread_mutex_unlock(&devices_lock);
+	return result;
+}
+
+static int parse_mac(const char *str, uint8_t *mac)
+{
+	int len = 0;
+
+	if (sscanf(str, "%2hhx:%2hhx:%2hhx:%2hhx:%2hhx:%2hhx%n", &mac[0], &mac[1], &mac[2], &mac[3], &mac[4],
+		   &mac[5], &len) != 6)
+		return 0;
+	return str[len] == '\0';
+}
+
+static int device_matches(const XenoFlowDevice *device, const char *selector, const uint8_t *mac)
+{
+	/* "03:00.0" matches "0000:03:00.0": only the "dddd:" domain may be left out, never the bus */
+	size_t pci_len = strlen(device->pci), len = strlen(selector);
+
+	if (strcmp(device->pci, selector) == 0)
+		return 1;
+	if (pci_len > 5 && len == pci_len - 5 && device->pci[4] == ':' && strcmp(device->pci + 5, selector) == 0)
+		return 1;
+	if (device->iface[0] != '\0' && strcmp(device->iface, selector) == 0)
+		return 1;
+	return mac != NULL && device->has_mac && memcmp(device->mac, mac, sizeof(device->mac)) == 0;
+}
+
+doca_error_t xenoflow_devices_find(const char *selector, const XenoFlowDevice **device)
+{
+	uint8_t mac[DOCA_DEVINFO_MAC_ADDR_SIZE];
+	int is_mac;
+	doca_error_t result;
+
+	result = xenoflow_devices_enumerate();
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	/* The cache is read only once enumerated, so it is walked without the lock */
+	is_mac = parse_mac(selector, mac);
+	for (uint32_t i = 0; i < nb_devices_found; i++) {
+		if (device_matches(&devices[i], selector, is_mac ? mac : NULL)) {
+			*device = &devices[i];
+			return DOCA_SUCCESS;
+		}
+	}
+
+	DOCA_LOG_ERR("No device matches \"%s\"", selector);
+	return DOCA_ERROR_NOT_FOUND;
+}
+
+doca_error_t xenoflow_device_open(const char *selector, struct doca_dev **dev)
+{
+	const XenoFlowDevice *device;
+	doca_error_t result;
+
+	result = xenoflow_devices_find(selector, &device);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_dev_open(device->devinfo, dev);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to open device %s: %s", device->pci, doca_error_get_descr(result));
+		return result;
+	}
+
+	if (device->has_mac)
+		DOCA_LOG_INFO("Opened device %s (%s, %02x:%02x:%02x:%02x:%02x:%02x)", device->pci,
+			      device->iface[0] != '\0' ? device->iface : "no interface", device->mac[0],
+			      device->mac[1], device->mac[2], device->mac[3], device->mac[4], device->mac[5]);
+	else
+		DOCA_LOG_INFO("Opened device %s (%s)", device->pci,
+			      device->iface[0] != '\0' ? device->iface : "no interface");
+	return DOCA_SUCCESS;
+}
+
+typedef struct {
+	pthread_t thread;
+	int started;
+	const char *selector;
+	struct doca_dev *dev;
+	doca_error_t result;
+} DeviceOpenJob;
+
+static void *device_open_job(void *arg)
+{
+	DeviceOpenJob *job = (DeviceOpenJob *)arg;
+
+	job->result = xenoflow_device_open(job->selector, &job->dev);
+	return NULL;
+}
+
+doca_error_t xenoflow_devices_open(const char *const *selectors, uint32_t nb_devices, struct doca_dev **devs)
+{
+	DeviceOpenJob jobs[XENOFLOW_MAX_DEVICES] = {0};
+	doca_error_t result;
+
+	if (nb_devices > XENOFLOW_MAX_DEVICES) {
+		DOCA_LOG_ERR("Cannot open %u devices, at most %d", nb_devices, XENOFLOW_MAX_DEVICES);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	/* Enumerated up front, so the threads only look up the cache and open */
+	result = xenoflow_devices_enumerate();
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	/* The first device is opened on this thread, the others next to it */
+	for (uint32_t i = 0; i < nb_devices; i++) {
+		jobs[i].selector = selectors[i];
+		if (i > 0)
+			jobs[i].started = pthread_create(&jobs[i].thread, NULL, device_open_job, &jobs[i]) == 0;
+	}
+	for (uint32_t i = 0; i < nb_devices; i++) {
+		if (jobs[i].started)
+			pthread_join(jobs[i].thread, NULL);
+		else
+			device_open_job(&jobs[i]);
+	}
+
+	for (uint32_t i = 0; i < nb_devices; i++) {
+		if (jobs[i].result != DOCA_SUCCESS && result == DOCA_SUCCESS)
+			result = jobs[i].result;
+	}
+	for (uint32_t i = 0; i < nb_devices; i++) {
+		if (result != DOCA_SUCCESS && jobs[i].result == DOCA_SUCCESS)
+			doca_dev_close(jobs[i].dev);
+		devs[i] = result == DOCA_SUCCESS ? jobs[i].dev : NULL;
+	}
+	return result;
+}
+
+void xenoflow_devices_release(void)
+{
+	pthread_mutex_lock(&devices_lock);
+	if (devinfo_list != NULL)
+		doca_devinfo_destroy_list(devinfo_list);
+	free(devices);
+	devinfo_list = NULL;
+	devices = NULL;
+	nb_devices_found = 0;
+	devices_enumerated = 0;
+	pthread_mutex_unlock(&devices_lock);
+}
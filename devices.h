@@ -0,0 +1,70 @@
+#ifndef DEVICES_H
+#define DEVICES_H
+
+#include <doca_dev.h>
+#include <doca_error.h>
+#include <stdint.h>
+
+/*
+ * Device discovery. The devinfo list of the host is enumerated once, along
+ * with the PCI address, interface name and MAC of every device, and kept
+ * until xenoflow_devices_release(), so selecting several devices walks the
+ * cache instead of the whole list each time. A selector is a PCI address,
+ * with or without the domain ("0000:03:00.0" or "03:00.0"), an interface
+ * name ("p0") or a MAC address ("b8:3f:d2:12:34:56").
+ */
+
+/* Device opened when neither --device nor the config name one */
+#define XENOFLOW_DEFAULT_DEVICE "0000:03:00.0"
+
+/* Most devices xenoflow_devices_open() opens at once */
+#define XENOFLOW_MAX_DEVICES 8
+
+/**
+ * @brief One device of the host and what it can be selected by
+ */
+typedef struct {
+	struct doca_devinfo *devinfo;
+	char pci[DOCA_DEVINFO_PCI_ADDR_SIZE];
+	char iface[DOCA_DEVINFO_IFACE_NAME_SIZE];	/* empty if it has none */
+	uint8_t mac[DOCA_DEVINFO_MAC_ADDR_SIZE];
+	int has_mac;
+} XenoFlowDevice;
+
+/**
+ * @brief Enumerate the devices of the host, once; later calls return the first result
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_devices_enumerate(void);
+
+/**
+ * @brief Find a device by selector, enumerating first if needed
+ * @param selector PCI address, interface name or MAC address
+ * @param device The device, valid until xenoflow_devices_release()
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NOT_FOUND if no device matches
+ */
+doca_error_t xenoflow_devices_find(const char *selector, const XenoFlowDevice **device);
+
+/**
+ * @brief Open one device by selector
+ * @param selector PCI address, interface name or MAC address
+ * @param dev The opened device, close with doca_dev_close()
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_device_open(const char *selector, struct doca_dev **dev);
+
+/**
+ * @brief Open several devices in parallel, one thread per device
+ * @param selectors Selector of each device
+ * @param nb_devices Number of devices, at most XENOFLOW_MAX_DEVICES
+ * @param devs The opened devices, all of them or none
+ * @return DOCA_SUCCESS on success, the first error otherwise
+ */
+doca_error_t xenoflow_devices_open(const char *const *selectors, uint32_t nb_devices, struct doca_dev **devs);
+
+/**
+ * @brief Free the cached devinfo list, devices already opened stay open
+ */
+void xenoflow_devices_release(void);
+
+#endif /* DEVICES_H */
@@ -0,0 +1,301 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <doca_log.h>
+
+#include "eventloop.h"
+
+DOCA_LOG_REGISTER(EVENTLOOP);
+
+enum handler_type {
+	HANDLER_FD,
+	HANDLER_TIMER,
+	HANDLER_SIGNAL,
+	HANDLER_WAKEUP,
+};
+
+struct XenoFlowLoopHandler {
+	int fd;
+	enum handler_type type;
+	union {
+		xenoflow_loop_fd_cb fd;
+		xenoflow_loop_timer_cb timer;
+		xenoflow_loop_signal_cb signal;
+	} cb;
+	void *arg;
+	XenoFlowLoopHandler *next;
+};
+
+struct XenoFlowLoopCall {
+	xenoflow_loop_call_fn fn;
+	void *arg;
+	XenoFlowLoopCall *next;
+};
+
+doca_error_t xenoflow_loop_block_signals(const sigset_t *signals)
+{
+	int err = pthread_sigmask(SIG_BLOCK, signals, NULL);
+
+	if (err != 0) {
+		DOCA_LOG_ERR("Failed to block signals: %s", strerror(err));
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+	return DOCA_SUCCESS;
+}
+
+static doca_error_t add_handler(XenoFlowLoop *loop, int fd, uint32_t events, enum handler_type type, void *arg,
+				XenoFlowLoopHandler **handler)
+{
+	XenoFlowLoopHandler *h = calloc(1, sizeof(*h));
+	struct epoll_event ev = {0};
+
+	if (h == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	h->fd = fd;
+	h->type = type;
+	h->arg = arg;
+
+	ev.events = events;
+	ev.data.ptr = h;
+	if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		DOCA_LOG_ERR("Failed to watch fd %d: %s", fd, strerror(errno));
+		free(h);
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	h->next = loop->handlers;
+	loop->handlers = h;
+	*handler = h;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_loop_init(XenoFlowLoop *loop)
+{
+	XenoFlowLoopHandler *h;
+	doca_error_t result;
+
+	memset(loop, 0, sizeof(*loop));
+	pthread_mutex_init(&loop->lock, NULL);
+
+	loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epfd < 0) {
+		DOCA_LOG_ERR("Failed to create epoll instance: %s", strerror(errno));
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (loop->wakefd < 0) {
+		DOCA_LOG_ERR("Failed to create wakeup eventfd: %s", strerror(errno));
+		close(loop->epfd);
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	result = add_handler(loop, loop->wakefd, EPOLLIN, HANDLER_WAKEUP, NULL, &h);
+	if (result != DOCA_SUCCESS) {
+		close(loop->wakefd);
+		close(loop->epfd);
+		return result;
+	}
+
+	loop->running = 1;
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_loop_destroy(XenoFlowLoop *loop)
+{
+	XenoFlowLoopHandler *h = loop->handlers;
+	XenoFlowLoopCall *call = loop->calls_head;
+
+	while (h != NULL) {
+		XenoFlowLoopHandler *next = h->next;
+
+		/* Plain fds belong to the caller, the loop created all others */
+		if (h->type != HANDLER_FD)
+			close(h->fd);
+		free(h);
+		h = next;
+	}
+	loop->handlers = NULL;
+
+	while (call != NULL) {
+		XenoFlowLoopCall *next = call->next;
+
+		free(call);
+		call = next;
+	}
+	loop->calls_head = loop->calls_tail = NULL;
+
+	close(loop->epfd);
+	pthread_mutex_destroy(&loop->lock);
+}
+
+doca_error_t xenoflow_loop_add_fd(XenoFlowLoop *loop, int fd, uint32_t events, xenoflow_loop_fd_cb cb, void *arg)
+{
+	XenoFlowLoopHandler *h;
+	doca_error_t result;
+
+	result = add_handler(loop, fd, events, HANDLER_FD, arg, &h);
+	if (result == DOCA_SUCCESS)
+		h->cb.fd = cb;
+	return result;
+}
+
+doca_error_t xenoflow_loop_add_timer(XenoFlowLoop *loop, uint32_t interval_ms, xenoflow_loop_timer_cb cb,
+				     void *arg)
+{
+	struct itimerspec its = {0};
+	XenoFlowLoopHandler *h;
+	doca_error_t result;
+	int fd;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		DOCA_LOG_ERR("Failed to create timerfd: %s", strerror(errno));
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	its.it_interval.tv_sec = interval_ms / 1000;
+	its.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000L;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL) != 0) {
+		DOCA_LOG_ERR("Failed to arm timerfd: %s", strerror(errno));
+		close(fd);
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	result = add_handler(loop, fd, EPOLLIN, HANDLER_TIMER, arg, &h);
+	if (result != DOCA_SUCCESS) {
+		close(fd);
+		return result;
+	}
+	h->cb.timer = cb;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_loop_add_signals(XenoFlowLoop *loop, const sigset_t *signals, xenoflow_loop_signal_cb cb,
+				       void *arg)
+{
+	XenoFlowLoopHandler *h;
+	doca_error_t result;
+	int fd;
+
+	fd = signalfd(-1, signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd < 0) {
+		DOCA_LOG_ERR("Failed to create signalfd: %s", strerror(errno));
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	result = add_handler(loop, fd, EPOLLIN, HANDLER_SIGNAL, arg, &h);
+	if (result != DOCA_SUCCESS) {
+		close(fd);
+		return result;
+	}
+	h->cb.signal = cb;
+	return DOCA_SUCCESS;
+}
+
+static void wakeup(XenoFlowLoop *loop)
+{
+	uint64_t one = 1;
+
+	/* Only fails with EAGAIN when the counter is saturated, the loop wakes up anyway */
+	if (write(loop->wakefd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+		DOCA_LOG_WARN("Failed to wake up the event loop: %s", strerror(errno));
+}
+
+doca_error_t xenoflow_loop_post(XenoFlowLoop *loop, xenoflow_loop_call_fn fn, void *arg)
+{
+	XenoFlowLoopCall *call = calloc(1, sizeof(*call));
+
+	if (call == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	call->fn = fn;
+	call->arg = arg;
+
+	pthread_mutex_lock(&loop->lock);
+	if (loop->calls_tail != NULL)
+		loop->calls_tail->next = call;
+	else
+		loop->calls_head = call;
+	loop->calls_tail = call;
+	pthread_mutex_unlock(&loop->lock);
+
+	wakeup(loop);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_loop_stop(XenoFlowLoop *loop)
+{
+	loop->running = 0;
+	wakeup(loop);
+}
+
+static void run_calls(XenoFlowLoop *loop)
+{
+	XenoFlowLoopCall *call;
+
+	pthread_mutex_lock(&loop->lock);
+	call = loop->calls_head;
+	loop->calls_head = loop->calls_tail = NULL;
+	pthread_mutex_unlock(&loop->lock);
+
+	while (call != NULL) {
+		XenoFlowLoopCall *next = call->next;
+
+		call->fn(call->arg);
+		free(call);
+		call = next;
+	}
+}
+
+static void dispatch(XenoFlowLoop *loop, XenoFlowLoopHandler *h, uint32_t events)
+{
+	struct signalfd_siginfo si;
+	uint64_t value;
+
+	switch (h->type) {
+	case HANDLER_FD:
+		h->cb.fd(h->fd, events, h->arg);
+		break;
+	case HANDLER_TIMER:
+		if (read(h->fd, &value, sizeof(value)) == sizeof(value))
+			h->cb.timer(value, h->arg);
+		break;
+	case HANDLER_SIGNAL:
+		while (read(h->fd, &si, sizeof(si)) == sizeof(si))
+			h->cb.signal((int)si.ssi_signo, h->arg);
+		break;
+	case HANDLER_WAKEUP:
+		if (read(h->fd, &value, sizeof(value)) == sizeof(value))
+			run_calls(loop);
+		break;
+	}
+}
+
+doca_error_t xenoflow_loop_run(XenoFlowLoop *loop)
+{
+	struct epoll_event events[XENOFLOW_LOOP_MAX_EVENTS];
+
+	while (loop->running) {
+		int n = epoll_wait(loop->epfd, events, XENOFLOW_LOOP_MAX_EVENTS, -1);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			DOCA_LOG_ERR("epoll_wait failed: %s", strerror(errno));
+			return DOCA_ERROR_OPERATING_SYSTEM;
+		}
+
+		for (int i = 0; i < n && loop->running; i++) {
+			dispatch(loop, (XenoFlowLoopHandler *)events[i].data.ptr, events[i].events);
+			loop->nb_events++;
+		}
+	}
+	return DOCA_SUCCESS;
+}
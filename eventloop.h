@@ -0,0 +1,140 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <doca_error.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+
+/* Most events handled per epoll_wait() call */
+#define XENOFLOW_LOOP_MAX_EVENTS 16
+
+/**
+ * @brief Callback of a watched file descriptor, runs on the loop thread
+ * @param fd The ready file descriptor, already drained for timers, signals and the wakeup eventfd
+ * @param events epoll events that fired
+ * @param arg Argument given when the handler was added
+ */
+typedef void (*xenoflow_loop_fd_cb)(int fd, uint32_t events, void *arg);
+
+/**
+ * @brief Callback of a timer, runs on the loop thread
+ * @param expirations Timer expirations since the last call, more than 1 if the loop fell behind
+ * @param arg Argument given when the timer was added
+ */
+typedef void (*xenoflow_loop_timer_cb)(uint64_t expirations, void *arg);
+
+/**
+ * @brief Callback of a signal delivered through the signalfd, runs on the loop thread
+ * @param signo Signal number
+ * @param arg Argument given when the signals were added
+ */
+typedef void (*xenoflow_loop_signal_cb)(int signo, void *arg);
+
+/**
+ * @brief Function called on the loop thread on behalf of another thread
+ * @param arg Argument given to xenoflow_loop_post()
+ */
+typedef void (*xenoflow_loop_call_fn)(void *arg);
+
+typedef struct XenoFlowLoopHandler XenoFlowLoopHandler;
+typedef struct XenoFlowLoopCall XenoFlowLoopCall;
+
+/**
+ * @brief Single-threaded event loop over epoll
+ *
+ * Timers are timerfds, signals come through one signalfd and other threads
+ * hand work to the loop with xenoflow_loop_post(), which wakes it through an
+ * eventfd. The loop sleeps in epoll_wait() between events.
+ */
+typedef struct {
+	int epfd;
+	int wakefd;			/* eventfd, written by xenoflow_loop_post() and xenoflow_loop_stop() */
+	volatile int running;
+	XenoFlowLoopHandler *handlers;	/* every fd added to epfd */
+	pthread_mutex_t lock;		/* calls */
+	XenoFlowLoopCall *calls_head;	/* posted, not run yet */
+	XenoFlowLoopCall *calls_tail;
+	uint64_t nb_events;
+} XenoFlowLoop;
+
+/**
+ * @brief Block the signals later handled by the loop in the calling thread
+ *
+ * Call before any other thread is created so that they all inherit the mask,
+ * otherwise a signal may be delivered to a thread that is not watching the signalfd.
+ *
+ * @param signals Signals to block
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_loop_block_signals(const sigset_t *signals);
+
+/**
+ * @brief Create the epoll instance and the wakeup eventfd
+ * @param loop Loop to initialize
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_loop_init(XenoFlowLoop *loop);
+
+/**
+ * @brief Close all file descriptors of the loop and drop calls that did not run
+ * @param loop The loop
+ */
+void xenoflow_loop_destroy(XenoFlowLoop *loop);
+
+/**
+ * @brief Watch a file descriptor, the loop does not own it
+ * @param loop The loop
+ * @param fd File descriptor
+ * @param events epoll events to wait for, e.g. EPOLLIN
+ * @param cb Callback
+ * @param arg Passed to cb
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_loop_add_fd(XenoFlowLoop *loop, int fd, uint32_t events, xenoflow_loop_fd_cb cb, void *arg);
+
+/**
+ * @brief Add a periodic timer
+ * @param loop The loop
+ * @param interval_ms Period in milliseconds, the first expiry is one period from now
+ * @param cb Callback
+ * @param arg Passed to cb
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_loop_add_timer(XenoFlowLoop *loop, uint32_t interval_ms, xenoflow_loop_timer_cb cb,
+				     void *arg);
+
+/**
+ * @brief Handle signals on the loop, they must be blocked with xenoflow_loop_block_signals()
+ * @param loop The loop
+ * @param signals Signals to handle
+ * @param cb Callback
+ * @param arg Passed to cb
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_loop_add_signals(XenoFlowLoop *loop, const sigset_t *signals, xenoflow_loop_signal_cb cb,
+				       void *arg);
+
+/**
+ * @brief Run fn on the loop thread, callable from any thread
+ * @param loop The loop
+ * @param fn Function to run
+ * @param arg Passed to fn
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NO_MEMORY otherwise
+ */
+doca_error_t xenoflow_loop_post(XenoFlowLoop *loop, xenoflow_loop_call_fn fn, void *arg);
+
+/**
+ * @brief Dispatch events until xenoflow_loop_stop() is called
+ * @param loop The loop
+ * @return DOCA_SUCCESS after a stop, error code if epoll_wait() failed
+ */
+doca_error_t xenoflow_loop_run(XenoFlowLoop *loop);
+
+/**
+ * @brief Make xenoflow_loop_run() return after the current event, callable from any thread
+ * @param loop The loop
+ */
+void xenoflow_loop_stop(XenoFlowLoop *loop);
+
+#endif /* EVENTLOOP_H */
@@ -0,0 +1,220 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <doca_log.h>
+
+#include "evlog.h"
+
+DOCA_LOG_REGISTER(EVLOG);
+
+#define RING_MASK (XENOFLOW_EVLOG_RING_SIZE - 1)
+
+/*
+ * Single producer (the owning thread), single consumer (the drainer).
+ * head and tail only grow, the slot is their value masked.
+ */
+typedef struct EvlogRing {
+	_Atomic uint64_t head;		/* next slot the producer writes */
+	_Atomic uint64_t tail;		/* next slot the drainer reads */
+	_Atomic uint64_t dropped;
+	uint16_t thread;
+	struct EvlogRing *next;
+	XenoFlowEvent events[XENOFLOW_EVLOG_RING_SIZE];
+} EvlogRing;
+
+volatile int xenoflow_evlog_on;
+
+static struct {
+	FILE *file;
+	pthread_t thread;
+	volatile int running;
+	pthread_mutex_t lock;		/* rings list */
+	EvlogRing *rings;
+	uint16_t nb_threads;
+	uint64_t nb_written;
+} evlog = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static __thread EvlogRing *thread_ring;
+
+uint64_t xenoflow_evlog_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t xenoflow_evlog_mac(const uint8_t *mac)
+{
+	uint64_t v = 0;
+
+	for (int i = 0; i < 6; i++)
+		v = (v << 8) | mac[i];
+	return v;
+}
+
+/* First event of a thread: allocate its ring, the only locked step */
+static EvlogRing *register_thread(void)
+{
+	EvlogRing *ring = calloc(1, sizeof(*ring));
+
+	if (ring == NULL)
+		return NULL;
+
+	pthread_mutex_lock(&evlog.lock);
+	ring->thread = evlog.nb_threads++;
+	ring->next = evlog.rings;
+	evlog.rings = ring;
+	pthread_mutex_unlock(&evlog.lock);
+
+	thread_ring = ring;
+	return ring;
+}
+
+void xenoflow_evlog_record(uint16_t type, uint32_t a, uint64_t b, uint64_t c)
+{
+	EvlogRing *ring = thread_ring;
+	XenoFlowEvent *ev;
+	uint64_t head;
+
+	if (ring == NULL) {
+		ring = register_thread();
+		if (ring == NULL)
+			return;
+	}
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == XENOFLOW_EVLOG_RING_SIZE) {
+		atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	ev = &ring->events[head & RING_MASK];
+	ev->ts_ns = xenoflow_evlog_now();
+	ev->type = type;
+	ev->thread = ring->thread;
+	ev->a = a;
+	ev->b = b;
+	ev->c = c;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void xenoflow_evlog_name(uint32_t id, const char *name)
+{
+	uint64_t packed[2] = {0, 0};
+
+	if (!xenoflow_evlog_on)
+		return;
+	strncpy((char *)packed, name, sizeof(packed));
+	xenoflow_evlog_record(XENOFLOW_EV_BACKEND_NAME, id, packed[0], packed[1]);
+}
+
+/* Write everything the producers published, at most two fwrite calls per ring */
+static void drain(void)
+{
+	EvlogRing *ring;
+
+	pthread_mutex_lock(&evlog.lock);
+	ring = evlog.rings;
+	pthread_mutex_unlock(&evlog.lock);
+
+	/* Rings are only ever prepended, the list from ring on does not change */
+	for (; ring != NULL; ring = ring->next) {
+		uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+		uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+		while (tail != head) {
+			uint64_t start = tail & RING_MASK;
+			uint64_t n = head - tail;
+
+			if (start + n > XENOFLOW_EVLOG_RING_SIZE)
+				n = XENOFLOW_EVLOG_RING_SIZE - start;
+			fwrite(&ring->events[start], sizeof(XenoFlowEvent), n, evlog.file);
+			evlog.nb_written += n;
+			tail += n;
+		}
+		atomic_store_explicit(&ring->tail, tail, memory_order_release);
+	}
+	fflush(evlog.file);
+}
+
+static void *drainer_main(void *arg)
+{
+	struct timespec interval = {
+		.tv_sec = 0,
+		.tv_nsec = XENOFLOW_EVLOG_DRAIN_INTERVAL_MS * 1000000L,
+	};
+
+	(void)arg;
+	while (evlog.running) {
+		nanosleep(&interval, NULL);
+		drain();
+	}
+	drain();
+	return NULL;
+}
+
+int xenoflow_evlog_start(const char *path)
+{
+	XenoFlowEvlogHeader header = {0};
+	struct timespec real;
+
+	evlog.file = fopen(path, "wb");
+	if (evlog.file == NULL) {
+		DOCA_LOG_ERR("Failed to open event log %s", path);
+		return -1;
+	}
+
+	memcpy(header.magic, XENOFLOW_EVLOG_MAGIC, sizeof(header.magic));
+	header.version = XENOFLOW_EVLOG_VERSION;
+	header.record_size = sizeof(XenoFlowEvent);
+	header.mono_start_ns = xenoflow_evlog_now();
+	clock_gettime(CLOCK_REALTIME, &real);
+	header.real_start_ns = (uint64_t)real.tv_sec * 1000000000ULL + (uint64_t)real.tv_nsec;
+	if (fwrite(&header, sizeof(header), 1, evlog.file) != 1) {
+		DOCA_LOG_ERR("Failed to write event log header to %s", path);
+		fclose(evlog.file);
+		evlog.file = NULL;
+		return -1;
+	}
+
+	evlog.running = 1;
+	if (pthread_create(&evlog.thread, NULL, drainer_main, NULL) != 0) {
+		DOCA_LOG_ERR("Failed to start the event log drainer");
+		evlog.running = 0;
+		fclose(evlog.file);
+		evlog.file = NULL;
+		return -1;
+	}
+
+	xenoflow_evlog_on = 1;
+	DOCA_LOG_INFO("Recording events to %s", path);
+	return 0;
+}
+
+void xenoflow_evlog_stop(void)
+{
+	uint64_t dropped = 0;
+
+	if (!evlog.running)
+		return;
+
+	xenoflow_evlog_on = 0;
+	evlog.running = 0;
+	pthread_join(evlog.thread, NULL);
+	fclose(evlog.file);
+	evlog.file = NULL;
+
+	pthread_mutex_lock(&evlog.lock);
+	for (EvlogRing *ring = evlog.rings; ring != NULL; ring = ring->next)
+		dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+	pthread_mutex_unlock(&evlog.lock);
+
+	DOCA_LOG_INFO("Event log closed: %" PRIu64 " events from %u threads, %" PRIu64 " dropped", evlog.nb_written,
+		      evlog.nb_threads, dropped);
+}
@@ -0,0 +1,132 @@
+#ifndef EVLOG_H
+#define EVLOG_H
+
+#include <stdint.h>
+
+/*
+ * Binary event log. Every thread records into its own lock-free ring, a
+ * background thread drains all rings into one file and xeno_evlog decodes
+ * it offline. Recording an event is a clock read and a 32-byte store, so
+ * traces can stay on where per-event DOCA_LOG lines would flood the log.
+ *
+ * Only this header is needed to read the file: a XenoFlowEvlogHeader
+ * followed by XenoFlowEvent records, in drain order (ordered per thread).
+ */
+
+#define XENOFLOW_EVLOG_MAGIC "XFEVLOG1"
+#define XENOFLOW_EVLOG_VERSION 1
+
+/* Events per thread ring, a power of two. A full ring drops new events and counts them */
+#define XENOFLOW_EVLOG_RING_SIZE 65536
+
+/* How often the drainer empties the rings */
+#define XENOFLOW_EVLOG_DRAIN_INTERVAL_MS 10
+
+/**
+ * @brief Event types and the meaning of their a, b and c fields
+ */
+enum XenoFlowEventType {
+	XENOFLOW_EV_BACKEND_ADD = 1,	/* a: counter index, b: MAC, c: queue-to-completion ns */
+	XENOFLOW_EV_BACKEND_ADD_FAILED,	/* a: counter index, b: MAC, c: doca_error_t */
+	XENOFLOW_EV_BACKEND_REMOVE,	/* a: counter index, b: MAC, c: queue-to-completion ns */
+	XENOFLOW_EV_BACKEND_NAME,	/* a: counter index, b and c: first 16 bytes of the name */
+	XENOFLOW_EV_VIP_ADD,		/* a: service index, b: VIP (network order), c: protocol << 16 | port */
+	XENOFLOW_EV_COUNTER_SAMPLE,	/* a: counter index, b: packets, c: bytes */
+	XENOFLOW_EV_API_CALL,		/* a: endpoint, b: method (0 GET, 1 POST), c: handler ns */
+	XENOFLOW_EV_OPS_BATCH,		/* a: operations pushed, b: coalescing window us */
+	XENOFLOW_EV_RELOAD,		/* a: backends queued */
+	XENOFLOW_EV_BUCKET_MOVE,	/* a: counter index of the bucket, b and c: counter index of the old and new owner */
+	XENOFLOW_EV_MAX,
+};
+
+/**
+ * @brief Endpoints recorded by XENOFLOW_EV_API_CALL
+ */
+enum XenoFlowEvlogEndpoint {
+	XENOFLOW_EVLOG_API_OTHER,
+	XENOFLOW_EVLOG_API_BASE,	/* /api */
+	XENOFLOW_EVLOG_API_SERVICES,	/* /api/services */
+	XENOFLOW_EVLOG_API_RESOURCES,	/* /api/resources */
+	XENOFLOW_EVLOG_API_RELOAD,	/* /api/reload */
+	XENOFLOW_EVLOG_API_STARTUP,	/* /api/startup */
+	XENOFLOW_EVLOG_API_STREAM,	/* /api/stream */
+	XENOFLOW_EVLOG_API_HISTORY,	/* /api/history */
+	XENOFLOW_EVLOG_API_LOOKUP,	/* /api/lookup */
+	XENOFLOW_EVLOG_API_MAX,
+};
+
+/**
+ * @brief One recorded event, 32 bytes
+ */
+typedef struct {
+	uint64_t ts_ns;		/* CLOCK_MONOTONIC */
+	uint16_t type;		/* enum XenoFlowEventType */
+	uint16_t thread;	/* recording thread, in order of their first event */
+	uint32_t a;
+	uint64_t b;
+	uint64_t c;
+} XenoFlowEvent;
+
+/**
+ * @brief File header, maps the monotonic timestamps to wall-clock time
+ */
+typedef struct {
+	char magic[8];		/* XENOFLOW_EVLOG_MAGIC */
+	uint32_t version;
+	uint32_t record_size;	/* sizeof(XenoFlowEvent) */
+	uint64_t mono_start_ns;	/* CLOCK_MONOTONIC when the log was opened */
+	uint64_t real_start_ns;	/* CLOCK_REALTIME at the same moment */
+} XenoFlowEvlogHeader;
+
+/* Set while a log is open, checked inline so disabled tracing costs one load */
+extern volatile int xenoflow_evlog_on;
+
+/**
+ * @brief Open the log file and start the drainer thread
+ * @param path File to write, truncated
+ * @return 0 on success, -1 on failure
+ */
+int xenoflow_evlog_start(const char *path);
+
+/**
+ * @brief Drain what is left, stop the drainer and close the file
+ *
+ * Rings stay allocated, a thread racing with the stop writes into its ring
+ * and the event is simply never drained.
+ */
+void xenoflow_evlog_stop(void);
+
+/**
+ * @brief Monotonic clock in nanoseconds, the time base of all events
+ * @return Current time
+ */
+uint64_t xenoflow_evlog_now(void);
+
+/**
+ * @brief Record an event in the calling thread's ring
+ * @param type enum XenoFlowEventType
+ * @param a, b, c Type-specific fields
+ */
+void xenoflow_evlog_record(uint16_t type, uint32_t a, uint64_t b, uint64_t c);
+
+/**
+ * @brief Record the first 16 bytes of a name for an id, so the decoder can print names
+ * @param id Counter index the name belongs to
+ * @param name Name, NUL-terminated
+ */
+void xenoflow_evlog_name(uint32_t id, const char *name);
+
+/**
+ * @brief Pack a 6-byte MAC address into the low bytes of a 64-bit field
+ * @param mac MAC address
+ * @return MAC as a number, first byte most significant
+ */
+uint64_t xenoflow_evlog_mac(const uint8_t *mac);
+
+static inline void xenoflow_evlog(uint16_t type, uint32_t a, uint64_t b, uint64_t c)
+{
+	if (xenoflow_evlog_on)
+		xenoflow_evlog_record(type, a, b, c);
+}
+
+#endif /* EVLOG_H */
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <rte_byteorder.h>
+
+#include <doca_log.h>
+#include <doca_flow.h>
+#include <doca_dev.h>
+
+#include "flow_common.h"
+#include "devices.h"
+
+DOCA_LOG_REGISTER(FLOW_COUNTER_QUERY);
+
+/* Largest pool measured, counters for both modes are reserved up front */
+#define MAX_COUNTERS 65536
+/* Entries pushed to the queue before processing */
+#define ENTRY_BATCH 64
+/* Collections timed per size and mode */
+#define ROUNDS 20
+
+static const uint32_t bench_sizes[] = {1024, 4096, 16384, 65536};
+
+void doca_try(doca_error_t result, char* message, int nb_ports, struct doca_flow_port** ports) {
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("%s: %s", message, doca_error_get_descr(result));
+		stop_doca_flow_ports(nb_ports, ports);
+		doca_flow_destroy();
+		exit(-1);
+	}
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static doca_error_t create_hash_pipe(struct doca_flow_port *port, uint32_t nb_entries, int shared,
+				     struct doca_flow_pipe **pipe)
+{
+	struct doca_flow_match match_mask;
+	struct doca_flow_monitor monitor;
+	struct doca_flow_fwd fwd;
+	struct doca_flow_pipe_cfg *pipe_cfg;
+	doca_error_t result;
+
+	memset(&match_mask, 0, sizeof(match_mask));
+	memset(&monitor, 0, sizeof(monitor));
+	memset(&fwd, 0, sizeof(fwd));
+
+	match_mask.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+	match_mask.outer.ip4.src_ip = 0xffffffff;
+
+	if (shared) {
+		monitor.counter_type = DOCA_FLOW_RESOURCE_TYPE_SHARED;
+		monitor.shared_counter.shared_counter_id = 0xffffffff;
+	} else {
+		monitor.counter_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	}
+
+	result = doca_flow_pipe_cfg_create(&pipe_cfg, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to create doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	result = set_flow_pipe_cfg(pipe_cfg, "COUNTER_BENCH_PIPE", DOCA_FLOW_PIPE_HASH, true);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	result = doca_flow_pipe_cfg_set_nr_entries(pipe_cfg, nb_entries);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg nr_entries: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	result = doca_flow_pipe_cfg_set_match(pipe_cfg, NULL, &match_mask);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg match: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	result = doca_flow_pipe_cfg_set_monitor(pipe_cfg, &monitor);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to set doca_flow_pipe_cfg monitor: %s", doca_error_get_descr(result));
+		goto destroy_pipe_cfg;
+	}
+
+	fwd.type = DOCA_FLOW_FWD_PORT;
+	fwd.port_id = 0;
+
+	result = doca_flow_pipe_create(pipe_cfg, &fwd, NULL, pipe);
+
+destroy_pipe_cfg:
+	doca_flow_pipe_cfg_destroy(pipe_cfg);
+	return result;
+}
+
+static doca_error_t add_entries(struct doca_flow_port *port, struct doca_flow_pipe *pipe, uint32_t nb_entries,
+				int shared, struct doca_flow_pipe_entry **entries)
+{
+	struct entries_status status;
+	struct doca_flow_monitor monitor;
+	struct doca_flow_fwd fwd;
+	doca_error_t result;
+
+	memset(&status, 0, sizeof(status));
+	memset(&fwd, 0, sizeof(fwd));
+	fwd.type = DOCA_FLOW_FWD_PORT;
+	fwd.port_id = 0;
+
+	for (uint32_t i = 0; i < nb_entries; i++) {
+		enum doca_flow_flags_type flags = DOCA_FLOW_WAIT_FOR_BATCH;
+
+		memset(&monitor, 0, sizeof(monitor));
+		if (shared) {
+			monitor.counter_type = DOCA_FLOW_RESOURCE_TYPE_SHARED;
+			monitor.shared_counter.shared_counter_id = i;
+		}
+
+		if (i % ENTRY_BATCH == ENTRY_BATCH - 1 || i == nb_entries - 1)
+			flags = DOCA_FLOW_NO_WAIT;
+
+		result = doca_flow_pipe_hash_add_entry(0, pipe, i, 0, NULL, &monitor, &fwd, flags, &status, &entries[i]);
+		if (result != DOCA_SUCCESS) {
+			DOCA_LOG_ERR("Failed to add hash entry %u: %s", i, doca_error_get_descr(result));
+			return result;
+		}
+
+		if (flags == DOCA_FLOW_NO_WAIT) {
+			result = doca_flow_entries_process(port, 0, DEFAULT_TIMEOUT_US, ENTRY_BATCH);
+			if (result != DOCA_SUCCESS) {
+				DOCA_LOG_ERR("Failed to process hash entries: %s", doca_error_get_descr(result));
+				return result;
+			}
+		}
+	}
+
+	/* Drain whatever the batched calls above left in flight */
+	while (status.nb_processed < (int)nb_entries && !status.failure) {
+		result = doca_flow_entries_process(port, 0, DEFAULT_TIMEOUT_US, nb_entries - status.nb_processed);
+		if (result != DOCA_SUCCESS)
+			return result;
+	}
+
+	if (status.failure) {
+		DOCA_LOG_ERR("Hash entry processing failed");
+		return DOCA_ERROR_BAD_STATE;
+	}
+	return DOCA_SUCCESS;
+}
+
+/* Time ROUNDS collections of nb counters and return the mean cost of one collection in us */
+static double time_collection(struct doca_flow_pipe_entry **entries, uint32_t *ids,
+			      struct doca_flow_resource_query *results, uint32_t nb, int shared)
+{
+	double start = now_us();
+	uint64_t total = 0;
+
+	for (int round = 0; round < ROUNDS; round++) {
+		if (shared) {
+			doca_flow_shared_resources_query(DOCA_FLOW_SHARED_RESOURCE_COUNTER, ids, results, nb);
+		} else {
+			for (uint32_t i = 0; i < nb; i++)
+				doca_flow_resource_query_entry(entries[i], &results[i]);
+		}
+		total += results[nb - 1].counter.total_pkts;
+	}
+
+	DOCA_LOG_DBG("Checksum %lu", total);
+	return (now_us() - start) / ROUNDS;
+}
+
+/* PCI address, interface name or MAC of the device, see devices.h */
+static const char *const device_selector = "0000:03:00.0";
+
+doca_error_t xeno_flow_counter_query(int nb_queues)
+{
+	int nb_ports = 1;
+	struct flow_resources resource = {0};
+	uint32_t nr_shared_resources[SHARED_RESOURCE_NUM_VALUES] = {0};
+	struct doca_flow_shared_resource_cfg cfg = {.domain = DOCA_FLOW_PIPE_DOMAIN_DEFAULT};
+	struct doca_flow_port *ports[1];
+	struct doca_dev *dev_arr[1];
+	uint32_t action_mem[1] = {0};
+	uint32_t nb_sizes = sizeof(bench_sizes) / sizeof(bench_sizes[0]);
+	double cost[nb_sizes][2];
+
+	uint32_t *ids = malloc(MAX_COUNTERS * sizeof(uint32_t));
+	struct doca_flow_pipe_entry **entries = calloc(MAX_COUNTERS, sizeof(*entries));
+	struct doca_flow_resource_query *results = calloc(MAX_COUNTERS, sizeof(*results));
+
+	if (ids == NULL || entries == NULL || results == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	for (uint32_t i = 0; i < MAX_COUNTERS; i++)
+		ids[i] = i;
+
+	resource.mode = DOCA_FLOW_RESOURCE_MODE_PORT;
+	resource.nr_counters = MAX_COUNTERS;
+	nr_shared_resources[DOCA_FLOW_SHARED_RESOURCE_COUNTER] = MAX_COUNTERS;
+
+	doca_try(init_doca_flow(nb_queues, "switch", &resource, nr_shared_resources), "Failed to init DOCA Flow", nb_ports, ports);
+
+	if (xenoflow_device_open(device_selector, &dev_arr[0]) != DOCA_SUCCESS)
+		return DOCA_ERROR_NOT_FOUND;
+	xenoflow_devices_release();
+
+	ARRAY_INIT(action_mem, ACTIONS_MEM_SIZE(1));
+	doca_try(init_doca_flow_ports(nb_ports, ports, true, dev_arr, action_mem, &resource), "Failed to init DOCA ports", nb_ports, ports);
+
+	for (uint32_t i = 0; i < MAX_COUNTERS; i++)
+		doca_try(doca_flow_shared_resource_set_cfg(DOCA_FLOW_SHARED_RESOURCE_COUNTER, i, &cfg),
+			 "Failed to configure shared counter", nb_ports, ports);
+	doca_try(doca_flow_shared_resources_bind(DOCA_FLOW_SHARED_RESOURCE_COUNTER, ids, MAX_COUNTERS, ports[0]),
+		 "Failed to bind shared counters", nb_ports, ports);
+
+	for (uint32_t s = 0; s < nb_sizes; s++) {
+		uint32_t nb = bench_sizes[s];
+
+		for (int shared = 0; shared <= 1; shared++) {
+			struct doca_flow_pipe *pipe;
+
+			doca_try(create_hash_pipe(ports[0], nb, shared, &pipe), "Failed to create hash pipe", nb_ports, ports);
+			doca_try(add_entries(ports[0], pipe, nb, shared, entries), "Failed to add entries", nb_ports, ports);
+
+			cost[s][shared] = time_collection(entries, ids, results, nb, shared);
+			DOCA_LOG_INFO("%6u counters, %-10s: %10.1f us per collection, %7.1f ns per counter",
+				      nb, shared ? "shared" : "per-entry", cost[s][shared], cost[s][shared] * 1000 / nb);
+
+			doca_flow_pipe_destroy(pipe);
+		}
+	}
+
+	DOCA_LOG_INFO("============================================");
+	DOCA_LOG_INFO("counters,per_entry_us,shared_bulk_us,speedup");
+	for (uint32_t s = 0; s < nb_sizes; s++)
+		DOCA_LOG_INFO("%u,%.1f,%.1f,%.1f", bench_sizes[s], cost[s][0], cost[s][1],
+			      cost[s][1] > 0 ? cost[s][0] / cost[s][1] : 0);
+
+	free(ids);
+	free(entries);
+	free(results);
+
+	doca_error_t result = stop_doca_flow_ports(nb_ports, ports);
+	doca_flow_destroy();
+	return result;
+}
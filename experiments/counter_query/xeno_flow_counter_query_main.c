@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2022-2023 NVIDIA CORPORATION AND AFFILIATES.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright notice, this list of
+ *       conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright notice, this list of
+ *       conditions and the following disclaimer in the documentation and/or other materials
+ *       provided with the distribution.
+ *     * Neither the name of the NVIDIA CORPORATION nor the names of its contributors may be used
+ *       to endorse or promote products derived from this software without specific prior written
+ *       permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NVIDIA CORPORATION BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TOR (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <stdlib.h>
+
+#include <doca_argp.h>
+#include <doca_flow.h>
+#include <doca_log.h>
+#include <doca_dpdk.h>
+
+
+#include <flow_common.h>
+#include <flow_switch_common.h>
+#include <dpdk_utils.h>
+
+DOCA_LOG_REGISTER(FLOW_SHARED_COUNTER::MAIN);
+
+/* Sample's Logic */
+doca_error_t xeno_flow_counter_query(int nb_queues);
+
+/*
+ * Sample main function
+ *
+ * @argc [in]: command line arguments size
+ * @argv [in]: array of command line arguments
+ * @return: EXIT_SUCCESS on success and EXIT_FAILURE otherwise
+ */
+
+ struct flow_hot_upgrade_ctx {
+	struct flow_switch_ctx switch_ctx;	   /* common switch context */
+	enum doca_flow_port_operation_state state; /* operation state to use after port configuration */
+};
+
+ void *xeno_flow_wrapper(void *arg) {
+    int nb_queues = *(int *)arg;
+    doca_error_t result = xeno_flow_counter_query(nb_queues);
+    if (result != DOCA_SUCCESS) {
+        DOCA_LOG_ERR("xeno_flow encountered an error: %s", doca_error_get_descr(result));
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	doca_error_t result;
+	struct doca_log_backend *sdk_log;
+	int exit_status = EXIT_FAILURE;
+	struct application_dpdk_config dpdk_config = {
+		.port_config.nb_ports = 2,
+		.port_config.nb_queues = 4,
+	};
+	//struct flow_dev_ctx ctx = {};
+
+	result = doca_log_backend_create_standard();
+	if (result != DOCA_SUCCESS)
+		goto sample_exit;
+	result = doca_log_backend_create_with_file_sdk(stderr, &sdk_log);
+	if (result != DOCA_SUCCESS)
+		goto sample_exit;
+	result = doca_log_backend_set_sdk_level(sdk_log, DOCA_LOG_LEVEL_WARNING);
+	if (result != DOCA_SUCCESS)
+		goto sample_exit;
+
+	DOCA_LOG_INFO("Starting the load balancer");
+
+	result = doca_argp_init("xeno_flow_counter_query", NULL);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to init ARGP resources: %s", doca_error_get_descr(result));
+		goto sample_exit;
+	}
+	
+	doca_argp_set_dpdk_program(dpdk_init);
+	result = doca_argp_start(argc, argv);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to parse sample input: %s", doca_error_get_descr(result));
+		goto argp_cleanup;
+	}
+
+	/* update queues and ports */
+	result = dpdk_queues_and_ports_init(&dpdk_config);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to update ports and queues");
+		goto dpdk_cleanup;
+	}
+
+	/* run sample */
+	result = xeno_flow_counter_query(dpdk_config.port_config.nb_queues);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("xeno_flow_counter_query() encountered an error: %s", doca_error_get_descr(result));
+		goto dpdk_ports_queues_cleanup;
+	}
+
+	exit_status = EXIT_SUCCESS;
+
+dpdk_ports_queues_cleanup:
+	dpdk_queues_and_ports_fini(&dpdk_config);
+dpdk_cleanup:
+	dpdk_fini();
+argp_cleanup:
+	doca_argp_destroy();
+sample_exit:
+	if (exit_status == EXIT_SUCCESS)
+		DOCA_LOG_INFO("Sample finished successfully");
+	else
+		DOCA_LOG_INFO("Sample finished with errors");
+	return exit_status;
+}
@@ -0,0 +1,38 @@
+#!/bin/sh
+# The XDP load balancer on a veth pair, no DPU or XDP-capable NIC needed: xeno_gen sends from a
+# network namespace into xdp1, the program on xdp0 rewrites the destination MAC and sends the
+# packets back out of xdp0, and xeno_gen counts them per destination MAC (i.e. backend).
+#
+# Run as root from this directory after building both this experiment and xeno_flow, e.g.
+#   ./run_veth.sh
+#   GEN_ARGS="--dst-ip 10.0.0.1 --dist zipf" ./run_veth.sh	# default service instead of the dns VIP
+set -e
+
+BUILD=${BUILD:-builddir}
+GEN_BUILD=${GEN_BUILD:-../../build}
+CONFIG=${CONFIG:-services_veth.json}
+NS=${NS:-xenogen}
+GEN_ARGS=${GEN_ARGS:---dst-ip 10.0.0.53 --dst-port 53 --sources 4096}
+COUNT=${COUNT:-1000000}
+
+cleanup() {
+	[ -n "$LB" ] && kill "$LB" 2>/dev/null && wait "$LB" || true
+	ip netns del "$NS" 2>/dev/null || true
+	ip link del xdp0 2>/dev/null || true
+}
+trap cleanup EXIT
+
+ip netns add "$NS"
+ip link add xdp0 type veth peer name xdp1 netns "$NS"
+ip link set xdp0 up
+ip -n "$NS" link set xdp1 up
+# XDP_TX on a veth needs NAPI on the peer, which GRO (or an XDP program there) turns on
+ip netns exec "$NS" ethtool -K xdp1 gro on
+
+"$BUILD/xeno_flow_xdp" --iface xdp0 --config "$CONFIG" --bpf-obj "$BUILD/xeno_xdp.bpf.o" &
+LB=$!
+sleep 1
+
+ip netns exec "$NS" "$GEN_BUILD/xeno_gen" -l 0-2 --no-pci --vdev=net_af_packet0,iface=xdp1 -- \
+	--rx-port 0 --count "$COUNT" $GEN_ARGS
+sleep 1
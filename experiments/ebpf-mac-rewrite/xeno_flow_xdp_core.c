@@ -0,0 +1,558 @@
+/*
+ * Control plane of the XDP data path: loads the same services config as
+ * xeno_flow, lays every service's hash entries out as a range of buckets
+ * like create_hash_pipe() and add_hash_entries() do, and reports the
+ * per-backend traffic read back with batched lookups of the counters map.
+ * It reads the config with services_json.c alone, so it needs no DOCA.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <linux/if_link.h>
+
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+
+#include "services_json.h"
+#include "xeno_xdp.h"
+
+/* Slots per bpf_map_*_batch() call */
+#define XDP_BATCH 4096
+
+/* Per-CPU values are laid out 8-byte aligned, one per possible CPU */
+#define XDP_COUNTER_SIZE ((sizeof(struct xeno_xdp_counter) + 7) & ~(size_t)7)
+
+struct xdp_state {
+	struct bpf_object *obj;
+	int ifindex;
+	__u32 attach_flags;
+	int vips_fd;
+	int default_fd;
+	int buckets_fd;
+	int counters_fd;
+	int tx_port_fd;
+	int nb_cpus;
+	XenoFlowServicesFile file;	/* the config the buckets were written from */
+	__u32 base;			/* first bucket of the half in use */
+	__u32 nb_used;			/* buckets used from base on */
+	int *owners;			/* backend of bucket base + i in its service, -1 if it has none */
+	struct xeno_xdp_service *ranges; /* buckets of service i, none if the kernel gets its traffic */
+	struct xeno_xdp_counter *last;	/* totals of bucket base + i at the last report */
+	struct timespec last_time;
+	void *percpu;			/* lookup buffer, XDP_BATCH buckets of nb_cpus values */
+};
+
+static uint32_t next_power_of_two(uint32_t value)
+{
+	if (value <= 1)
+		return 1;
+
+	value--;
+	value |= value >> 1;
+	value |= value >> 2;
+	value |= value >> 4;
+	value |= value >> 8;
+	value |= value >> 16;
+	return value + 1;
+}
+
+/*
+ * Services the XDP program cannot serve: it only rewrites the destination MAC,
+ * so NAT, tunnels and meters stay on the DPU
+ */
+static const char *unsupported_reason(const XenoFlowServiceDesc *service)
+{
+	if (service->nat)
+		return "NAT";
+	if (service->spillover != XENOFLOW_SPILLOVER_NONE)
+		return "spillover";
+	for (int i = 0; i < service->nb_backends; i++) {
+		if (service->backends[i].tunnel != XENOFLOW_TUNNEL_NONE)
+			return "tunneled backends";
+	}
+	return NULL;
+}
+
+/*
+ * Lay out one service's buckets like its hash pipe: every backend in its home
+ * slot, the rest of a rebalanced service's buckets round-robin over the
+ * backends that are not the host, and a slot nobody owns drops like a miss
+ */
+static void layout_service(const XenoFlowServiceDesc *service, uint32_t nb, int *owners)
+{
+	int next = 0;
+
+	for (uint32_t slot = 0; slot < nb; slot++)
+		owners[slot] = (int)slot < service->nb_backends ? (int)slot : -1;
+	if (service->buckets == 0)
+		return;
+	for (uint32_t slot = service->nb_backends; slot < nb; slot++) {
+		for (int tries = 0; tries < service->nb_backends; tries++) {
+			int b = next;
+
+			next = (next + 1) % service->nb_backends;
+			if (!service->backends[b].host) {
+				owners[slot] = b;
+				break;
+			}
+		}
+	}
+}
+
+/* Write count consecutive slots from first; with repeat, every batch writes the same values */
+static int write_slots(int fd, __u32 first, __u32 count, const void *values, size_t value_size, bool repeat)
+{
+	__u32 keys[XDP_BATCH];
+
+	for (__u32 done = 0; done < count;) {
+		__u32 n = count - done < XDP_BATCH ? count - done : XDP_BATCH;
+		const void *batch = repeat ? values : (const char *)values + (size_t)done * value_size;
+		int ret;
+
+		for (__u32 i = 0; i < n; i++)
+			keys[i] = first + done + i;
+		ret = bpf_map_update_batch(fd, keys, batch, &n, NULL);
+		if (ret != 0)
+			return ret;
+		done += n;
+	}
+	return 0;
+}
+
+static void vip_key(const XenoFlowServiceDesc *service, struct xeno_xdp_vip *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->addr = service->vip;
+	key->port = htons(service->port);
+	key->protocol = service->protocol;
+}
+
+/* Drop the VIPs of the old config the new one no longer has */
+static void delete_stale_vips(struct xdp_state *st, const XenoFlowServicesFile *file)
+{
+	struct xeno_xdp_vip key, next, stale[XENO_XDP_MAX_SERVICES];
+	struct xeno_xdp_vip *prev = NULL;
+	int nb_stale = 0;
+
+	while (bpf_map_get_next_key(st->vips_fd, prev, &next) == 0) {
+		bool found = false;
+
+		for (int s = 0; s < file->nb_services && !found; s++) {
+			struct xeno_xdp_vip wanted;
+
+			if (file->services[s].protocol == 0)
+				continue;
+			vip_key(&file->services[s], &wanted);
+			found = memcmp(&wanted, &next, sizeof(next)) == 0;
+		}
+		if (!found && nb_stale < XENO_XDP_MAX_SERVICES)
+			stale[nb_stale++] = next;
+		key = next;
+		prev = &key;
+	}
+	for (int i = 0; i < nb_stale; i++)
+		bpf_map_delete_elem(st->vips_fd, &stale[i]);
+}
+
+/*
+ * Write services into the half of the buckets not in use, then point the VIPs
+ * and the default service at it. A packet sees either the old or the new
+ * buckets of its service, never a mix.
+ */
+static int program_services(struct xdp_state *st, const XenoFlowServicesFile *file)
+{
+	__u32 base = st->base == 0 ? XENO_XDP_HALF_BUCKETS : 0;
+	struct xeno_xdp_service *ranges = NULL;
+	struct xeno_xdp_bucket *buckets = NULL;
+	const XenoFlowBackendDesc **backends = NULL;
+	int *owners = NULL;
+	struct xeno_xdp_counter *last = NULL;
+	void *zero = NULL;
+	bool has_default = false;
+	__u32 used = 0;
+	int ret;
+
+	ranges = calloc(file->nb_services, sizeof(*ranges));
+	owners = calloc(XENO_XDP_HALF_BUCKETS, sizeof(*owners));
+	backends = calloc(XENO_XDP_HALF_BUCKETS, sizeof(*backends));
+	if ((ranges == NULL && file->nb_services > 0) || owners == NULL || backends == NULL)
+		goto no_memory;
+
+	for (int s = 0; s < file->nb_services; s++) {
+		const XenoFlowServiceDesc *service = &file->services[s];
+		uint32_t wanted = service->buckets > (uint32_t)service->nb_backends ?
+					  service->buckets : (uint32_t)service->nb_backends;
+		uint32_t nb = next_power_of_two(wanted);
+		const char *reason = unsupported_reason(service);
+
+		if (reason != NULL) {
+			fprintf(stderr, "Service %s has %s, its traffic is left to the kernel\n", service->name, reason);
+			continue;
+		}
+		if (service->nb_backends == 0)
+			fprintf(stderr, "Service %s has no backends, its traffic is dropped\n", service->name);
+		if (nb > XENO_XDP_HALF_BUCKETS - used) {
+			fprintf(stderr, "Service %s needs %u buckets, only %u left\n", service->name, nb,
+				XENO_XDP_HALF_BUCKETS - used);
+			free(ranges);
+			free(owners);
+			free(backends);
+			return -ENOSPC;
+		}
+		layout_service(service, nb, owners + used);
+		for (uint32_t i = 0; i < nb; i++)
+			backends[used + i] = owners[used + i] >= 0 ? &service->backends[owners[used + i]] : NULL;
+		ranges[s].first_bucket = base + used;
+		ranges[s].nb_buckets = nb;
+		used += nb;
+	}
+
+	buckets = calloc(used > 0 ? used : 1, sizeof(*buckets));
+	last = calloc(used > 0 ? used : 1, sizeof(*last));
+	zero = calloc(XDP_BATCH, XDP_COUNTER_SIZE * st->nb_cpus);
+	if (buckets == NULL || last == NULL || zero == NULL)
+		goto no_memory;
+	for (__u32 i = 0; i < used; i++) {
+		if (backends[i] == NULL)
+			continue;
+		memcpy(buckets[i].mac, backends[i]->mac_address, sizeof(buckets[i].mac));
+		buckets[i].flags = XENO_XDP_BUCKET_USED | (backends[i]->host ? XENO_XDP_BUCKET_HOST : 0);
+	}
+	ret = write_slots(st->buckets_fd, base, used, buckets, sizeof(*buckets), false);
+	if (ret == 0)
+		ret = write_slots(st->counters_fd, base, used, zero, XDP_COUNTER_SIZE * st->nb_cpus, true);
+	if (ret != 0) {
+		fprintf(stderr, "Failed to write the buckets: %s\n", strerror(-ret));
+		goto failed;
+	}
+
+	/* The switch: each service moves to its new range with one map update */
+	for (int s = 0; s < file->nb_services; s++) {
+		const XenoFlowServiceDesc *service = &file->services[s];
+		struct xeno_xdp_vip key;
+		__u32 zero_key = 0;
+
+		if (service->protocol == 0) {
+			has_default = true;
+			ret = bpf_map_update_elem(st->default_fd, &zero_key, &ranges[s], BPF_ANY);
+		} else {
+			vip_key(service, &key);
+			ret = bpf_map_update_elem(st->vips_fd, &key, &ranges[s], BPF_ANY);
+		}
+		if (ret != 0) {
+			fprintf(stderr, "Failed to point service %s at its buckets: %s\n", service->name,
+				strerror(-ret));
+			goto failed;
+		}
+	}
+	if (!has_default) {
+		struct xeno_xdp_service none = {0};
+		__u32 zero_key = 0;
+
+		bpf_map_update_elem(st->default_fd, &zero_key, &none, BPF_ANY);
+	}
+	delete_stale_vips(st, file);
+
+	free(st->owners);
+	free(st->ranges);
+	free(st->last);
+	st->owners = owners;
+	st->ranges = ranges;
+	st->last = last;
+	st->base = base;
+	st->nb_used = used;
+	clock_gettime(CLOCK_MONOTONIC, &st->last_time);
+	free(backends);
+	free(buckets);
+	free(zero);
+	printf("Programmed %d services into %u buckets\n", file->nb_services, used);
+	return 0;
+
+no_memory:
+	ret = -ENOMEM;
+	fprintf(stderr, "Failed to allocate the bucket layout\n");
+failed:
+	free(ranges);
+	free(owners);
+	free(backends);
+	free(buckets);
+	free(last);
+	free(zero);
+	return ret;
+}
+
+/* Read the counters of the buckets in use and fold them into per-bucket totals */
+static int read_counters(struct xdp_state *st, struct xeno_xdp_counter *totals)
+{
+	__u32 keys[XDP_BATCH];
+	__u32 prev_key = st->base - 1, out_key;
+	__u32 *in = st->base == 0 ? NULL : &prev_key;
+
+	for (__u32 done = 0; done < st->nb_used;) {
+		__u32 n = st->nb_used - done < XDP_BATCH ? st->nb_used - done : XDP_BATCH;
+		int ret = bpf_map_lookup_batch(st->counters_fd, in, &out_key, keys, st->percpu, &n, NULL);
+
+		/* ENOENT only says the map ended, what was read is still there */
+		if (ret != 0 && ret != -ENOENT)
+			return ret;
+		for (__u32 i = 0; i < n; i++) {
+			const char *values = (const char *)st->percpu + (size_t)i * XDP_COUNTER_SIZE * st->nb_cpus;
+
+			totals[done + i].pkts = 0;
+			totals[done + i].bytes = 0;
+			for (int cpu = 0; cpu < st->nb_cpus; cpu++) {
+				const struct xeno_xdp_counter *c =
+					(const struct xeno_xdp_counter *)(values + cpu * XDP_COUNTER_SIZE);
+
+				totals[done + i].pkts += c->pkts;
+				totals[done + i].bytes += c->bytes;
+			}
+		}
+		done += n;
+		if (ret == -ENOENT || n == 0)
+			break;
+		prev_key = out_key;
+		in = &prev_key;
+	}
+	return 0;
+}
+
+/* Like print_status(): per backend the sum of its buckets, and what fell into empty ones */
+static void print_status(struct xdp_state *st)
+{
+	const XenoFlowServicesFile *file = &st->file;
+	struct xeno_xdp_counter *totals;
+	struct timespec now;
+	double elapsed;
+	int ret;
+
+	totals = calloc(st->nb_used > 0 ? st->nb_used : 1, sizeof(*totals));
+	if (totals == NULL)
+		return;
+	ret = read_counters(st, totals);
+	if (ret != 0) {
+		fprintf(stderr, "Failed to read the counters: %s\n", strerror(-ret));
+		free(totals);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - st->last_time.tv_sec) + (now.tv_nsec - st->last_time.tv_nsec) / 1e9;
+	st->last_time = now;
+
+	printf("XenoFlow XDP Load Balancer Status - %d services\n", file->nb_services);
+	for (int s = 0; s < file->nb_services; s++) {
+		const XenoFlowServiceDesc *service = &file->services[s];
+		struct xeno_xdp_service *range = &st->ranges[s];
+		struct xeno_xdp_counter *sums, *deltas;
+		uint32_t *nb_buckets;
+		__u64 missed;
+
+		printf("Service %s - %d backends\n", service->name, service->nb_backends);
+		if (range->nb_buckets == 0)
+			continue;
+		sums = calloc(2 * (service->nb_backends + 1), sizeof(*sums));
+		nb_buckets = calloc(service->nb_backends + 1, sizeof(*nb_buckets));
+		if (sums == NULL || nb_buckets == NULL) {
+			free(sums);
+			free(nb_buckets);
+			break;
+		}
+		deltas = sums + service->nb_backends + 1;
+		/* One pass over the service's buckets, folded by the owner's position in the pool */
+		for (__u32 i = range->first_bucket - st->base; i < range->first_bucket - st->base + range->nb_buckets; i++) {
+			int b = st->owners[i] >= 0 ? st->owners[i] : service->nb_backends;
+
+			nb_buckets[b]++;
+			sums[b].pkts += totals[i].pkts;
+			sums[b].bytes += totals[i].bytes;
+			deltas[b].pkts += totals[i].pkts - st->last[i].pkts;
+			deltas[b].bytes += totals[i].bytes - st->last[i].bytes;
+		}
+		for (int b = 0; b < service->nb_backends; b++) {
+			printf("  %u buckets - %s: %llu packets, %llu bytes (%.0f pps, %.2f Mbit/s)\n", nb_buckets[b],
+			       service->backends[b].name, sums[b].pkts, sums[b].bytes,
+			       elapsed > 0 ? deltas[b].pkts / elapsed : 0,
+			       elapsed > 0 ? deltas[b].bytes * 8 / elapsed / 1e6 : 0);
+		}
+		missed = sums[service->nb_backends].pkts;
+		if (missed > 0)
+			printf("  Dropped on empty buckets: %llu packets\n", missed);
+		free(sums);
+		free(nb_buckets);
+	}
+	printf("============================================\n");
+	fflush(stdout);
+	memcpy(st->last, totals, st->nb_used * sizeof(*totals));
+	free(totals);
+}
+
+/* SIGHUP: load the config again and switch to it, the old one stays on any error */
+static void reload(struct xdp_state *st, const char *config_path)
+{
+	XenoFlowServicesFile file = {0};
+	char err[256];
+	int ret;
+
+	ret = xenoflow_services_parse(config_path, &file, err, sizeof(err));
+	if (ret != 0)
+		fprintf(stderr, "%s: %s\n", config_path, err);
+	else
+		ret = program_services(st, &file);
+	if (ret != 0) {
+		fprintf(stderr, "Reload of %s failed, keeping the running config\n", config_path);
+		xenoflow_services_file_free(&file);
+		return;
+	}
+	xenoflow_services_file_free(&st->file);
+	st->file = file;
+}
+
+static int find_maps(struct xdp_state *st)
+{
+	struct {
+		const char *name;
+		int *fd;
+	} maps[] = {
+		{"vips", &st->vips_fd},
+		{"default_service", &st->default_fd},
+		{"buckets", &st->buckets_fd},
+		{"counters", &st->counters_fd},
+		{"tx_port", &st->tx_port_fd},
+	};
+
+	for (size_t i = 0; i < sizeof(maps) / sizeof(maps[0]); i++) {
+		*maps[i].fd = bpf_object__find_map_fd_by_name(st->obj, maps[i].name);
+		if (*maps[i].fd < 0) {
+			fprintf(stderr, "BPF object has no map %s\n", maps[i].name);
+			return -ENOENT;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Run the XDP load balancer on iface until SIGINT or SIGTERM
+ *
+ * @iface [in]: interface to attach to
+ * @config_path [in]: services config, the same file xeno_flow loads
+ * @redirect [in]: interface to send rewritten packets out of, NULL for back out of iface
+ * @bpf_obj [in]: compiled xeno_xdp.bpf.o
+ * @skb_mode [in]: attach in generic mode, for drivers without native XDP
+ * @stats_interval_ms [in]: period of the status report
+ * @return: 0 on success and a negative errno otherwise
+ */
+int xeno_flow_xdp(const char *iface, const char *config_path, const char *redirect, const char *bpf_obj,
+			   bool skb_mode, uint32_t stats_interval_ms)
+{
+	struct xdp_state st = {0};
+	struct bpf_program *prog;
+	struct timespec interval = {
+		.tv_sec = stats_interval_ms / 1000,
+		.tv_nsec = (stats_interval_ms % 1000) * 1000000L,
+	};
+	char err[256];
+	sigset_t signals;
+	int ret;
+
+	st.ifindex = if_nametoindex(iface);
+	if (st.ifindex == 0) {
+		fprintf(stderr, "No interface %s\n", iface);
+		return -ENODEV;
+	}
+	st.nb_cpus = libbpf_num_possible_cpus();
+	if (st.nb_cpus <= 0) {
+		fprintf(stderr, "Failed to count the possible CPUs\n");
+		return st.nb_cpus < 0 ? st.nb_cpus : -EINVAL;
+	}
+	st.percpu = calloc(XDP_BATCH, XDP_COUNTER_SIZE * st.nb_cpus);
+	if (st.percpu == NULL)
+		return -ENOMEM;
+
+	ret = xenoflow_services_parse(config_path, &st.file, err, sizeof(err));
+	if (ret != 0) {
+		fprintf(stderr, "%s: %s\n", config_path, err);
+		goto free_state;
+	}
+
+	st.obj = bpf_object__open_file(bpf_obj, NULL);
+	if (st.obj == NULL) {
+		ret = -errno;
+		fprintf(stderr, "Failed to open %s: %s\n", bpf_obj, strerror(errno));
+		goto free_state;
+	}
+	ret = bpf_object__load(st.obj);
+	if (ret != 0) {
+		fprintf(stderr, "Failed to load %s: %s\n", bpf_obj, strerror(-ret));
+		goto close_obj;
+	}
+	prog = bpf_object__find_program_by_name(st.obj, "xeno_xdp_lb");
+	ret = prog != NULL ? find_maps(&st) : -ENOENT;
+	if (ret != 0)
+		goto close_obj;
+
+	if (redirect != NULL) {
+		__u32 zero_key = 0, out = if_nametoindex(redirect);
+
+		if (out == 0) {
+			fprintf(stderr, "No interface %s\n", redirect);
+			ret = -ENODEV;
+			goto close_obj;
+		}
+		ret = bpf_map_update_elem(st.tx_port_fd, &zero_key, &out, BPF_ANY);
+		if (ret != 0) {
+			fprintf(stderr, "Failed to redirect to %s: %s\n", redirect, strerror(-ret));
+			goto close_obj;
+		}
+	}
+
+	/* Buckets before the program, so the first packet already sees the services */
+	ret = program_services(&st, &st.file);
+	if (ret != 0)
+		goto close_obj;
+
+	st.attach_flags = XDP_FLAGS_UPDATE_IF_NOEXIST | (skb_mode ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE);
+	ret = bpf_xdp_attach(st.ifindex, bpf_program__fd(prog), st.attach_flags, NULL);
+	if (ret != 0) {
+		fprintf(stderr, "Failed to attach to %s in %s mode: %s\n", iface, skb_mode ? "generic" : "native",
+			strerror(-ret));
+		goto close_obj;
+	}
+	printf("Attached to %s in %s mode, sending %s %s\n", iface, skb_mode ? "generic" : "native",
+	       redirect != NULL ? "out of" : "back out of", redirect != NULL ? redirect : iface);
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGHUP);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	for (;;) {
+		int sig = sigtimedwait(&signals, NULL, &interval);
+
+		if (sig == SIGINT || sig == SIGTERM)
+			break;
+		if (sig == SIGHUP)
+			reload(&st, config_path);
+		else
+			print_status(&st);
+	}
+
+	printf("Detaching from %s\n", iface);
+	bpf_xdp_detach(st.ifindex, st.attach_flags & ~XDP_FLAGS_UPDATE_IF_NOEXIST, NULL);
+	ret = 0;
+close_obj:
+	bpf_object__close(st.obj);
+free_state:
+	xenoflow_services_file_free(&st.file);
+	free(st.owners);
+	free(st.ranges);
+	free(st.last);
+	free(st.percpu);
+	return ret;
+}
@@ -0,0 +1,80 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Sample's Logic */
+int xeno_flow_xdp(const char *iface, const char *config_path, const char *redirect, const char *bpf_obj,
+			   bool skb_mode, uint32_t stats_interval_ms);
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s --iface IFNAME [options]\n"
+	       "  --iface IFNAME         interface to attach the XDP program to\n"
+	       "  --config FILE          services config, as for xeno_flow (default backends.json)\n"
+	       "  --redirect IFNAME      send rewritten packets out of IFNAME instead of back out of --iface\n"
+	       "  --skb-mode             attach in generic mode, for drivers without native XDP\n"
+	       "  --bpf-obj FILE         compiled XDP program (default xeno_xdp.bpf.o)\n"
+	       "  --stats-interval MS    status report period (default 1000)\n",
+	       prog);
+}
+
+int main(int argc, char **argv)
+{
+	enum {
+		OPT_IFACE = 256, OPT_CONFIG, OPT_REDIRECT, OPT_SKB_MODE, OPT_BPF_OBJ, OPT_STATS_INTERVAL, OPT_HELP,
+	};
+	static const struct option long_opts[] = {
+		{"iface", required_argument, NULL, OPT_IFACE},
+		{"config", required_argument, NULL, OPT_CONFIG},
+		{"redirect", required_argument, NULL, OPT_REDIRECT},
+		{"skb-mode", no_argument, NULL, OPT_SKB_MODE},
+		{"bpf-obj", required_argument, NULL, OPT_BPF_OBJ},
+		{"stats-interval", required_argument, NULL, OPT_STATS_INTERVAL},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+	const char *iface = NULL, *config_path = "backends.json", *redirect = NULL, *bpf_obj = "xeno_xdp.bpf.o";
+	uint32_t stats_interval_ms = 1000;
+	bool skb_mode = false;
+	int result, opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case OPT_IFACE:
+			iface = optarg;
+			break;
+		case OPT_CONFIG:
+			config_path = optarg;
+			break;
+		case OPT_REDIRECT:
+			redirect = optarg;
+			break;
+		case OPT_SKB_MODE:
+			skb_mode = true;
+			break;
+		case OPT_BPF_OBJ:
+			bpf_obj = optarg;
+			break;
+		case OPT_STATS_INTERVAL:
+			stats_interval_ms = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (iface == NULL || stats_interval_ms == 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	result = xeno_flow_xdp(iface, config_path, redirect, bpf_obj, skb_mode, stats_interval_ms);
+	if (result != 0) {
+		fprintf(stderr, "xeno_flow_xdp encountered an error: %s\n", strerror(-result));
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,120 @@
+/*
+ * XenoFlow data path in XDP, for hosts without a DPU. Per packet, the same as
+ * the VIP pipe and a service's hash pipe: IPv4 to a VIP (or anything for the
+ * default service) is hashed on the source address to a bucket, its counter
+ * is incremented and the destination MAC is rewritten to the bucket's backend.
+ * The packet leaves through the port it came in on, like the DPU's hairpin,
+ * or through the port in tx_port.
+ */
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/in.h>
+#include <linux/ip.h>
+
+#include <bpf/bpf_endian.h>
+#include <bpf/bpf_helpers.h>
+
+#include "xeno_xdp.h"
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, XENO_XDP_MAX_SERVICES);
+	__type(key, struct xeno_xdp_vip);
+	__type(value, struct xeno_xdp_service);
+} vips SEC(".maps");
+
+/* Service of the traffic to no VIP, nb_buckets 0 if there is none */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, __u32);
+	__type(value, struct xeno_xdp_service);
+} default_service SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, XENO_XDP_MAX_BUCKETS);
+	__type(key, __u32);
+	__type(value, struct xeno_xdp_bucket);
+} buckets SEC(".maps");
+
+/* Per bucket, as xeno_flow counts per hash entry */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, XENO_XDP_MAX_BUCKETS);
+	__type(key, __u32);
+	__type(value, struct xeno_xdp_counter);
+} counters SEC(".maps");
+
+/* Port to send rewritten packets out of, empty to send them back out of the one they came in */
+struct {
+	__uint(type, BPF_MAP_TYPE_DEVMAP);
+	__uint(max_entries, 1);
+	__type(key, __u32);
+	__type(value, __u32);
+} tx_port SEC(".maps");
+
+/* murmur3 finalizer: every source bit moves the low bits the bucket is taken from */
+static __always_inline __u32 hash_source(__u32 addr)
+{
+	addr ^= addr >> 16;
+	addr *= 0x85ebca6b;
+	addr ^= addr >> 13;
+	addr *= 0xc2b2ae35;
+	addr ^= addr >> 16;
+	return addr;
+}
+
+SEC("xdp")
+int xeno_xdp_lb(struct xdp_md *ctx)
+{
+	void *data = (void *)(long)ctx->data;
+	void *data_end = (void *)(long)ctx->data_end;
+	struct ethhdr *eth = data;
+	struct iphdr *ip = (struct iphdr *)(eth + 1);
+	struct xeno_xdp_vip key = {0};
+	struct xeno_xdp_service *service;
+	struct xeno_xdp_bucket *bucket;
+	struct xeno_xdp_counter *counter;
+	__u32 zero = 0, idx;
+
+	if ((void *)(ip + 1) > data_end || eth->h_proto != bpf_htons(ETH_P_IP))
+		return XDP_PASS;
+
+	key.addr = ip->daddr;
+	key.protocol = ip->protocol;
+	/* The ports of a fragment are only in the first one */
+	if ((ip->protocol == IPPROTO_TCP || ip->protocol == IPPROTO_UDP) &&
+	    (ip->frag_off & bpf_htons(0x1fff)) == 0) {
+		__u16 *ports = (__u16 *)((__u8 *)ip + ip->ihl * 4);
+
+		if (ip->ihl < 5 || (void *)(ports + 2) > data_end)
+			return XDP_PASS;
+		key.port = ports[1];
+		service = bpf_map_lookup_elem(&vips, &key);
+	} else {
+		service = NULL;
+	}
+	if (service == NULL)
+		service = bpf_map_lookup_elem(&default_service, &zero);
+	if (service == NULL || service->nb_buckets == 0)
+		return XDP_PASS;
+
+	idx = service->first_bucket + (hash_source(ip->saddr) & (service->nb_buckets - 1));
+	bucket = bpf_map_lookup_elem(&buckets, &idx);
+	counter = bpf_map_lookup_elem(&counters, &idx);
+	if (bucket == NULL || counter == NULL)
+		return XDP_ABORTED;
+
+	counter->pkts++;
+	counter->bytes += data_end - data;
+	if ((bucket->flags & XENO_XDP_BUCKET_USED) == 0)
+		return XDP_DROP;
+	if (bucket->flags & XENO_XDP_BUCKET_HOST)
+		return XDP_PASS;
+
+	__builtin_memcpy(eth->h_dest, bucket->mac, ETH_ALEN);
+	return bpf_redirect_map(&tx_port, 0, XDP_TX);
+}
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
@@ -0,0 +1,63 @@
+#ifndef XENO_XDP_H
+#define XENO_XDP_H
+
+#include <linux/types.h>
+
+/*
+ * Maps shared by the XDP program and its control plane. The program does
+ * what xeno_flow's VIP and hash pipes do in hardware: the destination picks
+ * the service, a hash of the IPv4 source picks one of the service's buckets,
+ * and the bucket's backend MAC becomes the destination MAC.
+ */
+
+/* Most services with a VIP */
+#define XENO_XDP_MAX_SERVICES 1024
+
+/*
+ * Bucket slots of all services. The control plane writes a new configuration
+ * into the half not in use and then points the services at it, so a packet
+ * never sees a half-written table.
+ */
+#define XENO_XDP_MAX_BUCKETS (1 << 18)
+#define XENO_XDP_HALF_BUCKETS (XENO_XDP_MAX_BUCKETS / 2)
+
+/* Bucket flags */
+#define XENO_XDP_BUCKET_USED 0x1	/* has a backend, else the packet is dropped like a hash pipe miss */
+#define XENO_XDP_BUCKET_HOST 0x2	/* backend is the host, the packet goes up the stack unchanged */
+
+/**
+ * @brief Key of the vips map, the fields xeno_flow's VIP pipe matches on
+ */
+struct xeno_xdp_vip {
+	__u32 addr;		/* network order */
+	__u16 port;		/* network order */
+	__u8 protocol;		/* IPPROTO_TCP or IPPROTO_UDP */
+	__u8 pad;
+};
+
+/**
+ * @brief Value of the vips map and of the default service slot
+ */
+struct xeno_xdp_service {
+	__u32 first_bucket;	/* in the buckets map */
+	__u32 nb_buckets;	/* power of two, 0 for no service */
+};
+
+/**
+ * @brief One hash bucket, what a hash pipe entry rewrites to
+ */
+struct xeno_xdp_bucket {
+	__u8 mac[6];
+	__u8 flags;
+	__u8 pad;
+};
+
+/**
+ * @brief Traffic of one bucket on one CPU
+ */
+struct xeno_xdp_counter {
+	__u64 pkts;
+	__u64 bytes;
+};
+
+#endif /* XENO_XDP_H */
@@ -24,6 +24,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <doca_argp.h>
 #include <doca_flow.h>
@@ -37,8 +38,63 @@
 
 DOCA_LOG_REGISTER(FLOW_SHARED_COUNTER::MAIN);
 
+/* Longest device selector, as XenoFlowOptions.device */
+#define DEVICE_SELECTOR_LEN 64
+
 /* Sample's Logic */
-doca_error_t flow_lb(int nb_queues);
+doca_error_t xeno_flow_entry_latency(int nb_queues, const char *const *device_selectors);
+
+/* The two devices of the ports, from --device */
+static char device_selectors[2][DEVICE_SELECTOR_LEN];
+static const char *const device_selector_ptrs[2] = {device_selectors[0], device_selectors[1]};
+
+/*
+ * ARGP callback - devices of the two ports
+ *
+ * @param [in]: "<dev0>,<dev1>", each a PCI address, interface name or MAC
+ * @config [out]: the two selectors to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t device_callback(void *param, void *config)
+{
+	char (*selectors)[DEVICE_SELECTOR_LEN] = (char (*)[DEVICE_SELECTOR_LEN])config;
+	const char *list = (const char *)param;
+	const char *second = strchr(list, ',');
+	size_t first_len = second != NULL ? (size_t)(second - list) : 0;
+
+	if (second == NULL || first_len == 0 || first_len >= DEVICE_SELECTOR_LEN || second[1] == '\0' ||
+	    strchr(second + 1, ',') != NULL || strlen(second + 1) >= DEVICE_SELECTOR_LEN) {
+		DOCA_LOG_ERR("--device takes two selectors as <dev0>,<dev1>, each shorter than %d",
+			     DEVICE_SELECTOR_LEN);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	memcpy(selectors[0], list, first_len);
+	selectors[0][first_len] = '\0';
+	strcpy(selectors[1], second + 1);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Register the command line parameters of the experiment
+ *
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t register_params(void)
+{
+	struct doca_argp_param *param;
+	doca_error_t result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "device");
+	doca_argp_param_set_arguments(param, "<dev0>,<dev1>");
+	doca_argp_param_set_description(param, "Devices of the two ports, each a PCI address, interface name or MAC");
+	doca_argp_param_set_callback(param, device_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	doca_argp_param_set_mandatory(param);
+	return doca_argp_register_param(param);
+}
 
 /*
  * Sample main function
@@ -55,7 +111,7 @@ doca_error_t flow_lb(int nb_queues);
 
  void *xeno_flow_wrapper(void *arg) {
     int nb_queues = *(int *)arg;
-    doca_error_t result = xeno_flow_entry_latency(nb_queues);
+    doca_error_t result = xeno_flow_entry_latency(nb_queues, device_selector_ptrs);
     if (result != DOCA_SUCCESS) {
         DOCA_LOG_ERR("xeno_flow encountered an error: %s", doca_error_get_descr(result));
     }
@@ -86,11 +142,16 @@ int main(int argc, char **argv)
 
 	DOCA_LOG_INFO("Starting the load balancer");
 
-	result = doca_argp_init("doca_flow_entry_latency", NULL);
+	result = doca_argp_init("doca_flow_entry_latency", device_selectors);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to init ARGP resources: %s", doca_error_get_descr(result));
 		goto sample_exit;
 	}
+	result = register_params();
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register parameters: %s", doca_error_get_descr(result));
+		goto argp_cleanup;
+	}
 	
 	doca_argp_set_dpdk_program(dpdk_init);
 	result = doca_argp_start(argc, argv);
@@ -107,7 +168,7 @@ int main(int argc, char **argv)
 	}
 
 	/* run sample */
-	result = xeno_flow_entry_latency(dpdk_config.port_config.nb_queues);
+	result = xeno_flow_entry_latency(dpdk_config.port_config.nb_queues, device_selector_ptrs);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("flow_lb() encountered an error: %s", doca_error_get_descr(result));
 		goto dpdk_ports_queues_cleanup;
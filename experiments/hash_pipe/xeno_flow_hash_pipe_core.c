@@ -8,6 +8,7 @@
 #include <doca_flow.h>
 
 #include "flow_common.h"
+#include "devices.h"
 
 DOCA_LOG_REGISTER(FLOW_HASH_PIPE);
 
@@ -135,38 +136,8 @@ destroy_pipe_cfg:
 	return result;
 }
 
-struct doca_dev *open_doca_dev_by_pci(const char *pci_bdf)
-{
-    struct doca_devinfo **list;
-    uint32_t nb;
-    doca_error_t err;
-
-    err = doca_devinfo_create_list(&list, &nb);
-    if (err != DOCA_SUCCESS) {
-        printf("devinfo_create_list failed\n");
-        return NULL;
-    }
-
-    struct doca_dev *dev = NULL;
-
-    for (uint32_t i = 0; i < nb; i++) {
-        char pci[DOCA_DEVINFO_PCI_ADDR_SIZE] = {0};
-		uint8_t ipv4[4];
-
-        if (doca_devinfo_get_pci_addr_str(list[i], pci) != DOCA_SUCCESS)
-            continue;
-
-        if (strcmp(pci, pci_bdf) == 0) {
-			doca_devinfo_get_ipv4_addr(list[i], ipv4, DOCA_DEVINFO_IPV4_ADDR_SIZE);
-			DOCA_LOG_INFO("IPv4: %u.%u.%u.%u", ipv4[0], ipv4[1], ipv4[2], ipv4[3]);
-			err = doca_dev_open(list[i], &dev);
-            break;
-        }
-    }
-
-    doca_devinfo_destroy_list(list);
-    return dev;
-}
+/* PCI address, interface name or MAC of each device, see devices.h */
+static const char *const device_selectors[] = {"0000:03:00.0", "0000:03:00.1"};
 
 doca_error_t xeno_flow_hash_pipe(int nb_queues)
 {
@@ -174,7 +145,7 @@ doca_error_t xeno_flow_hash_pipe(int nb_queues)
 	struct flow_resources resource = {0};
 	uint32_t nr_shared_resources[SHARED_RESOURCE_NUM_VALUES] = {0};
 	struct doca_flow_port *ports[2];
-	struct doca_dev *dev_arr[nb_ports];
+	struct doca_dev *dev_arr[2];
 	struct doca_flow_pipe *hash_pipe;
 	struct entries_status status;
 	doca_error_t result;
@@ -188,18 +159,10 @@ doca_error_t xeno_flow_hash_pipe(int nb_queues)
 
 	doca_try(init_doca_flow(nb_queues, "vnf,hws", &resource, nr_shared_resources), "Failed to init DOCA Flow", nb_ports, ports);
 
-	struct doca_dev *dev1 = open_doca_dev_by_pci("0000:03:00.0");
-	struct doca_dev *dev2 = open_doca_dev_by_pci("0000:03:00.1");
-
-	if (!dev1 || !dev2) {
-		DOCA_LOG_INFO("Device not found");
+	/* Both devices are opened at once, each on its own thread */
+	if (xenoflow_devices_open(device_selectors, 2, dev_arr) != DOCA_SUCCESS)
 		return DOCA_ERROR_NOT_FOUND;
-	}
-	else {
-		DOCA_LOG_INFO("Devices found!");
-	}
-	dev_arr[0] = dev1;
-	dev_arr[1] = dev2;
+	xenoflow_devices_release();
 
 	doca_try(init_doca_flow_ports(2, ports, true, dev_arr, action_mem, &resource), "Failed to init DOCA ports", nb_ports, ports);
 
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Packet loss across a hot upgrade: xeno_gen sends at a fixed rate through the load balancer while
+# a second xeno_flow takes the port over from the first. Fails if more than MAX_LOSS packets are lost.
+#
+# Run as root from this directory, e.g.
+#   FLOW_EAL="-a 0000:03:00.0,dv_flow_en=2" GEN_EAL="-l 0-2 -a 0000:18:00.0 -a 0000:18:00.1" \
+#   GEN_ARGS="--tx-port 0 --rx-port 1 --dst-mac c4:70:bd:a0:56:bc" ./run.sh
+# and with "./run.sh baseline" once without the upgrade for the loss of the setup itself.
+set -e
+
+BUILD=${BUILD:-../../build}
+CONFIG=${CONFIG:-../../services.json}
+RATE=${RATE:-1000000}		# packets per second
+DURATION=${DURATION:-20}	# seconds of traffic
+UPGRADE_AT=${UPGRADE_AT:-5}	# seconds into the traffic the new instance starts
+MAX_LOSS=${MAX_LOSS:-0}
+OUT=${OUT:-out}
+
+mkdir -p "$OUT"
+
+# Each instance is its own DPDK primary process, so they need separate file prefixes
+start_flow() {
+	"$BUILD/xeno_flow" $FLOW_EAL --file-prefix "xeno_$1" -- --config "$CONFIG" $2 > "$OUT/$1.log" 2>&1 &
+}
+
+wait_log() {
+	for i in $(seq 1 600); do
+		grep -q "$2" "$1" && return 0
+		sleep 0.1
+	done
+	echo "timed out waiting for '$2' in $1" >&2
+	return 1
+}
+
+start_flow old
+OLD=$!
+wait_log "$OUT/old.log" "Load Balancer initialized"
+
+"$BUILD/xeno_gen" $GEN_EAL -- $GEN_ARGS --rate "$RATE" --duration "$DURATION" > "$OUT/gen.log" 2>&1 &
+GEN=$!
+
+if [ "$1" = baseline ]; then
+	wait $GEN
+	CURRENT=$OLD
+else
+	sleep "$UPGRADE_AT"
+	START=$(date +%s.%N)
+	start_flow new "--takeover $OLD"
+	NEW=$!
+	wait $OLD || true
+	wait_log "$OUT/new.log" "takeover complete"
+	END=$(date +%s.%N)
+	echo "upgrade took $(echo "$END - $START" | bc) s, old instance exited"
+	wait $GEN
+	CURRENT=$NEW
+fi
+
+kill -INT "$CURRENT"
+wait "$CURRENT" || true
+
+LOSS=$(sed -n 's/^  Loss: \([0-9]*\) packets.*/\1/p' "$OUT/gen.log")
+grep "TX:\|RX:\|Loss:" "$OUT/gen.log"
+if [ -z "$LOSS" ]; then
+	echo "no summary in $OUT/gen.log" >&2
+	exit 1
+fi
+if [ "$LOSS" -gt "$MAX_LOSS" ]; then
+	echo "FAIL: $LOSS packets lost, at most $MAX_LOSS allowed"
+	exit 1
+fi
+echo "PASS: $LOSS packets lost"
@@ -10,6 +10,7 @@
 #include <doca_dev.h>
 
 #include "flow_common.h"
+#include "devices.h"
 
 
 DOCA_LOG_REGISTER(FLOW_SHARED_COUNTER);
@@ -194,47 +195,20 @@ static doca_error_t init_mac_change_entry(struct doca_flow_pipe *pipe,
 	return DOCA_SUCCESS;
 }
 
-struct doca_dev *open_doca_dev_by_pci(const char *pci_bdf)
-{
-    struct doca_devinfo **list;
-    uint32_t nb;
-    doca_error_t err;
-
-    err = doca_devinfo_create_list(&list, &nb);
-    if (err != DOCA_SUCCESS) {
-        printf("devinfo_create_list failed\n");
-        return NULL;
-    }
-
-    struct doca_dev *dev = NULL;
-
-    for (uint32_t i = 0; i < nb; i++) {
-        char pci[DOCA_DEVINFO_PCI_ADDR_SIZE] = {0};
-		uint8_t ipv4[4];
-
-        if (doca_devinfo_get_pci_addr_str(list[i], pci) != DOCA_SUCCESS)
-            continue;
-
-        if (strcmp(pci, pci_bdf) == 0) {
-			doca_devinfo_get_ipv4_addr(list[i], ipv4, DOCA_DEVINFO_IPV4_ADDR_SIZE);
-			char ipout[100]; 
-			DOCA_LOG_INFO("IPv4: %u.%u.%u.%u", ipv4[0], ipv4[1], ipv4[2], ipv4[3]);
-			err = doca_dev_open(list[i], &dev);
-            break;
-        }
-    }
-
-    doca_devinfo_destroy_list(list);
-    return dev;
-}
-
-doca_error_t xeno_flow_entry_latency(int nb_queues)
+/*
+ * Run the experiment
+ *
+ * @nb_queues [in]: number of queues of each port
+ * @device_selectors [in]: PCI address, interface name or MAC of the two devices, see devices.h
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+doca_error_t xeno_flow_entry_latency(int nb_queues, const char *const *device_selectors)
 {
 	int nb_ports = 1;
 	struct flow_resources resource = {1};
 	uint32_t nr_shared_resources[SHARED_RESOURCE_NUM_VALUES] = {0};
 	struct doca_flow_port *ports[2];
-	struct doca_dev *dev_arr[nb_ports];
+	struct doca_dev *dev_arr[2];
 	struct doca_flow_pipe *udp_pipe;
 	int port_id = 0;
 	uint32_t shared_counter_ids[] = {0, 1};
@@ -251,18 +225,10 @@ doca_error_t xeno_flow_entry_latency(int nb_queues)
 
 	doca_try(init_doca_flow(nb_queues, "vnf,hws", &resource, nr_shared_resources),
 			"Failed to init DOCA Flow", nb_ports, ports);
-	struct doca_dev *dev1 = open_doca_dev_by_pci("0000:0d:00.0");
-	struct doca_dev *dev2 = open_doca_dev_by_pci("0000:0d:00.1");
-
-	if (!dev1 || !dev2) {
-		DOCA_LOG_INFO("Device not found");
-		return;
-	}
-	else {
-		DOCA_LOG_INFO("Devices found!");
-	}
-	dev_arr[0] = dev1;
-	dev_arr[1] = dev2;
+	/* Both devices are opened at once, each on its own thread */
+	if (xenoflow_devices_open(device_selectors, 2, dev_arr) != DOCA_SUCCESS)
+		return DOCA_ERROR_NOT_FOUND;
+	xenoflow_devices_release();
 
 	if(result != DOCA_SUCCESS) {
 		DOCA_LOG_INFO("DOCA ports error");
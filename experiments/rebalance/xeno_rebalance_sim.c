@@ -0,0 +1,192 @@
+/*
+ * Rebalancer simulation: drives rebalance.c with synthetic per-bucket traffic
+ * and prints how far the busiest backend is above the mean after each round.
+ *
+ * Buckets are dealt round robin like xeno_flow deals them at startup, and the
+ * buckets of backend 0 see skew times the traffic of the others. Every round
+ * each bucket's rate wobbles by up to noise percent, so the planner also has to
+ * cope with loads that do not stay put.
+ */
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rebalance.h"
+
+struct sim_cfg {
+	uint32_t backends;
+	uint32_t buckets;
+	double skew;
+	uint32_t threshold;
+	uint32_t moves;
+	uint32_t rounds;
+	uint32_t noise;
+	uint64_t bytes;		/* mean bytes of a bucket per round */
+	unsigned int seed;
+};
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  --backends N     backends buckets move between (default 8)\n"
+	       "  --buckets N      hash entries of the service (default 256)\n"
+	       "  --skew X         traffic of backend 0's buckets over the others' (default 3)\n"
+	       "  --threshold PCT  balanced band around the mean, as --rebalance-threshold (default 5)\n"
+	       "  --moves N        most moves per round, as --rebalance-moves (default 16)\n"
+	       "  --rounds N       rounds to run (default 30)\n"
+	       "  --noise PCT      per-round wobble of each bucket's rate (default 10)\n"
+	       "  --seed N         random seed (default 1)\n",
+	       prog);
+}
+
+static int parse_args(int argc, char **argv, struct sim_cfg *cfg)
+{
+	static const struct option opts[] = {
+		{"backends", required_argument, NULL, 'b'},
+		{"buckets", required_argument, NULL, 'n'},
+		{"skew", required_argument, NULL, 'k'},
+		{"threshold", required_argument, NULL, 't'},
+		{"moves", required_argument, NULL, 'm'},
+		{"rounds", required_argument, NULL, 'r'},
+		{"noise", required_argument, NULL, 'z'},
+		{"seed", required_argument, NULL, 's'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+		switch (c) {
+		case 'b':
+			cfg->backends = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			cfg->buckets = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			cfg->skew = strtod(optarg, NULL);
+			break;
+		case 't':
+			cfg->threshold = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			cfg->moves = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			cfg->rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'z':
+			cfg->noise = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			cfg->seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+
+	if (cfg->backends < 2 || cfg->buckets < cfg->backends || cfg->skew <= 0 || cfg->moves == 0 ||
+	    cfg->noise >= 100) {
+		fprintf(stderr, "Need at least 2 backends, a bucket per backend, a positive skew, moves and noise below 100\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Busiest backend over the mean for the traffic of one round, from the true
+ * loads rather than the planner's view, which only sees the round before
+ */
+static double spread(const XenoFlowRebalancer *rb, const uint64_t *delta, uint32_t backends, uint64_t *load)
+{
+	uint64_t total = 0, max = 0;
+
+	for (uint32_t o = 0; o < backends; o++)
+		load[o] = 0;
+	for (uint32_t i = 0; i < rb->nb_buckets; i++)
+		load[rb->owner[i]] += delta[i];
+	for (uint32_t o = 0; o < backends; o++) {
+		total += load[o];
+		if (load[o] > max)
+			max = load[o];
+	}
+	return total > 0 ? (double)max * backends / total : 1.0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_cfg cfg = {
+		.backends = 8,
+		.buckets = 256,
+		.skew = 3.0,
+		.threshold = 5,
+		.moves = 16,
+		.rounds = 30,
+		.noise = 10,
+		.bytes = 1 << 20,
+		.seed = 1,
+	};
+	XenoFlowRebalancer rb;
+	XenoFlowBucketMove *moves;
+	uint64_t *rate, *bytes, *delta, *load;
+	double last = 1.0;
+	int ret = 1;
+
+	if (parse_args(argc, argv, &cfg) != 0)
+		return 1;
+	srand(cfg.seed);
+
+	rate = calloc(cfg.buckets, sizeof(uint64_t));
+	bytes = calloc(cfg.buckets, sizeof(uint64_t));
+	delta = calloc(cfg.buckets, sizeof(uint64_t));
+	load = calloc(cfg.backends, sizeof(uint64_t));
+	moves = calloc(cfg.moves, sizeof(XenoFlowBucketMove));
+	if (rate == NULL || bytes == NULL || delta == NULL || load == NULL || moves == NULL ||
+	    xenoflow_rebalance_init(&rb, cfg.buckets) != 0) {
+		fprintf(stderr, "Out of memory\n");
+		goto out;
+	}
+
+	for (uint32_t i = 0; i < cfg.buckets; i++) {
+		rb.owner[i] = i % cfg.backends;
+		/* The first bucket of each backend is its home entry, which never moves */
+		rb.fixed[i] = i < cfg.backends;
+		rate[i] = rb.owner[i] == 0 ? (uint64_t)(cfg.bytes * cfg.skew) : cfg.bytes;
+	}
+
+	/* The first round only primes the counters */
+	xenoflow_rebalance_plan(&rb, bytes, cfg.backends, cfg.threshold, cfg.moves, moves);
+
+	printf("round,moves,spread_pct\n");
+	for (uint32_t r = 1; r <= cfg.rounds; r++) {
+		uint32_t nb;
+
+		for (uint32_t i = 0; i < cfg.buckets; i++) {
+			int64_t wobble = (int64_t)(rate[i] * cfg.noise / 100);
+
+			delta[i] = rate[i] + (wobble > 0 ? rand() % (2 * wobble + 1) - wobble : 0);
+			bytes[i] += delta[i];
+		}
+		last = spread(&rb, delta, cfg.backends, load);
+		nb = xenoflow_rebalance_plan(&rb, bytes, cfg.backends, cfg.threshold, cfg.moves, moves);
+		printf("%u,%u,%.1f\n", r, nb, last * 100);
+	}
+
+	printf("# %lu moves in %u rounds, busiest backend at %.1f%% of the mean in the last round\n", rb.nb_moves,
+	       cfg.rounds, last * 100);
+	ret = 0;
+out:
+	xenoflow_rebalance_destroy(&rb);
+	free(rate);
+	free(bytes);
+	free(delta);
+	free(load);
+	free(moves);
+	return ret;
+}
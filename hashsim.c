@@ -0,0 +1,241 @@
+#include <string.h>
+
+/*
+ * The SIMD variants carry their own target attribute instead of needing
+ * -mavx2 or -march for the whole build, and xenoflow_hasher_init() picks
+ * them only on CPUs that have the instructions
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+
+#include "hashsim.h"
+
+/* Key of DPDK's mlx5 driver when none is configured */
+static const uint8_t default_key[XENOFLOW_HASH_KEY_LEN] = {
+	0x2c, 0xc6, 0x81, 0xd1, 0x5b, 0xdb, 0xf4, 0xf7, 0xfc, 0xa2, 0x83, 0x19, 0xdb, 0x1a,
+	0x3e, 0x94, 0x6b, 0x9e, 0x38, 0xd9, 0x2c, 0x9c, 0x03, 0xd1, 0xad, 0x99, 0x44, 0xa7,
+	0xd9, 0x56, 0x3d, 0x59, 0x06, 0x3c, 0x25, 0xf3, 0xfc, 0x1f, 0xdc, 0x2a,
+};
+
+static const char *const algo_names[XENOFLOW_HASH_MAX] = {
+	[XENOFLOW_HASH_CRC32] = "crc32",
+	[XENOFLOW_HASH_CRC32C] = "crc32c",
+	[XENOFLOW_HASH_TOEPLITZ] = "toeplitz",
+	[XENOFLOW_HASH_FMIX32] = "fmix32",
+};
+
+/*
+ * Reflected CRC of four bytes starting from ~0: once the address is XORed in,
+ * byte i is folded through 3 - i more bytes of zeros, and the ~0 of the
+ * initial value is taken into the index so each table only sees the address
+ */
+static void init_crc(XenoFlowHasher *hasher, uint32_t poly)
+{
+	uint32_t byte_table[4][256];
+
+	for (uint32_t v = 0; v < 256; v++) {
+		uint32_t crc = v;
+
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (crc & 1 ? poly : 0);
+		byte_table[0][v] = crc;
+	}
+	for (int k = 1; k < 4; k++) {
+		for (uint32_t v = 0; v < 256; v++)
+			byte_table[k][v] = (byte_table[k - 1][v] >> 8) ^ byte_table[0][byte_table[k - 1][v] & 0xff];
+	}
+	for (int i = 0; i < 4; i++) {
+		for (uint32_t v = 0; v < 256; v++)
+			hasher->tables[i][v] = byte_table[3 - i][v ^ 0xff];
+	}
+	hasher->xor_out = 0xffffffff;
+}
+
+/* Bit i of the input, counted from the most significant bit of the first byte, XORs in key bits i..i+31 */
+static void init_toeplitz(XenoFlowHasher *hasher)
+{
+	const uint8_t *key = hasher->key;
+
+	for (int i = 0; i < 4; i++) {
+		for (uint32_t v = 0; v < 256; v++) {
+			uint32_t hash = 0;
+
+			for (int bit = 0; bit < 8; bit++) {
+				int shift = 8 - bit;
+				uint64_t window = ((uint64_t)key[i] << 32) | ((uint64_t)key[i + 1] << 24) |
+						  ((uint64_t)key[i + 2] << 16) | ((uint64_t)key[i + 3] << 8) | key[i + 4];
+
+				if (v & (0x80 >> bit))
+					hash ^= (uint32_t)(window >> shift);
+			}
+			hasher->tables[i][v] = hash;
+		}
+	}
+	hasher->xor_out = 0;
+}
+
+/* What this CPU can do for the hash function, the tables are the fallback */
+static void pick_insns(XenoFlowHasher *hasher)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	/* SSE4.2 only has the Castagnoli CRC */
+	hasher->crc_insn = hasher->algo == XENOFLOW_HASH_CRC32C && __builtin_cpu_supports("sse4.2");
+	hasher->gather = (hasher->algo == XENOFLOW_HASH_CRC32 || hasher->algo == XENOFLOW_HASH_TOEPLITZ) &&
+			 __builtin_cpu_supports("avx2");
+#elif defined(__aarch64__)
+	hasher->crc_insn = (hasher->algo == XENOFLOW_HASH_CRC32 || hasher->algo == XENOFLOW_HASH_CRC32C) &&
+			   (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#endif
+}
+
+void xenoflow_hasher_init(XenoFlowHasher *hasher, enum XenoFlowHashAlgo algo, const uint8_t *key)
+{
+	memset(hasher, 0, sizeof(*hasher));
+	hasher->algo = algo;
+	memcpy(hasher->key, key != NULL ? key : default_key, XENOFLOW_HASH_KEY_LEN);
+	if (algo == XENOFLOW_HASH_CRC32)
+		init_crc(hasher, 0xedb88320);
+	else if (algo == XENOFLOW_HASH_CRC32C)
+		init_crc(hasher, 0x82f63b78);
+	else if (algo == XENOFLOW_HASH_TOEPLITZ)
+		init_toeplitz(hasher);
+	pick_insns(hasher);
+}
+
+static inline uint32_t fmix32(uint32_t addr)
+{
+	addr ^= addr >> 16;
+	addr *= 0x85ebca6b;
+	addr ^= addr >> 13;
+	addr *= 0xc2b2ae35;
+	addr ^= addr >> 16;
+	return addr;
+}
+
+/* Byte i of an address in network order is byte i in memory, the low one first on the little-endian hosts we run on */
+static inline uint32_t table_hash(const XenoFlowHasher *hasher, uint32_t addr)
+{
+	return hasher->tables[0][addr & 0xff] ^ hasher->tables[1][(addr >> 8) & 0xff] ^
+	       hasher->tables[2][(addr >> 16) & 0xff] ^ hasher->tables[3][addr >> 24] ^ hasher->xor_out;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2"))) static uint32_t crc_insn(const XenoFlowHasher *hasher, uint32_t addr)
+{
+	(void)hasher;
+	return ~_mm_crc32_u32(0xffffffff, addr);
+}
+
+/* Eight addresses at a time, one gather per table; returns how many it hashed */
+__attribute__((target("avx2"))) static size_t table_hash_avx2(const XenoFlowHasher *hasher, const uint32_t *addrs,
+							      uint32_t *hashes, size_t n)
+{
+	const __m256i mask = _mm256_set1_epi32(0xff);
+	const __m256i xor_out = _mm256_set1_epi32((int)hasher->xor_out);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(addrs + i));
+		__m256i h = _mm256_i32gather_epi32((const int *)hasher->tables[0], _mm256_and_si256(a, mask), 4);
+
+		h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int *)hasher->tables[1],
+				     _mm256_and_si256(_mm256_srli_epi32(a, 8), mask), 4));
+		h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int *)hasher->tables[2],
+				     _mm256_and_si256(_mm256_srli_epi32(a, 16), mask), 4));
+		h = _mm256_xor_si256(h, _mm256_i32gather_epi32((const int *)hasher->tables[3],
+				     _mm256_srli_epi32(a, 24), 4));
+		_mm256_storeu_si256((__m256i *)(hashes + i), _mm256_xor_si256(h, xor_out));
+	}
+	return i;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc"))) static uint32_t crc_insn(const XenoFlowHasher *hasher, uint32_t addr)
+{
+	return hasher->algo == XENOFLOW_HASH_CRC32C ? ~__crc32cw(0xffffffff, addr) : ~__crc32w(0xffffffff, addr);
+}
+#endif
+
+uint32_t xenoflow_hash_one(const XenoFlowHasher *hasher, uint32_t addr)
+{
+	if (hasher->algo == XENOFLOW_HASH_FMIX32)
+		return fmix32(addr);
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+	if (hasher->crc_insn)
+		return crc_insn(hasher, addr);
+#endif
+	return table_hash(hasher, addr);
+}
+
+void xenoflow_hash_batch(const XenoFlowHasher *hasher, const uint32_t *addrs, uint32_t *hashes, size_t n)
+{
+	size_t i = 0;
+
+	if (hasher->algo == XENOFLOW_HASH_FMIX32) {
+		/* Plain arithmetic, the compiler vectorizes it */
+		for (; i < n; i++)
+			hashes[i] = fmix32(addrs[i]);
+		return;
+	}
+#if defined(__x86_64__) || defined(__i386__)
+	if (hasher->gather)
+		i = table_hash_avx2(hasher, addrs, hashes, n);
+#endif
+	for (; i < n; i++)
+		hashes[i] = xenoflow_hash_one(hasher, addrs[i]);
+}
+
+const char *xenoflow_hash_name(enum XenoFlowHashAlgo algo)
+{
+	return algo < XENOFLOW_HASH_MAX ? algo_names[algo] : "unknown";
+}
+
+int xenoflow_hash_parse(const char *name, enum XenoFlowHashAlgo *algo)
+{
+	for (int i = 0; i < XENOFLOW_HASH_MAX; i++) {
+		if (strcmp(name, algo_names[i]) == 0) {
+			*algo = (enum XenoFlowHashAlgo)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+uint32_t xenoflow_hashsim_entries(uint32_t nb_backends, uint32_t buckets)
+{
+	uint32_t value = nb_backends > buckets ? nb_backends : buckets;
+
+	if (value <= 1)
+		return 1;
+	value--;
+	value |= value >> 1;
+	value |= value >> 2;
+	value |= value >> 4;
+	value |= value >> 8;
+	value |= value >> 16;
+	return value + 1;
+}
+
+void xenoflow_hashsim_layout(const int *host, uint32_t nb_backends, uint32_t buckets, int32_t *owners,
+			     uint32_t nb_entries)
+{
+	uint32_t next = 0;
+
+	for (uint32_t i = 0; i < nb_entries; i++)
+		owners[i] = i < nb_backends ? (int32_t)i : -1;
+	if (buckets == 0)
+		return;
+	for (uint32_t i = nb_backends; i < nb_entries; i++) {
+		for (uint32_t tries = 0; tries < nb_backends && owners[i] < 0; tries++, next++) {
+			if (!host[next % nb_backends])
+				owners[i] = (int32_t)(next % nb_backends);
+		}
+	}
+}
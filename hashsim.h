@@ -0,0 +1,114 @@
+#ifndef HASHSIM_H
+#define HASHSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Software model of a service's hash pipe: which hash entry an IPv4 source
+ * address lands on, and which backend owns that entry right after startup.
+ * The NIC hashes the matched source address and takes the low bits as the
+ * entry, so the entry of a source is hash & (entries - 1).
+ *
+ * The NIC's hash is not documented per device, hence several candidates;
+ * GET /api/lookup shows the entry the hardware picks next to each of them.
+ * Addresses are handled as they are on the wire, network order in a uint32_t.
+ */
+
+/* Length of a Toeplitz key, as for RSS */
+#define XENOFLOW_HASH_KEY_LEN 40
+
+/**
+ * @brief Hash functions the model can use
+ */
+enum XenoFlowHashAlgo {
+	XENOFLOW_HASH_CRC32,		/* IEEE 802.3 CRC, as zlib */
+	XENOFLOW_HASH_CRC32C,		/* Castagnoli CRC, as SSE4.2 and ARMv8 compute it */
+	XENOFLOW_HASH_TOEPLITZ,		/* RSS hash with XenoFlowHasher.key */
+	XENOFLOW_HASH_FMIX32,		/* murmur3 finalizer, the XDP data path's hash */
+	XENOFLOW_HASH_MAX,
+};
+
+/**
+ * @brief A hash function ready to use
+ *
+ * CRC and Toeplitz are linear over the four address bytes, so each is four
+ * 256-entry tables XORed together: one lookup per byte instead of one step
+ * per bit. Where the CPU has them, found at run time so one build runs on
+ * any host, AVX2 does eight addresses per gather and the CRC instructions
+ * of SSE4.2 or ARMv8 replace the tables.
+ */
+typedef struct {
+	enum XenoFlowHashAlgo algo;
+	uint32_t tables[4][256];	/* contribution of byte i of the address */
+	uint32_t xor_out;
+	uint8_t key[XENOFLOW_HASH_KEY_LEN]; /* Toeplitz key */
+	uint8_t crc_insn;		/* the CPU computes algo with one instruction */
+	uint8_t gather;			/* the CPU has AVX2 to look up eight addresses at once */
+} XenoFlowHasher;
+
+/**
+ * @brief Prepare a hash function
+ * @param hasher Hash function to fill
+ * @param algo Hash function to use
+ * @param key Toeplitz key, NULL for the mlx5 default, ignored by the others
+ */
+void xenoflow_hasher_init(XenoFlowHasher *hasher, enum XenoFlowHashAlgo algo, const uint8_t *key);
+
+/**
+ * @brief Hash addresses
+ * @param hasher Hash function
+ * @param addrs IPv4 source addresses, network order
+ * @param hashes Hash of each address
+ * @param n Number of addresses
+ */
+void xenoflow_hash_batch(const XenoFlowHasher *hasher, const uint32_t *addrs, uint32_t *hashes, size_t n);
+
+/**
+ * @brief Hash one address
+ * @param hasher Hash function
+ * @param addr IPv4 source address, network order
+ * @return Its hash
+ */
+uint32_t xenoflow_hash_one(const XenoFlowHasher *hasher, uint32_t addr);
+
+/**
+ * @brief Name of a hash function, as --hash takes it
+ * @param algo Hash function
+ * @return Its name
+ */
+const char *xenoflow_hash_name(enum XenoFlowHashAlgo algo);
+
+/**
+ * @brief Hash function by name
+ * @param name crc32, crc32c, toeplitz or fmix32
+ * @param algo Hash function found
+ * @return 0 on success, -1 for an unknown name
+ */
+int xenoflow_hash_parse(const char *name, enum XenoFlowHashAlgo *algo);
+
+/**
+ * @brief Hash entries of a service, as xeno_flow sizes its hash pipe
+ * @param nb_backends Backends in the service's config
+ * @param buckets Entries the service asks for, 0 for one per backend
+ * @return Entries, a power of two
+ */
+uint32_t xenoflow_hashsim_entries(uint32_t nb_backends, uint32_t buckets);
+
+/**
+ * @brief Owner of every hash entry at startup
+ *
+ * Backend i takes entry i; with buckets the rest are dealt round robin to the
+ * backends that are not the host, as queue_spread_buckets() does. Without,
+ * they stay empty and their packets are dropped.
+ *
+ * @param host Whether backend i forwards to the host
+ * @param nb_backends Backends in the service's config
+ * @param buckets Entries the service asks for, 0 for one per backend
+ * @param owners Backend index of each entry, -1 for none
+ * @param nb_entries Size of owners, xenoflow_hashsim_entries()
+ */
+void xenoflow_hashsim_layout(const int *host, uint32_t nb_backends, uint32_t buckets, int32_t *owners,
+			     uint32_t nb_entries);
+
+#endif /* HASHSIM_H */
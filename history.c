@@ -0,0 +1,543 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <doca_log.h>
+
+#include "history.h"
+
+DOCA_LOG_REGISTER(HISTORY);
+
+/* Missing points a block is padded over with zeros, a longer gap starts a new block */
+#define MAX_GAP_POINTS 60
+
+/* Most values a query returns over all series, its step is coarsened to stay below */
+#define MAX_RESULT_VALUES (1u << 20)
+
+/* Share of the blocks of each tier, in percent */
+static const uint32_t tier_shares[XENOFLOW_HISTORY_TIERS] = {50, 35, 15};
+static const uint32_t tier_steps[XENOFLOW_HISTORY_TIERS] = {1, 60, 3600};
+
+static size_t names_offset(void)
+{
+	return XENOFLOW_HISTORY_BLOCK_SIZE;
+}
+
+static size_t blocks_offset(void)
+{
+	return names_offset() + (size_t)XENOFLOW_HISTORY_MAX_SERIES * XENOFLOW_HISTORY_NAME_SIZE;
+}
+
+static XenoFlowHistoryBlock *block_at(const XenoFlowHistory *history, uint32_t idx)
+{
+	return (XenoFlowHistoryBlock *)((uint8_t *)history->map + blocks_offset() +
+					(size_t)idx * XENOFLOW_HISTORY_BLOCK_SIZE);
+}
+
+static uint8_t *column_at(XenoFlowHistoryBlock *block, int column)
+{
+	return (uint8_t *)(block + 1) + column * XENOFLOW_HISTORY_COLUMN_SIZE;
+}
+
+static uint64_t zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static size_t varint_len(uint64_t v)
+{
+	size_t len = 1;
+
+	while (v >= 0x80) {
+		v >>= 7;
+		len++;
+	}
+	return len;
+}
+
+static size_t put_varint(uint8_t *p, uint64_t v)
+{
+	size_t len = 0;
+
+	while (v >= 0x80) {
+		p[len++] = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+	p[len++] = (uint8_t)v;
+	return len;
+}
+
+static int get_varint(const uint8_t *p, size_t end, size_t *pos, uint64_t *v)
+{
+	uint64_t value = 0;
+
+	for (int shift = 0; shift < 64 && *pos < end; shift += 7) {
+		uint8_t byte = p[(*pos)++];
+
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			*v = value;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* A new file: tiers laid out, every block free, no series */
+static void format_file(XenoFlowHistory *history)
+{
+	XenoFlowHistoryHeader *header = history->header;
+	uint32_t nb_blocks = (history->size - blocks_offset()) / XENOFLOW_HISTORY_BLOCK_SIZE, first = 0;
+
+	memset(history->map, 0, blocks_offset());
+	header->magic = XENOFLOW_HISTORY_MAGIC;
+	header->format = XENOFLOW_HISTORY_FORMAT;
+	header->block_size = XENOFLOW_HISTORY_BLOCK_SIZE;
+	header->file_size = history->size;
+	for (int t = 0; t < XENOFLOW_HISTORY_TIERS; t++) {
+		XenoFlowHistoryTier *tier = &header->tiers[t];
+
+		tier->step = tier_steps[t];
+		tier->first_block = first;
+		tier->nb_blocks = t == XENOFLOW_HISTORY_TIERS - 1 ? nb_blocks - first : nb_blocks * tier_shares[t] / 100;
+		first += tier->nb_blocks;
+	}
+	for (uint32_t i = 0; i < nb_blocks; i++) {
+		XenoFlowHistoryBlock *block = block_at(history, i);
+
+		memset(block, 0, sizeof(*block));
+		block->series = XENOFLOW_HISTORY_FREE;
+	}
+}
+
+static int file_matches(const XenoFlowHistory *history)
+{
+	const XenoFlowHistoryHeader *header = history->header;
+
+	return header->magic == XENOFLOW_HISTORY_MAGIC && header->format == XENOFLOW_HISTORY_FORMAT &&
+	       header->block_size == XENOFLOW_HISTORY_BLOCK_SIZE && header->file_size == history->size &&
+	       header->nb_series <= XENOFLOW_HISTORY_MAX_SERIES;
+}
+
+doca_error_t xenoflow_history_open(XenoFlowHistory *history, const char *path, uint32_t size_mb)
+{
+	struct stat st;
+	int fd, fresh;
+
+	memset(history, 0, sizeof(*history));
+	pthread_mutex_init(&history->lock, NULL);
+	history->size = (size_t)size_mb << 20;
+	if (history->size < blocks_offset() + XENOFLOW_HISTORY_TIERS * 4 * XENOFLOW_HISTORY_BLOCK_SIZE) {
+		DOCA_LOG_ERR("History of %u MB is too small", size_mb);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		DOCA_LOG_ERR("Failed to open history %s: %s", path, strerror(errno));
+		return DOCA_ERROR_IO_FAILED;
+	}
+	if (fstat(fd, &st) != 0 || ((size_t)st.st_size != history->size && ftruncate(fd, (off_t)history->size) != 0)) {
+		DOCA_LOG_ERR("Failed to size history %s: %s", path, strerror(errno));
+		close(fd);
+		return DOCA_ERROR_IO_FAILED;
+	}
+	history->map = mmap(NULL, history->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (history->map == MAP_FAILED) {
+		history->map = NULL;
+		DOCA_LOG_ERR("Failed to map history %s: %s", path, strerror(errno));
+		return DOCA_ERROR_IO_FAILED;
+	}
+	history->header = (XenoFlowHistoryHeader *)history->map;
+	history->names = (char (*)[XENOFLOW_HISTORY_NAME_SIZE])((uint8_t *)history->map + names_offset());
+
+	history->series = calloc(XENOFLOW_HISTORY_MAX_SERIES, sizeof(*history->series));
+	if (history->series == NULL) {
+		xenoflow_history_close(history);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	for (uint32_t s = 0; s < XENOFLOW_HISTORY_MAX_SERIES; s++) {
+		for (int t = 0; t < XENOFLOW_HISTORY_TIERS; t++)
+			history->series[s].open[t] = XENOFLOW_HISTORY_FREE;
+	}
+
+	/* Points of a matching file are kept, appends go on in new blocks */
+	fresh = !file_matches(history);
+	if (fresh)
+		format_file(history);
+	DOCA_LOG_INFO("History %s: %zu MB, %s, %u series", path, history->size >> 20,
+		      fresh ? "new" : "continued", history->header->nb_series);
+	return DOCA_SUCCESS;
+}
+
+static uint32_t find_series(XenoFlowHistory *history, const char *name, int create)
+{
+	XenoFlowHistoryHeader *header = history->header;
+
+	for (uint32_t s = 0; s < header->nb_series; s++) {
+		if (strcmp(history->names[s], name) == 0)
+			return s;
+	}
+	if (!create || header->nb_series == XENOFLOW_HISTORY_MAX_SERIES)
+		return XENOFLOW_HISTORY_FREE;
+	snprintf(history->names[header->nb_series], XENOFLOW_HISTORY_NAME_SIZE, "%s", name);
+	return header->nb_series++;
+}
+
+static XenoFlowHistoryBlock *alloc_block(XenoFlowHistory *history, int t, uint32_t series, uint64_t start)
+{
+	XenoFlowHistoryTier *tier = &history->header->tiers[t];
+	uint32_t idx = tier->first_block + tier->next_block;
+	XenoFlowHistoryBlock *block = block_at(history, idx);
+
+	/* The oldest block may still be some series' open one */
+	if (block->series < history->header->nb_series && history->series[block->series].open[t] == idx)
+		history->series[block->series].open[t] = XENOFLOW_HISTORY_FREE;
+
+	tier->next_block = (tier->next_block + 1) % tier->nb_blocks;
+	block->series = XENOFLOW_HISTORY_FREE;
+	block->count = 0;
+	block->used[0] = 0;
+	block->used[1] = 0;
+	block->start = start;
+	block->series = series;
+	history->series[series].open[t] = idx;
+	history->series[series].prev[t][0] = 0;
+	history->series[series].prev[t][1] = 0;
+	return block;
+}
+
+/* Append one point to a block, 0 if it does not fit */
+static int block_append(XenoFlowHistoryBlock *block, int64_t *prev, uint64_t pkts, uint64_t bytes)
+{
+	uint64_t values[2] = {zigzag((int64_t)pkts - prev[0]), zigzag((int64_t)bytes - prev[1])};
+
+	for (int c = 0; c < 2; c++) {
+		if (block->used[c] + varint_len(values[c]) > XENOFLOW_HISTORY_COLUMN_SIZE)
+			return 0;
+	}
+	/* Columns first, the count last, so a reader never decodes a half-written point */
+	for (int c = 0; c < 2; c++)
+		block->used[c] += put_varint(column_at(block, c) + block->used[c], values[c]);
+	prev[0] = (int64_t)pkts;
+	prev[1] = (int64_t)bytes;
+	block->count++;
+	return 1;
+}
+
+static void write_point(XenoFlowHistory *history, uint32_t s, int t, uint64_t start, uint64_t pkts, uint64_t bytes)
+{
+	XenoFlowHistorySeries *series = &history->series[s];
+	uint32_t step = history->header->tiers[t].step;
+	XenoFlowHistoryBlock *block = NULL;
+
+	if (series->open[t] != XENOFLOW_HISTORY_FREE) {
+		block = block_at(history, series->open[t]);
+		if (block->series != s)
+			block = NULL;
+	}
+	if (block != NULL) {
+		uint64_t next = block->start + (uint64_t)block->count * step;
+
+		/* The clock went back, the point would land in the past */
+		if (start < next)
+			return;
+		if ((start - next) / step > MAX_GAP_POINTS)
+			block = NULL;
+		for (; block != NULL && next < start; next += step) {
+			if (!block_append(block, series->prev[t], 0, 0))
+				block = NULL;
+		}
+	}
+	if (block == NULL || !block_append(block, series->prev[t], pkts, bytes)) {
+		block = alloc_block(history, t, s, start);
+		block_append(block, series->prev[t], pkts, bytes);
+	}
+	history->nb_points++;
+}
+
+/* Traffic into the pending point of a tier, which is written and rolled up once a later interval begins */
+static void add_traffic(XenoFlowHistory *history, uint32_t s, int t, uint64_t now, uint64_t pkts, uint64_t bytes)
+{
+	XenoFlowHistoryPoint *pending = &history->series[s].pending[t];
+	uint32_t step = history->header->tiers[t].step;
+	uint64_t start = now - now % step;
+
+	if (pending->start != 0 && pending->start != start) {
+		write_point(history, s, t, pending->start, pending->pkts, pending->bytes);
+		if (t + 1 < XENOFLOW_HISTORY_TIERS)
+			add_traffic(history, s, t + 1, pending->start, pending->pkts, pending->bytes);
+		pending->pkts = 0;
+		pending->bytes = 0;
+	}
+	pending->start = start;
+	pending->pkts += pkts;
+	pending->bytes += bytes;
+}
+
+/* Series of every sample, looked up by name only when the backends changed since the last append */
+static int map_samples(XenoFlowHistory *history, const XenoFlowHistorySample *samples, uint32_t nb_samples)
+{
+	char name[XENOFLOW_HISTORY_NAME_SIZE];
+	int same = nb_samples == history->nb_keys;
+
+	for (uint32_t i = 0; same && i < nb_samples; i++)
+		same = samples[i].key == history->keys[i];
+	if (same)
+		return 0;
+
+	if (nb_samples > history->nb_keys) {
+		const void **keys = realloc(history->keys, nb_samples * sizeof(*keys));
+		uint32_t *key_series;
+
+		if (keys == NULL)
+			return -1;
+		history->keys = keys;
+		key_series = realloc(history->key_series, nb_samples * sizeof(*key_series));
+		if (key_series == NULL)
+			return -1;
+		history->key_series = key_series;
+	}
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		snprintf(name, sizeof(name), "%s/%s", samples[i].service, samples[i].name);
+		history->keys[i] = samples[i].key;
+		history->key_series[i] = find_series(history, name, 1);
+		if (history->key_series[i] == XENOFLOW_HISTORY_FREE)
+			DOCA_LOG_WARN("History keeps at most %d series, %s is left out", XENOFLOW_HISTORY_MAX_SERIES,
+				      name);
+	}
+	history->nb_keys = nb_samples;
+	return 0;
+}
+
+void xenoflow_history_append(XenoFlowHistory *history, uint64_t now, const XenoFlowHistorySample *samples,
+			     uint32_t nb_samples)
+{
+	if (history->map == NULL)
+		return;
+
+	pthread_mutex_lock(&history->lock);
+	if (map_samples(history, samples, nb_samples) != 0) {
+		history->nb_keys = 0;
+		pthread_mutex_unlock(&history->lock);
+		return;
+	}
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		uint32_t s = history->key_series[i];
+		XenoFlowHistorySeries *series;
+
+		if (s == XENOFLOW_HISTORY_FREE)
+			continue;
+		series = &history->series[s];
+		/* The first sample and a counter going back only set where the next interval starts from */
+		if (series->primed && samples[i].pkts >= series->last_pkts && samples[i].bytes >= series->last_bytes)
+			add_traffic(history, s, 0, now, samples[i].pkts - series->last_pkts,
+				    samples[i].bytes - series->last_bytes);
+		series->last_pkts = samples[i].pkts;
+		series->last_bytes = samples[i].bytes;
+		series->primed = 1;
+	}
+	pthread_mutex_unlock(&history->lock);
+}
+
+static uint64_t tier_oldest(const XenoFlowHistory *history, int t)
+{
+	const XenoFlowHistoryTier *tier = &history->header->tiers[t];
+	uint64_t oldest = UINT64_MAX;
+
+	for (uint32_t i = 0; i < tier->nb_blocks; i++) {
+		const XenoFlowHistoryBlock *block = block_at(history, tier->first_block + i);
+
+		if (block->series != XENOFLOW_HISTORY_FREE && block->count > 0 && block->start < oldest)
+			oldest = block->start;
+	}
+	return oldest;
+}
+
+static int alloc_result(XenoFlowHistoryResult *result)
+{
+	result->covered = calloc(result->nb_buckets, 1);
+	result->series = calloc(result->nb_series, sizeof(*result->series));
+	if (result->covered == NULL || result->series == NULL)
+		return -1;
+	for (uint32_t i = 0; i < result->nb_series; i++) {
+		result->series[i].pps = calloc(result->nb_buckets, sizeof(double));
+		result->series[i].bps = calloc(result->nb_buckets, sizeof(double));
+		if (result->series[i].pps == NULL || result->series[i].bps == NULL)
+			return -1;
+	}
+	return 0;
+}
+
+/* Add the points of one block inside [from, to] and before cutoff to the buckets */
+static void decode_block(XenoFlowHistoryBlock *block, uint32_t step, uint64_t to, uint64_t cutoff,
+			 XenoFlowHistoryResult *result, XenoFlowHistorySeriesResult *series)
+{
+	const uint8_t *columns[2] = {column_at(block, 0), column_at(block, 1)};
+	size_t pos[2] = {0, 0};
+	int64_t values[2] = {0, 0};
+	uint64_t t = block->start;
+
+	for (uint32_t i = 0; i < block->count; i++, t += step) {
+		for (int c = 0; c < 2; c++) {
+			uint64_t v;
+
+			/* Damaged block, the rest of it is skipped */
+			if (!get_varint(columns[c], block->used[c], &pos[c], &v))
+				return;
+			values[c] += unzigzag(v);
+		}
+		if (t > to || t + step > cutoff)
+			return;
+		if (t < result->from)
+			continue;
+
+		uint32_t bucket = (t - result->from) / result->step;
+
+		result->covered[bucket] = 1;
+		result->series[0].pps[bucket] += values[0];
+		result->series[0].bps[bucket] += values[1];
+		if (series != NULL) {
+			series->pps[bucket] += values[0];
+			series->bps[bucket] += values[1];
+		}
+	}
+}
+
+doca_error_t xenoflow_history_query(XenoFlowHistory *history, uint64_t from, uint64_t to, uint32_t step,
+				    const char *series, int totals_only, XenoFlowHistoryResult *result)
+{
+	uint64_t oldest[XENOFLOW_HISTORY_TIERS], cutoff = UINT64_MAX, span;
+	uint32_t only = XENOFLOW_HISTORY_FREE, max_buckets;
+
+	memset(result, 0, sizeof(*result));
+	if (history->map == NULL)
+		return DOCA_ERROR_NOT_SUPPORTED;
+	if (to < from)
+		return DOCA_ERROR_INVALID_VALUE;
+
+	pthread_mutex_lock(&history->lock);
+	if (series != NULL) {
+		only = find_series(history, series, 0);
+		if (only == XENOFLOW_HISTORY_FREE) {
+			pthread_mutex_unlock(&history->lock);
+			return DOCA_ERROR_NOT_FOUND;
+		}
+	}
+
+	/* The total first, then one series or all of them */
+	result->nb_series = 1 + (totals_only ? 0 : series != NULL ? 1 : history->header->nb_series);
+	max_buckets = MAX_RESULT_VALUES / result->nb_series;
+	if (max_buckets > XENOFLOW_HISTORY_MAX_BUCKETS)
+		max_buckets = XENOFLOW_HISTORY_MAX_BUCKETS;
+	if (max_buckets == 0)
+		max_buckets = 1;
+	span = to - from + 1;
+	if (step == 0)
+		step = span / 720 > 0 ? span / 720 : 1;
+	if (span / step >= max_buckets)
+		step = (span + max_buckets - 1) / max_buckets;
+	/* Buckets on multiples of the step, so the same range always splits the same way */
+	result->step = step;
+	result->from = from - from % step;
+	result->nb_buckets = (to - result->from) / step + 1;
+	if (alloc_result(result) != 0) {
+		pthread_mutex_unlock(&history->lock);
+		xenoflow_history_result_free(result);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	snprintf(result->series[0].name, XENOFLOW_HISTORY_NAME_SIZE, "total");
+	for (uint32_t i = 1; i < result->nb_series; i++)
+		snprintf(result->series[i].name, XENOFLOW_HISTORY_NAME_SIZE, "%s",
+			 history->names[only != XENOFLOW_HISTORY_FREE ? only : i - 1]);
+
+	/*
+	 * Finest tier first. A coarser tier only fills in before the oldest point
+	 * of the finer ones, so no traffic is counted twice.
+	 */
+	for (int t = 0; t < XENOFLOW_HISTORY_TIERS; t++) {
+		XenoFlowHistoryTier *tier = &history->header->tiers[t];
+
+		if (tier->step > step)
+			break;
+		oldest[t] = tier_oldest(history, t);
+		if (oldest[t] == UINT64_MAX)
+			continue;
+		for (uint32_t i = 0; i < tier->nb_blocks; i++) {
+			XenoFlowHistoryBlock *block = block_at(history, tier->first_block + i);
+			XenoFlowHistorySeriesResult *out = NULL;
+
+			if (block->series >= history->header->nb_series || block->count == 0)
+				continue;
+			if (only != XENOFLOW_HISTORY_FREE && block->series != only)
+				continue;
+			if (block->start > to || block->start + (uint64_t)block->count * tier->step <= result->from ||
+			    block->start >= cutoff)
+				continue;
+			if (!totals_only)
+				out = &result->series[only != XENOFLOW_HISTORY_FREE ? 1 : 1 + block->series];
+			decode_block(block, tier->step, to, cutoff, result, out);
+			if (result->resolution == 0)
+				result->resolution = tier->step;
+		}
+		if (oldest[t] < cutoff)
+			cutoff = oldest[t];
+	}
+	pthread_mutex_unlock(&history->lock);
+
+	/* Traffic per bucket into rates */
+	for (uint32_t i = 0; i < result->nb_series; i++) {
+		for (uint32_t b = 0; b < result->nb_buckets; b++) {
+			result->series[i].pps[b] /= step;
+			result->series[i].bps[b] *= 8.0 / step;
+		}
+	}
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_history_result_free(XenoFlowHistoryResult *result)
+{
+	for (uint32_t i = 0; result->series != NULL && i < result->nb_series; i++) {
+		free(result->series[i].pps);
+		free(result->series[i].bps);
+	}
+	free(result->series);
+	free(result->covered);
+	memset(result, 0, sizeof(*result));
+}
+
+void xenoflow_history_close(XenoFlowHistory *history)
+{
+	if (history->map != NULL) {
+		/* The last second is written, the minute and hour in progress are lost */
+		pthread_mutex_lock(&history->lock);
+		for (uint32_t s = 0; s < history->header->nb_series; s++) {
+			XenoFlowHistoryPoint *pending = &history->series[s].pending[0];
+
+			if (pending->start != 0)
+				write_point(history, s, 0, pending->start, pending->pkts, pending->bytes);
+		}
+		pthread_mutex_unlock(&history->lock);
+		msync(history->map, history->size, MS_SYNC);
+		munmap(history->map, history->size);
+		history->map = NULL;
+	}
+	free(history->series);
+	free(history->keys);
+	free(history->key_series);
+	history->series = NULL;
+	history->keys = NULL;
+	history->key_series = NULL;
+	history->nb_keys = 0;
+}
@@ -0,0 +1,195 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <doca_error.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * On-disk counter history. The file is memory mapped and split into blocks
+ * of XENOFLOW_HISTORY_BLOCK_SIZE bytes, shared by three tiers: points every
+ * second, every minute and every hour, the coarser ones pre-aggregated from
+ * the finer one as each minute and hour ends. Every tier is a ring, so once
+ * full it overwrites its oldest block; with the default file the second tier
+ * of a hundred backends reaches back about a day and the minute tier weeks.
+ *
+ * A block holds the points of one series, the packets and bytes of one
+ * backend, in two columns. A point is the traffic of its interval, stored as
+ * the zigzag varint of its difference to the point before, so steady traffic
+ * takes a byte per column. Timestamps are implicit: the block's start plus
+ * its step per point, and a gap starts a new block.
+ */
+
+#define XENOFLOW_HISTORY_MAGIC 0x5453494854594548ULL /* "HEYTHIST" */
+#define XENOFLOW_HISTORY_FORMAT 1
+#define XENOFLOW_HISTORY_BLOCK_SIZE 4096
+#define XENOFLOW_HISTORY_MAX_SERIES 4096
+#define XENOFLOW_HISTORY_NAME_SIZE 128
+#define XENOFLOW_HISTORY_TIERS 3
+
+/* Most buckets a query returns, a finer step is coarsened to stay below */
+#define XENOFLOW_HISTORY_MAX_BUCKETS 2000
+
+#define DEFAULT_HISTORY_SIZE_MB 64
+
+/* Block not holding any series */
+#define XENOFLOW_HISTORY_FREE UINT32_MAX
+
+/**
+ * @brief One tier of the file: a ring of blocks with points step seconds apart
+ */
+typedef struct {
+	uint32_t step;			/* seconds per point */
+	uint32_t first_block;		/* its blocks in the file */
+	uint32_t nb_blocks;
+	uint32_t next_block;		/* next to write, the oldest once wrapped */
+} XenoFlowHistoryTier;
+
+/**
+ * @brief Start of the file, followed by the series names and the blocks
+ */
+typedef struct {
+	uint64_t magic;
+	uint32_t format;
+	uint32_t block_size;
+	uint64_t file_size;
+	uint32_t nb_series;
+	uint32_t reserved;
+	XenoFlowHistoryTier tiers[XENOFLOW_HISTORY_TIERS];
+} XenoFlowHistoryHeader;
+
+/**
+ * @brief Start of a block, its two columns split the rest in halves
+ */
+typedef struct {
+	uint32_t series;		/* XENOFLOW_HISTORY_FREE if unused */
+	uint32_t count;			/* points */
+	uint64_t start;			/* CLOCK_REALTIME seconds of the first point */
+	uint16_t used[2];		/* bytes of the packet and byte columns */
+	uint32_t reserved[3];
+} XenoFlowHistoryBlock;
+
+#define XENOFLOW_HISTORY_COLUMN_SIZE ((XENOFLOW_HISTORY_BLOCK_SIZE - sizeof(XenoFlowHistoryBlock)) / 2)
+
+/**
+ * @brief Traffic of one interval not written yet, one per series and tier
+ */
+typedef struct {
+	uint64_t start;			/* of the interval, 0 if nothing is pending */
+	uint64_t pkts;
+	uint64_t bytes;
+} XenoFlowHistoryPoint;
+
+/**
+ * @brief In-memory state of one series
+ */
+typedef struct {
+	uint64_t last_pkts;		/* cumulative counters of the last sample */
+	uint64_t last_bytes;
+	int primed;			/* last_* hold a sample */
+	uint32_t open[XENOFLOW_HISTORY_TIERS];	/* block appended to, XENOFLOW_HISTORY_FREE for none */
+	int64_t prev[XENOFLOW_HISTORY_TIERS][2];	/* last point of the open block, per column */
+	XenoFlowHistoryPoint pending[XENOFLOW_HISTORY_TIERS];
+} XenoFlowHistorySeries;
+
+/**
+ * @brief Cumulative counters of one backend handed to the history
+ */
+typedef struct {
+	const void *key;		/* the backend, so names are only looked up when backends change */
+	const char *service;
+	const char *name;
+	uint64_t pkts;
+	uint64_t bytes;
+} XenoFlowHistorySample;
+
+typedef struct {
+	pthread_mutex_t lock;		/* appends on the event loop, queries from the HTTP server */
+	void *map;			/* the whole file, NULL if no history is kept */
+	size_t size;
+	XenoFlowHistoryHeader *header;
+	char (*names)[XENOFLOW_HISTORY_NAME_SIZE];	/* "service/backend" of every series */
+	XenoFlowHistorySeries *series;
+	const void **keys;		/* key of each sample of the last append */
+	uint32_t *key_series;		/* and its series */
+	uint32_t nb_keys;
+	uint64_t nb_points;		/* written since start */
+} XenoFlowHistory;
+
+/**
+ * @brief Traffic history of one series, or of all of them, per bucket
+ */
+typedef struct {
+	char name[XENOFLOW_HISTORY_NAME_SIZE];	/* "service/backend", "total" for the sum */
+	double *pps;			/* per bucket */
+	double *bps;
+} XenoFlowHistorySeriesResult;
+
+/**
+ * @brief Result of xenoflow_history_query()
+ */
+typedef struct {
+	uint64_t from;			/* start of the first bucket */
+	uint32_t step;			/* seconds per bucket, may be more than asked for */
+	uint32_t resolution;		/* step of the finest tier used */
+	uint32_t nb_buckets;
+	uint8_t *covered;		/* bucket has any point */
+	uint32_t nb_series;		/* the total comes first */
+	XenoFlowHistorySeriesResult *series;
+} XenoFlowHistoryResult;
+
+/**
+ * @brief Open a history file, creating or resizing it if needed
+ *
+ * A file of another format or size is started over. The series and points of
+ * a matching file are kept and appended to.
+ *
+ * @param history History to initialize
+ * @param path History file
+ * @param size_mb Size of the file in MB
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_history_open(XenoFlowHistory *history, const char *path, uint32_t size_mb);
+
+/**
+ * @brief Add one sample of every backend
+ *
+ * The traffic since the sample before goes into the current second; a
+ * second, minute or hour is written once a sample of a later one arrives.
+ *
+ * @param history The history
+ * @param now CLOCK_REALTIME seconds
+ * @param samples Cumulative counters of the backends
+ * @param nb_samples Number of backends
+ */
+void xenoflow_history_append(XenoFlowHistory *history, uint64_t now, const XenoFlowHistorySample *samples,
+			     uint32_t nb_samples);
+
+/**
+ * @brief Traffic rates over a time range, downsampled
+ * @param history The history
+ * @param from First second, CLOCK_REALTIME
+ * @param to Last second
+ * @param step Seconds per bucket, 0 to pick one
+ * @param series Only the series of this "service/backend", NULL for all of them
+ * @param totals_only Leave out the series, only the total
+ * @param result Rates per bucket, free with xenoflow_history_result_free()
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NOT_FOUND for an unknown series, error code otherwise
+ */
+doca_error_t xenoflow_history_query(XenoFlowHistory *history, uint64_t from, uint64_t to, uint32_t step,
+				    const char *series, int totals_only, XenoFlowHistoryResult *result);
+
+/**
+ * @brief Free a query result
+ * @param result The result
+ */
+void xenoflow_history_result_free(XenoFlowHistoryResult *result);
+
+/**
+ * @brief Flush and unmap the file
+ * @param history History, may be one that was never opened
+ */
+void xenoflow_history_close(XenoFlowHistory *history);
+
+#endif /* HISTORY_H */
@@ -1,23 +1,548 @@
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <arpa/inet.h>
 #include <microhttpd.h>
 #include <cjson/cJSON.h>
 #include <doca_log.h>
 
 #include "http_server.h"
+#include "assets.h"
 #include "core.h"
+#include "evlog.h"
+#include "startup.h"
 
 DOCA_LOG_REGISTER(HTTP_SERVER);
 
 struct http_server_ctx *http_server_ctx = NULL;
 
+/*
+ * Backends of one POST /api, added asynchronously. The connection stays
+ * suspended until the entry poller completed the last of them.
+ */
+struct add_request {
+	pthread_mutex_t lock;
+	struct MHD_Connection *connection;
+	int pending;		/* queued entries not completed yet, +1 while still queueing */
+	int suspended;
+	int failed;
+	cJSON *results;
+};
+
 struct post_data {
 	char *data;
 	size_t size;
 	int received_data;
+	struct add_request *add;
 };
 
-static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *connection,
+static void add_result(struct add_request *add, const char *name, doca_error_t result)
+{
+	cJSON *info = cJSON_CreateObject();
+
+	cJSON_AddStringToObject(info, "name", name);
+	cJSON_AddStringToObject(info, "status", result == DOCA_SUCCESS ? "ok" : "error");
+	if (result != DOCA_SUCCESS) {
+		cJSON_AddStringToObject(info, "error", doca_error_get_descr(result));
+		add->failed++;
+	}
+	cJSON_AddItemToArray(add->results, info);
+}
+
+/* Runs on the entry poller thread */
+static void backend_added(XenoFlowBackend *backend, doca_error_t result, void *arg)
+{
+	struct add_request *add = (struct add_request *)arg;
+
+	pthread_mutex_lock(&add->lock);
+	add_result(add, backend->name, result);
+	if (--add->pending == 0 && add->suspended)
+		MHD_resume_connection(add->connection);
+	pthread_mutex_unlock(&add->lock);
+}
+
+static void free_post_data(struct post_data *post)
+{
+	if (post->add != NULL) {
+		cJSON_Delete(post->add->results);
+		pthread_mutex_destroy(&post->add->lock);
+		free(post->add);
+	}
+	free(post->data);
+	free(post);
+}
+
+static char *error_response(const char *message)
+{
+	cJSON *error = cJSON_CreateObject();
+	char *str;
+
+	cJSON_AddStringToObject(error, "status", "error");
+	cJSON_AddStringToObject(error, "error", message);
+	str = cJSON_Print(error);
+	cJSON_Delete(error);
+	return str;
+}
+
+static char *finish_add_backends_request(struct add_request *add)
+{
+	cJSON *root = cJSON_CreateObject();
+	char *str;
+
+	cJSON_AddStringToObject(root, "status", add->failed ? "error" : "ok");
+	cJSON_AddItemReferenceToObject(root, "backends", add->results);
+	str = cJSON_Print(root);
+	cJSON_Delete(root);
+	return str;
+}
+
+/*
+ * Queue the backends of a POST /api body. Returns NULL once the connection is
+ * suspended waiting for completions, or the response to send right away with
+ * its status: an error if the body is invalid or memory ran out (post->add
+ * stays NULL), the results if nothing had to wait for hardware.
+ */
+static char *handle_add_backends_request(struct MHD_Connection *connection, struct post_data *post,
+					 unsigned int *status)
+{
+	XenoFlow *xeno = http_server_ctx->xeno;
+	XenoFlowService *service;
+	XenoFlowServiceDesc service_desc;
+	struct add_request *add;
+	cJSON *root, *backends, *service_name;
+	int pending;
+
+	*status = MHD_HTTP_BAD_REQUEST;
+	root = cJSON_Parse(post->data);
+	if (root == NULL)
+		return error_response("Invalid JSON");
+
+	backends = cJSON_GetObjectItem(root, "backends");
+	if (!cJSON_IsArray(backends)) {
+		cJSON_Delete(root);
+		return error_response("Missing backends array");
+	}
+
+	/* Without a name, go to the default service, or the only one there is */
+	service_name = cJSON_GetObjectItem(root, "service");
+	if (cJSON_IsString(service_name))
+		service = xenoflow_services_find(&xeno->services, service_name->valuestring);
+	else if (xeno->services.defaultService != NULL)
+		service = xeno->services.defaultService;
+	else
+		service = xeno->services.numServices == 1 ? xeno->services.services[0] : NULL;
+	if (service == NULL) {
+		cJSON_Delete(root);
+		return error_response("Unknown service");
+	}
+
+	/* Backends are checked as in the service's config, by the same parser */
+	xenoflow_service_describe(service, &service_desc);
+
+	add = calloc(1, sizeof(*add));
+	if (add == NULL || (add->results = cJSON_CreateArray()) == NULL) {
+		free(add);
+		cJSON_Delete(root);
+		*status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+		return error_response("Out of memory");
+	}
+	pthread_mutex_init(&add->lock, NULL);
+	add->connection = connection;
+	add->pending = 1;
+	post->add = add;
+	*status = MHD_HTTP_OK;
+
+	for (int i = 0; i < cJSON_GetArraySize(backends); i++) {
+		cJSON *backend = cJSON_GetArrayItem(backends, i);
+		cJSON *name = cJSON_GetObjectItem(backend, "name");
+		XenoFlowBackendDesc desc;
+		XenoFlowBackend *spec = NULL;
+		doca_error_t result = DOCA_ERROR_INVALID_VALUE;
+		char err[256];
+
+		if (xenoflow_backend_parse(&service_desc, backend, i, &desc, err, sizeof(err)) == 0) {
+			spec = xenoflow_backend_create(&desc);
+			result = spec != NULL ? DOCA_SUCCESS : DOCA_ERROR_NO_MEMORY;
+		} else
+			DOCA_LOG_ERR("%s", err);
+		if (result != DOCA_SUCCESS) {
+			pthread_mutex_lock(&add->lock);
+			add_result(add, cJSON_IsString(name) ? name->valuestring : "", result);
+			pthread_mutex_unlock(&add->lock);
+			destroyBackend(spec);
+			continue;
+		}
+
+		pthread_mutex_lock(&add->lock);
+		add->pending++;
+		pthread_mutex_unlock(&add->lock);
+
+		result = xenoflow_add_backend_async(xeno, service, spec, backend_added, add);
+		destroyBackend(spec);
+		if (result != DOCA_SUCCESS) {
+			pthread_mutex_lock(&add->lock);
+			add->pending--;
+			add_result(add, desc.name, result);
+			pthread_mutex_unlock(&add->lock);
+		}
+	}
+	cJSON_Delete(root);
+
+	/* Drop the queueing reference, suspend in the same critical section so a completion cannot resume early */
+	pthread_mutex_lock(&add->lock);
+	pending = --add->pending;
+	if (pending > 0) {
+		MHD_suspend_connection(connection);
+		add->suspended = 1;
+	}
+	pthread_mutex_unlock(&add->lock);
+
+	return pending > 0 ? NULL : finish_add_backends_request(add);
+}
+
+/*
+ * One /api/stream subscriber. MHD pulls its frames through stream_reader(),
+ * the connection is suspended between frames and resumed by the publisher.
+ */
+struct stream_client {
+	XenoFlowStreamSub sub;
+	XenoFlowStream *stream;
+	struct MHD_Connection *connection;
+};
+
+static void stream_client_wait(void *arg)
+{
+	MHD_suspend_connection(((struct stream_client *)arg)->connection);
+}
+
+static void stream_client_wake(void *arg)
+{
+	MHD_resume_connection(((struct stream_client *)arg)->connection);
+}
+
+static ssize_t stream_reader(void *cls, uint64_t pos, char *buf, size_t max)
+{
+	struct stream_client *client = (struct stream_client *)cls;
+	ssize_t len = xenoflow_stream_read(client->stream, &client->sub, buf, max);
+
+	(void)pos;
+	return len < 0 ? MHD_CONTENT_READER_END_OF_STREAM : len;
+}
+
+static void stream_client_free(void *cls)
+{
+	struct stream_client *client = (struct stream_client *)cls;
+
+	xenoflow_stream_unsubscribe(client->stream, &client->sub);
+	free(client);
+}
+
+static enum MHD_Result handle_stream_request(struct MHD_Connection *connection)
+{
+	struct stream_client *client;
+	struct MHD_Response *response;
+	enum MHD_Result ret;
+	unsigned int status = MHD_HTTP_OK;
+
+	client = http_server_ctx->xeno->options.streamIntervalMs > 0 ? calloc(1, sizeof(*client)) : NULL;
+	if (client == NULL) {
+		char *str = error_response(http_server_ctx->xeno->options.streamIntervalMs > 0 ? "Out of memory"
+											 : "Stream is off");
+
+		response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+		MHD_add_response_header(response, "Content-Type", "application/json");
+		status = MHD_HTTP_SERVICE_UNAVAILABLE;
+	} else {
+		client->stream = &http_server_ctx->xeno->stream;
+		client->connection = connection;
+		client->sub.wait = stream_client_wait;
+		client->sub.wake = stream_client_wake;
+		client->sub.arg = client;
+		xenoflow_stream_subscribe(client->stream, &client->sub);
+
+		response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4096, stream_reader, client,
+							     stream_client_free);
+		MHD_add_response_header(response, "Content-Type", "text/event-stream");
+		MHD_add_response_header(response, "Cache-Control", "no-cache");
+	}
+	ret = MHD_queue_response(connection, status, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
+/*
+ * A time argument of /api/history: seconds since the epoch, or before now if negative
+ */
+static int history_time(struct MHD_Connection *connection, const char *key, uint64_t now, uint64_t *t)
+{
+	const char *value = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, key);
+	char *end;
+	long long v;
+
+	if (value == NULL)
+		return 0;
+	v = strtoll(value, &end, 10);
+	if (end == value || *end != '\0' || (v < 0 && (uint64_t)-v > now))
+		return -1;
+	*t = v < 0 ? now - (uint64_t)-v : (uint64_t)v;
+	return 0;
+}
+
+static cJSON *history_values(const XenoFlowHistoryResult *result, const double *values)
+{
+	cJSON *array = cJSON_CreateArray();
+
+	for (uint32_t b = 0; b < result->nb_buckets; b++)
+		cJSON_AddItemToArray(array, result->covered[b] ? cJSON_CreateNumber(values[b]) : cJSON_CreateNull());
+	return array;
+}
+
+/*
+ * GET /api/history?from=&to=&step=&backend=&total=: packet and bit rates per
+ * bucket from the history file, null where it has no points
+ */
+static enum MHD_Result handle_history_request(struct MHD_Connection *connection)
+{
+	XenoFlowHistory *history = &http_server_ctx->xeno->history;
+	const char *step_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "step");
+	const char *backend = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "backend");
+	const char *total = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "total");
+	uint64_t now = (uint64_t)time(NULL), to = now, from;
+	unsigned long step = 0;
+	XenoFlowHistoryResult result;
+	struct MHD_Response *response;
+	unsigned int status = MHD_HTTP_OK;
+	doca_error_t err = DOCA_ERROR_INVALID_VALUE;
+	enum MHD_Result ret;
+	char *str, *end;
+	int valid = 1;
+
+	if (step_arg != NULL) {
+		step = strtoul(step_arg, &end, 10);
+		valid = end != step_arg && *end == '\0' && step <= UINT32_MAX;
+	}
+	/* The last hour by default */
+	if (valid && history_time(connection, "to", now, &to) != 0)
+		valid = 0;
+	from = to >= 3600 ? to - 3600 : 0;
+	if (valid && history_time(connection, "from", now, &from) != 0)
+		valid = 0;
+	if (valid)
+		err = xenoflow_history_query(history, from, to, (uint32_t)step, backend,
+					     total != NULL && strcmp(total, "0") != 0, &result);
+
+	if (err == DOCA_SUCCESS) {
+		cJSON *json = cJSON_CreateObject();
+		cJSON *series = cJSON_CreateArray();
+
+		cJSON_AddNumberToObject(json, "from", result.from);
+		cJSON_AddNumberToObject(json, "to", to);
+		cJSON_AddNumberToObject(json, "step", result.step);
+		cJSON_AddNumberToObject(json, "resolution", result.resolution);
+		for (uint32_t i = 0; i < result.nb_series; i++) {
+			cJSON *entry = cJSON_CreateObject();
+
+			cJSON_AddStringToObject(entry, "name", result.series[i].name);
+			cJSON_AddItemToObject(entry, "pps", history_values(&result, result.series[i].pps));
+			cJSON_AddItemToObject(entry, "bps", history_values(&result, result.series[i].bps));
+			cJSON_AddItemToArray(series, entry);
+		}
+		cJSON_AddItemToObject(json, "series", series);
+		str = cJSON_PrintUnformatted(json);
+		cJSON_Delete(json);
+		xenoflow_history_result_free(&result);
+	} else if (err == DOCA_ERROR_NOT_SUPPORTED) {
+		str = error_response("History is off");
+		status = MHD_HTTP_SERVICE_UNAVAILABLE;
+	} else if (err == DOCA_ERROR_NOT_FOUND) {
+		str = error_response("Unknown backend");
+		status = MHD_HTTP_NOT_FOUND;
+	} else if (err == DOCA_ERROR_INVALID_VALUE) {
+		str = error_response("Invalid from, to or step");
+		status = MHD_HTTP_BAD_REQUEST;
+	} else {
+		str = error_response("Out of memory");
+		status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+	}
+
+	response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+	MHD_add_response_header(response, "Content-Type", "application/json");
+	ret = MHD_queue_response(connection, status, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
+/* Service of a lookup: by name, else the one whose VIP dst, proto and port hit, else the default service */
+static XenoFlowService *lookup_service(struct MHD_Connection *connection, int *valid)
+{
+	XenoFlowServices *services = &http_server_ctx->xeno->services;
+	const char *name = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "service");
+	const char *dst_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "dst");
+	const char *proto = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "proto");
+	const char *port_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "port");
+	struct in_addr dst;
+	unsigned long port = 0;
+	uint8_t protocol = 0;
+	char *end;
+
+	*valid = 1;
+	if (name != NULL)
+		return xenoflow_services_find(services, name);
+	if (dst_arg == NULL)
+		return services->defaultService;
+
+	if (proto != NULL && strcmp(proto, "tcp") == 0)
+		protocol = DOCA_FLOW_PROTO_TCP;
+	else if (proto != NULL && strcmp(proto, "udp") == 0)
+		protocol = DOCA_FLOW_PROTO_UDP;
+	if (port_arg != NULL)
+		port = strtoul(port_arg, &end, 10);
+	if (inet_pton(AF_INET, dst_arg, &dst) != 1 || protocol == 0 || port_arg == NULL || end == port_arg ||
+	    *end != '\0' || port > UINT16_MAX) {
+		*valid = 0;
+		return NULL;
+	}
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+
+		if (service != services->defaultService && service->vip == dst.s_addr && service->protocol == protocol &&
+		    service->port == port)
+			return service;
+	}
+	return services->defaultService;
+}
+
+/*
+ * GET /api/lookup?src=&service= or ?src=&dst=&proto=&port=: the hash entry the
+ * NIC picks for a client and the backend owning it now, next to the entry each
+ * of the simulator's hash functions predicts
+ */
+static enum MHD_Result handle_lookup_request(struct MHD_Connection *connection)
+{
+	XenoFlow *xeno = http_server_ctx->xeno;
+	const char *src_arg = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "src");
+	struct doca_flow_match match;
+	struct MHD_Response *response;
+	unsigned int status = MHD_HTTP_OK;
+	XenoFlowService *service = NULL;
+	struct in_addr src;
+	uint32_t hash;
+	doca_error_t result;
+	enum MHD_Result ret;
+	int valid = src_arg != NULL && inet_pton(AF_INET, src_arg, &src) == 1;
+	char *str;
+
+	pthread_mutex_lock(&xeno->lock);
+	if (valid)
+		service = lookup_service(connection, &valid);
+	if (!valid) {
+		str = error_response("Invalid src, dst, proto or port");
+		status = MHD_HTTP_BAD_REQUEST;
+	} else if (service == NULL) {
+		str = error_response("No such service");
+		status = MHD_HTTP_NOT_FOUND;
+	} else {
+		memset(&match, 0, sizeof(match));
+		match.outer.l3_type = DOCA_FLOW_L3_TYPE_IP4;
+		match.outer.ip4.src_ip = src.s_addr;
+		result = doca_flow_pipe_calc_hash(service->hash_pipe, &match, &hash);
+		if (result == DOCA_SUCCESS) {
+			uint32_t entry = hash & (service->hash_pipe_entries - 1);
+			XenoFlowBackend *backend = service->slots[entry];
+			cJSON *json = cJSON_CreateObject();
+			cJSON *simulated = cJSON_CreateObject();
+			char mac[18];
+
+			cJSON_AddStringToObject(json, "src", src_arg);
+			cJSON_AddStringToObject(json, "service", service->name);
+			cJSON_AddNumberToObject(json, "hash", hash);
+			cJSON_AddNumberToObject(json, "entry", entry);
+			cJSON_AddNumberToObject(json, "entries", service->hash_pipe_entries);
+			if (backend != NULL) {
+				cJSON *info = cJSON_CreateObject();
+
+				snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", backend->mac_address[0],
+					 backend->mac_address[1], backend->mac_address[2], backend->mac_address[3],
+					 backend->mac_address[4], backend->mac_address[5]);
+				cJSON_AddStringToObject(info, "name", backend->name);
+				cJSON_AddStringToObject(info, "mac_address", mac);
+				cJSON_AddBoolToObject(info, "host", backend->host);
+				cJSON_AddItemToObject(json, "backend", info);
+			} else {
+				/* A free entry has no hash pipe entry, its packets miss and are dropped */
+				cJSON_AddNullToObject(json, "backend");
+			}
+			/* Which model of xeno_hashsim matches this NIC */
+			for (int a = 0; a < XENOFLOW_HASH_MAX; a++)
+				cJSON_AddNumberToObject(simulated, xenoflow_hash_name((enum XenoFlowHashAlgo)a),
+							xenoflow_hash_one(&http_server_ctx->hashers[a], src.s_addr) &
+								(service->hash_pipe_entries - 1));
+			cJSON_AddItemToObject(json, "simulatedEntries", simulated);
+			str = cJSON_PrintUnformatted(json);
+			cJSON_Delete(json);
+		} else {
+			DOCA_LOG_ERR("Failed to calculate the hash of %s: %s", src_arg, doca_error_get_descr(result));
+			str = error_response("Hash calculation failed");
+			status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+		}
+	}
+	pthread_mutex_unlock(&xeno->lock);
+
+	response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+	MHD_add_response_header(response, "Content-Type", "application/json");
+	ret = MHD_queue_response(connection, status, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
+static const XenoFlowAsset *find_asset(const char *url)
+{
+	for (size_t i = 0; i < xenoflow_nb_assets; i++) {
+		if (strcmp(xenoflow_assets[i].path, url) == 0)
+			return &xenoflow_assets[i];
+	}
+	return NULL;
+}
+
+/*
+ * Embedded dashboard file straight from the binary: the gzip variant if the
+ * client takes it, and no body at all if its cached copy has the same ETag
+ */
+static enum MHD_Result handle_asset_request(struct MHD_Connection *connection, const XenoFlowAsset *asset)
+{
+	const char *accept = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+							 MHD_HTTP_HEADER_ACCEPT_ENCODING);
+	const char *match = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+	int gzip = asset->gzip != NULL && accept != NULL && strstr(accept, "gzip") != NULL;
+	const char *etag = gzip ? asset->gzip_etag : asset->etag;
+	int not_modified = match != NULL && (strcmp(match, "*") == 0 || strstr(match, etag) != NULL);
+	struct MHD_Response *response;
+	enum MHD_Result ret;
+
+	if (not_modified)
+		response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+	else if (gzip)
+		response = MHD_create_response_from_buffer(asset->gzip_size, (void *)asset->gzip,
+							   MHD_RESPMEM_PERSISTENT);
+	else
+		response = MHD_create_response_from_buffer(asset->size, (void *)asset->data, MHD_RESPMEM_PERSISTENT);
+
+	MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+	MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
+	/* Cached, but checked against the ETag every time, so a new build shows up at once */
+	MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+	if (!not_modified) {
+		MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, asset->content_type);
+		if (gzip)
+			MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+	}
+	ret = MHD_queue_response(connection, not_modified ? MHD_HTTP_NOT_MODIFIED : MHD_HTTP_OK, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
+static enum MHD_Result handle_request(void *cls, struct MHD_Connection *connection,
 					     const char *url, const char *method,
 					     const char *version, const char *upload_data,
 					     size_t *upload_data_size, void **con_cls)
@@ -26,7 +551,9 @@ static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *co
 	enum MHD_Result ret;
 
 	if (strcmp(url, "/api") == 0 && strcmp(method, "GET") == 0) {		
+		pthread_mutex_lock(&http_server_ctx->xeno->lock);
 		char *json_str = handle_base_path_request();
+		pthread_mutex_unlock(&http_server_ctx->xeno->lock);
 		
 		response = MHD_create_response_from_buffer(strlen(json_str), (void *)json_str, MHD_RESPMEM_MUST_FREE);
 		MHD_add_response_header(response, "Content-Type", "application/json");
@@ -34,14 +561,59 @@ static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *co
 		MHD_destroy_response(response);
 		return ret;
 	}
+	if (strcmp(url, "/api/resources") == 0 && strcmp(method, "GET") == 0) {
+		pthread_mutex_lock(&http_server_ctx->xeno->lock);
+		char *json_str = handle_resources_request();
+		pthread_mutex_unlock(&http_server_ctx->xeno->lock);
+
+		response = MHD_create_response_from_buffer(strlen(json_str), (void *)json_str, MHD_RESPMEM_MUST_FREE);
+		MHD_add_response_header(response, "Content-Type", "application/json");
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		return ret;
+	}
+	if (strcmp(url, "/api/services") == 0 && strcmp(method, "GET") == 0) {
+		pthread_mutex_lock(&http_server_ctx->xeno->lock);
+		char *json_str = handle_services_request();
+		pthread_mutex_unlock(&http_server_ctx->xeno->lock);
+
+		response = MHD_create_response_from_buffer(strlen(json_str), (void *)json_str, MHD_RESPMEM_MUST_FREE);
+		MHD_add_response_header(response, "Content-Type", "application/json");
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		return ret;
+	}
+	if (strcmp(url, "/api/stream") == 0 && strcmp(method, "GET") == 0)
+		return handle_stream_request(connection);
+	if (strcmp(url, "/api/history") == 0 && strcmp(method, "GET") == 0)
+		return handle_history_request(connection);
+	if (strcmp(url, "/api/lookup") == 0 && strcmp(method, "GET") == 0)
+		return handle_lookup_request(connection);
+	if (strcmp(url, "/api/startup") == 0 && strcmp(method, "GET") == 0) {
+		char *json_str = handle_startup_request();
+
+		response = MHD_create_response_from_buffer(strlen(json_str), (void *)json_str, MHD_RESPMEM_MUST_FREE);
+		MHD_add_response_header(response, "Content-Type", "application/json");
+		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+		MHD_destroy_response(response);
+		return ret;
+	}
+	if (strcmp(url, "/api/reload") == 0 && strcmp(method, "POST") == 0) {
+		/* Runs on the event loop, the request only queues it */
+		int ok = xenoflow_request_reload(http_server_ctx->xeno) == DOCA_SUCCESS;
+		char *str = strdup(ok ? "{\"status\": \"reloading\"}" : "{\"status\": \"error\"}");
+
+		response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+		MHD_add_response_header(response, "Content-Type", "application/json");
+		ret = MHD_queue_response(connection, ok ? MHD_HTTP_ACCEPTED : MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+		MHD_destroy_response(response);
+		return ret;
+	}
 	if (strcmp(url, "/api") == 0 && strcmp(method, "POST") == 0) {
 		struct post_data *post = (struct post_data *)*con_cls;
 		
 		if (post == NULL) {
-			post = malloc(sizeof(struct post_data));
-			post->data = NULL;
-			post->size = 0;
-			post->received_data = 0;
+			post = calloc(1, sizeof(struct post_data));
 			*con_cls = post;
 			return MHD_YES;
 		}
@@ -56,33 +628,37 @@ static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *co
 			return MHD_YES;
 		}
 		
-		//DOCA_LOG_INFO("Received POST: %s", post->data ? post->data : "(empty)");
-		
-		cJSON *root = cJSON_Parse(post->data);
-		cJSON *backends = cJSON_GetObjectItem(root, "backends");
-		int numberOfBackends = cJSON_GetArraySize(backends);
-		for (int i = 0; i < numberOfBackends; i++) {
-			cJSON *backend = cJSON_GetArrayItem(backends, i);
-			cJSON *name = cJSON_GetObjectItem(backend, "name");
-			cJSON *mac = cJSON_GetObjectItem(backend, "mac_address");
-			DOCA_LOG_INFO("backend name: %s", name->valuestring);
-			DOCA_LOG_INFO("backend mac: %s", mac->valuestring);
+		/* First call after the upload queues the entries, the call after resume answers */
+		if (post->add == NULL) {
+			unsigned int status;
+			char *str = handle_add_backends_request(connection, post, &status);
+
+			if (str == NULL)
+				return MHD_YES;
+			response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+			MHD_add_response_header(response, "Content-Type", "application/json");
+			ret = MHD_queue_response(connection, status, response);
+			MHD_destroy_response(response);
+			free_post_data(post);
+			*con_cls = NULL;
+			return ret;
 		}
 
-		char *str = malloc(64);
-		snprintf(str, 64, "{\"status\": \"Ok\"}");
+		char *str = finish_add_backends_request(post->add);
 		response = MHD_create_response_from_buffer(strlen(str), (void*)str, MHD_RESPMEM_MUST_FREE);
 		MHD_add_response_header(response, "Content-Type", "application/json");
 		ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
 		MHD_destroy_response(response);
 		
-		if (post->data) free(post->data);
-		free(post);
+		free_post_data(post);
 		*con_cls = NULL;
 		
 		return ret;
 	}
 
+	if (strcmp(method, "GET") == 0 && find_asset(url) != NULL)
+		return handle_asset_request(connection, find_asset(url));
+
 	/* 404 Response */
 	cJSON *error = cJSON_CreateObject();
 	cJSON_AddStringToObject(error, "error", "Endpoint not found");
@@ -97,6 +673,40 @@ static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *co
 	return ret;
 }
 
+static void add_traffic_stats(cJSON *obj, const struct doca_flow_resource_query *stats, const XenoFlowEntryRate *rate)
+{
+	char packets[32];
+
+	/* Kept as a string for existing API consumers */
+	snprintf(packets, sizeof(packets), "%lu", stats->counter.total_pkts);
+	cJSON_AddStringToObject(obj, "packetsProcessed", packets);
+	cJSON_AddNumberToObject(obj, "bytesProcessed", stats->counter.total_bytes);
+	cJSON_AddNumberToObject(obj, "packetsPerSecond", rate->pps);
+	cJSON_AddNumberToObject(obj, "bitsPerSecond", rate->bps);
+}
+
+static void add_mac_address(cJSON *obj, const XenoFlowBackend *backend)
+{
+	char mac_str[18];
+
+	snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
+			backend->mac_address[0], backend->mac_address[1],
+			backend->mac_address[2], backend->mac_address[3],
+			backend->mac_address[4], backend->mac_address[5]);
+	cJSON_AddStringToObject(obj, "mac_address", mac_str);
+}
+
+static void add_tunnel(cJSON *obj, const XenoFlowBackend *backend)
+{
+	char remote[INET_ADDRSTRLEN];
+
+	inet_ntop(AF_INET, &backend->remote, remote, sizeof(remote));
+	cJSON_AddStringToObject(obj, "tunnel", xenoflow_tunnel_name(backend->tunnel));
+	cJSON_AddStringToObject(obj, "remote", remote);
+	if (backend->tunnel != XENOFLOW_TUNNEL_IPIP)
+		cJSON_AddNumberToObject(obj, "vni", backend->vni);
+}
+
 char* handle_base_path_request() {
 	cJSON *root = cJSON_CreateObject();
 	cJSON_AddStringToObject(root, "message", "XenoFlow REST API is running.");
@@ -104,43 +714,266 @@ char* handle_base_path_request() {
 	cJSON_AddNumberToObject(root, "version", 1.0);
 
 	cJSON *backends = cJSON_CreateArray();
-	XenoFlowConfig* config = http_server_ctx->config;
+	cJSON *entries = cJSON_CreateArray();
+	XenoFlowServices *services = &http_server_ctx->xeno->services;
+	uint64_t total_packets = 0, total_bytes = 0;
+	double total_pps = 0, total_bps = 0;
+	int total_backends = 0;
 	
-	for (int i = 0; i < config->numBackends; i++) {
-		XenoFlowBackend *backend = config->backends[i];
-		cJSON *backend_info = cJSON_CreateObject();
-		cJSON_AddStringToObject(backend_info, "name", backend->name);
-		
-		/* Format MAC address as string */
-		char mac_str[18];
-		snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
-				backend->mac_address[0], backend->mac_address[1], 
-				backend->mac_address[2], backend->mac_address[3],
-				backend->mac_address[4], backend->mac_address[5]);
-		cJSON_AddStringToObject(backend_info, "mac_address", mac_str);
-
-		char entry_pps[128];
-		snprintf(entry_pps, 128, "%d", entry_processed_packages(i, config));
-		cJSON_AddStringToObject(backend_info, "packetsProcessed", entry_pps);
-		
-		cJSON_AddItemToArray(backends, backend_info);
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		XenoFlowConfig *config = service->config;
+
+		for (int i = 0; i < config->numBackends; i++) {
+			XenoFlowBackend *backend = config->backends[i];
+			struct doca_flow_resource_query stats;
+			XenoFlowEntryRate rate_value, *rate = &rate_value;
+			cJSON *backend_info = cJSON_CreateObject();
+			cJSON_AddStringToObject(backend_info, "name", backend->name);
+			cJSON_AddStringToObject(backend_info, "service", service->name);
+			add_mac_address(backend_info, backend);
+
+			/* From the last collection of the stats timer, no hardware queries under the lock */
+			xenoflow_backend_stats(backend, &stats, rate);
+			add_traffic_stats(backend_info, &stats, rate);
+			total_packets += stats.counter.total_pkts;
+			total_bytes += stats.counter.total_bytes;
+			total_pps += rate->pps;
+			total_bps += rate->bps;
+			
+			cJSON_AddItemToArray(backends, backend_info);
+
+			cJSON *entry_info = cJSON_CreateObject();
+			cJSON_AddNumberToObject(entry_info, "index", backend->entry_index);
+			cJSON_AddStringToObject(entry_info, "service", service->name);
+			cJSON_AddStringToObject(entry_info, "backend", backend->name);
+			add_traffic_stats(entry_info, &stats, rate);
+			cJSON_AddItemToArray(entries, entry_info);
+		}
+		total_backends += config->numBackends;
 	}
 	cJSON_AddItemToObject(root, "backends", backends);
+	cJSON_AddItemToObject(root, "entries", entries);
+
+	cJSON_AddNumberToObject(root, "serviceNumber", services->numServices);
+	cJSON_AddNumberToObject(root, "backendNumber", total_backends);
+	cJSON_AddNumberToObject(root, "totalPackets", total_packets);
+	cJSON_AddNumberToObject(root, "totalBytes", total_bytes);
+	cJSON_AddNumberToObject(root, "packetsPerSecond", total_pps);
+	cJSON_AddNumberToObject(root, "bitsPerSecond", total_bps);
+	char *json_str = cJSON_Print(root);
+	cJSON_Delete(root);
+
+	return json_str;
+}
+
+char* handle_services_request() {
+	XenoFlowServices *services = &http_server_ctx->xeno->services;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *list = cJSON_CreateArray();
+
+	for (int s = 0; s < services->numServices; s++) {
+		XenoFlowService *service = services->services[s];
+		cJSON *service_info = cJSON_CreateObject();
+		cJSON *backends = cJSON_CreateArray();
+		uint64_t packets = 0, bytes = 0;
+		double pps = 0, bps = 0;
+		char vip[INET_ADDRSTRLEN];
+
+		cJSON_AddStringToObject(service_info, "name", service->name);
+		cJSON_AddBoolToObject(service_info, "default", service->protocol == 0);
+		if (service->protocol != 0) {
+			xenoflow_service_vip_str(service, vip, sizeof(vip));
+			cJSON_AddStringToObject(service_info, "vip", vip);
+			cJSON_AddNumberToObject(service_info, "port", service->port);
+		}
+		cJSON_AddStringToObject(service_info, "protocol", xenoflow_service_protocol_name(service));
+		cJSON_AddNumberToObject(service_info, "hashPipeEntries", service->hash_pipe_entries);
+		if (service->spillover != XENOFLOW_SPILLOVER_NONE)
+			cJSON_AddStringToObject(service_info, "spillover",
+						service->spillover == XENOFLOW_SPILLOVER_DROP ? "drop" : "rehash");
+
+		for (int i = 0; i < service->config->numBackends; i++) {
+			XenoFlowBackend *backend = service->config->backends[i];
+			struct doca_flow_resource_query stats_value, *stats = &stats_value;
+			XenoFlowEntryRate rate_value, *rate = &rate_value;
+			cJSON *backend_info = cJSON_CreateObject();
+
+			xenoflow_backend_stats(backend, stats, rate);
+
+			cJSON_AddStringToObject(backend_info, "name", backend->name);
+			add_mac_address(backend_info, backend);
+			cJSON_AddNumberToObject(backend_info, "index", backend->entry_index);
+			cJSON_AddBoolToObject(backend_info, "host", backend->host);
+			if (backend->tunnel != XENOFLOW_TUNNEL_NONE)
+				add_tunnel(backend_info, backend);
+			if (backend->rate_limit != 0)
+				cJSON_AddNumberToObject(backend_info, "rateLimitMbps", backend->rate_limit * 8 / 1e6);
+			if (service->buckets != 0)
+				cJSON_AddNumberToObject(backend_info, "buckets", backend->nb_buckets);
+			add_traffic_stats(backend_info, stats, rate);
+			cJSON_AddItemToArray(backends, backend_info);
+
+			packets += stats->counter.total_pkts;
+			bytes += stats->counter.total_bytes;
+			pps += rate->pps;
+			bps += rate->bps;
+		}
+		cJSON_AddItemToObject(service_info, "backends", backends);
+		cJSON_AddNumberToObject(service_info, "totalPackets", packets);
+		cJSON_AddNumberToObject(service_info, "totalBytes", bytes);
+		cJSON_AddNumberToObject(service_info, "packetsPerSecond", pps);
+		cJSON_AddNumberToObject(service_info, "bitsPerSecond", bps);
+		cJSON_AddItemToArray(list, service_info);
+	}
+	cJSON_AddItemToObject(root, "services", list);
+
+	char *json_str = cJSON_Print(root);
+	cJSON_Delete(root);
+
+	return json_str;
+}
+
+static void add_resource_usage(cJSON *obj, const char *key, uint32_t used, uint32_t total)
+{
+	cJSON *usage = cJSON_CreateObject();
+
+	cJSON_AddNumberToObject(usage, "configured", total);
+	cJSON_AddNumberToObject(usage, "used", used);
+	cJSON_AddNumberToObject(usage, "headroom", total > used ? total - used : 0);
+	cJSON_AddNumberToObject(usage, "usagePercent", total ? (double)used / total * 100 : 0);
+	cJSON_AddBoolToObject(usage, "nearLimit", total && (double)used / total >= XENOFLOW_RESOURCE_WARN_RATIO);
+	cJSON_AddItemToObject(obj, key, usage);
+}
+
+char* handle_resources_request() {
+	XenoFlowResources *res = &http_server_ctx->xeno->resources;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *pipes = cJSON_CreateArray();
+
+	add_resource_usage(root, "counters", xenoflow_resources_used_counters(res), res->nr_counters);
+	add_resource_usage(root, "actionMemoryBytes", xenoflow_resources_used_action_mem(res), res->action_mem_size);
+
+	for (int i = 0; i < res->numPipes; i++) {
+		XenoFlowPipeResources *p = &res->pipes[i];
+		cJSON *pipe_info = cJSON_CreateObject();
+
+		cJSON_AddStringToObject(pipe_info, "name", p->name);
+		add_resource_usage(pipe_info, "entries", p->used_entries, p->nr_entries);
+		cJSON_AddNumberToObject(pipe_info, "counters", p->used_counters);
+		cJSON_AddNumberToObject(pipe_info, "actionMemoryBytes", p->used_action_mem);
+		cJSON_AddItemToArray(pipes, pipe_info);
+	}
+	cJSON_AddItemToObject(root, "pipes", pipes);
+
+	/* One object per worker of the host entries' slow path, none when they go to the kernel */
+	XenoFlowSlowPath *sp = &http_server_ctx->xeno->slowpath;
+	cJSON *slow_path = cJSON_CreateArray();
+
+	for (uint16_t i = 0; i < sp->nb_queues; i++) {
+		XenoFlowSlowPathQueue *q = &sp->queues[i];
+		cJSON *queue_info = cJSON_CreateObject();
+
+		cJSON_AddNumberToObject(queue_info, "queue", sp->queue_ids[i]);
+		cJSON_AddNumberToObject(queue_info, "packets", atomic_load(&q->pkts));
+		cJSON_AddNumberToObject(queue_info, "bytes", atomic_load(&q->bytes));
+		cJSON_AddNumberToObject(queue_info, "replies", atomic_load(&q->replies));
+		cJSON_AddNumberToObject(queue_info, "unhandled", atomic_load(&q->unhandled));
+		cJSON_AddNumberToObject(queue_info, "txDrops", atomic_load(&q->tx_drops));
+		cJSON_AddItemToArray(slow_path, queue_info);
+	}
+	cJSON_AddItemToObject(root, "slowPath", slow_path);
 
-	cJSON_AddNumberToObject(root, "backendNumber", config->numBackends);
 	char *json_str = cJSON_Print(root);
 	cJSON_Delete(root);
 
 	return json_str;
 }
 
+char *handle_startup_request()
+{
+	XenoFlowStartup startup;
+	cJSON *root = cJSON_CreateObject();
+	cJSON *phases = cJSON_CreateArray();
+
+	xenoflow_startup_get(&startup);
+	if (startup.ready_ns != 0) {
+		cJSON_AddStringToObject(root, "mode", startup.mode);
+		cJSON_AddNumberToObject(root, "readyMs", startup.ready_ns / 1e6);
+	} else {
+		cJSON_AddNullToObject(root, "mode");
+		cJSON_AddNullToObject(root, "readyMs");
+	}
+
+	for (uint32_t i = 0; i < startup.nb_phases; i++) {
+		const XenoFlowStartupPhase *phase = &startup.phases[i];
+		cJSON *phase_info = cJSON_CreateObject();
+
+		cJSON_AddStringToObject(phase_info, "name", phase->name);
+		cJSON_AddNumberToObject(phase_info, "startMs", phase->start_ns / 1e6);
+		if (phase->end_ns != 0)
+			cJSON_AddNumberToObject(phase_info, "durationMs", (phase->end_ns - phase->start_ns) / 1e6);
+		else
+			cJSON_AddNullToObject(phase_info, "durationMs");
+		cJSON_AddBoolToObject(phase_info, "parallel", phase->parallel);
+		cJSON_AddItemToArray(phases, phase_info);
+	}
+	cJSON_AddItemToObject(root, "phases", phases);
+
+	char *json_str = cJSON_Print(root);
+	cJSON_Delete(root);
+
+	return json_str;
+}
+
+static uint32_t api_endpoint(const char *url)
+{
+	if (strcmp(url, "/api") == 0)
+		return XENOFLOW_EVLOG_API_BASE;
+	if (strcmp(url, "/api/services") == 0)
+		return XENOFLOW_EVLOG_API_SERVICES;
+	if (strcmp(url, "/api/resources") == 0)
+		return XENOFLOW_EVLOG_API_RESOURCES;
+	if (strcmp(url, "/api/reload") == 0)
+		return XENOFLOW_EVLOG_API_RELOAD;
+	if (strcmp(url, "/api/startup") == 0)
+		return XENOFLOW_EVLOG_API_STARTUP;
+	if (strcmp(url, "/api/stream") == 0)
+		return XENOFLOW_EVLOG_API_STREAM;
+	if (strcmp(url, "/api/history") == 0)
+		return XENOFLOW_EVLOG_API_HISTORY;
+	if (strcmp(url, "/api/lookup") == 0)
+		return XENOFLOW_EVLOG_API_LOOKUP;
+	return XENOFLOW_EVLOG_API_OTHER;
+}
+
+/*
+ * Record every answered request in the event log. POST handlers are also
+ * called to set up and per upload chunk, those calls are not recorded.
+ */
+static enum MHD_Result http_request_handler(void *cls, struct MHD_Connection *connection,
+					     const char *url, const char *method,
+					     const char *version, const char *upload_data,
+					     size_t *upload_data_size, void **con_cls)
+{
+	int post = strcmp(method, "POST") == 0;
+	int answers = !post || (*con_cls != NULL && *upload_data_size == 0);
+	uint64_t start = xenoflow_evlog_on && answers ? xenoflow_evlog_now() : 0;
+	enum MHD_Result ret;
+
+	ret = handle_request(cls, connection, url, method, version, upload_data, upload_data_size, con_cls);
+	if (start != 0)
+		xenoflow_evlog(XENOFLOW_EV_API_CALL, api_endpoint(url), post, xenoflow_evlog_now() - start);
+	return ret;
+}
+
 /**
  * @brief Start the HTTP server on the specified port
  * @param port Port number to listen on
- * @param config Pointer to XenoFlowConfig
+ * @param xeno Pointer to the XenoFlow instance, its services must be loaded
  * @return 0 on success, -1 on failure
  */
-int http_server_start(int port, XenoFlowConfig *config)
+int http_server_start(int port, XenoFlow *xeno)
 {
 	http_server_ctx = malloc(sizeof(struct http_server_ctx));
 	if (!http_server_ctx) {
@@ -149,8 +982,11 @@ int http_server_start(int port, XenoFlowConfig *config)
 	}
 
 	http_server_ctx->port = port;
-	http_server_ctx->config = config;
-	http_server_ctx->daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY,
+	http_server_ctx->xeno = xeno;
+	/* Read-only once built, so lookups share them without a lock */
+	for (int a = 0; a < XENOFLOW_HASH_MAX; a++)
+		xenoflow_hasher_init(&http_server_ctx->hashers[a], (enum XenoFlowHashAlgo)a, NULL);
+	http_server_ctx->daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY | MHD_ALLOW_SUSPEND_RESUME,
 										   http_server_ctx->port,
 										   NULL, NULL,
 										   &http_request_handler, NULL,
@@ -174,6 +1010,8 @@ void http_server_stop(void)
 {
 	if (http_server_ctx != NULL) {
 		if (http_server_ctx->daemon != NULL) {
+			/* Stream subscribers are suspended between frames, they end once resumed */
+			xenoflow_stream_close(&http_server_ctx->xeno->stream);
 			MHD_stop_daemon(http_server_ctx->daemon);
 			DOCA_LOG_INFO("HTTP server stopped");
 		}
@@ -181,17 +1019,3 @@ void http_server_stop(void)
 		http_server_ctx = NULL;
 	}
 }
-
-int entry_processed_packages(int entryId, XenoFlowConfig *config) {
-	struct doca_flow_resource_query query_stats;
-	doca_error_t query_result;
-	
-	query_result = doca_flow_resource_query_entry(config->backends[entryId]->entry, &query_stats);
-	
-	uint64_t packets = 0;
-	if (query_result == DOCA_SUCCESS) {
-		packets = query_stats.counter.total_pkts;
-	}
-	
-	return packets;
-}
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define HTTP_SERVER_H
 
 #include "core.h"
+#include "hashsim.h"
 #include <microhttpd.h>
 
 /**
@@ -10,7 +11,8 @@
 struct http_server_ctx {
 	struct MHD_Daemon *daemon;
 	int port;
-	XenoFlowConfig *config;  /* pointer to XenoFlowConfig */
+	XenoFlow *xeno;          /* pointer to the running XenoFlow instance */
+	XenoFlowHasher hashers[XENOFLOW_HASH_MAX]; /* simulator's models, for /api/lookup */
 };
 
 /**
@@ -21,10 +23,10 @@ extern struct http_server_ctx *http_server_ctx;
 /**
  * @brief Start the HTTP server on the specified port
  * @param port Port number to listen on
- * @param config Pointer to XenoFlowConfig
+ * @param xeno Pointer to the XenoFlow instance, its services must be loaded
  * @return 0 on success, -1 on failure
  */
-int http_server_start(int port, XenoFlowConfig *config);
+int http_server_start(int port, XenoFlow *xeno);
 
 /**
  * @brief Stop the HTTP server
@@ -33,6 +35,22 @@ void http_server_stop(void);
 
 char* handle_base_path_request();
 
-int entry_processed_packages(int entryId, XenoFlowConfig *config);
+/**
+ * @brief Build the /api/services response: VIP, protocol, port and backends with traffic per service
+ * @return JSON string, to be freed by the caller
+ */
+char* handle_services_request();
+
+/**
+ * @brief Build the /api/resources response: configured vs used entries, counters and action memory
+ * @return JSON string, to be freed by the caller
+ */
+char* handle_resources_request();
+
+/**
+ * @brief Build the /api/startup response: time to serving and every startup phase
+ * @return JSON string, to be freed by the caller
+ */
+char* handle_startup_request();
 
 #endif /* HTTP_SERVER_H */
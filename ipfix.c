@@ -0,0 +1,174 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <doca_log.h>
+
+#include "ipfix.h"
+
+DOCA_LOG_REGISTER(IPFIX);
+
+#define FIELD_LEN(id, len, name) +(len)
+#define FIELD_ONE(id, len, name) +1
+
+#define RECORD_LEN (0 XENOFLOW_IPFIX_FIELDS(FIELD_LEN))
+#define NB_FIELDS (0 XENOFLOW_IPFIX_FIELDS(FIELD_ONE))
+
+/* Set header (id, length), template header (id, field count), one (id, length) pair per field */
+#define TEMPLATE_SET_LEN (4 + 4 + 4 * NB_FIELDS)
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+	return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+	p = put16(p, v >> 16);
+	return put16(p, v);
+}
+
+static uint8_t *put64(uint8_t *p, uint64_t v)
+{
+	p = put32(p, v >> 32);
+	return put32(p, v);
+}
+
+int xenoflow_ipfix_open(XenoFlowIpfix *ipfix, const char *collector, uint32_t domain_id,
+			uint32_t sampling_interval)
+{
+	struct sockaddr_in addr = {.sin_family = AF_INET};
+	char host[INET_ADDRSTRLEN];
+	unsigned int port;
+
+	memset(ipfix, 0, sizeof(*ipfix));
+	ipfix->fd = -1;
+	ipfix->domain_id = domain_id;
+	ipfix->sampling_interval = sampling_interval;
+
+	if (sscanf(collector, "%15[0-9.]:%u", host, &port) != 2 || port == 0 || port > 65535 ||
+	    inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+		DOCA_LOG_ERR("Invalid IPFIX collector '%s', expected ip:port", collector);
+		return -1;
+	}
+	addr.sin_port = htons(port);
+
+	ipfix->fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (ipfix->fd < 0) {
+		DOCA_LOG_ERR("Failed to create IPFIX socket: %s", strerror(errno));
+		return -1;
+	}
+	/* Connected, so a missing collector shows up as send errors instead of silence */
+	if (connect(ipfix->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		DOCA_LOG_ERR("Failed to connect to IPFIX collector %s: %s", collector, strerror(errno));
+		close(ipfix->fd);
+		ipfix->fd = -1;
+		return -1;
+	}
+
+	DOCA_LOG_INFO("Exporting IPFIX to %s, observation domain %u", collector, domain_id);
+	return 0;
+}
+
+static void put_template(XenoFlowIpfix *ipfix)
+{
+	uint8_t *p = ipfix->buf + ipfix->len;
+
+	p = put16(p, XENOFLOW_IPFIX_SET_TEMPLATE);
+	p = put16(p, TEMPLATE_SET_LEN);
+	p = put16(p, XENOFLOW_IPFIX_TEMPLATE_ID);
+	p = put16(p, NB_FIELDS);
+#define FIELD_SPEC(id, len, name) \
+	p = put16(p, id);         \
+	p = put16(p, len);
+	XENOFLOW_IPFIX_FIELDS(FIELD_SPEC)
+#undef FIELD_SPEC
+	ipfix->len += TEMPLATE_SET_LEN;
+}
+
+/* Header, the template when it is due, and an empty data set */
+static void open_message(XenoFlowIpfix *ipfix, uint64_t now_ms)
+{
+	ipfix->len = sizeof(XenoFlowIpfixHeader);
+	if (ipfix->last_template_ms == 0 || now_ms - ipfix->last_template_ms >= XENOFLOW_IPFIX_TEMPLATE_REFRESH_MS) {
+		put_template(ipfix);
+		ipfix->last_template_ms = now_ms;
+	}
+	ipfix->data_set = ipfix->len;
+	ipfix->len += 4;
+	ipfix->nb_records = 0;
+}
+
+void xenoflow_ipfix_flush(XenoFlowIpfix *ipfix, uint64_t now_ms)
+{
+	uint8_t *p = ipfix->buf;
+
+	if (ipfix->len == 0 || ipfix->nb_records == 0)
+		return;
+
+	p = put16(p, XENOFLOW_IPFIX_VERSION);
+	p = put16(p, ipfix->len);
+	p = put32(p, now_ms / 1000);
+	p = put32(p, ipfix->sequence);
+	put32(p, ipfix->domain_id);
+	p = put16(ipfix->buf + ipfix->data_set, XENOFLOW_IPFIX_TEMPLATE_ID);
+	put16(p, ipfix->len - ipfix->data_set);
+
+	if (send(ipfix->fd, ipfix->buf, ipfix->len, 0) < 0) {
+		/* Logged once, a collector that is down would flood the log otherwise */
+		if (ipfix->nb_errors++ == 0)
+			DOCA_LOG_WARN("Failed to send IPFIX message: %s", strerror(errno));
+	} else {
+		ipfix->nb_messages++;
+		ipfix->nb_exported += ipfix->nb_records;
+	}
+	/* Records count as sent either way, the collector sees the loss as a sequence gap */
+	ipfix->sequence += ipfix->nb_records;
+	ipfix->len = 0;
+	ipfix->nb_records = 0;
+}
+
+void xenoflow_ipfix_add(XenoFlowIpfix *ipfix, const XenoFlowIpfixRecord *record, uint64_t now_ms)
+{
+	uint8_t *p;
+
+	if (ipfix->fd < 0)
+		return;
+	if (ipfix->len != 0 && ipfix->len + RECORD_LEN > sizeof(ipfix->buf))
+		xenoflow_ipfix_flush(ipfix, now_ms);
+	if (ipfix->len == 0)
+		open_message(ipfix, now_ms);
+
+	/* Addresses are kept in network order, written as they are */
+	p = ipfix->buf + ipfix->len;
+	memcpy(p, &record->src_ip, 4);
+	memcpy(p + 4, &record->dst_ip, 4);
+	p = put16(p + 8, record->src_port);
+	p = put16(p, record->dst_port);
+	*p++ = record->protocol;
+	p = put64(p, record->packets);
+	p = put64(p, record->bytes);
+	p = put64(p, record->start_ms);
+	p = put64(p, record->end_ms);
+	put32(p, ipfix->sampling_interval);
+
+	ipfix->len += RECORD_LEN;
+	ipfix->nb_records++;
+}
+
+void xenoflow_ipfix_close(XenoFlowIpfix *ipfix, uint64_t now_ms)
+{
+	if (ipfix->fd < 0)
+		return;
+	xenoflow_ipfix_flush(ipfix, now_ms);
+	close(ipfix->fd);
+	ipfix->fd = -1;
+	DOCA_LOG_INFO("IPFIX exporter closed: %" PRIu64 " records in %" PRIu64 " messages, %" PRIu64 " failed sends",
+		      ipfix->nb_exported, ipfix->nb_messages, ipfix->nb_errors);
+}
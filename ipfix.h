@@ -0,0 +1,114 @@
+#ifndef IPFIX_H
+#define IPFIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IPFIX (RFC 7011) export of the flow records built from sampled packets.
+ * Messages go over UDP, so the template is repeated every
+ * XENOFLOW_IPFIX_TEMPLATE_REFRESH_MS and collectors that start late still
+ * decode them. xeno_ipfix is a small collector for testing, it only needs
+ * this header.
+ */
+
+#define XENOFLOW_IPFIX_VERSION 10
+#define XENOFLOW_IPFIX_SET_TEMPLATE 2
+#define XENOFLOW_IPFIX_TEMPLATE_ID 256
+
+/* Largest message, fits a 1500 byte MTU with IP and UDP headers */
+#define XENOFLOW_IPFIX_MAX_MESSAGE 1400
+
+#define XENOFLOW_IPFIX_TEMPLATE_REFRESH_MS 30000
+
+/* Information elements of the template, in record order */
+#define XENOFLOW_IPFIX_FIELDS(X)                         \
+	X(8, 4, "sourceIPv4Address")                     \
+	X(12, 4, "destinationIPv4Address")               \
+	X(7, 2, "sourceTransportPort")                   \
+	X(11, 2, "destinationTransportPort")             \
+	X(4, 1, "protocolIdentifier")                    \
+	X(2, 8, "packetDeltaCount")                      \
+	X(1, 8, "octetDeltaCount")                       \
+	X(152, 8, "flowStartMilliseconds")               \
+	X(153, 8, "flowEndMilliseconds")                 \
+	X(305, 4, "samplingPacketInterval")
+
+/**
+ * @brief IPFIX message header, all fields in network order on the wire
+ */
+typedef struct {
+	uint16_t version;	/* XENOFLOW_IPFIX_VERSION */
+	uint16_t length;	/* whole message */
+	uint32_t export_time;	/* seconds since the epoch */
+	uint32_t sequence;	/* data records sent before this message */
+	uint32_t domain_id;	/* observation domain */
+} XenoFlowIpfixHeader;
+
+/**
+ * @brief One flow record, counts already scaled by the sampling interval
+ */
+typedef struct {
+	uint32_t src_ip;	/* network order */
+	uint32_t dst_ip;	/* network order */
+	uint16_t src_port;	/* host order, 0 if not TCP or UDP */
+	uint16_t dst_port;
+	uint8_t protocol;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t start_ms;	/* first and last sample, ms since the epoch */
+	uint64_t end_ms;
+} XenoFlowIpfixRecord;
+
+/**
+ * @brief UDP exporter, fills one message at a time
+ */
+typedef struct {
+	int fd;			/* connected UDP socket, -1 when closed */
+	uint32_t domain_id;
+	uint32_t sampling_interval;
+	uint32_t sequence;	/* data records sent so far */
+	uint64_t last_template_ms;
+	uint8_t buf[XENOFLOW_IPFIX_MAX_MESSAGE];
+	size_t len;		/* bytes in buf, 0 when no message is open */
+	size_t data_set;	/* offset of the open data set */
+	uint32_t nb_records;	/* records in the open message */
+	uint64_t nb_messages;
+	uint64_t nb_exported;	/* records sent */
+	uint64_t nb_errors;	/* messages that failed to send */
+} XenoFlowIpfix;
+
+/**
+ * @brief Open the exporter
+ * @param ipfix Exporter to initialize
+ * @param collector Collector as ip:port
+ * @param domain_id Observation domain of the messages
+ * @param sampling_interval 1-in-N sampling the records come from, exported with each record
+ * @return 0 on success, -1 on failure
+ */
+int xenoflow_ipfix_open(XenoFlowIpfix *ipfix, const char *collector, uint32_t domain_id,
+			uint32_t sampling_interval);
+
+/**
+ * @brief Add a record, sends the open message first if it is full
+ * @param ipfix The exporter
+ * @param record Record to export
+ * @param now_ms Current time, ms since the epoch
+ */
+void xenoflow_ipfix_add(XenoFlowIpfix *ipfix, const XenoFlowIpfixRecord *record, uint64_t now_ms);
+
+/**
+ * @brief Send the open message, if any
+ * @param ipfix The exporter
+ * @param now_ms Current time, ms since the epoch
+ */
+void xenoflow_ipfix_flush(XenoFlowIpfix *ipfix, uint64_t now_ms);
+
+/**
+ * @brief Send what is left and close the socket
+ * @param ipfix The exporter
+ * @param now_ms Current time, ms since the epoch
+ */
+void xenoflow_ipfix_close(XenoFlowIpfix *ipfix, uint64_t now_ms);
+
+#endif /* IPFIX_H */
@@ -23,7 +23,9 @@
  *
  */
 
+#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <doca_argp.h>
 #include <doca_flow.h>
@@ -35,12 +37,590 @@
 #include <dpdk_utils.h>
 
 #include "core.h"
+#include "devices.h"
 #include "main.h"
+#include "startup.h"
 
 DOCA_LOG_REGISTER(FLOW_SHARED_COUNTER::MAIN);
 
-/* Sample's Logic */
-doca_error_t xeno_flow(int nb_queues);
+/*
+ * ARGP callback - bind hash entries to shared counters
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS
+ */
+static doca_error_t shared_counters_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+
+	options->sharedCounters = *(bool *)param;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - interval of the status loop
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t stats_interval_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int interval = *(int *)param;
+
+	if (interval <= 0) {
+		DOCA_LOG_ERR("Stats interval must be positive, got %d", interval);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->statsIntervalMs = interval;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - JSON file with the services and their backends
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t config_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *path = (const char *)param;
+
+	if (strnlen(path, sizeof(options->configPath)) == sizeof(options->configPath)) {
+		DOCA_LOG_ERR("Config path is too long (max %zu)", sizeof(options->configPath) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->configPath, path);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - binary event log file
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t evlog_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *path = (const char *)param;
+
+	if (strnlen(path, sizeof(options->evlogPath)) == sizeof(options->evlogPath)) {
+		DOCA_LOG_ERR("Event log path is too long (max %zu)", sizeof(options->evlogPath) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->evlogPath, path);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - sample 1 in N packets into flow records
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t sample_rate_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int rate = *(int *)param;
+
+	if (rate <= 0 || rate > 65536) {
+		DOCA_LOG_ERR("Sample rate must be between 1 and 65536, got %d", rate);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->sampleRate = rate;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - IPFIX collector of the flow records
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t ipfix_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *collector = (const char *)param;
+
+	if (strnlen(collector, sizeof(options->ipfixCollector)) == sizeof(options->ipfixCollector)) {
+		DOCA_LOG_ERR("IPFIX collector is too long (max %zu)", sizeof(options->ipfixCollector) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->ipfixCollector, collector);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - take the port over from a running instance
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t takeover_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int pid = *(int *)param;
+
+	if (pid <= 1) {
+		DOCA_LOG_ERR("Takeover needs the PID of the running instance, got %d", pid);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->takeoverPid = pid;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - state snapshot file
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t snapshot_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *path = (const char *)param;
+
+	if (strnlen(path, sizeof(options->snapshotPath)) == sizeof(options->snapshotPath)) {
+		DOCA_LOG_ERR("Snapshot path is too long (max %zu)", sizeof(options->snapshotPath) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->snapshotPath, path);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - interval of the snapshot writes
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t snapshot_interval_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int interval = *(int *)param;
+
+	if (interval < 10) {
+		DOCA_LOG_ERR("Snapshot interval must be at least 10 ms, got %d", interval);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->snapshotIntervalMs = interval;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - interval of the /api/stream frames
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t stream_interval_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int interval = *(int *)param;
+
+	if (interval != 0 && interval < 50) {
+		DOCA_LOG_ERR("Stream interval must be 0 or at least 50 ms, got %d", interval);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->streamIntervalMs = interval;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - counter history file
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t history_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *path = (const char *)param;
+
+	if (strnlen(path, sizeof(options->historyPath)) == sizeof(options->historyPath)) {
+		DOCA_LOG_ERR("History path is too long (max %zu)", sizeof(options->historyPath) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->historyPath, path);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - size of the counter history file
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t history_size_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int size = *(int *)param;
+
+	if (size < 2 || size > 65536) {
+		DOCA_LOG_ERR("History size must be 2 to 65536 MB, got %d", size);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->historySizeMb = size;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - device of the port
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t device_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	const char *device = (const char *)param;
+
+	if (strnlen(device, sizeof(options->device)) == sizeof(options->device)) {
+		DOCA_LOG_ERR("Device selector is too long (max %zu)", sizeof(options->device) - 1);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	strcpy(options->device, device);
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - interval of the bucket rebalancing rounds
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t rebalance_interval_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int interval = *(int *)param;
+
+	if (interval < 100) {
+		DOCA_LOG_ERR("Rebalance interval must be at least 100 ms, got %d", interval);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->rebalanceIntervalMs = interval;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - most buckets moved per service and round
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t rebalance_moves_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int moves = *(int *)param;
+
+	if (moves <= 0 || moves > 1024) {
+		DOCA_LOG_ERR("Rebalance moves must be between 1 and 1024, got %d", moves);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->rebalanceMoves = moves;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - load band around the mean that counts as balanced
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t rebalance_threshold_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int threshold = *(int *)param;
+
+	if (threshold <= 0 || threshold > 100) {
+		DOCA_LOG_ERR("Rebalance threshold must be between 1 and 100 percent, got %d", threshold);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->rebalanceThreshold = threshold;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - RX queues of the host entries' slow path
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t slow_path_queues_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int queues = *(int *)param;
+
+	if (queues < 0 || queues > XENOFLOW_SLOWPATH_MAX_QUEUES) {
+		DOCA_LOG_ERR("Slow path queues must be between 0 and %d, got %d", XENOFLOW_SLOWPATH_MAX_QUEUES, queues);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->slowPathQueues = queues;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * ARGP callback - CPU of the first slow path worker
+ *
+ * @param [in]: pointer to the parameter value
+ * @config [out]: XenoFlowOptions to fill
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR_INVALID_VALUE otherwise
+ */
+static doca_error_t slow_path_cpu_callback(void *param, void *config)
+{
+	XenoFlowOptions *options = (XenoFlowOptions *)config;
+	int cpu = *(int *)param;
+
+	if (cpu < 0) {
+		DOCA_LOG_ERR("Slow path CPU must not be negative, got %d", cpu);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+	options->slowPathCpu = cpu;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Register the XenoFlow command line parameters
+ *
+ * @return: DOCA_SUCCESS on success and DOCA_ERROR otherwise
+ */
+static doca_error_t register_xeno_flow_params(void)
+{
+	struct doca_argp_param *param;
+	doca_error_t result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "shared-counters");
+	doca_argp_param_set_description(param, "Use shared counters for hash entries, read with one bulk query");
+	doca_argp_param_set_callback(param, shared_counters_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_BOOLEAN);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "stats-interval");
+	doca_argp_param_set_arguments(param, "<ms>");
+	doca_argp_param_set_description(param, "Interval of the status loop in milliseconds (default 5000)");
+	doca_argp_param_set_callback(param, stats_interval_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "config");
+	doca_argp_param_set_arguments(param, "<path>");
+	doca_argp_param_set_description(param, "JSON file with the services (VIP, protocol, port) and their backends");
+	doca_argp_param_set_callback(param, config_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "evlog");
+	doca_argp_param_set_arguments(param, "<path>");
+	doca_argp_param_set_description(param, "Record entry, counter and API events to a binary log (decode with xeno_evlog)");
+	doca_argp_param_set_callback(param, evlog_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "sample-rate");
+	doca_argp_param_set_arguments(param, "<n>");
+	doca_argp_param_set_description(param, "Mirror 1 in n packets (a power of two) into IPFIX flow records, needs --ipfix");
+	doca_argp_param_set_callback(param, sample_rate_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "ipfix");
+	doca_argp_param_set_arguments(param, "<ip:port>");
+	doca_argp_param_set_description(param, "UDP collector of the sampled flow records");
+	doca_argp_param_set_callback(param, ipfix_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "takeover");
+	doca_argp_param_set_arguments(param, "<pid>");
+	doca_argp_param_set_description(param, "Start in standby, install all entries, then take the port over from <pid>");
+	doca_argp_param_set_callback(param, takeover_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "snapshot");
+	doca_argp_param_set_arguments(param, "<file>");
+	doca_argp_param_set_description(param, "Restore from <file> at start if it matches the config, snapshot the state to it");
+	doca_argp_param_set_callback(param, snapshot_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "snapshot-interval");
+	doca_argp_param_set_arguments(param, "<ms>");
+	doca_argp_param_set_description(param, "Snapshot every <ms> (default 1000)");
+	doca_argp_param_set_callback(param, snapshot_interval_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "stream-interval");
+	doca_argp_param_set_arguments(param, "<ms>");
+	doca_argp_param_set_description(param, "Send /api/stream counter deltas every <ms>, 0 for no stream (default 500)");
+	doca_argp_param_set_callback(param, stream_interval_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "history");
+	doca_argp_param_set_arguments(param, "<file>");
+	doca_argp_param_set_description(param, "Keep the counter history for /api/history in <file>");
+	doca_argp_param_set_callback(param, history_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "history-size");
+	doca_argp_param_set_arguments(param, "<MB>");
+	doca_argp_param_set_description(param, "Size of the history file, the oldest points are overwritten (default 64)");
+	doca_argp_param_set_callback(param, history_size_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "device");
+	doca_argp_param_set_arguments(param, "<pci|iface|mac>");
+	doca_argp_param_set_description(param, "Device of the port, over the config's \"device\" (default " XENOFLOW_DEFAULT_DEVICE ")");
+	doca_argp_param_set_callback(param, device_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_STRING);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "rebalance-interval");
+	doca_argp_param_set_arguments(param, "<ms>");
+	doca_argp_param_set_description(param, "Move buckets of services with buckets by load every <ms> (default off)");
+	doca_argp_param_set_callback(param, rebalance_interval_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "rebalance-moves");
+	doca_argp_param_set_arguments(param, "<n>");
+	doca_argp_param_set_description(param, "Most buckets moved per service and round (default 16)");
+	doca_argp_param_set_callback(param, rebalance_moves_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "rebalance-threshold");
+	doca_argp_param_set_arguments(param, "<percent>");
+	doca_argp_param_set_description(param, "Backends within this much of the mean load count as balanced (default 5)");
+	doca_argp_param_set_callback(param, rebalance_threshold_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "slow-path-queues");
+	doca_argp_param_set_arguments(param, "<n>");
+	doca_argp_param_set_description(param, "Spread host entries over n RX queues polled by DPDK workers instead of the kernel (default 0)");
+	doca_argp_param_set_callback(param, slow_path_queues_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	result = doca_argp_register_param(param);
+	if (result != DOCA_SUCCESS)
+		return result;
+
+	result = doca_argp_param_create(&param);
+	if (result != DOCA_SUCCESS)
+		return result;
+	doca_argp_param_set_long_name(param, "slow-path-cpu");
+	doca_argp_param_set_arguments(param, "<cpu>");
+	doca_argp_param_set_description(param, "Pin slow path worker i to CPU cpu + i (default unpinned)");
+	doca_argp_param_set_callback(param, slow_path_cpu_callback);
+	doca_argp_param_set_type(param, DOCA_ARGP_TYPE_INT);
+	return doca_argp_register_param(param);
+}
 
 /*
  * Sample main function
@@ -50,14 +630,9 @@ doca_error_t xeno_flow(int nb_queues);
  * @return: EXIT_SUCCESS on success and EXIT_FAILURE otherwise
  */
 
- struct flow_hot_upgrade_ctx {
-	struct flow_switch_ctx switch_ctx;	   /* common switch context */
-	enum doca_flow_port_operation_state state; /* operation state to use after port configuration */
-};
-
  void *xeno_flow_wrapper(void *arg) {
     int nb_queues = *(int *)arg;
-    doca_error_t result = xeno_flow(nb_queues);
+    doca_error_t result = xeno_flow(nb_queues, NULL);
     if (result != DOCA_SUCCESS) {
         DOCA_LOG_ERR("xeno_flow encountered an error: %s", doca_error_get_descr(result));
     }
@@ -69,12 +644,16 @@ int main(int argc, char **argv)
 	doca_error_t result;
 	struct doca_log_backend *sdk_log;
 	int exit_status = EXIT_FAILURE;
+	XenoFlowOptions options;
+	sigset_t signals;
+	int phase;
 	struct application_dpdk_config dpdk_config = {
 		.port_config.nb_ports = 2,
 		.port_config.nb_queues = 4,
 	};
 	//struct flow_dev_ctx ctx = {};
 
+	xenoflow_startup_init();
 	result = doca_log_backend_create_standard();
 	if (result != DOCA_SUCCESS)
 		goto sample_exit;
@@ -87,28 +666,48 @@ int main(int argc, char **argv)
 
 	DOCA_LOG_INFO("Starting the load balancer");
 
-	result = doca_argp_init("xeno_flow", NULL);
+	/* Before DPDK starts its threads, so only the event loop's signalfd sees these signals */
+	xeno_flow_signals(&signals);
+	result = xenoflow_loop_block_signals(&signals);
+	if (result != DOCA_SUCCESS)
+		goto sample_exit;
+
+	xeno_flow_options_init(&options);
+
+	result = doca_argp_init("xeno_flow", &options);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to init ARGP resources: %s", doca_error_get_descr(result));
 		goto sample_exit;
 	}
+
+	result = register_xeno_flow_params();
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to register XenoFlow parameters: %s", doca_error_get_descr(result));
+		goto argp_cleanup;
+	}
 	
 	doca_argp_set_dpdk_program(dpdk_init);
+	/* Parses the arguments and runs the DPDK EAL init */
+	phase = xenoflow_phase_begin("eal", 0);
 	result = doca_argp_start(argc, argv);
+	xenoflow_phase_end(phase);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to parse sample input: %s", doca_error_get_descr(result));
 		goto argp_cleanup;
 	}
 
-	/* update queues and ports */
+	/* update queues and ports, the slow path's RX queues come on top */
+	dpdk_config.port_config.nb_queues += options.slowPathQueues;
+	phase = xenoflow_phase_begin("dpdk_ports", 0);
 	result = dpdk_queues_and_ports_init(&dpdk_config);
+	xenoflow_phase_end(phase);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("Failed to update ports and queues");
 		goto dpdk_cleanup;
 	}
 
 	/* run sample */
-	result = xeno_flow(dpdk_config.port_config.nb_queues);
+	result = xeno_flow(dpdk_config.port_config.nb_queues, &options);
 	if (result != DOCA_SUCCESS) {
 		DOCA_LOG_ERR("xeno_flow_hash_pipe() encountered an error: %s", doca_error_get_descr(result));
 		goto dpdk_ports_queues_cleanup;
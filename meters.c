@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <doca_log.h>
+
+#include "meters.h"
+
+DOCA_LOG_REGISTER(METERS);
+
+doca_error_t xenoflow_meters_init(XenoFlowMeters *meters, uint32_t nb_meters)
+{
+	memset(meters, 0, sizeof(*meters));
+	if (nb_meters == 0)
+		return DOCA_SUCCESS;
+
+	meters->ids = calloc(nb_meters, sizeof(uint32_t));
+	if (meters->ids == NULL) {
+		DOCA_LOG_ERR("Failed to allocate %u meters", nb_meters);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	meters->nb_meters = nb_meters;
+	for (uint32_t i = 0; i < nb_meters; i++)
+		meters->ids[i] = i;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_meters_configure(XenoFlowMeters *meters, uint32_t id, uint64_t rate, uint64_t burst)
+{
+	struct doca_flow_shared_resource_cfg cfg = {.domain = DOCA_FLOW_PIPE_DOMAIN_DEFAULT};
+	doca_error_t result;
+
+	if (id >= meters->nb_meters)
+		return DOCA_ERROR_INVALID_VALUE;
+
+	if (rate == 0)
+		rate = XENOFLOW_METER_UNLIMITED_RATE;
+	if (burst == 0) {
+		/* Multiply first, rates below 1000 B/s would round to no burst at all */
+		burst = rate <= UINT64_MAX / XENOFLOW_METER_DEFAULT_BURST_MS
+				? rate * XENOFLOW_METER_DEFAULT_BURST_MS / 1000
+				: rate / 1000 * XENOFLOW_METER_DEFAULT_BURST_MS;
+		if (burst < XENOFLOW_METER_MIN_BURST)
+			burst = XENOFLOW_METER_MIN_BURST;
+	}
+
+	/* Single rate, color blind: green up to rate with burst, red above */
+	cfg.meter_cfg.limit_type = DOCA_FLOW_METER_LIMIT_TYPE_BYTES;
+	cfg.meter_cfg.color_mode = DOCA_FLOW_METER_COLOR_MODE_BLIND;
+	cfg.meter_cfg.alg = DOCA_FLOW_METER_ALGORITHM_TYPE_RFC2697;
+	cfg.meter_cfg.cir = rate;
+	cfg.meter_cfg.cbs = burst;
+
+	result = doca_flow_shared_resource_set_cfg(DOCA_FLOW_SHARED_RESOURCE_METER, id, &cfg);
+	if (result != DOCA_SUCCESS)
+		DOCA_LOG_ERR("Failed to configure meter %u: %s", id, doca_error_get_descr(result));
+	return result;
+}
+
+doca_error_t xenoflow_meters_bind(XenoFlowMeters *meters, struct doca_flow_port *port)
+{
+	doca_error_t result;
+
+	if (meters->nb_meters == 0)
+		return DOCA_SUCCESS;
+
+	for (uint32_t i = 0; i < meters->nb_meters; i++) {
+		result = xenoflow_meters_configure(meters, i, 0, 0);
+		if (result != DOCA_SUCCESS)
+			return result;
+	}
+
+	result = doca_flow_shared_resources_bind(DOCA_FLOW_SHARED_RESOURCE_METER, meters->ids, meters->nb_meters,
+						 port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind %u shared meters to port: %s", meters->nb_meters,
+			     doca_error_get_descr(result));
+		return result;
+	}
+
+	DOCA_LOG_INFO("Bound %u shared meters", meters->nb_meters);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_meters_monitor(const XenoFlowMeters *meters, struct doca_flow_monitor *monitor, uint32_t id)
+{
+	(void)meters;
+	monitor->meter_type = DOCA_FLOW_RESOURCE_TYPE_SHARED;
+	monitor->shared_meter.shared_meter_id = id;
+}
+
+void xenoflow_meters_destroy(XenoFlowMeters *meters)
+{
+	free(meters->ids);
+	meters->ids = NULL;
+	meters->nb_meters = 0;
+}
@@ -0,0 +1,68 @@
+#ifndef METERS_H
+#define METERS_H
+
+#include <doca_flow.h>
+#include <stdint.h>
+
+/*
+ * Meters of the hash pipe entries, one shared meter per hash entry with the
+ * entry's counter index as id. Backends without a rate limit keep their meter
+ * at XENOFLOW_METER_UNLIMITED_RATE so it never turns a packet red.
+ */
+
+/* Bytes per second no port reaches, 800 Gbit/s */
+#define XENOFLOW_METER_UNLIMITED_RATE 100000000000ULL
+
+/* Burst of a limited backend when none is configured, in ms worth of its rate */
+#define XENOFLOW_METER_DEFAULT_BURST_MS 100
+
+/* Smallest default burst, a full frame of a 1500 byte MTU, or a slow meter turns every packet red */
+#define XENOFLOW_METER_MIN_BURST 1518
+
+typedef struct {
+	uint32_t nb_meters;		/* 0 when no service meters its backends */
+	uint32_t *ids;			/* shared meter ids 0..nb_meters-1 */
+} XenoFlowMeters;
+
+/**
+ * @brief Allocate the meter table
+ * @param meters Meter table
+ * @param nb_meters Number of meters, one per hash entry, 0 for none
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NO_MEMORY otherwise
+ */
+doca_error_t xenoflow_meters_init(XenoFlowMeters *meters, uint32_t nb_meters);
+
+/**
+ * @brief Configure all meters as unlimited and bind them to the port
+ * @param meters Meter table
+ * @param port Port of the hash pipes
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_meters_bind(XenoFlowMeters *meters, struct doca_flow_port *port);
+
+/**
+ * @brief Set the rate of one meter, called before the entry using it is added
+ * @param meters Meter table
+ * @param id Meter id, the entry's counter index
+ * @param rate Committed rate in bytes per second, 0 for unlimited
+ * @param burst Committed burst in bytes, 0 for XENOFLOW_METER_DEFAULT_BURST_MS of the rate but at least
+ *              XENOFLOW_METER_MIN_BURST
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_meters_configure(XenoFlowMeters *meters, uint32_t id, uint64_t rate, uint64_t burst);
+
+/**
+ * @brief Attach a meter to an entry's monitor
+ * @param meters Meter table
+ * @param monitor Monitor to fill
+ * @param id Meter id, UINT32_MAX in pipe templates to take it from the entries
+ */
+void xenoflow_meters_monitor(const XenoFlowMeters *meters, struct doca_flow_monitor *monitor, uint32_t id);
+
+/**
+ * @brief Free the meter table
+ * @param meters Meter table
+ */
+void xenoflow_meters_destroy(XenoFlowMeters *meters);
+
+#endif /* METERS_H */
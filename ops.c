@@ -0,0 +1,326 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <doca_log.h>
+
+#include "evlog.h"
+#include "ops.h"
+
+DOCA_LOG_REGISTER(OPS);
+
+/* How long one doca_flow_entries_process() call may wait for completions */
+#define XENOFLOW_OPS_PROCESS_TIMEOUT_US 1000
+
+void xenoflow_ops_entry_cb(struct doca_flow_pipe_entry *entry, uint16_t pipe_queue,
+			   enum doca_flow_entry_status status, enum doca_flow_entry_op op, void *user_ctx)
+{
+	XenoFlowEntryCtx *ctx = (XenoFlowEntryCtx *)user_ctx;
+	XenoFlowOp *xop;
+
+	(void)entry;
+	(void)pipe_queue;
+
+	/* Adds and updates complete an operation; aging notifications carry none, removals are not tracked */
+	if (ctx == NULL || (op != DOCA_FLOW_ENTRY_OP_ADD && op != DOCA_FLOW_ENTRY_OP_UPD))
+		return;
+
+	xop = ctx->op;
+	if (xop == NULL) {
+		DOCA_LOG_WARN("Completion of an entry with no operation in flight");
+		return;
+	}
+	/* An entry's own context must not outlive the op, the next op on the entry sets it again */
+	if (ctx != &xop->ctx)
+		ctx->op = NULL;
+
+	if (status != DOCA_FLOW_ENTRY_STATUS_SUCCESS)
+		xop->status.failure = true;
+	xop->status.nb_processed++;
+}
+
+XenoFlowOp *xenoflow_op_create(size_t size, xenoflow_op_submit_fn submit, xenoflow_op_done_fn done, void *arg,
+			       int detached)
+{
+	XenoFlowOp *op;
+
+	if (size < sizeof(XenoFlowOp))
+		size = sizeof(XenoFlowOp);
+
+	op = calloc(1, size);
+	if (op == NULL)
+		return NULL;
+
+	op->submit = submit;
+	op->done = done;
+	op->arg = arg;
+	op->detached = detached;
+	op->nb_entries = 1;
+	pthread_mutex_init(&op->lock, NULL);
+	pthread_cond_init(&op->cond, NULL);
+	return op;
+}
+
+void xenoflow_op_destroy(XenoFlowOp *op)
+{
+	if (op == NULL)
+		return;
+	pthread_mutex_destroy(&op->lock);
+	pthread_cond_destroy(&op->cond);
+	free(op);
+}
+
+doca_error_t xenoflow_op_wait(XenoFlowOp *op)
+{
+	doca_error_t result;
+
+	pthread_mutex_lock(&op->lock);
+	while (!op->completed)
+		pthread_cond_wait(&op->cond, &op->lock);
+	result = op->result;
+	pthread_mutex_unlock(&op->lock);
+	return result;
+}
+
+static void complete(XenoFlowOps *ops, XenoFlowOp *op, doca_error_t result)
+{
+	/* Failed submits leave no completion behind, the next op on the entry may go */
+	if (op->entry_ctx != NULL && op->entry_ctx->op == op)
+		op->entry_ctx->op = NULL;
+
+	op->result = result;
+	if (result == DOCA_SUCCESS)
+		ops->nb_completed++;
+	else
+		ops->nb_failed++;
+
+	if (op->done != NULL)
+		op->done(op, result);
+
+	if (op->detached) {
+		xenoflow_op_destroy(op);
+		return;
+	}
+
+	pthread_mutex_lock(&op->lock);
+	op->completed = 1;
+	pthread_cond_broadcast(&op->cond);
+	pthread_mutex_unlock(&op->lock);
+}
+
+/*
+ * Several operations waiting in one round means callers are bursting: widen
+ * the window so the next burst goes out in fewer, larger batches. A lone
+ * operation means a quiet control plane: shrink the window so it is not delayed.
+ */
+static void adapt_window(XenoFlowOps *ops, uint32_t batch_size)
+{
+	if (batch_size > 1) {
+		ops->window_us = ops->window_us ? ops->window_us * 2 : 10;
+		if (ops->window_us > XENOFLOW_OPS_WINDOW_MAX_US)
+			ops->window_us = XENOFLOW_OPS_WINDOW_MAX_US;
+	} else {
+		ops->window_us = ops->window_us / 2 > XENOFLOW_OPS_WINDOW_MIN_US ? ops->window_us / 2
+										  : XENOFLOW_OPS_WINDOW_MIN_US;
+	}
+}
+
+static void wait_for_batch(XenoFlowOps *ops)
+{
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += (long)ops->window_us * 1000;
+	if (deadline.tv_nsec >= 1000000000L) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	while (ops->running && ops->nb_pending < XENOFLOW_OPS_BATCH_MAX) {
+		if (pthread_cond_timedwait(&ops->cond, &ops->lock, &deadline) == ETIMEDOUT)
+			break;
+	}
+}
+
+static void reap(XenoFlowOps *ops)
+{
+	XenoFlowOp **link = &ops->inflight;
+
+	while (*link != NULL) {
+		XenoFlowOp *op = *link;
+
+		if (op->status.nb_processed < (int)op->nb_entries) {
+			link = &op->next;
+			continue;
+		}
+
+		*link = op->next;
+		ops->nb_inflight--;
+		complete(ops, op, op->status.failure ? DOCA_ERROR_DRIVER : DOCA_SUCCESS);
+	}
+}
+
+/*
+ * Take an op into the batch unless its entry has one in flight, or held back
+ * earlier in this batch; claiming the entry here keeps later ops on it out
+ */
+static int claim_entry(XenoFlowOps *ops, XenoFlowOp *op, XenoFlowOp ***held_tail)
+{
+	if (op->entry_ctx == NULL)
+		return 1;
+	if (op->entry_ctx->op == NULL) {
+		op->entry_ctx->op = op;
+		return 1;
+	}
+	op->next = NULL;
+	**held_tail = op;
+	*held_tail = &op->next;
+	ops->nb_held++;
+	return 0;
+}
+
+static void *poller_main(void *arg)
+{
+	XenoFlowOps *ops = (XenoFlowOps *)arg;
+	XenoFlowOp *batch[XENOFLOW_OPS_BATCH_MAX];
+
+	for (;;) {
+		XenoFlowOp *held, **held_tail = &ops->held;
+		uint32_t n = 0;
+		doca_error_t result;
+
+		pthread_mutex_lock(&ops->lock);
+		while (ops->running && ops->nb_pending == 0 && ops->nb_inflight == 0 && ops->nb_held == 0)
+			pthread_cond_wait(&ops->cond, &ops->lock);
+		if (!ops->running && ops->nb_pending == 0 && ops->nb_inflight == 0 && ops->nb_held == 0) {
+			pthread_mutex_unlock(&ops->lock);
+			break;
+		}
+
+		/* Nothing to reap, so give more submitters a chance to join this batch */
+		if (ops->nb_pending > 0 && ops->nb_inflight == 0 && ops->window_us > 0)
+			wait_for_batch(ops);
+
+		/* Held ops were queued first, they go before the new ones on the same entry */
+		held = ops->held;
+		ops->held = NULL;
+		ops->nb_held = 0;
+		while (held != NULL && n < XENOFLOW_OPS_BATCH_MAX) {
+			XenoFlowOp *op = held;
+
+			held = held->next;
+			if (claim_entry(ops, op, &held_tail))
+				batch[n++] = op;
+		}
+		while (ops->pending_head != NULL && n < XENOFLOW_OPS_BATCH_MAX) {
+			XenoFlowOp *op = ops->pending_head;
+
+			ops->pending_head = op->next;
+			ops->nb_pending--;
+			if (claim_entry(ops, op, &held_tail))
+				batch[n++] = op;
+		}
+		if (ops->pending_head == NULL)
+			ops->pending_tail = NULL;
+		/* A full batch leaves the rest of the held ops for the next round, still ahead of the new ones */
+		*held_tail = held;
+		for (; held != NULL; held = held->next)
+			ops->nb_held++;
+		pthread_mutex_unlock(&ops->lock);
+
+		for (uint32_t i = 0; i < n; i++) {
+			XenoFlowOp *op = batch[i];
+			uint32_t flags = i + 1 == n ? DOCA_FLOW_NO_WAIT : DOCA_FLOW_WAIT_FOR_BATCH;
+
+			op->next = NULL;
+			result = op->submit(op, ops->queue, flags);
+			if (result != DOCA_SUCCESS) {
+				complete(ops, op, result);
+				continue;
+			}
+			op->next = ops->inflight;
+			ops->inflight = op;
+			ops->nb_inflight++;
+		}
+		if (n > 0) {
+			xenoflow_evlog(XENOFLOW_EV_OPS_BATCH, n, ops->window_us, 0);
+			adapt_window(ops, n);
+			ops->nb_batches++;
+		}
+
+		if (ops->nb_inflight == 0)
+			continue;
+
+		result = doca_flow_entries_process(ops->port, ops->queue, XENOFLOW_OPS_PROCESS_TIMEOUT_US, 0);
+		if (result != DOCA_SUCCESS)
+			DOCA_LOG_WARN("Failed to process entries on queue %u: %s", ops->queue, doca_error_get_descr(result));
+		reap(ops);
+	}
+
+	return NULL;
+}
+
+doca_error_t xenoflow_ops_start(XenoFlowOps *ops, struct doca_flow_port *port, uint16_t queue)
+{
+	pthread_condattr_t attr;
+
+	memset(ops, 0, sizeof(*ops));
+	ops->port = port;
+	ops->queue = queue;
+	ops->running = 1;
+	ops->window_us = XENOFLOW_OPS_WINDOW_MIN_US;
+
+	pthread_mutex_init(&ops->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&ops->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (pthread_create(&ops->thread, NULL, poller_main, ops) != 0) {
+		DOCA_LOG_ERR("Failed to start the entry poller");
+		ops->running = 0;
+		return DOCA_ERROR_INITIALIZATION;
+	}
+
+	DOCA_LOG_INFO("Entry poller started on queue %u", queue);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_ops_stop(XenoFlowOps *ops)
+{
+	pthread_mutex_lock(&ops->lock);
+	if (!ops->running) {
+		pthread_mutex_unlock(&ops->lock);
+		return;
+	}
+	ops->running = 0;
+	pthread_cond_signal(&ops->cond);
+	pthread_mutex_unlock(&ops->lock);
+
+	pthread_join(ops->thread, NULL);
+	DOCA_LOG_INFO("Entry poller stopped: %lu completed, %lu failed in %lu batches",
+		      ops->nb_completed, ops->nb_failed, ops->nb_batches);
+}
+
+doca_error_t xenoflow_ops_submit(XenoFlowOps *ops, XenoFlowOp *op)
+{
+	pthread_mutex_lock(&ops->lock);
+	if (!ops->running) {
+		pthread_mutex_unlock(&ops->lock);
+		return DOCA_ERROR_SHUTDOWN;
+	}
+
+	op->queued_ns = xenoflow_evlog_on ? xenoflow_evlog_now() : 0;
+	op->next = NULL;
+	if (ops->pending_tail != NULL)
+		ops->pending_tail->next = op;
+	else
+		ops->pending_head = op;
+	ops->pending_tail = op;
+	ops->nb_pending++;
+
+	pthread_cond_signal(&ops->cond);
+	pthread_mutex_unlock(&ops->lock);
+	return DOCA_SUCCESS;
+}
@@ -0,0 +1,174 @@
+#ifndef OPS_H
+#define OPS_H
+
+#include <doca_flow.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "flow_common.h"
+
+/* Most operations pushed to hardware in one batch */
+#define XENOFLOW_OPS_BATCH_MAX 256
+
+/* Bounds of the adaptive coalescing window, microseconds */
+#define XENOFLOW_OPS_WINDOW_MIN_US 0
+#define XENOFLOW_OPS_WINDOW_MAX_US 200
+
+typedef struct XenoFlowOp XenoFlowOp;
+
+/**
+ * @brief usr_ctx of every entry added through an operation
+ *
+ * doca_flow_pipe_update_entry() takes no usr_ctx, its completion carries the
+ * one the entry was added with, long after that op was freed. An entry that is
+ * updated later is therefore added with a context that lives as long as the
+ * entry, and each op on it, add or update, points the context at itself first.
+ * Entries that are never updated use the op's own context.
+ *
+ * One context means one op in flight per entry: the poller holds back an op
+ * whose entry still has one in flight and submits it once that completed, in
+ * the order they were queued.
+ */
+typedef struct XenoFlowEntryCtx {
+	XenoFlowOp *op;			/* operation waiting for the entry's next completion */
+} XenoFlowEntryCtx;
+
+/**
+ * @brief Issue the DOCA Flow call of an operation on the poller's queue
+ *
+ * Must pass xenoflow_op_usr_ctx() as usr_ctx and &op->entry as the entry to the
+ * add call, with op->entry_ctx for the entry the op was queued for. A submit adding or updating several entries sets op->nb_entries,
+ * the op then completes once all of them did.
+ *
+ * @param op The operation
+ * @param queue Pipe queue owned by the poller
+ * @param flags DOCA_FLOW_WAIT_FOR_BATCH while more of the batch follows, DOCA_FLOW_NO_WAIT for the last
+ * @return DOCA_SUCCESS if the operation is in flight, error code otherwise
+ */
+typedef doca_error_t (*xenoflow_op_submit_fn)(XenoFlowOp *op, uint16_t queue, uint32_t flags);
+
+/**
+ * @brief Completion callback, runs on the poller thread
+ * @param op The operation, op->entry is set on success
+ * @param result DOCA_SUCCESS if hardware accepted the entry, error code otherwise
+ */
+typedef void (*xenoflow_op_done_fn)(XenoFlowOp *op, doca_error_t result);
+
+/**
+ * @brief One entry operation, queued by any thread and completed by the poller
+ *
+ * Detached operations are freed by the poller after their done callback;
+ * the others must be collected with xenoflow_op_wait() and xenoflow_op_destroy().
+ * Operations are usually embedded at the start of a larger struct carrying
+ * their arguments.
+ */
+struct XenoFlowOp {
+	struct entries_status status;	/* updated by the entry process callback */
+	XenoFlowEntryCtx ctx;		/* usr_ctx of the entries only this op adds */
+	XenoFlowEntryCtx *entry_ctx;	/* context of the long-lived entry it adds or updates, NULL for none */
+	xenoflow_op_submit_fn submit;
+	xenoflow_op_done_fn done;	/* may be NULL */
+	void *arg;			/* for the submit and done callbacks */
+	struct doca_flow_pipe_entry *entry;
+	uint32_t nb_entries;		/* completions to wait for, 1 unless submit says otherwise */
+	doca_error_t result;
+	uint64_t queued_ns;		/* xenoflow_evlog_now() at submit, 0 without an event log */
+	int detached;
+	int completed;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	XenoFlowOp *next;
+};
+
+/**
+ * @brief Operation queue and the poller thread that owns one pipe queue of a port
+ */
+typedef struct {
+	struct doca_flow_port *port;
+	uint16_t queue;
+	pthread_t thread;
+	int running;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	XenoFlowOp *pending_head;	/* submitted, not yet pushed to hardware */
+	XenoFlowOp *pending_tail;
+	uint32_t nb_pending;
+	XenoFlowOp *inflight;		/* pushed, waiting for completion */
+	uint32_t nb_inflight;
+	XenoFlowOp *held;		/* waiting for the op in flight on their entry, in queue order */
+	uint32_t nb_held;
+	uint32_t window_us;		/* current coalescing window */
+	uint64_t nb_completed;
+	uint64_t nb_failed;
+	uint64_t nb_batches;
+} XenoFlowOps;
+
+/**
+ * @brief Point an entry's context at an operation, called by submit before the DOCA Flow call
+ * @param op The operation
+ * @param entry_ctx Context owned with the entry, NULL for the op's own
+ * @return The usr_ctx to pass
+ */
+static inline void *xenoflow_op_usr_ctx(XenoFlowOp *op, XenoFlowEntryCtx *entry_ctx)
+{
+	if (entry_ctx == NULL)
+		entry_ctx = &op->ctx;
+	entry_ctx->op = op;
+	return entry_ctx;
+}
+
+/**
+ * @brief Entry process callback to register with DOCA Flow, usr_ctx must be a XenoFlowEntryCtx
+ */
+void xenoflow_ops_entry_cb(struct doca_flow_pipe_entry *entry, uint16_t pipe_queue,
+			   enum doca_flow_entry_status status, enum doca_flow_entry_op op, void *user_ctx);
+
+/**
+ * @brief Start the poller thread
+ * @param ops Operation queue
+ * @param port Port the entries are added on
+ * @param queue Pipe queue used by the poller, no one else may use it
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_ops_start(XenoFlowOps *ops, struct doca_flow_port *port, uint16_t queue);
+
+/**
+ * @brief Stop the poller after all queued and in-flight operations completed
+ * @param ops Operation queue
+ */
+void xenoflow_ops_stop(XenoFlowOps *ops);
+
+/**
+ * @brief Allocate an operation
+ * @param size Size of the struct embedding the op at offset 0, at least sizeof(XenoFlowOp)
+ * @param submit Issues the DOCA Flow call
+ * @param done Completion callback, may be NULL
+ * @param arg Passed to the callbacks through op->arg
+ * @param detached Free the op after done instead of waiting for xenoflow_op_wait()
+ * @return The op, NULL if out of memory
+ */
+XenoFlowOp *xenoflow_op_create(size_t size, xenoflow_op_submit_fn submit, xenoflow_op_done_fn done, void *arg,
+			       int detached);
+
+/**
+ * @brief Queue an operation, returns without waiting for hardware
+ * @param ops Operation queue
+ * @param op The operation, owned by the queue until it completes
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_SHUTDOWN if the poller is stopped
+ */
+doca_error_t xenoflow_ops_submit(XenoFlowOps *ops, XenoFlowOp *op);
+
+/**
+ * @brief Block until a non-detached operation completed
+ * @param op The operation
+ * @return Result of the operation
+ */
+doca_error_t xenoflow_op_wait(XenoFlowOp *op);
+
+/**
+ * @brief Free a completed, non-detached operation
+ * @param op The operation, may be NULL
+ */
+void xenoflow_op_destroy(XenoFlowOp *op);
+
+#endif /* OPS_H */
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rebalance.h"
+
+int xenoflow_rebalance_init(XenoFlowRebalancer *rb, uint32_t nb_buckets)
+{
+	memset(rb, 0, sizeof(*rb));
+	rb->nb_buckets = nb_buckets;
+	rb->last_bytes = calloc(nb_buckets, sizeof(uint64_t));
+	rb->delta = calloc(nb_buckets, sizeof(uint64_t));
+	rb->cooldown = calloc(nb_buckets, sizeof(uint8_t));
+	rb->owner = calloc(nb_buckets, sizeof(uint32_t));
+	rb->fixed = calloc(nb_buckets, sizeof(uint8_t));
+	rb->load = calloc(nb_buckets, sizeof(uint64_t));
+	rb->spread = 1.0;
+	if (rb->last_bytes == NULL || rb->delta == NULL || rb->cooldown == NULL || rb->owner == NULL ||
+	    rb->fixed == NULL || rb->load == NULL) {
+		xenoflow_rebalance_destroy(rb);
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Bucket of hi whose move to lo narrows their gap the most: the one closest
+ * to half the gap, smaller than the gap so lo does not end up above hi
+ */
+static uint32_t pick_bucket(const XenoFlowRebalancer *rb, uint32_t hi, uint64_t gap)
+{
+	uint32_t best = UINT32_MAX;
+	uint64_t best_dist = UINT64_MAX;
+
+	for (uint32_t i = 0; i < rb->nb_buckets; i++) {
+		uint64_t d = rb->delta[i], dist;
+
+		if (rb->owner[i] != hi || rb->fixed[i] || rb->cooldown[i] != 0 || d == 0 || d >= gap)
+			continue;
+		dist = 2 * d > gap ? 2 * d - gap : gap - 2 * d;
+		if (dist < best_dist) {
+			best = i;
+			best_dist = dist;
+		}
+	}
+	return best;
+}
+
+uint32_t xenoflow_rebalance_plan(XenoFlowRebalancer *rb, const uint64_t *bytes, uint32_t nb_owners,
+				 uint32_t threshold_pct, uint32_t max_moves, XenoFlowBucketMove *moves)
+{
+	double mean, band = threshold_pct / 100.0;
+	uint64_t total = 0;
+	uint32_t nb = 0, hi = 0, lo = 0;
+
+	for (uint32_t i = 0; i < rb->nb_buckets; i++) {
+		/* A counter that went backwards was reset, its round is lost */
+		rb->delta[i] = rb->primed && bytes[i] >= rb->last_bytes[i] ? bytes[i] - rb->last_bytes[i] : 0;
+		rb->last_bytes[i] = bytes[i];
+		if (rb->cooldown[i] != 0)
+			rb->cooldown[i]--;
+	}
+	if (!rb->primed) {
+		rb->primed = 1;
+		return 0;
+	}
+	rb->nb_rounds++;
+	if (nb_owners < 2)
+		return 0;
+
+	memset(rb->load, 0, nb_owners * sizeof(uint64_t));
+	for (uint32_t i = 0; i < rb->nb_buckets; i++) {
+		if (rb->owner[i] == XENOFLOW_REBALANCE_PINNED)
+			continue;
+		rb->load[rb->owner[i]] += rb->delta[i];
+		total += rb->delta[i];
+	}
+	if (total < (uint64_t)XENOFLOW_REBALANCE_MIN_BYTES * nb_owners)
+		return 0;
+	mean = (double)total / nb_owners;
+
+	for (;;) {
+		uint32_t bucket;
+
+		for (uint32_t o = 0; o < nb_owners; o++) {
+			if (rb->load[o] > rb->load[hi])
+				hi = o;
+			if (rb->load[o] < rb->load[lo])
+				lo = o;
+		}
+		if (nb == max_moves || (rb->load[hi] <= mean * (1 + band) && rb->load[lo] >= mean * (1 - band)))
+			break;
+
+		bucket = pick_bucket(rb, hi, rb->load[hi] - rb->load[lo]);
+		if (bucket == UINT32_MAX)
+			break;
+
+		rb->owner[bucket] = lo;
+		rb->load[hi] -= rb->delta[bucket];
+		rb->load[lo] += rb->delta[bucket];
+		/* Counted down at the start of each round, so it sits out the next COOLDOWN rounds */
+		rb->cooldown[bucket] = XENOFLOW_REBALANCE_COOLDOWN_ROUNDS + 1;
+		moves[nb].bucket = bucket;
+		moves[nb].from = hi;
+		moves[nb].to = lo;
+		nb++;
+	}
+
+	rb->spread = rb->load[hi] / mean;
+	rb->nb_moves += nb;
+	return nb;
+}
+
+void xenoflow_rebalance_destroy(XenoFlowRebalancer *rb)
+{
+	free(rb->last_bytes);
+	free(rb->delta);
+	free(rb->cooldown);
+	free(rb->owner);
+	free(rb->fixed);
+	free(rb->load);
+	memset(rb, 0, sizeof(*rb));
+}
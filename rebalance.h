@@ -0,0 +1,83 @@
+#ifndef REBALANCE_H
+#define REBALANCE_H
+
+#include <stdint.h>
+
+/*
+ * Load-aware rebalancing of hash buckets. A service with "buckets" has many
+ * more hash entries than backends; every round the bytes each bucket saw since
+ * the round before are summed per backend, and while the busiest backend is
+ * more than threshold percent above the mean, or the idlest as far below, single
+ * buckets move from the busiest to the idlest backend. Only moves that narrow
+ * the gap between the two are made, at most max_moves per round, and a moved
+ * bucket stays put for a few rounds so noise cannot make it flap.
+ */
+
+/* Rounds a moved bucket is not moved again */
+#define XENOFLOW_REBALANCE_COOLDOWN_ROUNDS 3
+
+/* Rounds with less traffic than this per backend are left alone, bytes */
+#define XENOFLOW_REBALANCE_MIN_BYTES 65536
+
+/* Owner of a bucket outside rebalancing, e.g. the host entry's */
+#define XENOFLOW_REBALANCE_PINNED UINT32_MAX
+
+/**
+ * @brief Rebalancing state of one service
+ */
+typedef struct {
+	uint32_t nb_buckets;
+	int primed;			/* last_bytes holds a previous round */
+	uint64_t *last_bytes;		/* byte counter of each bucket at the previous round */
+	uint64_t *delta;		/* bytes of each bucket in the current round */
+	uint8_t *cooldown;		/* rounds before a bucket may move again */
+	uint32_t *owner;		/* owner of each bucket for the planner, filled by the caller */
+	uint8_t *fixed;			/* buckets that count for their owner but never move, filled by the caller */
+	uint64_t *load;			/* bytes per owner in the current round */
+	uint64_t nb_moves;		/* buckets moved since start */
+	uint32_t nb_rounds;
+	double spread;			/* busiest over mean load after the last round, 1.0 is balanced */
+} XenoFlowRebalancer;
+
+/**
+ * @brief One bucket to move
+ */
+typedef struct {
+	uint32_t bucket;
+	uint32_t from;			/* owner indexes as in XenoFlowRebalancer.owner */
+	uint32_t to;
+} XenoFlowBucketMove;
+
+/**
+ * @brief Allocate the state of one service
+ * @param rb Rebalancer
+ * @param nb_buckets Hash entries of the service, also the most owners there can be
+ * @return 0 on success, -1 if out of memory
+ */
+int xenoflow_rebalance_init(XenoFlowRebalancer *rb, uint32_t nb_buckets);
+
+/**
+ * @brief Plan one round
+ *
+ * Before the call rb->owner[i] must hold the owner of bucket i, an index below
+ * nb_owners, or XENOFLOW_REBALANCE_PINNED, and rb->fixed[i] whether it may move.
+ * Owners are updated for the moves made.
+ *
+ * @param rb Rebalancer
+ * @param bytes Byte counter of each bucket, cumulative
+ * @param nb_owners Backends buckets may move between
+ * @param threshold_pct Load band around the mean that counts as balanced, in percent
+ * @param max_moves Most buckets to move, the size of moves
+ * @param moves Moves to apply
+ * @return Number of moves
+ */
+uint32_t xenoflow_rebalance_plan(XenoFlowRebalancer *rb, const uint64_t *bytes, uint32_t nb_owners,
+				 uint32_t threshold_pct, uint32_t max_moves, XenoFlowBucketMove *moves);
+
+/**
+ * @brief Free the state of one service
+ * @param rb Rebalancer
+ */
+void xenoflow_rebalance_destroy(XenoFlowRebalancer *rb);
+
+#endif /* REBALANCE_H */
@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "registry.h"
+
+#define XENOFLOW_INDEX_TOMBSTONE ((void *)1)
+#define XENOFLOW_INDEX_MIN_CAPACITY 16
+
+static const void *item_key(const XenoFlowIndex *index, const void *item)
+{
+	return (const char *)item + index->key_offset;
+}
+
+static int key_equal(const XenoFlowIndex *index, const void *a, const void *b)
+{
+	if (index->key_len == 0)
+		return strcmp(a, b) == 0;
+	return memcmp(a, b, index->key_len) == 0;
+}
+
+/* FNV-1a, good enough for names and MAC addresses */
+static uint32_t key_hash(const XenoFlowIndex *index, const void *key)
+{
+	const uint8_t *p = key;
+	uint32_t h = 2166136261u;
+
+	if (index->key_len == 0) {
+		for (; *p != '\0'; p++)
+			h = (h ^ *p) * 16777619u;
+	} else {
+		for (size_t i = 0; i < index->key_len; i++)
+			h = (h ^ p[i]) * 16777619u;
+	}
+	return h;
+}
+
+void xenoflow_index_init(XenoFlowIndex *index, size_t key_offset, size_t key_len)
+{
+	memset(index, 0, sizeof(*index));
+	index->key_offset = key_offset;
+	index->key_len = key_len;
+}
+
+void xenoflow_index_destroy(XenoFlowIndex *index)
+{
+	free(index->slots);
+	index->slots = NULL;
+	index->capacity = 0;
+	index->count = 0;
+	index->tombstones = 0;
+}
+
+/*
+ * Slot holding key, or -1. With insert_pos set, also returns the first free slot
+ * on the probe path, where the key would be inserted.
+ */
+static int64_t probe(const XenoFlowIndex *index, const void *key, int64_t *insert_pos)
+{
+	uint32_t mask = index->capacity - 1;
+	uint32_t pos = key_hash(index, key) & mask;
+	int64_t first_free = -1;
+
+	for (uint32_t n = 0; n < index->capacity; n++, pos = (pos + 1) & mask) {
+		void *slot = index->slots[pos];
+
+		if (slot == NULL) {
+			if (first_free < 0)
+				first_free = pos;
+			break;
+		}
+		if (slot == XENOFLOW_INDEX_TOMBSTONE) {
+			if (first_free < 0)
+				first_free = pos;
+			continue;
+		}
+		if (key_equal(index, item_key(index, slot), key))
+			return pos;
+	}
+
+	if (insert_pos != NULL)
+		*insert_pos = first_free;
+	return -1;
+}
+
+static int resize(XenoFlowIndex *index, uint32_t capacity)
+{
+	void **old_slots = index->slots;
+	uint32_t old_capacity = index->capacity;
+
+	index->slots = calloc(capacity, sizeof(void *));
+	if (index->slots == NULL) {
+		index->slots = old_slots;
+		return -1;
+	}
+	index->capacity = capacity;
+	index->count = 0;
+	index->tombstones = 0;
+
+	for (uint32_t i = 0; i < old_capacity; i++) {
+		int64_t pos;
+
+		if (old_slots[i] == NULL || old_slots[i] == XENOFLOW_INDEX_TOMBSTONE)
+			continue;
+		probe(index, item_key(index, old_slots[i]), &pos);
+		index->slots[pos] = old_slots[i];
+		index->count++;
+	}
+	free(old_slots);
+	return 0;
+}
+
+int xenoflow_index_insert(XenoFlowIndex *index, void *item)
+{
+	const void *key = item_key(index, item);
+	int64_t pos;
+
+	if (index->capacity == 0) {
+		if (resize(index, XENOFLOW_INDEX_MIN_CAPACITY) != 0)
+			return -1;
+	} else if ((uint64_t)(index->count + index->tombstones + 1) * 4 > (uint64_t)index->capacity * 3) {
+		/* Rehash in place if most of the load is tombstones, grow otherwise */
+		uint32_t capacity = index->count * 2 >= index->capacity ? index->capacity * 2 : index->capacity;
+
+		if (resize(index, capacity) != 0)
+			return -1;
+	}
+
+	if (probe(index, key, &pos) >= 0)
+		return -1;
+
+	if (index->slots[pos] == XENOFLOW_INDEX_TOMBSTONE)
+		index->tombstones--;
+	index->slots[pos] = item;
+	index->count++;
+	return 0;
+}
+
+void *xenoflow_index_find(const XenoFlowIndex *index, const void *key)
+{
+	int64_t pos;
+
+	if (index->count == 0)
+		return NULL;
+	pos = probe(index, key, NULL);
+	return pos >= 0 ? index->slots[pos] : NULL;
+}
+
+int xenoflow_index_remove(XenoFlowIndex *index, void *item)
+{
+	int64_t pos;
+
+	if (index->count == 0)
+		return -1;
+	pos = probe(index, item_key(index, item), NULL);
+	if (pos < 0 || index->slots[pos] != item)
+		return -1;
+
+	index->slots[pos] = XENOFLOW_INDEX_TOMBSTONE;
+	index->count--;
+	index->tombstones++;
+	return 0;
+}
+
+void xenoflow_slab_init(XenoFlowSlab *slab, size_t obj_size, uint32_t objs_per_chunk)
+{
+	memset(slab, 0, sizeof(*slab));
+	slab->obj_size = obj_size < sizeof(void *) ? sizeof(void *) : obj_size;
+	slab->objs_per_chunk = objs_per_chunk;
+	slab->next_in_chunk = objs_per_chunk;
+	pthread_mutex_init(&slab->lock, NULL);
+}
+
+void *xenoflow_slab_alloc(XenoFlowSlab *slab)
+{
+	void *obj = NULL;
+
+	pthread_mutex_lock(&slab->lock);
+
+	if (slab->free_list != NULL) {
+		obj = slab->free_list;
+		slab->free_list = *(void **)obj;
+		goto out;
+	}
+
+	if (slab->next_in_chunk == slab->objs_per_chunk) {
+		void *chunk;
+
+		if (slab->nb_chunks == slab->chunks_capacity) {
+			uint32_t capacity = slab->chunks_capacity ? slab->chunks_capacity * 2 : 8;
+			void **chunks = realloc(slab->chunks, capacity * sizeof(void *));
+
+			if (chunks == NULL)
+				goto out;
+			slab->chunks = chunks;
+			slab->chunks_capacity = capacity;
+		}
+
+		chunk = malloc(slab->obj_size * slab->objs_per_chunk);
+		if (chunk == NULL)
+			goto out;
+		slab->chunks[slab->nb_chunks++] = chunk;
+		slab->next_in_chunk = 0;
+	}
+
+	obj = (char *)slab->chunks[slab->nb_chunks - 1] + slab->obj_size * slab->next_in_chunk++;
+
+out:
+	if (obj != NULL) {
+		slab->in_use++;
+		memset(obj, 0, slab->obj_size);
+	}
+	pthread_mutex_unlock(&slab->lock);
+	return obj;
+}
+
+void xenoflow_slab_free(XenoFlowSlab *slab, void *obj)
+{
+	if (obj == NULL)
+		return;
+
+	pthread_mutex_lock(&slab->lock);
+	*(void **)obj = slab->free_list;
+	slab->free_list = obj;
+	slab->in_use--;
+	pthread_mutex_unlock(&slab->lock);
+}
@@ -0,0 +1,103 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Open-addressing hash index from a key embedded in an item to the item
+ *
+ * The index does not own its items. Keys are either NUL-terminated strings
+ * (key_len 0) or fixed-size byte strings of key_len bytes, found at key_offset
+ * inside the item. Lookups, inserts and removals are O(1) on average; the
+ * table doubles when it gets 3/4 full, counting removed slots.
+ */
+typedef struct {
+	void **slots;		/* NULL = empty, XENOFLOW_INDEX_TOMBSTONE = removed */
+	uint32_t capacity;	/* power of two, 0 until the first insert */
+	uint32_t count;		/* live items */
+	uint32_t tombstones;	/* removed slots not yet reused */
+	size_t key_offset;	/* offset of the key inside an item */
+	size_t key_len;		/* key length in bytes, 0 for strings */
+} XenoFlowIndex;
+
+/**
+ * @brief Fixed-size object allocator handing out objects from chunks
+ *
+ * Objects are never returned to the system, freed objects go to a free list
+ * and are reused first. Safe to use from several threads.
+ */
+typedef struct {
+	size_t obj_size;	 /* at least sizeof(void *) */
+	uint32_t objs_per_chunk;
+	void **chunks;
+	uint32_t nb_chunks;
+	uint32_t chunks_capacity;
+	uint32_t next_in_chunk;	 /* first never-used object of the last chunk */
+	void *free_list;	 /* freed objects, linked through their first word */
+	uint32_t in_use;
+	pthread_mutex_t lock;
+} XenoFlowSlab;
+
+/**
+ * @brief Initialize an empty index
+ * @param index Index to initialize
+ * @param key_offset offsetof() the key in the indexed struct
+ * @param key_len Key length in bytes, 0 for NUL-terminated strings
+ */
+void xenoflow_index_init(XenoFlowIndex *index, size_t key_offset, size_t key_len);
+
+/**
+ * @brief Free the slot table, the items are left alone
+ * @param index The index
+ */
+void xenoflow_index_destroy(XenoFlowIndex *index);
+
+/**
+ * @brief Add an item
+ * @param index The index
+ * @param item Item to add, its key must not be in the index yet
+ * @return 0 on success, -1 if the key exists or the table cannot grow
+ */
+int xenoflow_index_insert(XenoFlowIndex *index, void *item);
+
+/**
+ * @brief Look up an item by key
+ * @param index The index
+ * @param key Key to look for, a string or key_len bytes
+ * @return The item, NULL if there is none
+ */
+void *xenoflow_index_find(const XenoFlowIndex *index, const void *key);
+
+/**
+ * @brief Remove an item
+ * @param index The index
+ * @param item Item to remove
+ * @return 0 on success, -1 if the item is not in the index
+ */
+int xenoflow_index_remove(XenoFlowIndex *index, void *item);
+
+/**
+ * @brief Initialize a slab
+ * @param slab Slab to initialize
+ * @param obj_size Object size in bytes
+ * @param objs_per_chunk Objects allocated at once when the slab runs empty
+ */
+void xenoflow_slab_init(XenoFlowSlab *slab, size_t obj_size, uint32_t objs_per_chunk);
+
+/**
+ * @brief Get a zeroed object
+ * @param slab The slab
+ * @return The object, NULL if out of memory
+ */
+void *xenoflow_slab_alloc(XenoFlowSlab *slab);
+
+/**
+ * @brief Give an object back to the slab
+ * @param slab The slab
+ * @param obj Object from xenoflow_slab_alloc(), may be NULL
+ */
+void xenoflow_slab_free(XenoFlowSlab *slab, void *obj);
+
+#endif /* REGISTRY_H */
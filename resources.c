@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <doca_log.h>
+
+#include "resources.h"
+
+DOCA_LOG_REGISTER(RESOURCES);
+
+void xenoflow_resources_init(XenoFlowResources *res, uint32_t nr_counters, uint32_t action_mem_size)
+{
+	res->nr_counters = nr_counters;
+	res->action_mem_size = action_mem_size;
+}
+
+doca_error_t xenoflow_resources_add_pipe(XenoFlowResources *res, const char *name, struct doca_flow_pipe *pipe,
+					 uint32_t nr_entries, int has_counters, int has_actions, int *slot)
+{
+	XenoFlowPipeResources *p;
+
+	if (res->numPipes == res->maxPipes) {
+		int max = res->maxPipes ? res->maxPipes * 2 : 8;
+		XenoFlowPipeResources *pipes = realloc(res->pipes, max * sizeof(*pipes));
+
+		if (pipes == NULL) {
+			DOCA_LOG_ERR("Cannot track pipe %s: out of memory", name);
+			return DOCA_ERROR_NO_MEMORY;
+		}
+		res->pipes = pipes;
+		res->maxPipes = max;
+	}
+
+	*slot = res->numPipes;
+	p = &res->pipes[res->numPipes++];
+	memset(p, 0, sizeof(*p));
+	snprintf(p->name, sizeof(p->name), "%s", name);
+	p->pipe = pipe;
+	p->nr_entries = nr_entries;
+	p->has_counters = has_counters;
+	p->has_actions = has_actions;
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_resources_account_entry(XenoFlowResources *res, int slot, int delta)
+{
+	XenoFlowPipeResources *p = &res->pipes[slot];
+
+	p->used_entries += delta;
+	if (p->has_counters)
+		p->used_counters += delta;
+	if (p->has_actions)
+		p->used_action_mem += delta * XENOFLOW_ENTRY_ACTION_MEM;
+}
+
+uint32_t xenoflow_resources_used_counters(const XenoFlowResources *res)
+{
+	uint32_t used = 0;
+
+	for (int i = 0; i < res->numPipes; i++)
+		used += res->pipes[i].used_counters;
+	return used;
+}
+
+uint32_t xenoflow_resources_used_action_mem(const XenoFlowResources *res)
+{
+	uint32_t used = 0;
+
+	for (int i = 0; i < res->numPipes; i++)
+		used += res->pipes[i].used_action_mem;
+	return used;
+}
+
+static void report_line(const char *what, uint32_t used, uint32_t total)
+{
+	double ratio = total ? (double)used / total : 0;
+
+	if (ratio >= XENOFLOW_RESOURCE_WARN_RATIO)
+		DOCA_LOG_WARN("  %-14s %u / %u used (%.1f%%), %u left - close to the limit", what, used, total,
+			      ratio * 100, total > used ? total - used : 0);
+	else
+		DOCA_LOG_INFO("  %-14s %u / %u used (%.1f%%), %u left", what, used, total, ratio * 100,
+			      total > used ? total - used : 0);
+}
+
+void xenoflow_resources_report(const XenoFlowResources *res)
+{
+	DOCA_LOG_INFO("Hardware resource usage:");
+	report_line("counters", xenoflow_resources_used_counters(res), res->nr_counters);
+	report_line("action mem [B]", xenoflow_resources_used_action_mem(res), res->action_mem_size);
+	for (int i = 0; i < res->numPipes; i++) {
+		const XenoFlowPipeResources *p = &res->pipes[i];
+
+		DOCA_LOG_INFO(" Pipe %s:", p->name);
+		report_line("entries", p->used_entries, p->nr_entries);
+		if (p->has_counters)
+			DOCA_LOG_INFO("  %-14s %u", "counters", p->used_counters);
+		if (p->has_actions)
+			DOCA_LOG_INFO("  %-14s %u", "action mem [B]", p->used_action_mem);
+	}
+}
@@ -0,0 +1,94 @@
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <doca_flow.h>
+#include <stdint.h>
+
+/* Usage ratio above which the startup report and the API flag a resource as nearly exhausted */
+#define XENOFLOW_RESOURCE_WARN_RATIO 0.9
+
+/**
+ * @brief Configured capacity and current usage of one pipe
+ */
+typedef struct {
+	char name[32];
+	struct doca_flow_pipe *pipe;
+	uint32_t nr_entries;	  /* table size the pipe was created with */
+	uint32_t used_entries;	  /* entries installed or queued */
+	uint32_t used_counters;	  /* installed entries that carry a counter */
+	uint32_t used_action_mem; /* action memory held by installed entries, bytes */
+	int has_counters;	  /* entries of this pipe get a counter */
+	int has_actions;	  /* entries of this pipe consume action memory */
+} XenoFlowPipeResources;
+
+/**
+ * @brief Hardware resources reserved at init and how much of them is in use
+ */
+typedef struct {
+	uint32_t nr_counters;	  /* counters reserved in DOCA Flow (resource.nr_counters) */
+	uint32_t action_mem_size; /* action memory reserved per port, bytes */
+	int numPipes;
+	int maxPipes;
+	XenoFlowPipeResources *pipes;
+} XenoFlowResources;
+
+/**
+ * @brief Action memory one entry with modify actions takes out of the port's action memory
+ */
+#define XENOFLOW_ENTRY_ACTION_MEM DOCA_FLOW_MAX_ENTRY_ACTIONS_MEM_SIZE
+
+/**
+ * @brief Record the resources reserved at DOCA Flow/port init
+ * @param res Resource table
+ * @param nr_counters Counters reserved in DOCA Flow
+ * @param action_mem_size Action memory reserved per port in bytes
+ */
+void xenoflow_resources_init(XenoFlowResources *res, uint32_t nr_counters, uint32_t action_mem_size);
+
+/**
+ * @brief Register a pipe so its entries are accounted for
+ * @param res Resource table
+ * @param name Pipe name used in reports
+ * @param pipe The pipe
+ * @param nr_entries Table size the pipe was created with
+ * @param has_counters Whether entries of this pipe carry a counter
+ * @param has_actions Whether entries of this pipe consume action memory
+ * @param slot Index of the pipe in the table, what xenoflow_resources_account_entry() takes
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NO_MEMORY otherwise
+ */
+doca_error_t xenoflow_resources_add_pipe(XenoFlowResources *res, const char *name, struct doca_flow_pipe *pipe,
+					 uint32_t nr_entries, int has_counters, int has_actions, int *slot);
+
+/**
+ * @brief Account for an entry queued to (delta = 1) or gone from (delta = -1) a pipe
+ *
+ * An entry counts from the moment it is queued, so failed adds, rolled back
+ * entries and removals must give it back.
+ *
+ * @param res Resource table
+ * @param slot Index of the pipe from xenoflow_resources_add_pipe()
+ * @param delta +1 or -1
+ */
+void xenoflow_resources_account_entry(XenoFlowResources *res, int slot, int delta);
+
+/**
+ * @brief Counters in use across all pipes
+ * @param res Resource table
+ * @return Number of counters in use
+ */
+uint32_t xenoflow_resources_used_counters(const XenoFlowResources *res);
+
+/**
+ * @brief Action memory in use across all pipes
+ * @param res Resource table
+ * @return Bytes of action memory in use
+ */
+uint32_t xenoflow_resources_used_action_mem(const XenoFlowResources *res);
+
+/**
+ * @brief Log configured vs used entries, counters and action memory per pipe
+ * @param res Resource table
+ */
+void xenoflow_resources_report(const XenoFlowResources *res);
+
+#endif /* RESOURCES_H */
@@ -0,0 +1,348 @@
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_jhash.h>
+#include <rte_mbuf.h>
+
+#include <doca_log.h>
+
+#include "sampler.h"
+
+DOCA_LOG_REGISTER(SAMPLER);
+
+#define SAMPLER_BURST 32
+
+/* Sleep of the sampler thread when the queue was empty, samples are rare by design */
+#define SAMPLER_IDLE_SLEEP_US 200
+
+#define NO_FLOW UINT32_MAX
+
+typedef struct {
+	uint32_t src_ip;
+	uint32_t dst_ip;
+	uint16_t src_port;
+	uint16_t dst_port;
+	uint8_t protocol;
+} FlowKey;
+
+struct XenoFlowFlow {
+	FlowKey key;
+	uint32_t next;		/* chain of the bucket, or of the free list */
+	uint64_t packets;	/* samples, scaled by the rate on export */
+	uint64_t bytes;
+	uint64_t start_ms;
+	uint64_t end_ms;
+};
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint32_t flow_hash(const FlowKey *key)
+{
+	return rte_jhash_3words(key->src_ip, key->dst_ip, (uint32_t)key->src_port << 16 | key->dst_port,
+				key->protocol) &
+	       (XENOFLOW_FLOW_CACHE_SIZE - 1);
+}
+
+static int cache_init(XenoFlowFlowCache *cache)
+{
+	cache->buckets = malloc(XENOFLOW_FLOW_CACHE_SIZE * sizeof(uint32_t));
+	cache->flows = calloc(XENOFLOW_FLOW_CACHE_SIZE, sizeof(XenoFlowFlow));
+	if (cache->buckets == NULL || cache->flows == NULL) {
+		free(cache->buckets);
+		free(cache->flows);
+		return -1;
+	}
+
+	for (uint32_t i = 0; i < XENOFLOW_FLOW_CACHE_SIZE; i++) {
+		cache->buckets[i] = NO_FLOW;
+		cache->flows[i].next = i + 1 < XENOFLOW_FLOW_CACHE_SIZE ? i + 1 : NO_FLOW;
+	}
+	cache->free_list = 0;
+	cache->nb_active = 0;
+	return 0;
+}
+
+static void export_flow(XenoFlowSampler *sampler, const XenoFlowFlow *flow, uint64_t now)
+{
+	XenoFlowIpfixRecord record = {
+		.src_ip = flow->key.src_ip,
+		.dst_ip = flow->key.dst_ip,
+		.src_port = flow->key.src_port,
+		.dst_port = flow->key.dst_port,
+		.protocol = flow->key.protocol,
+		.packets = flow->packets * sampler->rate,
+		.bytes = flow->bytes * sampler->rate,
+		.start_ms = flow->start_ms,
+		.end_ms = flow->end_ms,
+	};
+
+	xenoflow_ipfix_add(&sampler->ipfix, &record, now);
+	atomic_fetch_add_explicit(&sampler->nb_flows, 1, memory_order_relaxed);
+}
+
+/*
+ * Export and free the flows that are idle or active for too long, all of them with force
+ */
+static void cache_expire(XenoFlowSampler *sampler, uint64_t now, int force)
+{
+	XenoFlowFlowCache *cache = &sampler->cache;
+
+	for (uint32_t b = 0; b < XENOFLOW_FLOW_CACHE_SIZE && cache->nb_active > 0; b++) {
+		uint32_t *link = &cache->buckets[b];
+
+		while (*link != NO_FLOW) {
+			uint32_t idx = *link;
+			XenoFlowFlow *flow = &cache->flows[idx];
+
+			if (!force && now - flow->end_ms < XENOFLOW_FLOW_IDLE_TIMEOUT_MS &&
+			    now - flow->start_ms < XENOFLOW_FLOW_ACTIVE_TIMEOUT_MS) {
+				link = &flow->next;
+				continue;
+			}
+
+			export_flow(sampler, flow, now);
+			*link = flow->next;
+			flow->next = cache->free_list;
+			cache->free_list = idx;
+			cache->nb_active--;
+		}
+	}
+	xenoflow_ipfix_flush(&sampler->ipfix, now);
+}
+
+static void cache_add(XenoFlowSampler *sampler, const FlowKey *key, uint32_t bytes, uint64_t now)
+{
+	XenoFlowFlowCache *cache = &sampler->cache;
+	uint32_t bucket = flow_hash(key);
+	XenoFlowFlow *flow;
+	uint32_t idx;
+
+	for (idx = cache->buckets[bucket]; idx != NO_FLOW; idx = flow->next) {
+		flow = &cache->flows[idx];
+		if (memcmp(&flow->key, key, sizeof(*key)) == 0) {
+			flow->packets++;
+			flow->bytes += bytes;
+			flow->end_ms = now;
+			return;
+		}
+	}
+
+	/* Full: export everything early rather than lose samples */
+	if (cache->free_list == NO_FLOW) {
+		atomic_fetch_add_explicit(&sampler->nb_evictions, cache->nb_active, memory_order_relaxed);
+		cache_expire(sampler, now, 1);
+	}
+
+	idx = cache->free_list;
+	flow = &cache->flows[idx];
+	cache->free_list = flow->next;
+
+	flow->key = *key;
+	flow->packets = 1;
+	flow->bytes = bytes;
+	flow->start_ms = now;
+	flow->end_ms = now;
+	flow->next = cache->buckets[bucket];
+	cache->buckets[bucket] = idx;
+	cache->nb_active++;
+}
+
+/*
+ * 5-tuple and IP length of a sampled packet, -1 if it is not IPv4
+ */
+static int parse_sample(struct rte_mbuf *m, FlowKey *key, uint32_t *bytes)
+{
+	struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	struct rte_ipv4_hdr *ip;
+	uint32_t ihl;
+
+	if (m->data_len < sizeof(*eth) + sizeof(*ip) || eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))
+		return -1;
+
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * 4;
+
+	memset(key, 0, sizeof(*key));
+	key->src_ip = ip->src_addr;
+	key->dst_ip = ip->dst_addr;
+	key->protocol = ip->next_proto_id;
+	*bytes = rte_be_to_cpu_16(ip->total_length);
+
+	/* Ports are only in the first fragment */
+	if ((key->protocol == IPPROTO_TCP || key->protocol == IPPROTO_UDP) &&
+	    (rte_be_to_cpu_16(ip->fragment_offset) & RTE_IPV4_HDR_OFFSET_MASK) == 0 &&
+	    m->data_len >= sizeof(*eth) + ihl + 4) {
+		const uint16_t *ports = (const uint16_t *)((const uint8_t *)ip + ihl);
+
+		key->src_port = rte_be_to_cpu_16(ports[0]);
+		key->dst_port = rte_be_to_cpu_16(ports[1]);
+	}
+	return 0;
+}
+
+static void *sampler_main(void *arg)
+{
+	XenoFlowSampler *sampler = (XenoFlowSampler *)arg;
+	struct timespec idle = {.tv_sec = 0, .tv_nsec = SAMPLER_IDLE_SLEEP_US * 1000L};
+	struct rte_mbuf *pkts[SAMPLER_BURST];
+	uint64_t next_expiry = now_ms() + XENOFLOW_FLOW_EXPIRY_INTERVAL_MS;
+
+	while (sampler->running) {
+		uint16_t nb = rte_eth_rx_burst(sampler->port_id, sampler->queue, pkts, SAMPLER_BURST);
+		uint64_t now = now_ms();
+
+		for (uint16_t i = 0; i < nb; i++) {
+			FlowKey key;
+			uint32_t bytes;
+
+			if (parse_sample(pkts[i], &key, &bytes) == 0)
+				cache_add(sampler, &key, bytes, now);
+		}
+		if (nb > 0) {
+			rte_pktmbuf_free_bulk(pkts, nb);
+			atomic_fetch_add_explicit(&sampler->nb_samples, nb, memory_order_relaxed);
+		}
+
+		if (now >= next_expiry) {
+			cache_expire(sampler, now, 0);
+			next_expiry = now + XENOFLOW_FLOW_EXPIRY_INTERVAL_MS;
+		}
+		if (nb == 0)
+			nanosleep(&idle, NULL);
+	}
+	return NULL;
+}
+
+doca_error_t xenoflow_sampler_init(XenoFlowSampler *sampler, uint32_t rate, const char *collector, uint16_t port_id,
+				   uint16_t queue)
+{
+	uint32_t rounded = 1;
+
+	memset(sampler, 0, sizeof(*sampler));
+	if (rate == 0)
+		return DOCA_SUCCESS;
+	if (collector[0] == '\0') {
+		DOCA_LOG_ERR("Sampling needs an IPFIX collector");
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	/* The hardware random value is 16 bits, matched under a mask */
+	while (rounded < rate && rounded < 65536)
+		rounded <<= 1;
+	if (rounded != rate)
+		DOCA_LOG_WARN("Sample rate 1/%u rounded to 1/%u", rate, rounded);
+
+	if (cache_init(&sampler->cache) != 0) {
+		DOCA_LOG_ERR("Failed to allocate the flow cache");
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	if (xenoflow_ipfix_open(&sampler->ipfix, collector, 1, rounded) != 0) {
+		free(sampler->cache.buckets);
+		free(sampler->cache.flows);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	sampler->rate = rounded;
+	sampler->port_id = port_id;
+	sampler->queue = queue;
+	return DOCA_SUCCESS;
+}
+
+doca_error_t xenoflow_sampler_bind(XenoFlowSampler *sampler, struct doca_flow_port *port)
+{
+	struct doca_flow_shared_resource_cfg cfg = {.domain = DOCA_FLOW_PIPE_DOMAIN_DEFAULT};
+	struct doca_flow_mirror_target target;
+	uint32_t id = XENOFLOW_SAMPLER_MIRROR_ID;
+	doca_error_t result;
+
+	if (sampler->rate == 0)
+		return DOCA_SUCCESS;
+
+	memset(&target, 0, sizeof(target));
+	target.fwd.type = DOCA_FLOW_FWD_RSS;
+	target.fwd.rss_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	target.fwd.rss.outer_flags = DOCA_FLOW_RSS_IPV4;
+	target.fwd.rss.queues_array = &sampler->queue;
+	target.fwd.rss.nr_queues = 1;
+	cfg.mirror_cfg.nr_targets = 1;
+	cfg.mirror_cfg.target = &target;
+
+	result = doca_flow_shared_resource_set_cfg(DOCA_FLOW_SHARED_RESOURCE_MIRROR, id, &cfg);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to configure the sample mirror: %s", doca_error_get_descr(result));
+		return result;
+	}
+
+	result = doca_flow_shared_resources_bind(DOCA_FLOW_SHARED_RESOURCE_MIRROR, &id, 1, port);
+	if (result != DOCA_SUCCESS) {
+		DOCA_LOG_ERR("Failed to bind the sample mirror to port: %s", doca_error_get_descr(result));
+		return result;
+	}
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_sampler_match(const XenoFlowSampler *sampler, struct doca_flow_match *match,
+			    struct doca_flow_match *mask)
+{
+	match->parser_meta.random = 0;
+	mask->parser_meta.random = (uint16_t)(sampler->rate - 1);
+}
+
+void xenoflow_sampler_monitor(const XenoFlowSampler *sampler, struct doca_flow_monitor *monitor)
+{
+	(void)sampler;
+	monitor->shared_mirror_id = XENOFLOW_SAMPLER_MIRROR_ID;
+}
+
+doca_error_t xenoflow_sampler_start(XenoFlowSampler *sampler)
+{
+	if (sampler->rate == 0)
+		return DOCA_SUCCESS;
+
+	sampler->running = 1;
+	if (pthread_create(&sampler->thread, NULL, sampler_main, sampler) != 0) {
+		DOCA_LOG_ERR("Failed to start the sampler thread");
+		sampler->running = 0;
+		return DOCA_ERROR_OPERATING_SYSTEM;
+	}
+
+	DOCA_LOG_INFO("Sampling 1 in %u packets from port %u queue %u", sampler->rate, sampler->port_id,
+		      sampler->queue);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_sampler_stop(XenoFlowSampler *sampler)
+{
+	uint64_t now = now_ms();
+
+	if (sampler->rate == 0)
+		return;
+
+	if (sampler->running) {
+		sampler->running = 0;
+		pthread_join(sampler->thread, NULL);
+	}
+
+	cache_expire(sampler, now, 1);
+	xenoflow_ipfix_close(&sampler->ipfix, now);
+	free(sampler->cache.buckets);
+	free(sampler->cache.flows);
+	sampler->rate = 0;
+
+	DOCA_LOG_INFO("Sampler stopped: %" PRIu64 " samples, %" PRIu64 " flow records, %" PRIu64 " evicted early",
+		      atomic_load(&sampler->nb_samples), atomic_load(&sampler->nb_flows),
+		      atomic_load(&sampler->nb_evictions));
+}
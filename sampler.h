@@ -0,0 +1,109 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <doca_error.h>
+#include <doca_flow.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "ipfix.h"
+
+/*
+ * Packet sampling. Each service's SAMPLE pipe matches 1 in rate packets on the
+ * hardware random value and mirrors them to an RX queue, the original goes on
+ * to the hash pipe either way. A thread reads the copies, aggregates them into
+ * flow records and exports expired records over IPFIX.
+ */
+
+/* Shared mirror resource of the SAMPLE pipes */
+#define XENOFLOW_SAMPLER_MIRROR_ID 0
+
+/* Flow records held at once, a power of two */
+#define XENOFLOW_FLOW_CACHE_SIZE 65536
+
+/* A flow is exported after this long without samples, and at least this often while active */
+#define XENOFLOW_FLOW_IDLE_TIMEOUT_MS 15000
+#define XENOFLOW_FLOW_ACTIVE_TIMEOUT_MS 60000
+
+/* How often the cache is scanned for expired flows */
+#define XENOFLOW_FLOW_EXPIRY_INTERVAL_MS 1000
+
+typedef struct XenoFlowFlow XenoFlowFlow;
+
+/**
+ * @brief Flow cache: chained hash table over a fixed array of records, only touched by the sampler thread
+ */
+typedef struct {
+	uint32_t *buckets;		/* first record of each chain, UINT32_MAX if empty */
+	XenoFlowFlow *flows;
+	uint32_t free_list;		/* first unused record, UINT32_MAX if full */
+	uint32_t nb_active;		/* also read by the status report, without a lock */
+} XenoFlowFlowCache;
+
+/**
+ * @brief Sampling state, rate 0 means sampling is off
+ */
+typedef struct {
+	uint32_t rate;			/* 1 in rate packets, a power of two */
+	uint16_t port_id;		/* DPDK port the copies arrive on */
+	uint16_t queue;			/* and its RX queue */
+	XenoFlowFlowCache cache;
+	XenoFlowIpfix ipfix;
+	pthread_t thread;
+	volatile int running;
+	_Atomic uint64_t nb_samples;	/* copies received */
+	_Atomic uint64_t nb_flows;	/* records exported */
+	_Atomic uint64_t nb_evictions;	/* flows exported early because the cache was full */
+} XenoFlowSampler;
+
+/**
+ * @brief Allocate the flow cache and open the IPFIX exporter
+ * @param sampler Sampler to initialize
+ * @param rate 1-in-rate sampling, rounded up to a power of two, at most 65536
+ * @param collector IPFIX collector as ip:port
+ * @param port_id DPDK port the mirrored copies arrive on
+ * @param queue RX queue of the copies
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_sampler_init(XenoFlowSampler *sampler, uint32_t rate, const char *collector, uint16_t port_id,
+				   uint16_t queue);
+
+/**
+ * @brief Configure the shared mirror that copies samples to the RX queue and bind it to the port
+ * @param sampler The sampler
+ * @param port DOCA Flow port of the SAMPLE pipes
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_sampler_bind(XenoFlowSampler *sampler, struct doca_flow_port *port);
+
+/**
+ * @brief Fill the match of a SAMPLE pipe: the low bits of the random value are all zero
+ * @param sampler The sampler
+ * @param match Match to fill
+ * @param mask Its mask
+ */
+void xenoflow_sampler_match(const XenoFlowSampler *sampler, struct doca_flow_match *match,
+			    struct doca_flow_match *mask);
+
+/**
+ * @brief Attach the sample mirror to a monitor
+ * @param sampler The sampler
+ * @param monitor Monitor of the SAMPLE pipe
+ */
+void xenoflow_sampler_monitor(const XenoFlowSampler *sampler, struct doca_flow_monitor *monitor);
+
+/**
+ * @brief Start the thread that reads the samples
+ * @param sampler The sampler
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_sampler_start(XenoFlowSampler *sampler);
+
+/**
+ * @brief Stop the thread, export all flows in the cache and close the exporter
+ * @param sampler The sampler
+ */
+void xenoflow_sampler_stop(XenoFlowSampler *sampler);
+
+#endif /* SAMPLER_H */
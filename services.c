@@ -0,0 +1,424 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <doca_log.h>
+
+#include "services.h"
+
+DOCA_LOG_REGISTER(SERVICES);
+
+/* Backends of all pools come from one slab */
+static XenoFlowSlab backend_slab;
+static pthread_once_t backend_slab_once = PTHREAD_ONCE_INIT;
+
+static void backend_slab_init(void)
+{
+	xenoflow_slab_init(&backend_slab, sizeof(XenoFlowBackend), 1024);
+}
+
+XenoFlowBackend *createBackend(const char *name, const char *mac_str)
+{
+	XenoFlowBackend *b;
+	uint8_t mac[6];
+
+	if (strlen(name) >= sizeof(b->name)) {
+		DOCA_LOG_ERR("Backend name '%.16s...' is too long (max %zu)", name, sizeof(b->name) - 1);
+		return NULL;
+	}
+	if (sscanf(mac_str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+		   &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) != 6) {
+		DOCA_LOG_ERR("Backend %s: invalid MAC '%s'", name, mac_str);
+		return NULL;
+	}
+
+	pthread_once(&backend_slab_once, backend_slab_init);
+	b = xenoflow_slab_alloc(&backend_slab);
+	if (b == NULL)
+		return NULL;
+	strcpy(b->name, name);
+	memcpy(b->mac_address, mac, sizeof(mac));
+	return b;
+}
+
+XenoFlowBackend *copyBackend(const XenoFlowBackend *spec)
+{
+	XenoFlowBackend *b;
+
+	pthread_once(&backend_slab_once, backend_slab_init);
+	b = xenoflow_slab_alloc(&backend_slab);
+	if (b == NULL)
+		return NULL;
+	strcpy(b->name, spec->name);
+	memcpy(b->mac_address, spec->mac_address, sizeof(b->mac_address));
+	b->host = spec->host;
+	b->ip = spec->ip;
+	b->port = spec->port;
+	b->tunnel = spec->tunnel;
+	b->remote = spec->remote;
+	b->vni = spec->vni;
+	b->rate_limit = spec->rate_limit;
+	b->burst = spec->burst;
+	return b;
+}
+
+XenoFlowBackend *xenoflow_backend_create(const XenoFlowBackendDesc *desc)
+{
+	XenoFlowBackend *b;
+
+	pthread_once(&backend_slab_once, backend_slab_init);
+	b = xenoflow_slab_alloc(&backend_slab);
+	if (b == NULL)
+		return NULL;
+	memcpy(b->name, desc->name, sizeof(b->name));
+	memcpy(b->mac_address, desc->mac_address, sizeof(b->mac_address));
+	b->host = desc->host;
+	b->ip = desc->ip;
+	b->port = desc->port;
+	b->tunnel = desc->tunnel;
+	b->remote = desc->remote;
+	b->vni = desc->vni;
+	b->rate_limit = desc->rate_limit;
+	b->burst = desc->burst;
+	return b;
+}
+
+void destroyBackend(XenoFlowBackend *backend)
+{
+	xenoflow_slab_free(&backend_slab, backend);
+}
+
+XenoFlowConfig *createConfig(void)
+{
+	XenoFlowConfig *config = calloc(1, sizeof(XenoFlowConfig));
+
+	if (config == NULL)
+		return NULL;
+	xenoflow_index_init(&config->byName, offsetof(XenoFlowBackend, name), 0);
+	xenoflow_index_init(&config->byMac, offsetof(XenoFlowBackend, mac_address), 6);
+	xenoflow_index_init(&config->byTarget, offsetof(XenoFlowBackend, ip), XENOFLOW_BACKEND_TARGET_LEN);
+	return config;
+}
+
+void destroyConfig(XenoFlowConfig *config)
+{
+	if (config == NULL)
+		return;
+	for (int i = 0; i < config->numBackends; i++)
+		destroyBackend(config->backends[i]);
+	xenoflow_index_destroy(&config->byName);
+	xenoflow_index_destroy(&config->byMac);
+	xenoflow_index_destroy(&config->byTarget);
+	free(config->backends);
+	free(config);
+}
+
+/* NAT backends share their gateway's MAC and are told apart by IP and port instead */
+static XenoFlowIndex *address_index(XenoFlowConfig *config, const XenoFlowBackend *backend)
+{
+	return backend->ip != 0 ? &config->byTarget : &config->byMac;
+}
+
+doca_error_t configAddBackend(XenoFlowConfig *config, XenoFlowBackend *backend)
+{
+	const XenoFlowBackend *other;
+
+	if (configFindBackend(config, backend->name) != NULL) {
+		DOCA_LOG_ERR("Cannot add backend: name %s already in use", backend->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+	other = configFindBackendByAddress(config, backend);
+	if (other != NULL) {
+		DOCA_LOG_ERR("Cannot add backend %s: %s already used by %s", backend->name,
+			     backend->ip != 0 ? "IP and port" : "MAC", other->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+
+	if (config->numBackends == config->capacity) {
+		int capacity = config->capacity ? config->capacity * 2 : 16;
+		XenoFlowBackend **backends = realloc(config->backends, capacity * sizeof(XenoFlowBackend *));
+
+		if (backends == NULL)
+			return DOCA_ERROR_NO_MEMORY;
+		config->backends = backends;
+		config->capacity = capacity;
+	}
+
+	if (xenoflow_index_insert(&config->byName, backend) != 0)
+		return DOCA_ERROR_NO_MEMORY;
+	if (xenoflow_index_insert(address_index(config, backend), backend) != 0) {
+		xenoflow_index_remove(&config->byName, backend);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+
+	backend->pool_index = config->numBackends;
+	config->backends[config->numBackends] = backend;
+	config->numBackends += 1;
+	return DOCA_SUCCESS;
+}
+
+void configRemoveBackend(XenoFlowConfig *config, XenoFlowBackend *backend)
+{
+	int last = config->numBackends - 1;
+
+	if (backend->pool_index > last || config->backends[backend->pool_index] != backend)
+		return;
+
+	xenoflow_index_remove(&config->byName, backend);
+	xenoflow_index_remove(address_index(config, backend), backend);
+
+	/* Keep the array dense by moving the last backend into the hole */
+	config->backends[backend->pool_index] = config->backends[last];
+	config->backends[backend->pool_index]->pool_index = backend->pool_index;
+	config->backends[last] = NULL;
+	config->numBackends = last;
+}
+
+XenoFlowBackend *configFindBackend(const XenoFlowConfig *config, const char *name)
+{
+	return xenoflow_index_find(&config->byName, name);
+}
+
+XenoFlowBackend *configFindBackendByMac(const XenoFlowConfig *config, const uint8_t *mac)
+{
+	return xenoflow_index_find(&config->byMac, mac);
+}
+
+XenoFlowBackend *configFindBackendByAddress(const XenoFlowConfig *config, const XenoFlowBackend *like)
+{
+	if (like->ip != 0)
+		return xenoflow_index_find(&config->byTarget, &like->ip);
+	return xenoflow_index_find(&config->byMac, like->mac_address);
+}
+
+XenoFlowService *xenoflow_service_create(const char *name, const char *vip, const char *protocol, int port)
+{
+	XenoFlowService *service;
+	struct in_addr addr;
+
+	if (name == NULL || name[0] == '\0') {
+		DOCA_LOG_ERR("Service without a name");
+		return NULL;
+	}
+
+	service = calloc(1, sizeof(XenoFlowService));
+	if (service == NULL)
+		return NULL;
+	snprintf(service->name, sizeof(service->name), "%s", name);
+
+	if (vip != NULL) {
+		if (inet_pton(AF_INET, vip, &addr) != 1) {
+			DOCA_LOG_ERR("Service %s: invalid VIP '%s'", name, vip);
+			goto invalid;
+		}
+		service->vip = addr.s_addr;
+
+		if (protocol != NULL && strcasecmp(protocol, "tcp") == 0)
+			service->protocol = DOCA_FLOW_PROTO_TCP;
+		else if (protocol != NULL && strcasecmp(protocol, "udp") == 0)
+			service->protocol = DOCA_FLOW_PROTO_UDP;
+		else {
+			DOCA_LOG_ERR("Service %s: protocol must be tcp or udp", name);
+			goto invalid;
+		}
+
+		if (port <= 0 || port > 65535) {
+			DOCA_LOG_ERR("Service %s: invalid port %d", name, port);
+			goto invalid;
+		}
+		service->port = port;
+	}
+
+	service->config = createConfig();
+	if (service->config == NULL)
+		goto invalid;
+	return service;
+
+invalid:
+	free(service);
+	return NULL;
+}
+
+static void service_destroy(XenoFlowService *service)
+{
+	destroyConfig(service->config);
+	free(service->slots);
+	free(service->entries);
+	free(service->entry_ctx);
+	free(service->nb_queued);
+	free(service);
+}
+
+void xenoflow_services_init(XenoFlowServices *services)
+{
+	memset(services, 0, sizeof(*services));
+	xenoflow_index_init(&services->byName, offsetof(XenoFlowService, name), 0);
+}
+
+void xenoflow_services_destroy(XenoFlowServices *services)
+{
+	for (int i = 0; i < services->numServices; i++)
+		service_destroy(services->services[i]);
+	free(services->services);
+	xenoflow_index_destroy(&services->byName);
+	memset(services, 0, sizeof(*services));
+}
+
+doca_error_t xenoflow_services_add(XenoFlowServices *services, XenoFlowService *service)
+{
+
+	if (xenoflow_services_find(services, service->name) != NULL) {
+		DOCA_LOG_ERR("Cannot add service %s: name already in use", service->name);
+		return DOCA_ERROR_ALREADY_EXIST;
+	}
+
+	for (int i = 0; i < services->numServices; i++) {
+		XenoFlowService *other = services->services[i];
+
+		if (service->protocol != 0 && other->vip == service->vip && other->protocol == service->protocol &&
+		    other->port == service->port) {
+			DOCA_LOG_ERR("Cannot add service %s: same VIP as service %s", service->name, other->name);
+			return DOCA_ERROR_ALREADY_EXIST;
+		}
+	}
+
+	if (service->protocol == 0) {
+		if (services->defaultService != NULL) {
+			DOCA_LOG_ERR("Cannot add service %s: default service is already %s", service->name,
+				     services->defaultService->name);
+			return DOCA_ERROR_ALREADY_EXIST;
+		}
+	}
+
+	if (services->numServices == services->capacity) {
+		int capacity = services->capacity ? services->capacity * 2 : 16;
+		XenoFlowService **list = realloc(services->services, capacity * sizeof(XenoFlowService *));
+
+		if (list == NULL)
+			return DOCA_ERROR_NO_MEMORY;
+		services->services = list;
+		services->capacity = capacity;
+	}
+
+	if (xenoflow_index_insert(&services->byName, service) != 0)
+		return DOCA_ERROR_NO_MEMORY;
+	if (service->protocol == 0)
+		services->defaultService = service;
+	services->services[services->numServices++] = service;
+	return DOCA_SUCCESS;
+}
+
+/*
+ * Service and backend pool of a parsed service, duplicate names and
+ * addresses show up here as the pool and the service table index them
+ */
+static doca_error_t build_service(XenoFlowServices *services, const XenoFlowServiceDesc *desc)
+{
+	XenoFlowService *service = calloc(1, sizeof(XenoFlowService));
+	doca_error_t result = DOCA_SUCCESS;
+
+	if (service == NULL)
+		return DOCA_ERROR_NO_MEMORY;
+	memcpy(service->name, desc->name, sizeof(service->name));
+	service->vip = desc->vip;
+	service->protocol = desc->protocol;
+	service->port = desc->port;
+	service->nat = desc->nat;
+	memcpy(service->gateway_mac, desc->gateway_mac, sizeof(service->gateway_mac));
+	service->underlay = desc->underlay;
+	service->underlay_ip = desc->underlay_ip;
+	memcpy(service->underlay_mac, desc->underlay_mac, sizeof(service->underlay_mac));
+	memcpy(service->underlay_gateway_mac, desc->underlay_gateway_mac, sizeof(service->underlay_gateway_mac));
+	service->spillover = desc->spillover;
+	service->buckets = desc->buckets;
+	service->config = createConfig();
+	if (service->config == NULL)
+		result = DOCA_ERROR_NO_MEMORY;
+
+	for (int i = 0; i < desc->nb_backends && result == DOCA_SUCCESS; i++) {
+		XenoFlowBackend *b = xenoflow_backend_create(&desc->backends[i]);
+
+		if (b == NULL) {
+			result = DOCA_ERROR_NO_MEMORY;
+			break;
+		}
+		result = configAddBackend(service->config, b);
+		if (result != DOCA_SUCCESS)
+			destroyBackend(b);
+	}
+
+	if (result == DOCA_SUCCESS)
+		result = xenoflow_services_add(services, service);
+	if (result != DOCA_SUCCESS)
+		service_destroy(service);
+	return result;
+}
+
+doca_error_t xenoflow_services_load(const char *path, XenoFlowServices *services)
+{
+	doca_error_t result = DOCA_SUCCESS;
+	XenoFlowServicesFile file;
+	char err[256];
+	int ret;
+
+	ret = xenoflow_services_parse(path, &file, err, sizeof(err));
+	if (ret != 0) {
+		DOCA_LOG_ERR("%s", err);
+		xenoflow_services_file_free(&file);
+		return ret == -EIO ? DOCA_ERROR_IO_FAILED : ret == -ENOMEM ? DOCA_ERROR_NO_MEMORY :
+									   DOCA_ERROR_INVALID_VALUE;
+	}
+
+	strcpy(services->device, file.device);
+	for (int i = 0; i < file.nb_services && result == DOCA_SUCCESS; i++)
+		result = build_service(services, &file.services[i]);
+	xenoflow_services_file_free(&file);
+	return result;
+}
+
+void xenoflow_service_describe(const XenoFlowService *service, XenoFlowServiceDesc *desc)
+{
+	memset(desc, 0, sizeof(*desc));
+	memcpy(desc->name, service->name, sizeof(desc->name));
+	desc->vip = service->vip;
+	desc->protocol = service->protocol;
+	desc->port = service->port;
+	desc->nat = service->nat;
+	memcpy(desc->gateway_mac, service->gateway_mac, sizeof(desc->gateway_mac));
+	desc->underlay = service->underlay;
+	desc->underlay_ip = service->underlay_ip;
+	memcpy(desc->underlay_mac, service->underlay_mac, sizeof(desc->underlay_mac));
+	memcpy(desc->underlay_gateway_mac, service->underlay_gateway_mac, sizeof(desc->underlay_gateway_mac));
+	desc->spillover = service->spillover;
+	desc->buckets = service->buckets;
+}
+
+XenoFlowService *xenoflow_services_find(const XenoFlowServices *services, const char *name)
+{
+	return xenoflow_index_find(&services->byName, name);
+}
+
+const char *xenoflow_service_protocol_name(const XenoFlowService *service)
+{
+	switch (service->protocol) {
+	case DOCA_FLOW_PROTO_TCP:
+		return "tcp";
+	case DOCA_FLOW_PROTO_UDP:
+		return "udp";
+	default:
+		return "any";
+	}
+}
+
+void xenoflow_service_vip_str(const XenoFlowService *service, char *buf, size_t len)
+{
+	struct in_addr addr = {.s_addr = service->vip};
+
+	if (inet_ntop(AF_INET, &addr, buf, len) == NULL && len > 0)
+		buf[0] = '\0';
+}
@@ -0,0 +1,286 @@
+#ifndef SERVICES_H
+#define SERVICES_H
+
+#include <doca_flow.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "registry.h"
+#include "services_json.h"
+
+/**
+ * @brief Backend structure
+ */
+typedef struct {
+	char name[64];
+	uint8_t mac_address[6];
+	struct doca_flow_pipe_entry *entry;
+	uint32_t entry_index;	/* index in the service's hash pipe, its home bucket when rebalancing */
+	uint32_t counter_index;	/* index in XenoFlow.counters */
+	int host;		/* forward to the kernel instead of out of the port */
+	int pool_index;		/* position in XenoFlowConfig.backends */
+	doca_be32_t ip;		/* NAT target address, network order, 0 for direct server return */
+	uint16_t port;		/* NAT target port, host order, 0 keeps the service port; right after ip */
+	struct doca_flow_pipe_entry *reverse_entry; /* NAT reply rewrite back to the VIP */
+	uint8_t tunnel;		/* enum XenoFlowTunnel */
+	doca_be32_t remote;	/* tunnel endpoint in the underlay, network order */
+	uint32_t vni;		/* VXLAN/GENEVE network identifier, 24 bits */
+	uint64_t rate_limit;	/* bytes per second its hash entry's meter lets through, 0 for none */
+	uint64_t burst;		/* bytes above rate_limit, 0 for the meter default */
+	uint32_t nb_buckets;	/* hash entries it owns, 1 unless the service rebalances */
+	/* Its hash entries' counters summed at the last collection */
+	uint64_t pkts;
+	uint64_t bytes;
+	double pps;
+	double bps;
+} XenoFlowBackend;
+
+/* ip and port together key XenoFlowConfig.byTarget */
+#define XENOFLOW_BACKEND_TARGET_LEN (sizeof(doca_be32_t) + sizeof(uint16_t))
+
+/**
+ * @brief XenoFlow configuration structure, the backend pool of one service
+ *
+ * backends is a dense array that grows as needed; byName, byMac and byTarget
+ * index the same backends for O(1) lookups. Names are unique within a pool,
+ * and so are the MACs of direct server return backends and the IP and port
+ * of NAT backends.
+ */
+typedef struct {
+	XenoFlowBackend **backends;
+	int numBackends;
+	int capacity;		/* allocated slots in backends */
+	int nextBackend;
+	XenoFlowIndex byName;
+	XenoFlowIndex byMac;		/* direct server return backends */
+	XenoFlowIndex byTarget;		/* NAT backends */
+} XenoFlowConfig;
+
+/**
+ * @brief A virtual IP (dst IP, protocol, dst port) balanced over its own backend pool
+ *
+ * Every service gets its own hash pipe. The root VIP pipe matches the VIP and
+ * forwards to it; the default service (protocol 0) has no VIP and takes all
+ * IPv4 traffic no other service matches.
+ *
+ * In NAT mode the hash entries also rewrite the destination IP and port to
+ * the backend's, so backends may sit in other subnets behind gateway_mac.
+ * Replies are rewritten back to the VIP by the NAT_REVERSE pipe.
+ *
+ * A service with an underlay can also reach backends through a tunnel: their
+ * hash entries pick an action template that wraps the packet in VXLAN, GENEVE
+ * or IPIP from underlay_ip towards the backend's remote, through underlay_gateway_mac.
+ *
+ * With spillover every hash entry also goes through a meter. Packets a backend's
+ * rate limit turns red leave the hash pipe for COLOR_<name>, which drops them or
+ * sends them to SPILL_<name> to be rehashed over the backends without a limit.
+ *
+ * With buckets the hash pipe has many more entries than there are backends.
+ * Every backend owns its home entry plus a share of the rest, and the
+ * rebalancer moves single entries between backends by their load.
+ */
+typedef struct {
+	char name[64];
+	doca_be32_t vip;		/* network order */
+	uint8_t protocol;		/* DOCA_FLOW_PROTO_TCP or DOCA_FLOW_PROTO_UDP, 0 for the default service */
+	uint16_t port;			/* host order */
+	XenoFlowConfig *config;		/* backend pool */
+	struct doca_flow_pipe *hash_pipe;
+	uint32_t hash_pipe_entries;
+	XenoFlowBackend **slots;	/* backend owning hash entry i, set when the entry is queued */
+	struct doca_flow_pipe_entry **entries; /* hash entry i, NULL until added */
+	struct XenoFlowEntryCtx *entry_ctx; /* usr_ctx of hash entry i, its updates complete through it */
+	uint32_t *nb_queued;		/* ops queued on hash entry i and not done yet, under XenoFlow.lock */
+	uint32_t buckets;		/* hash entries wanted for rebalancing, 0 for one per backend */
+	uint32_t nextFreeSlot;		/* no free slot below this index */
+	uint32_t counter_base;		/* counter of hash entry i is counter_base + i */
+	struct doca_flow_pipe_entry *vip_entry;
+	struct doca_flow_pipe *sample_pipe;	/* between the VIP and the hash pipe when sampling, else NULL */
+	struct doca_flow_pipe_entry *sample_entry;
+	int nat;			/* rewrite dst IP/port to the backend, not only the MAC */
+	uint8_t gateway_mac[6];		/* NAT: next hop of the replies rewritten back to the VIP */
+	int underlay;			/* tunnels allowed, the hash pipe has their action templates */
+	doca_be32_t underlay_ip;	/* outer source address, network order */
+	uint8_t underlay_mac[6];	/* outer source MAC */
+	uint8_t underlay_gateway_mac[6]; /* outer destination MAC, the underlay next hop */
+	uint8_t spillover;		/* enum XenoFlowSpillover */
+	struct doca_flow_pipe *color_pipe;	/* after metered hash entries, NULL without spillover */
+	struct doca_flow_pipe_entry *color_entry;
+	struct doca_flow_pipe *spill_pipe;	/* rehash of red packets, NULL unless spillover is rehash */
+	/* Resource slots of the service's pipes, valid once the pipe exists */
+	int hash_res;
+	int sample_res;
+	int color_res;
+	int spill_res;
+} XenoFlowService;
+
+/**
+ * @brief All services of the load balancer
+ */
+typedef struct {
+	XenoFlowService **services;
+	int numServices;
+	int capacity;			/* allocated slots in services */
+	XenoFlowService *defaultService; /* also in services, NULL if there is none */
+	XenoFlowIndex byName;
+	char device[64];		/* top-level "device" of the config, empty if it names none */
+} XenoFlowServices;
+
+/**
+ * @brief Allocate a backend from the backend slab
+ * @param name Backend name, shorter than XenoFlowBackend.name
+ * @param mac_str MAC address as xx:xx:xx:xx:xx:xx
+ * @return The backend, NULL if the name is too long, the MAC is invalid or out of memory
+ */
+XenoFlowBackend *createBackend(const char *name, const char *mac_str);
+
+/**
+ * @brief Allocate a backend with the name, MAC, host flag and NAT target of another
+ * @param spec Backend to copy, its hardware state is not copied
+ * @return The backend, NULL if out of memory
+ */
+XenoFlowBackend *copyBackend(const XenoFlowBackend *spec);
+
+/**
+ * @brief Allocate a backend from a parsed description, see xenoflow_backend_parse()
+ * @param desc The backend as the config file or the API describes it
+ * @return The backend, NULL if out of memory
+ */
+XenoFlowBackend *xenoflow_backend_create(const XenoFlowBackendDesc *desc);
+
+/**
+ * @brief Give a backend back to the backend slab, it must not be in any pool
+ * @param backend The backend, may be NULL
+ */
+void destroyBackend(XenoFlowBackend *backend);
+
+/**
+ * @brief Create an empty backend pool
+ * @return The pool, NULL if out of memory
+ */
+XenoFlowConfig *createConfig(void);
+
+/**
+ * @brief Free a backend pool and all backends in it
+ * @param config The pool, may be NULL
+ */
+void destroyConfig(XenoFlowConfig *config);
+
+/**
+ * @brief Append a backend to a pool
+ * @param config The pool
+ * @param backend Backend to add
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_ALREADY_EXIST if the name or MAC is taken,
+ *	   DOCA_ERROR_NO_MEMORY otherwise
+ */
+doca_error_t configAddBackend(XenoFlowConfig *config, XenoFlowBackend *backend);
+
+/**
+ * @brief Remove a backend from a pool, the backend itself is not freed
+ * @param config The pool
+ * @param backend Backend to remove
+ */
+void configRemoveBackend(XenoFlowConfig *config, XenoFlowBackend *backend);
+
+/**
+ * @brief Find a backend by name
+ * @param config The pool
+ * @param name Backend name
+ * @return The backend, NULL if there is none
+ */
+XenoFlowBackend *configFindBackend(const XenoFlowConfig *config, const char *name);
+
+/**
+ * @brief Find a backend by MAC address
+ * @param config The pool
+ * @param mac MAC address, 6 bytes
+ * @return The backend, NULL if there is none
+ */
+XenoFlowBackend *configFindBackendByMac(const XenoFlowConfig *config, const uint8_t *mac);
+
+/**
+ * @brief Find the backend with the same address: IP and port for NAT backends, MAC otherwise
+ * @param config The pool
+ * @param like Backend whose address to look for
+ * @return The backend, NULL if there is none
+ */
+XenoFlowBackend *configFindBackendByAddress(const XenoFlowConfig *config, const XenoFlowBackend *like);
+
+/**
+ * @brief Create a service without backends
+ * @param name Service name
+ * @param vip Virtual IPv4 address in dotted notation, NULL for the default service
+ * @param protocol "tcp" or "udp", ignored for the default service
+ * @param port Destination port, ignored for the default service
+ * @return The service, NULL on invalid arguments
+ */
+XenoFlowService *xenoflow_service_create(const char *name, const char *vip, const char *protocol, int port);
+
+/**
+ * @brief Initialize an empty service table
+ * @param services Service table
+ */
+void xenoflow_services_init(XenoFlowServices *services);
+
+/**
+ * @brief Free all services and their backends
+ * @param services Service table, empty afterwards
+ */
+void xenoflow_services_destroy(XenoFlowServices *services);
+
+/**
+ * @brief Add a service, at most one default service is allowed
+ * @param services Service table
+ * @param service Service to add, owned by the table afterwards
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_services_add(XenoFlowServices *services, XenoFlowService *service);
+
+/**
+ * @brief Load services and their backends from a JSON file
+ *
+ * Format: {"services": [{"name", "vip", "protocol", "port", "backends": [{"name", "mac_address", "host"}]}],
+ * "backends": [...]}. The optional top-level "backends" become the default service.
+ * NAT services add "mode" and "gateway_mac", their backends "ip" and "port".
+ * Services with an "underlay" {"ip", "mac", "gateway_mac"} take backends with
+ * "tunnel", "remote" and "vni". Services with "spillover" ("drop" or "rehash")
+ * take backends with "rate_limit" {"mbps", "burst_kb"}. "buckets" sizes the hash
+ * pipe of a service for rebalancing.
+ *
+ * @param path Path of the JSON file
+ * @param services Service table to fill
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_services_load(const char *path, XenoFlowServices *services);
+
+/**
+ * @brief The settings of a running service as the config file describes them, to check backends against
+ * @param service The service
+ * @param desc Description to fill, without backends
+ */
+void xenoflow_service_describe(const XenoFlowService *service, XenoFlowServiceDesc *desc);
+
+/**
+ * @brief Find a service by name
+ * @param services Service table
+ * @param name Service name
+ * @return The service, NULL if there is none with this name
+ */
+XenoFlowService *xenoflow_services_find(const XenoFlowServices *services, const char *name);
+
+/**
+ * @brief Protocol name of a service, "tcp", "udp" or "any" for the default service
+ * @param service The service
+ * @return Protocol name
+ */
+const char *xenoflow_service_protocol_name(const XenoFlowService *service);
+
+/**
+ * @brief Format the VIP of a service as a dotted IPv4 address
+ * @param service The service
+ * @param buf Output buffer, at least 16 bytes
+ * @param len Size of buf
+ */
+void xenoflow_service_vip_str(const XenoFlowService *service, char *buf, size_t len);
+
+#endif /* SERVICES_H */
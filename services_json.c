@@ -0,0 +1,412 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <cjson/cJSON.h>
+
+#include "services_json.h"
+
+static const char *const tunnel_names[XENOFLOW_TUNNEL_MAX] = {
+	[XENOFLOW_TUNNEL_NONE] = "none",
+	[XENOFLOW_TUNNEL_VXLAN] = "vxlan",
+	[XENOFLOW_TUNNEL_GENEVE] = "geneve",
+	[XENOFLOW_TUNNEL_IPIP] = "ipip",
+};
+
+/**
+ * @brief Where a failed parse leaves its reason
+ */
+struct parser {
+	char *err;
+	size_t err_len;
+};
+
+static int __attribute__((format(printf, 2, 3))) invalid(struct parser *p, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(p->err, p->err_len, fmt, ap);
+	va_end(ap);
+	return -EINVAL;
+}
+
+const char *xenoflow_tunnel_name(uint8_t tunnel)
+{
+	return tunnel < XENOFLOW_TUNNEL_MAX ? tunnel_names[tunnel] : "?";
+}
+
+int xenoflow_tunnel_parse(const char *name, uint8_t *tunnel)
+{
+	for (uint8_t t = XENOFLOW_TUNNEL_VXLAN; t < XENOFLOW_TUNNEL_MAX; t++) {
+		if (strcasecmp(name, tunnel_names[t]) == 0) {
+			*tunnel = t;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int parse_mac(cJSON *item, uint8_t *mac)
+{
+	return cJSON_IsString(item) && sscanf(item->valuestring, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1],
+					      &mac[2], &mac[3], &mac[4], &mac[5]) == 6;
+}
+
+static int parse_ip(cJSON *item, uint32_t *addr)
+{
+	struct in_addr in;
+
+	if (!cJSON_IsString(item) || inet_pton(AF_INET, item->valuestring, &in) != 1)
+		return 0;
+	*addr = in.s_addr;
+	return 1;
+}
+
+/*
+ * "mode": "dsr" (default) only rewrites the MAC, "nat" also the destination
+ * IP and port and then needs the "gateway_mac" replies are sent to
+ */
+static int load_mode(struct parser *p, XenoFlowServiceDesc *service, cJSON *item)
+{
+	cJSON *mode = cJSON_GetObjectItem(item, "mode");
+
+	if (mode == NULL || (cJSON_IsString(mode) && strcasecmp(mode->valuestring, "dsr") == 0))
+		return 0;
+	if (!cJSON_IsString(mode) || strcasecmp(mode->valuestring, "nat") != 0)
+		return invalid(p, "Service %s: mode must be dsr or nat", service->name);
+	if (!parse_mac(cJSON_GetObjectItem(item, "gateway_mac"), service->gateway_mac))
+		return invalid(p, "Service %s: NAT mode needs a valid gateway_mac", service->name);
+	service->nat = 1;
+	return 0;
+}
+
+/*
+ * "underlay": {"ip", "mac", "gateway_mac"}, the outer source and next hop of
+ * tunnels to the service's backends
+ */
+static int load_underlay(struct parser *p, XenoFlowServiceDesc *service, cJSON *item)
+{
+	cJSON *underlay = cJSON_GetObjectItem(item, "underlay");
+
+	if (underlay == NULL)
+		return 0;
+	if (!parse_ip(cJSON_GetObjectItem(underlay, "ip"), &service->underlay_ip) ||
+	    !parse_mac(cJSON_GetObjectItem(underlay, "mac"), service->underlay_mac) ||
+	    !parse_mac(cJSON_GetObjectItem(underlay, "gateway_mac"), service->underlay_gateway_mac))
+		return invalid(p, "Service %s: underlay needs a valid ip, mac and gateway_mac", service->name);
+	service->underlay = 1;
+	return 0;
+}
+
+/* "spillover": "drop" or "rehash" meters the backends of a service */
+static int load_spillover(struct parser *p, XenoFlowServiceDesc *service, cJSON *item)
+{
+	cJSON *spillover = cJSON_GetObjectItem(item, "spillover");
+
+	if (spillover == NULL)
+		return 0;
+	if (cJSON_IsString(spillover) && strcasecmp(spillover->valuestring, "drop") == 0)
+		service->spillover = XENOFLOW_SPILLOVER_DROP;
+	else if (cJSON_IsString(spillover) && strcasecmp(spillover->valuestring, "rehash") == 0)
+		service->spillover = XENOFLOW_SPILLOVER_REHASH;
+	else
+		return invalid(p, "Service %s: spillover must be drop or rehash", service->name);
+	return 0;
+}
+
+/*
+ * "buckets": hash entries of a service to rebalance between its backends.
+ * Meters limit single entries, so it does not go with spillover.
+ */
+static int load_buckets(struct parser *p, XenoFlowServiceDesc *service, cJSON *item)
+{
+	cJSON *buckets = cJSON_GetObjectItem(item, "buckets");
+
+	if (buckets == NULL)
+		return 0;
+	if (!cJSON_IsNumber(buckets) || buckets->valueint < 1 || buckets->valueint > XENOFLOW_MAX_BUCKETS)
+		return invalid(p, "Service %s: buckets must be between 1 and %d", service->name, XENOFLOW_MAX_BUCKETS);
+	if (service->spillover != XENOFLOW_SPILLOVER_NONE)
+		return invalid(p, "Service %s: buckets and spillover cannot be combined", service->name);
+	service->buckets = buckets->valueint;
+	return 0;
+}
+
+/* "ip" and "port" of a NAT backend; host entries hand the packet to the kernel unchanged */
+static int load_nat(struct parser *p, const XenoFlowServiceDesc *service, XenoFlowBackendDesc *b, cJSON *item)
+{
+	cJSON *ip = cJSON_GetObjectItem(item, "ip");
+	cJSON *port = cJSON_GetObjectItem(item, "port");
+
+	if (!service->nat || b->host)
+		return 0;
+	if (!cJSON_IsString(ip))
+		return invalid(p, "Service %s: NAT backend %s needs an ip", service->name, b->name);
+	if (!parse_ip(ip, &b->ip))
+		return invalid(p, "Backend %s: invalid IP '%s'", b->name, ip->valuestring);
+	if (cJSON_IsNumber(port) && (port->valueint < 0 || port->valueint > 65535))
+		return invalid(p, "Backend %s: invalid port %d", b->name, port->valueint);
+	b->port = cJSON_IsNumber(port) ? port->valueint : 0;
+	return 0;
+}
+
+/* "tunnel", "remote" and "vni" of a backend, only in services with an underlay */
+static int load_tunnel(struct parser *p, const XenoFlowServiceDesc *service, XenoFlowBackendDesc *b, cJSON *item)
+{
+	cJSON *tunnel = cJSON_GetObjectItem(item, "tunnel");
+	cJSON *remote = cJSON_GetObjectItem(item, "remote");
+	cJSON *vni = cJSON_GetObjectItem(item, "vni");
+	int64_t id = cJSON_IsNumber(vni) ? (int64_t)vni->valuedouble : 0;
+
+	if (tunnel == NULL)
+		return 0;
+	if (!service->underlay || b->host)
+		return invalid(p, "Service %s: backend %s cannot use a tunnel, %s", service->name, b->name,
+			       b->host ? "it is a host entry" : "the service has no underlay");
+	if (!cJSON_IsString(tunnel) || !cJSON_IsString(remote))
+		return invalid(p, "Service %s: tunnel of backend %s needs a type and a remote", service->name,
+			       b->name);
+	if (xenoflow_tunnel_parse(tunnel->valuestring, &b->tunnel) != 0)
+		return invalid(p, "Backend %s: tunnel must be vxlan, geneve or ipip", b->name);
+	if (!parse_ip(remote, &b->remote))
+		return invalid(p, "Backend %s: invalid tunnel remote '%s'", b->name, remote->valuestring);
+	if (b->tunnel != XENOFLOW_TUNNEL_IPIP && (id < 0 || id > 0xffffff))
+		return invalid(p, "Backend %s: invalid VNI %" PRId64, b->name, id);
+	b->vni = b->tunnel != XENOFLOW_TUNNEL_IPIP ? (uint32_t)id : 0;
+	return 0;
+}
+
+/* "rate_limit": {"mbps", "burst_kb"} of a backend, only in services with spillover */
+static int load_rate_limit(struct parser *p, const XenoFlowServiceDesc *service, XenoFlowBackendDesc *b,
+			   cJSON *item)
+{
+	cJSON *limit = cJSON_GetObjectItem(item, "rate_limit");
+	cJSON *mbps = cJSON_GetObjectItem(limit, "mbps");
+	cJSON *burst = cJSON_GetObjectItem(limit, "burst_kb");
+	double burst_kb = cJSON_IsNumber(burst) ? burst->valuedouble : 0;
+
+	if (limit == NULL)
+		return 0;
+	/* Red packets of a tunnel backend would reach the spill pipe already encapsulated */
+	if (service->spillover == XENOFLOW_SPILLOVER_NONE || b->host ||
+	    (b->tunnel != XENOFLOW_TUNNEL_NONE && service->spillover == XENOFLOW_SPILLOVER_REHASH))
+		return invalid(p, "Service %s: backend %s cannot have a rate limit, %s", service->name, b->name,
+			       b->host ? "it is a host entry" :
+			       b->tunnel != XENOFLOW_TUNNEL_NONE ? "it uses a tunnel and spillover is rehash" :
+								    "the service has no spillover");
+	if (!cJSON_IsNumber(mbps) || mbps->valuedouble <= 0)
+		return invalid(p, "Service %s: rate_limit of backend %s needs mbps above 0", service->name, b->name);
+	if (burst_kb < 0)
+		return invalid(p, "Backend %s: invalid rate limit %.1f Mbit/s, burst %.1f KB", b->name,
+			       mbps->valuedouble, burst_kb);
+	b->rate_limit = (uint64_t)(mbps->valuedouble * 1e6 / 8);
+	b->burst = (uint64_t)(burst_kb * 1024);
+	return 0;
+}
+
+/* One entry of a "backends" array, index only names it in messages */
+static int load_backend(struct parser *p, const XenoFlowServiceDesc *service, XenoFlowBackendDesc *b, cJSON *item,
+			int index)
+{
+	cJSON *name = cJSON_GetObjectItem(item, "name");
+	cJSON *mac = cJSON_GetObjectItem(item, "mac_address");
+	int ret;
+
+	if (!cJSON_IsString(name) || !cJSON_IsString(mac))
+		return invalid(p, "Service %s: backend %d needs a name and a mac_address", service->name, index);
+	if (strlen(name->valuestring) >= sizeof(b->name))
+		return invalid(p, "Backend name '%.16s...' is too long (max %zu)", name->valuestring,
+			       sizeof(b->name) - 1);
+	strcpy(b->name, name->valuestring);
+	if (!parse_mac(mac, b->mac_address))
+		return invalid(p, "Backend %s: invalid MAC '%s'", b->name, mac->valuestring);
+	b->host = cJSON_IsTrue(cJSON_GetObjectItem(item, "host"));
+
+	ret = load_nat(p, service, b, item);
+	if (ret == 0)
+		ret = load_tunnel(p, service, b, item);
+	if (ret == 0)
+		ret = load_rate_limit(p, service, b, item);
+	return ret;
+}
+
+static int load_backends(struct parser *p, XenoFlowServiceDesc *service, cJSON *backends)
+{
+	int n = cJSON_GetArraySize(backends);
+	int ret;
+
+	if (n == 0)
+		return invalid(p, "Service %s has no backends", service->name);
+	service->backends = calloc(n, sizeof(XenoFlowBackendDesc));
+	if (service->backends == NULL)
+		return -ENOMEM;
+
+	for (int i = 0; i < n; i++) {
+		ret = load_backend(p, service, &service->backends[i], cJSON_GetArrayItem(backends, i), i);
+		if (ret != 0)
+			return ret;
+		service->nb_backends++;
+	}
+	return 0;
+}
+
+int xenoflow_backend_parse(const XenoFlowServiceDesc *service, const struct cJSON *item, int index,
+			   XenoFlowBackendDesc *backend, char *err, size_t err_len)
+{
+	struct parser p = {.err = err, .err_len = err_len};
+
+	memset(backend, 0, sizeof(*backend));
+	if (!cJSON_IsObject(item))
+		return invalid(&p, "Service %s: backend %d is not an object", service->name, index);
+	return load_backend(&p, service, backend, (cJSON *)item, index);
+}
+
+/* Name, VIP, protocol and port of an entry of "services" */
+static int load_vip(struct parser *p, XenoFlowServiceDesc *service, cJSON *item)
+{
+	cJSON *name = cJSON_GetObjectItem(item, "name");
+	cJSON *vip = cJSON_GetObjectItem(item, "vip");
+	cJSON *protocol = cJSON_GetObjectItem(item, "protocol");
+	cJSON *port = cJSON_GetObjectItem(item, "port");
+
+	if (!cJSON_IsString(name) || !cJSON_IsString(vip) || !cJSON_IsString(protocol) || !cJSON_IsNumber(port))
+		return invalid(p, "Every service needs a name, vip, protocol and port");
+	if (name->valuestring[0] == '\0')
+		return invalid(p, "Service without a name");
+	snprintf(service->name, sizeof(service->name), "%s", name->valuestring);
+
+	if (!parse_ip(vip, &service->vip))
+		return invalid(p, "Service %s: invalid VIP '%s'", service->name, vip->valuestring);
+	if (strcasecmp(protocol->valuestring, "tcp") == 0)
+		service->protocol = IPPROTO_TCP;
+	else if (strcasecmp(protocol->valuestring, "udp") == 0)
+		service->protocol = IPPROTO_UDP;
+	else
+		return invalid(p, "Service %s: protocol must be tcp or udp", service->name);
+	if (port->valueint <= 0 || port->valueint > 65535)
+		return invalid(p, "Service %s: invalid port %d", service->name, port->valueint);
+	service->port = port->valueint;
+	return 0;
+}
+
+static char *read_file(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	char *content;
+	long length;
+
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	content = malloc(length + 1);
+	if (content != NULL) {
+		if (fread(content, 1, length, file) != (size_t)length) {
+			free(content);
+			content = NULL;
+		} else {
+			content[length] = '\0';
+		}
+	}
+	fclose(file);
+	return content;
+}
+
+int xenoflow_services_parse(const char *path, XenoFlowServicesFile *file, char *err, size_t err_len)
+{
+	struct parser p = {.err = err, .err_len = err_len};
+	XenoFlowServiceDesc *service;
+	cJSON *json, *list, *item;
+	char *content;
+	int ret = 0;
+
+	memset(file, 0, sizeof(*file));
+	content = read_file(path);
+	if (content == NULL) {
+		snprintf(err, err_len, "Failed to read config %s", path);
+		return -EIO;
+	}
+
+	json = cJSON_Parse(content);
+	free(content);
+	if (json == NULL)
+		return invalid(&p, "Failed to parse config %s near '%.32s'", path, cJSON_GetErrorPtr());
+
+	item = cJSON_GetObjectItem(json, "device");
+	if (item != NULL) {
+		if (!cJSON_IsString(item) || strlen(item->valuestring) >= sizeof(file->device)) {
+			ret = invalid(&p, "\"device\" must be a PCI address, interface name or MAC");
+			goto out;
+		}
+		strcpy(file->device, item->valuestring);
+	}
+
+	/* Room for every listed service and the default one */
+	list = cJSON_GetObjectItem(json, "services");
+	file->services = calloc(cJSON_GetArraySize(list) + 1, sizeof(XenoFlowServiceDesc));
+	if (file->services == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	cJSON_ArrayForEach(item, list) {
+		service = &file->services[file->nb_services++];
+		ret = load_vip(&p, service, item);
+		if (ret == 0)
+			ret = load_mode(&p, service, item);
+		if (ret == 0)
+			ret = load_underlay(&p, service, item);
+		if (ret == 0)
+			ret = load_spillover(&p, service, item);
+		if (ret == 0)
+			ret = load_buckets(&p, service, item);
+		if (ret == 0)
+			ret = load_backends(&p, service, cJSON_GetObjectItem(item, "backends"));
+		if (ret != 0)
+			goto out;
+	}
+
+	/* Top-level backends keep the old single-pool format working */
+	list = cJSON_GetObjectItem(json, "backends");
+	if (list != NULL) {
+		service = &file->services[file->nb_services++];
+		strcpy(service->name, "default");
+		/* and so do a top-level "underlay", "spillover" and "buckets" */
+		ret = load_underlay(&p, service, json);
+		if (ret == 0)
+			ret = load_spillover(&p, service, json);
+		if (ret == 0)
+			ret = load_buckets(&p, service, json);
+		if (ret == 0)
+			ret = load_backends(&p, service, list);
+		if (ret != 0)
+			goto out;
+	}
+
+	if (file->nb_services == 0)
+		ret = invalid(&p, "No services or backends found in %s", path);
+
+out:
+	if (ret == -ENOMEM)
+		snprintf(err, err_len, "Out of memory loading config %s", path);
+	cJSON_Delete(json);
+	return ret;
+}
+
+void xenoflow_services_file_free(XenoFlowServicesFile *file)
+{
+	for (int i = 0; file->services != NULL && i < file->nb_services; i++)
+		free(file->services[i].backends);
+	free(file->services);
+	memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,128 @@
+#ifndef SERVICES_JSON_H
+#define SERVICES_JSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Services config file parsing without DOCA, so that offline tools such as
+ * xeno_hashsim read the same files as xeno_flow. The file is parsed and
+ * checked into plain descriptions; services.c builds the services and backend
+ * pools from them, and finds duplicate names and addresses as it indexes them.
+ */
+
+struct cJSON;
+
+/* Most hash entries a service may ask for to rebalance */
+#define XENOFLOW_MAX_BUCKETS 65536
+
+/**
+ * @brief How a backend is reached, also the index of its action template in the hash pipe
+ */
+enum XenoFlowTunnel {
+	XENOFLOW_TUNNEL_NONE,		/* same L2 segment, only the MAC is rewritten */
+	XENOFLOW_TUNNEL_VXLAN,
+	XENOFLOW_TUNNEL_GENEVE,
+	XENOFLOW_TUNNEL_IPIP,		/* L3 tunnel, the inner Ethernet header is dropped */
+	XENOFLOW_TUNNEL_MAX,
+};
+
+/**
+ * @brief What a service does with packets over a backend's rate limit
+ */
+enum XenoFlowSpillover {
+	XENOFLOW_SPILLOVER_NONE,	/* no meters, backends cannot have a rate limit */
+	XENOFLOW_SPILLOVER_DROP,
+	XENOFLOW_SPILLOVER_REHASH,	/* rehash over the backends without a rate limit */
+};
+
+/**
+ * @brief A backend as the config file describes it, fields as in XenoFlowBackend
+ */
+typedef struct {
+	char name[64];
+	uint8_t mac_address[6];
+	int host;
+	uint32_t ip;		/* network order, 0 for direct server return */
+	uint16_t port;		/* host order */
+	uint8_t tunnel;		/* enum XenoFlowTunnel */
+	uint32_t remote;	/* network order */
+	uint32_t vni;
+	uint64_t rate_limit;	/* bytes per second, 0 for none */
+	uint64_t burst;		/* bytes */
+} XenoFlowBackendDesc;
+
+/**
+ * @brief A service as the config file describes it, fields as in XenoFlowService
+ */
+typedef struct {
+	char name[64];
+	uint32_t vip;		/* network order */
+	uint8_t protocol;	/* IPPROTO_TCP or IPPROTO_UDP, 0 for the default service */
+	uint16_t port;		/* host order */
+	int nat;
+	uint8_t gateway_mac[6];
+	int underlay;
+	uint32_t underlay_ip;	/* network order */
+	uint8_t underlay_mac[6];
+	uint8_t underlay_gateway_mac[6];
+	uint8_t spillover;	/* enum XenoFlowSpillover */
+	uint32_t buckets;	/* 0 for one hash entry per backend */
+	XenoFlowBackendDesc *backends;
+	int nb_backends;
+} XenoFlowServiceDesc;
+
+/**
+ * @brief Everything in a services config file
+ */
+typedef struct {
+	char device[64];		/* top-level "device", empty if it names none */
+	XenoFlowServiceDesc *services;	/* in file order, the default service last */
+	int nb_services;
+} XenoFlowServicesFile;
+
+/**
+ * @brief Parse and check a services config file, see xenoflow_services_load() for the format
+ * @param path Path of the JSON file
+ * @param file Descriptions to fill, to be freed with xenoflow_services_file_free() also on failure
+ * @param err Reason of a failure
+ * @param err_len Size of err
+ * @return 0 on success, -EIO if the file cannot be read, -EINVAL if it is invalid, -ENOMEM
+ */
+int xenoflow_services_parse(const char *path, XenoFlowServicesFile *file, char *err, size_t err_len);
+
+/**
+ * @brief Parse and check one backend the way an entry of a service's "backends" array is
+ * @param service The service the backend is for, only its own settings are looked at
+ * @param item JSON object of the backend
+ * @param index Position of the backend in its array, for the messages
+ * @param backend Description to fill
+ * @param err Reason of a failure
+ * @param err_len Size of err
+ * @return 0 on success, -EINVAL if the backend is invalid
+ */
+int xenoflow_backend_parse(const XenoFlowServiceDesc *service, const struct cJSON *item, int index,
+			   XenoFlowBackendDesc *backend, char *err, size_t err_len);
+
+/**
+ * @brief Free the descriptions of a config file
+ * @param file Descriptions, empty afterwards
+ */
+void xenoflow_services_file_free(XenoFlowServicesFile *file);
+
+/**
+ * @brief Tunnel type by name
+ * @param name "vxlan", "geneve" or "ipip", in any case
+ * @param tunnel Tunnel type found
+ * @return 0 on success, -1 for an unknown name
+ */
+int xenoflow_tunnel_parse(const char *name, uint8_t *tunnel);
+
+/**
+ * @brief Name of a tunnel type
+ * @param tunnel enum XenoFlowTunnel
+ * @return "none", "vxlan", "geneve" or "ipip"
+ */
+const char *xenoflow_tunnel_name(uint8_t tunnel);
+
+#endif /* SERVICES_JSON_H */
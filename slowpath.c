@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include <rte_byteorder.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_icmp.h>
+#include <rte_ip.h>
+
+#include <doca_log.h>
+
+#include "slowpath.h"
+
+DOCA_LOG_REGISTER(SLOWPATH);
+
+#define SLOWPATH_BURST 32
+
+/* Empty polls before a worker starts sleeping, so an idle slow path does not keep its cores busy */
+#define SLOWPATH_IDLE_POLLS 1024
+#define SLOWPATH_IDLE_SLEEP_US 50
+
+/*
+ * Default handler: answers ICMP echo requests in place and drops everything else
+ */
+static enum XenoFlowSlowPathVerdict echo_handler(struct rte_mbuf *m, uint16_t queue, void *arg)
+{
+	struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+	struct rte_ether_addr mac;
+	struct rte_ipv4_hdr *ip;
+	struct rte_icmp_hdr *icmp;
+	uint32_t ihl, addr, cksum;
+
+	(void)queue;
+	(void)arg;
+
+	if (m->data_len < sizeof(*eth) + sizeof(*ip) || eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))
+		return XENOFLOW_SLOWPATH_DROP;
+
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ihl = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * 4;
+	if (ip->next_proto_id != IPPROTO_ICMP || m->data_len < sizeof(*eth) + ihl + sizeof(*icmp) ||
+	    (rte_be_to_cpu_16(ip->fragment_offset) & (RTE_IPV4_HDR_OFFSET_MASK | RTE_IPV4_HDR_MF_FLAG)) != 0)
+		return XENOFLOW_SLOWPATH_DROP;
+
+	icmp = (struct rte_icmp_hdr *)((uint8_t *)ip + ihl);
+	if (icmp->icmp_type != RTE_IP_ICMP_ECHO_REQUEST || icmp->icmp_code != 0)
+		return XENOFLOW_SLOWPATH_DROP;
+
+	rte_ether_addr_copy(&eth->src_addr, &mac);
+	rte_ether_addr_copy(&eth->dst_addr, &eth->src_addr);
+	rte_ether_addr_copy(&mac, &eth->dst_addr);
+
+	/* Swapping the addresses leaves the IP checksum as it is */
+	addr = ip->src_addr;
+	ip->src_addr = ip->dst_addr;
+	ip->dst_addr = addr;
+
+	/* Type 8 to 0: one's complement update of the checksum, as testpmd's icmpecho does */
+	icmp->icmp_type = RTE_IP_ICMP_ECHO_REPLY;
+	cksum = ~icmp->icmp_cksum & 0xffff;
+	cksum += ~rte_cpu_to_be_16(RTE_IP_ICMP_ECHO_REQUEST << 8) & 0xffff;
+	cksum += rte_cpu_to_be_16(RTE_IP_ICMP_ECHO_REPLY << 8);
+	cksum = (cksum & 0xffff) + (cksum >> 16);
+	cksum = (cksum & 0xffff) + (cksum >> 16);
+	icmp->icmp_cksum = (uint16_t)~cksum;
+	return XENOFLOW_SLOWPATH_TX;
+}
+
+static void *worker_main(void *arg)
+{
+	XenoFlowSlowPathQueue *q = (XenoFlowSlowPathQueue *)arg;
+	XenoFlowSlowPath *sp = q->sp;
+	uint16_t queue_id = sp->queue_ids[q->index];
+	struct timespec idle = {.tv_sec = 0, .tv_nsec = SLOWPATH_IDLE_SLEEP_US * 1000L};
+	struct rte_mbuf *pkts[SLOWPATH_BURST], *tx[SLOWPATH_BURST], *drop[SLOWPATH_BURST];
+	uint32_t empty_polls = 0;
+
+	while (sp->running) {
+		uint16_t nb = rte_eth_rx_burst(sp->port_id, queue_id, pkts, SLOWPATH_BURST);
+		uint16_t nb_tx = 0, nb_drop = 0, sent;
+		uint64_t bytes = 0;
+
+		if (nb == 0) {
+			if (++empty_polls >= SLOWPATH_IDLE_POLLS)
+				nanosleep(&idle, NULL);
+			continue;
+		}
+		empty_polls = 0;
+
+		for (uint16_t i = 0; i < nb; i++) {
+			bytes += rte_pktmbuf_pkt_len(pkts[i]);
+			switch (sp->handler(pkts[i], q->index, sp->handler_arg)) {
+			case XENOFLOW_SLOWPATH_TX:
+				tx[nb_tx++] = pkts[i];
+				break;
+			case XENOFLOW_SLOWPATH_KEEP:
+				break;
+			default:
+				drop[nb_drop++] = pkts[i];
+				break;
+			}
+		}
+
+		/* Each worker has its own TX queue, the one of its RX queue */
+		sent = nb_tx > 0 ? rte_eth_tx_burst(sp->port_id, queue_id, tx, nb_tx) : 0;
+		if (sent < nb_tx) {
+			rte_pktmbuf_free_bulk(&tx[sent], nb_tx - sent);
+			atomic_fetch_add_explicit(&q->tx_drops, nb_tx - sent, memory_order_relaxed);
+		}
+		if (nb_drop > 0) {
+			rte_pktmbuf_free_bulk(drop, nb_drop);
+			atomic_fetch_add_explicit(&q->unhandled, nb_drop, memory_order_relaxed);
+		}
+
+		atomic_fetch_add_explicit(&q->pkts, nb, memory_order_relaxed);
+		atomic_fetch_add_explicit(&q->bytes, bytes, memory_order_relaxed);
+		atomic_fetch_add_explicit(&q->replies, sent, memory_order_relaxed);
+	}
+	return NULL;
+}
+
+doca_error_t xenoflow_slowpath_init(XenoFlowSlowPath *sp, uint16_t nb_queues, uint16_t port_id, uint16_t first_queue,
+				    int first_cpu)
+{
+	memset(sp, 0, sizeof(*sp));
+	if (nb_queues > XENOFLOW_SLOWPATH_MAX_QUEUES) {
+		DOCA_LOG_ERR("Slow path can use at most %d queues, got %u", XENOFLOW_SLOWPATH_MAX_QUEUES, nb_queues);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	sp->nb_queues = nb_queues;
+	sp->port_id = port_id;
+	sp->first_cpu = first_cpu;
+	sp->handler = echo_handler;
+	for (uint16_t i = 0; i < nb_queues; i++) {
+		sp->queue_ids[i] = first_queue + i;
+		sp->queues[i].sp = sp;
+		sp->queues[i].index = i;
+	}
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_slowpath_set_handler(XenoFlowSlowPath *sp, xenoflow_slowpath_handler handler, void *arg)
+{
+	sp->handler = handler;
+	sp->handler_arg = arg;
+}
+
+void xenoflow_slowpath_fwd(XenoFlowSlowPath *sp, struct doca_flow_fwd *fwd)
+{
+	/* The 5-tuple spreads one client's connections over the workers, each connection stays on one */
+	fwd->type = DOCA_FLOW_FWD_RSS;
+	fwd->rss_type = DOCA_FLOW_RESOURCE_TYPE_NON_SHARED;
+	fwd->rss.outer_flags = DOCA_FLOW_RSS_IPV4 | DOCA_FLOW_RSS_TCP | DOCA_FLOW_RSS_UDP;
+	fwd->rss.queues_array = sp->queue_ids;
+	fwd->rss.nr_queues = sp->nb_queues;
+}
+
+doca_error_t xenoflow_slowpath_start(XenoFlowSlowPath *sp)
+{
+	if (sp->nb_queues == 0)
+		return DOCA_SUCCESS;
+
+	sp->running = 1;
+	for (uint16_t i = 0; i < sp->nb_queues; i++) {
+		XenoFlowSlowPathQueue *q = &sp->queues[i];
+
+		if (pthread_create(&q->thread, NULL, worker_main, q) != 0) {
+			DOCA_LOG_ERR("Failed to start slow path worker %u", i);
+			sp->running = 0;
+			while (i-- > 0)
+				pthread_join(sp->queues[i].thread, NULL);
+			return DOCA_ERROR_OPERATING_SYSTEM;
+		}
+
+		if (sp->first_cpu >= 0) {
+			cpu_set_t cpus;
+			int err;
+
+			CPU_ZERO(&cpus);
+			CPU_SET(sp->first_cpu + i, &cpus);
+			err = pthread_setaffinity_np(q->thread, sizeof(cpus), &cpus);
+			if (err != 0)
+				DOCA_LOG_WARN("Failed to pin slow path worker %u to CPU %d: %s", i, sp->first_cpu + i,
+					      strerror(err));
+		}
+	}
+
+	DOCA_LOG_INFO("Host entries go to %u slow path queues from port %u queue %u", sp->nb_queues, sp->port_id,
+		      sp->queue_ids[0]);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_slowpath_stop(XenoFlowSlowPath *sp)
+{
+	uint64_t pkts = 0, replies = 0, unhandled = 0;
+
+	if (!sp->running)
+		return;
+
+	sp->running = 0;
+	for (uint16_t i = 0; i < sp->nb_queues; i++) {
+		pthread_join(sp->queues[i].thread, NULL);
+		pkts += atomic_load(&sp->queues[i].pkts);
+		replies += atomic_load(&sp->queues[i].replies);
+		unhandled += atomic_load(&sp->queues[i].unhandled);
+	}
+
+	DOCA_LOG_INFO("Slow path stopped: %" PRIu64 " packets, %" PRIu64 " replies, %" PRIu64 " unhandled", pkts, replies,
+		      unhandled);
+}
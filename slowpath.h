@@ -0,0 +1,112 @@
+#ifndef SLOWPATH_H
+#define SLOWPATH_H
+
+#include <doca_error.h>
+#include <doca_flow.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_mbuf.h>
+
+/*
+ * DPDK slow path of the host entries. Instead of the kernel target, host
+ * entries forward with RSS over a range of RX queues, each polled by its own
+ * worker thread, so host-bound traffic scales with the Arm cores given to it.
+ * A worker hands every packet to the handler, which answers it, keeps it or
+ * drops it; the default one answers ICMP echo requests and drops the rest.
+ */
+
+/* Most RX queues of the slow path */
+#define XENOFLOW_SLOWPATH_MAX_QUEUES 64
+
+/**
+ * @brief What the handler did with a packet
+ */
+enum XenoFlowSlowPathVerdict {
+	XENOFLOW_SLOWPATH_DROP,		/* not for us, the worker frees it */
+	XENOFLOW_SLOWPATH_TX,		/* rewritten into a reply, sent back out of the queue's port */
+	XENOFLOW_SLOWPATH_KEEP,		/* the handler took the mbuf */
+};
+
+/**
+ * @brief Per-packet handler, called on the worker thread of the queue
+ * @param m The packet
+ * @param queue Index of the queue in the slow path, 0 for the first
+ * @param arg Handler argument
+ * @return What to do with the packet
+ */
+typedef enum XenoFlowSlowPathVerdict (*xenoflow_slowpath_handler)(struct rte_mbuf *m, uint16_t queue, void *arg);
+
+typedef struct XenoFlowSlowPath XenoFlowSlowPath;
+
+/**
+ * @brief One RX queue and its worker, the counters are only written by the worker
+ */
+typedef struct {
+	XenoFlowSlowPath *sp;
+	uint16_t index;			/* in the slow path, as the handler gets it */
+	pthread_t thread;
+	_Atomic uint64_t pkts;		/* packets received */
+	_Atomic uint64_t bytes;		/* and their bytes */
+	_Atomic uint64_t replies;	/* replies sent */
+	_Atomic uint64_t unhandled;	/* packets the handler dropped */
+	_Atomic uint64_t tx_drops;	/* replies the TX queue had no room for */
+} __rte_cache_aligned XenoFlowSlowPathQueue;
+
+/**
+ * @brief Slow path state, nb_queues 0 means host entries go to the kernel
+ */
+struct XenoFlowSlowPath {
+	uint16_t nb_queues;
+	uint16_t port_id;				/* DPDK port the host traffic arrives on */
+	uint16_t queue_ids[XENOFLOW_SLOWPATH_MAX_QUEUES]; /* its RX queues, also the TX queues of the replies */
+	int first_cpu;					/* worker i is pinned to first_cpu + i, -1 for no pinning */
+	xenoflow_slowpath_handler handler;
+	void *handler_arg;
+	volatile int running;
+	XenoFlowSlowPathQueue queues[XENOFLOW_SLOWPATH_MAX_QUEUES];
+};
+
+/**
+ * @brief Set up the slow path with the default handler
+ * @param sp Slow path to initialize
+ * @param nb_queues RX queues to spread host traffic over, 0 to keep the kernel target
+ * @param port_id DPDK port the host traffic arrives on
+ * @param first_queue First of the RX queues, the others follow it
+ * @param first_cpu CPU of the first worker, -1 to leave the workers unpinned
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_slowpath_init(XenoFlowSlowPath *sp, uint16_t nb_queues, uint16_t port_id, uint16_t first_queue,
+				    int first_cpu);
+
+/**
+ * @brief Replace the packet handler, before xenoflow_slowpath_start()
+ * @param sp The slow path
+ * @param handler Handler of every packet
+ * @param arg Handler argument
+ */
+void xenoflow_slowpath_set_handler(XenoFlowSlowPath *sp, xenoflow_slowpath_handler handler, void *arg);
+
+/**
+ * @brief Fill the forward of a host entry: RSS over the slow path's queues
+ * @param sp The slow path, with nb_queues not 0
+ * @param fwd Forward to fill
+ */
+void xenoflow_slowpath_fwd(XenoFlowSlowPath *sp, struct doca_flow_fwd *fwd);
+
+/**
+ * @brief Start one worker per queue
+ * @param sp The slow path
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_slowpath_start(XenoFlowSlowPath *sp);
+
+/**
+ * @brief Stop the workers
+ * @param sp The slow path
+ */
+void xenoflow_slowpath_stop(XenoFlowSlowPath *sp);
+
+#endif /* SLOWPATH_H */
@@ -0,0 +1,369 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <doca_log.h>
+
+#include "snapshot.h"
+
+DOCA_LOG_REGISTER(SNAPSHOT);
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Region layout: header, services, backends, counters, owners */
+static size_t backends_offset(uint32_t nb_services)
+{
+	return sizeof(XenoFlowSnapRegionHeader) + nb_services * sizeof(XenoFlowSnapService);
+}
+
+static size_t counters_offset(uint32_t nb_services, uint32_t nb_counters)
+{
+	return backends_offset(nb_services) + nb_counters * sizeof(XenoFlowSnapBackend);
+}
+
+static size_t owners_offset(uint32_t nb_services, uint32_t nb_counters)
+{
+	return counters_offset(nb_services, nb_counters) + nb_counters * sizeof(XenoFlowSnapCounter);
+}
+
+static uint64_t region_size(uint32_t nb_services, uint32_t nb_counters)
+{
+	return (owners_offset(nb_services, nb_counters) + nb_counters * sizeof(uint32_t) + 7) & ~(size_t)7;
+}
+
+uint64_t xenoflow_snapshot_config_version(const char *path)
+{
+	uint64_t hash = FNV_OFFSET;
+	char buf[4096];
+	size_t len;
+	FILE *f;
+
+	if (path == NULL || path[0] == '\0')
+		return hash;
+
+	f = fopen(path, "rb");
+	if (f == NULL)
+		return 0;
+	while ((len = fread(buf, 1, sizeof(buf), f)) > 0)
+		hash = fnv1a(hash, buf, len);
+	if (ferror(f))
+		hash = 0;
+	fclose(f);
+	return hash;
+}
+
+static void image_set(XenoFlowSnapshotImage *image, uint32_t nb_services, uint32_t nb_counters)
+{
+	uint8_t *region = image->buf;
+
+	image->header = (const XenoFlowSnapRegionHeader *)region;
+	image->services = (const XenoFlowSnapService *)(region + sizeof(XenoFlowSnapRegionHeader));
+	image->backends = (const XenoFlowSnapBackend *)(region + backends_offset(nb_services));
+	image->counters = (const XenoFlowSnapCounter *)(region + counters_offset(nb_services, nb_counters));
+	image->owners = (const uint32_t *)(region + owners_offset(nb_services, nb_counters));
+}
+
+/*
+ * Read one region, 0 if it is complete and its checksum matches
+ */
+static int read_region(int fd, off_t offset, uint64_t size, uint8_t *buf)
+{
+	const XenoFlowSnapRegionHeader *header = (const XenoFlowSnapRegionHeader *)buf;
+
+	if (pread(fd, buf, size, offset) != (ssize_t)size)
+		return -1;
+	if (header->seq == 0)
+		return -1;
+	return fnv1a(FNV_OFFSET, buf + sizeof(*header), size - sizeof(*header)) == header->checksum ? 0 : -1;
+}
+
+/*
+ * The region must describe the same services with the same pipes, and its indexes must stay in bounds
+ */
+static int image_matches(const XenoFlowSnapshotImage *image, const XenoFlowServices *services, uint32_t nb_counters)
+{
+	uint32_t nb_backends = image->header->nb_backends;
+
+	if (nb_backends > nb_counters)
+		return 0;
+	for (int s = 0; s < services->numServices; s++) {
+		const XenoFlowService *service = services->services[s];
+		const XenoFlowSnapService *saved = &image->services[s];
+
+		if (strncmp(saved->name, service->name, sizeof(saved->name)) != 0 ||
+		    saved->hash_pipe_entries != service->hash_pipe_entries ||
+		    saved->counter_base != service->counter_base || saved->first_backend > nb_backends ||
+		    saved->nb_backends > nb_backends - saved->first_backend)
+			return 0;
+	}
+	for (uint32_t i = 0; i < nb_counters; i++)
+		if (image->owners[i] != XENOFLOW_SNAPSHOT_NO_OWNER && image->owners[i] >= nb_backends)
+			return 0;
+	return 1;
+}
+
+doca_error_t xenoflow_snapshot_load(const char *path, const XenoFlowServices *services, uint32_t nb_counters,
+				    uint64_t config_version, XenoFlowSnapshotImage *image)
+{
+	uint32_t nb_services = (uint32_t)services->numServices;
+	uint64_t size = region_size(nb_services, nb_counters);
+	XenoFlowSnapFileHeader file;
+	uint8_t *regions[2] = {NULL, NULL};
+	int valid[2], fd, best;
+
+	memset(image, 0, sizeof(*image));
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		DOCA_LOG_INFO("No snapshot at %s (%s), cold start", path, strerror(errno));
+		return DOCA_ERROR_NOT_FOUND;
+	}
+
+	if (pread(fd, &file, sizeof(file), 0) != sizeof(file) || file.magic != XENOFLOW_SNAPSHOT_MAGIC ||
+	    file.format != XENOFLOW_SNAPSHOT_FORMAT || file.nb_services != nb_services ||
+	    file.nb_counters != nb_counters || file.region_size != size) {
+		DOCA_LOG_WARN("Snapshot %s is not for this layout, cold start", path);
+		close(fd);
+		return DOCA_ERROR_NOT_FOUND;
+	}
+
+	regions[0] = malloc(size);
+	regions[1] = malloc(size);
+	if (regions[0] == NULL || regions[1] == NULL) {
+		free(regions[0]);
+		free(regions[1]);
+		close(fd);
+		return DOCA_ERROR_NO_MEMORY;
+	}
+	for (int r = 0; r < 2; r++)
+		valid[r] = read_region(fd, sizeof(file) + r * size, size, regions[r]) == 0;
+	close(fd);
+
+	if (!valid[0] && !valid[1]) {
+		DOCA_LOG_WARN("Snapshot %s has no complete region, cold start", path);
+		free(regions[0]);
+		free(regions[1]);
+		return DOCA_ERROR_NOT_FOUND;
+	}
+	if (valid[0] && valid[1])
+		best = ((XenoFlowSnapRegionHeader *)regions[1])->seq > ((XenoFlowSnapRegionHeader *)regions[0])->seq;
+	else
+		best = valid[1];
+	image->buf = regions[best];
+	free(regions[!best]);
+	image_set(image, nb_services, nb_counters);
+
+	if (image->header->config_version != config_version) {
+		DOCA_LOG_WARN("Snapshot %s was taken with another config, cold start", path);
+		xenoflow_snapshot_image_free(image);
+		return DOCA_ERROR_NOT_FOUND;
+	}
+	if (!image_matches(image, services, nb_counters)) {
+		DOCA_LOG_WARN("Snapshot %s does not match the services of the config, cold start", path);
+		xenoflow_snapshot_image_free(image);
+		return DOCA_ERROR_NOT_FOUND;
+	}
+
+	DOCA_LOG_INFO("Snapshot %s: %u backends, %.1f s old", path, image->header->nb_backends,
+		      (clock_ns(CLOCK_REALTIME) - image->header->written_ns) / 1e9);
+	return DOCA_SUCCESS;
+}
+
+void xenoflow_snapshot_image_free(XenoFlowSnapshotImage *image)
+{
+	free(image->buf);
+	memset(image, 0, sizeof(*image));
+}
+
+static void save_backend(XenoFlowSnapBackend *saved, const XenoFlowBackend *b)
+{
+	memset(saved, 0, sizeof(*saved));
+	memcpy(saved->name, b->name, sizeof(saved->name));
+	memcpy(saved->mac_address, b->mac_address, sizeof(saved->mac_address));
+	saved->host = (uint8_t)b->host;
+	saved->tunnel = b->tunnel;
+	saved->ip = b->ip;
+	saved->port = b->port;
+	saved->remote = b->remote;
+	saved->vni = b->vni;
+	saved->entry_index = b->entry_index;
+	saved->rate_limit = b->rate_limit;
+	saved->burst = b->burst;
+}
+
+/*
+ * Fill a region after its header, returns the number of backends
+ */
+static uint32_t fill_region(XenoFlowSnapshot *snap, uint8_t *region, const XenoFlowServices *services,
+			    const XenoFlowCounters *counters)
+{
+	XenoFlowSnapService *saved_services = (XenoFlowSnapService *)(region + sizeof(XenoFlowSnapRegionHeader));
+	XenoFlowSnapBackend *saved_backends = (XenoFlowSnapBackend *)(region + backends_offset(snap->nb_services));
+	XenoFlowSnapCounter *saved_counters =
+		(XenoFlowSnapCounter *)(region + counters_offset(snap->nb_services, snap->nb_counters));
+	uint32_t *owners = (uint32_t *)(region + owners_offset(snap->nb_services, snap->nb_counters));
+	uint32_t nb_backends = 0;
+
+	for (uint32_t i = 0; i < snap->nb_counters; i++) {
+		owners[i] = XENOFLOW_SNAPSHOT_NO_OWNER;
+		saved_counters[i].pkts = counters->results[i].counter.total_pkts;
+		saved_counters[i].bytes = counters->results[i].counter.total_bytes;
+	}
+
+	for (uint32_t s = 0; s < snap->nb_services && s < (uint32_t)services->numServices; s++) {
+		const XenoFlowService *service = services->services[s];
+		const XenoFlowConfig *config = service->config;
+		XenoFlowSnapService *saved = &saved_services[s];
+		uint32_t first = nb_backends;
+
+		memset(saved, 0, sizeof(*saved));
+		memcpy(saved->name, service->name, sizeof(saved->name));
+		saved->hash_pipe_entries = service->hash_pipe_entries;
+		saved->counter_base = service->counter_base;
+		saved->first_backend = first;
+
+		for (int i = 0; i < config->numBackends && nb_backends < snap->nb_counters; i++)
+			save_backend(&saved_backends[nb_backends++], config->backends[i]);
+		saved->nb_backends = nb_backends - first;
+
+		/* Owners by their position in the pool, which is where they were just saved */
+		for (uint32_t i = 0; i < service->hash_pipe_entries; i++) {
+			const XenoFlowBackend *b = service->slots != NULL ? service->slots[i] : NULL;
+			uint32_t idx = service->counter_base + i;
+
+			if (b != NULL && idx < snap->nb_counters && (uint32_t)b->pool_index < saved->nb_backends)
+				owners[idx] = first + b->pool_index;
+		}
+	}
+	return nb_backends;
+}
+
+void xenoflow_snapshot_write(XenoFlowSnapshot *snap, const XenoFlowServices *services,
+			     const XenoFlowCounters *counters)
+{
+	uint64_t start = clock_ns(CLOCK_MONOTONIC);
+	uint64_t seq = snap->seq + 1;
+	XenoFlowSnapRegionHeader *header;
+	uint8_t *region;
+
+	if (snap->map == NULL)
+		return;
+	region = (uint8_t *)snap->map + sizeof(XenoFlowSnapFileHeader) + (seq % 2) * snap->region_size;
+	header = (XenoFlowSnapRegionHeader *)region;
+
+	/* Invalid while it is written, the other region stays the one a restart picks */
+	header->seq = 0;
+	atomic_thread_fence(memory_order_release);
+
+	header->nb_backends = fill_region(snap, region, services, counters);
+	header->config_version = snap->config_version;
+	header->written_ns = clock_ns(CLOCK_REALTIME);
+	header->checksum = fnv1a(FNV_OFFSET, region + sizeof(*header), snap->region_size - sizeof(*header));
+
+	atomic_thread_fence(memory_order_release);
+	header->seq = seq;
+
+	/* The page cache outlives a crash of the process, this only bounds the loss on a crash of the host */
+	msync(snap->map, snap->size, MS_ASYNC);
+
+	snap->seq = seq;
+	snap->nb_writes++;
+	snap->last_write_ns = clock_ns(CLOCK_MONOTONIC) - start;
+}
+
+doca_error_t xenoflow_snapshot_open(XenoFlowSnapshot *snap, const char *path, const XenoFlowServices *services,
+				    const XenoFlowCounters *counters, uint64_t config_version)
+{
+	XenoFlowSnapFileHeader *file;
+	char tmp[PATH_MAX];
+	int fd;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->nb_services = (uint32_t)services->numServices;
+	snap->nb_counters = counters->nb_counters;
+	snap->config_version = config_version;
+	snap->region_size = region_size(snap->nb_services, snap->nb_counters);
+	snap->size = sizeof(XenoFlowSnapFileHeader) + 2 * snap->region_size;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+		DOCA_LOG_ERR("Snapshot path %s is too long", path);
+		return DOCA_ERROR_INVALID_VALUE;
+	}
+
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		DOCA_LOG_ERR("Failed to create snapshot %s: %s", tmp, strerror(errno));
+		return DOCA_ERROR_IO_FAILED;
+	}
+	if (ftruncate(fd, (off_t)snap->size) != 0) {
+		DOCA_LOG_ERR("Failed to size snapshot %s: %s", tmp, strerror(errno));
+		close(fd);
+		goto fail;
+	}
+	/* The mapping keeps the file open */
+	snap->map = mmap(NULL, snap->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (snap->map == MAP_FAILED) {
+		snap->map = NULL;
+		DOCA_LOG_ERR("Failed to map snapshot %s: %s", tmp, strerror(errno));
+		goto fail;
+	}
+
+	file = (XenoFlowSnapFileHeader *)snap->map;
+	file->magic = XENOFLOW_SNAPSHOT_MAGIC;
+	file->format = XENOFLOW_SNAPSHOT_FORMAT;
+	file->nb_services = snap->nb_services;
+	file->nb_counters = snap->nb_counters;
+	file->region_size = snap->region_size;
+
+	/* The old file stays in place until the new one has a complete region */
+	xenoflow_snapshot_write(snap, services, counters);
+	if (rename(tmp, path) != 0) {
+		DOCA_LOG_ERR("Failed to replace snapshot %s: %s", path, strerror(errno));
+		goto fail;
+	}
+
+	DOCA_LOG_INFO("Snapshotting to %s, %zu bytes", path, snap->size);
+	return DOCA_SUCCESS;
+
+fail:
+	xenoflow_snapshot_close(snap);
+	unlink(tmp);
+	return DOCA_ERROR_IO_FAILED;
+}
+
+void xenoflow_snapshot_close(XenoFlowSnapshot *snap)
+{
+	if (snap->map != NULL) {
+		msync(snap->map, snap->size, MS_SYNC);
+		munmap(snap->map, snap->size);
+		snap->map = NULL;
+	}
+}
@@ -0,0 +1,161 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <doca_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "counters.h"
+#include "services.h"
+
+/*
+ * State snapshot for warm starts. The file is memory mapped and holds two
+ * regions written alternately, each with a sequence number and a checksum, so
+ * a crash in the middle of a write leaves the other region intact. A region
+ * holds the backends of every service, the owner of every hash entry and the
+ * counter of every hash entry. It is only restored into the same pipe layout
+ * built from the same config file, told apart by the config version.
+ */
+
+#define XENOFLOW_SNAPSHOT_MAGIC 0x50414e534f4e4558ULL /* "XENOSNAP" */
+#define XENOFLOW_SNAPSHOT_FORMAT 1
+
+/* Hash entry without an owner in XenoFlowSnapshotImage.owners */
+#define XENOFLOW_SNAPSHOT_NO_OWNER UINT32_MAX
+
+/**
+ * @brief Start of the file, then two regions of region_size bytes
+ */
+typedef struct {
+	uint64_t magic;
+	uint32_t format;
+	uint32_t nb_services;
+	uint32_t nb_counters;		/* hash entries over all services, also the most backends */
+	uint32_t reserved;
+	uint64_t region_size;
+} XenoFlowSnapFileHeader;
+
+/**
+ * @brief Start of a region, seq 0 while it is being written
+ */
+typedef struct {
+	uint64_t seq;
+	uint64_t checksum;		/* FNV-1a of the region after this header */
+	uint64_t config_version;
+	uint64_t written_ns;		/* CLOCK_REALTIME */
+	uint32_t nb_backends;
+	uint32_t reserved;
+} XenoFlowSnapRegionHeader;
+
+typedef struct {
+	char name[64];
+	uint32_t hash_pipe_entries;
+	uint32_t counter_base;
+	uint32_t first_backend;		/* its backends in XenoFlowSnapshotImage.backends */
+	uint32_t nb_backends;
+} XenoFlowSnapService;
+
+typedef struct {
+	char name[64];
+	uint8_t mac_address[6];
+	uint8_t host;
+	uint8_t tunnel;
+	doca_be32_t ip;
+	uint16_t port;
+	uint16_t reserved;
+	doca_be32_t remote;
+	uint32_t vni;
+	uint32_t entry_index;
+	uint64_t rate_limit;
+	uint64_t burst;
+} XenoFlowSnapBackend;
+
+typedef struct {
+	uint64_t pkts;
+	uint64_t bytes;
+} XenoFlowSnapCounter;
+
+/**
+ * @brief A valid region read back from a file
+ */
+typedef struct {
+	void *buf;			/* copy of the region */
+	const XenoFlowSnapRegionHeader *header;
+	const XenoFlowSnapService *services;
+	const XenoFlowSnapBackend *backends;
+	const uint32_t *owners;		/* backend index owning counter i, or XENOFLOW_SNAPSHOT_NO_OWNER */
+	const XenoFlowSnapCounter *counters;
+} XenoFlowSnapshotImage;
+
+/**
+ * @brief Writer side of a snapshot file
+ */
+typedef struct {
+	void *map;			/* the whole file */
+	size_t size;
+	uint64_t region_size;
+	uint32_t nb_services;
+	uint32_t nb_counters;
+	uint64_t config_version;
+	uint64_t seq;			/* of the last region written */
+	uint64_t nb_writes;
+	uint64_t last_write_ns;		/* time the last write took */
+} XenoFlowSnapshot;
+
+/**
+ * @brief Version of a config file, a hash of its contents
+ * @param path Config file, NULL or empty for the built-in pool
+ * @return The version, 0 if the file cannot be read
+ */
+uint64_t xenoflow_snapshot_config_version(const char *path);
+
+/**
+ * @brief Read the newest valid region of a snapshot file made for this layout
+ * @param path Snapshot file
+ * @param services Services as loaded from the config, their pipe sizes and counter bases set
+ * @param nb_counters Hash entries over all services
+ * @param config_version Version of the config the services were loaded from
+ * @param image Region read, free with xenoflow_snapshot_image_free()
+ * @return DOCA_SUCCESS on success, DOCA_ERROR_NOT_FOUND without a usable snapshot
+ */
+doca_error_t xenoflow_snapshot_load(const char *path, const XenoFlowServices *services, uint32_t nb_counters,
+				    uint64_t config_version, XenoFlowSnapshotImage *image);
+
+/**
+ * @brief Free a region read by xenoflow_snapshot_load()
+ * @param image The region
+ */
+void xenoflow_snapshot_image_free(XenoFlowSnapshotImage *image);
+
+/**
+ * @brief Create a new snapshot file with a first region and put it in place of the old one
+ *
+ * The file is built next to path and renamed over it, so a process still
+ * mapping the old file is not affected.
+ *
+ * @param snap Writer to initialize
+ * @param path Snapshot file
+ * @param services Running services, the caller holds their lock
+ * @param counters Counters of the hash entries, collected
+ * @param config_version Version of the running config
+ * @return DOCA_SUCCESS on success, error code otherwise
+ */
+doca_error_t xenoflow_snapshot_open(XenoFlowSnapshot *snap, const char *path, const XenoFlowServices *services,
+				    const XenoFlowCounters *counters, uint64_t config_version);
+
+/**
+ * @brief Write the region not written last
+ * @param snap Writer
+ * @param services Running services, the caller holds their lock
+ * @param counters Counters of the hash entries, collected
+ */
+void xenoflow_snapshot_write(XenoFlowSnapshot *snap, const XenoFlowServices *services,
+			     const XenoFlowCounters *counters);
+
+/**
+ * @brief Flush and unmap the file
+ * @param snap Writer, may be one that was never opened
+ */
+void xenoflow_snapshot_close(XenoFlowSnapshot *snap);
+
+#endif /* SNAPSHOT_H */
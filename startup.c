@@ -0,0 +1,91 @@
+#include <string.h>
+#include <time.h>
+
+#include <doca_log.h>
+
+#include "startup.h"
+
+DOCA_LOG_REGISTER(STARTUP);
+
+XenoFlowStartup xenoflow_startup = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void xenoflow_startup_init(void)
+{
+	pthread_mutex_lock(&xenoflow_startup.lock);
+	xenoflow_startup.origin_ns = monotonic_ns();
+	xenoflow_startup.ready_ns = 0;
+	xenoflow_startup.mode = NULL;
+	xenoflow_startup.nb_phases = 0;
+	pthread_mutex_unlock(&xenoflow_startup.lock);
+}
+
+int xenoflow_phase_begin(const char *name, int parallel)
+{
+	uint64_t now = monotonic_ns();
+	int id = -1;
+
+	pthread_mutex_lock(&xenoflow_startup.lock);
+	if (xenoflow_startup.nb_phases < XENOFLOW_STARTUP_MAX_PHASES) {
+		XenoFlowStartupPhase *phase = &xenoflow_startup.phases[xenoflow_startup.nb_phases];
+
+		phase->name = name;
+		phase->start_ns = now - xenoflow_startup.origin_ns;
+		phase->end_ns = 0;
+		phase->parallel = parallel;
+		id = (int)xenoflow_startup.nb_phases++;
+	}
+	pthread_mutex_unlock(&xenoflow_startup.lock);
+	return id;
+}
+
+void xenoflow_phase_end(int id)
+{
+	uint64_t now = monotonic_ns();
+
+	if (id < 0)
+		return;
+	pthread_mutex_lock(&xenoflow_startup.lock);
+	xenoflow_startup.phases[id].end_ns = now - xenoflow_startup.origin_ns;
+	pthread_mutex_unlock(&xenoflow_startup.lock);
+}
+
+void xenoflow_startup_ready(const char *mode)
+{
+	XenoFlowStartup copy;
+
+	pthread_mutex_lock(&xenoflow_startup.lock);
+	xenoflow_startup.ready_ns = monotonic_ns() - xenoflow_startup.origin_ns;
+	xenoflow_startup.mode = mode;
+	pthread_mutex_unlock(&xenoflow_startup.lock);
+
+	xenoflow_startup_get(&copy);
+	DOCA_LOG_INFO("Serving %.1f ms after start (%s start)", copy.ready_ns / 1e6, mode);
+	for (uint32_t i = 0; i < copy.nb_phases; i++) {
+		const XenoFlowStartupPhase *phase = &copy.phases[i];
+
+		if (phase->end_ns == 0)
+			DOCA_LOG_INFO("  %-12s at %8.1f ms, still running", phase->name, phase->start_ns / 1e6);
+		else
+			DOCA_LOG_INFO("  %-12s at %8.1f ms, %8.1f ms%s", phase->name, phase->start_ns / 1e6,
+				      (phase->end_ns - phase->start_ns) / 1e6, phase->parallel ? " (parallel)" : "");
+	}
+}
+
+void xenoflow_startup_get(XenoFlowStartup *copy)
+{
+	pthread_mutex_lock(&xenoflow_startup.lock);
+	copy->origin_ns = xenoflow_startup.origin_ns;
+	copy->ready_ns = xenoflow_startup.ready_ns;
+	copy->mode = xenoflow_startup.mode;
+	copy->nb_phases = xenoflow_startup.nb_phases;
+	memcpy(copy->phases, xenoflow_startup.phases, copy->nb_phases * sizeof(copy->phases[0]));
+	pthread_mutex_unlock(&xenoflow_startup.lock);
+}
@@ -0,0 +1,65 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/*
+ * Startup phase timing. Every phase records its start and end relative to
+ * xenoflow_startup_init() at the top of main(); phases on other threads
+ * overlap those of the main thread, so the sum of the durations is more than
+ * the time to serving. Reported in the log once serving and at /api/startup.
+ */
+
+#define XENOFLOW_STARTUP_MAX_PHASES 32
+
+typedef struct {
+	const char *name;	/* static string */
+	uint64_t start_ns;	/* since xenoflow_startup_init() */
+	uint64_t end_ns;	/* 0 while running */
+	int parallel;		/* ran on its own thread, next to the main thread */
+} XenoFlowStartupPhase;
+
+typedef struct {
+	pthread_mutex_t lock;
+	uint64_t origin_ns;	/* CLOCK_MONOTONIC at xenoflow_startup_init() */
+	uint64_t ready_ns;	/* since the origin, 0 until serving */
+	const char *mode;	/* "cold", "warm" or "takeover" once serving */
+	uint32_t nb_phases;
+	XenoFlowStartupPhase phases[XENOFLOW_STARTUP_MAX_PHASES];
+} XenoFlowStartup;
+
+extern XenoFlowStartup xenoflow_startup;
+
+/**
+ * @brief Start the clock, first thing in main()
+ */
+void xenoflow_startup_init(void);
+
+/**
+ * @brief Record the start of a phase, callable from any thread
+ * @param name Phase name, a static string
+ * @param parallel The phase runs on its own thread
+ * @return Phase id for xenoflow_phase_end(), -1 once XENOFLOW_STARTUP_MAX_PHASES are recorded
+ */
+int xenoflow_phase_begin(const char *name, int parallel);
+
+/**
+ * @brief Record the end of a phase
+ * @param id Phase id from xenoflow_phase_begin(), -1 is ignored
+ */
+void xenoflow_phase_end(int id);
+
+/**
+ * @brief Record the time traffic is served from and log every phase
+ * @param mode "cold", "warm" or "takeover", a static string
+ */
+void xenoflow_startup_ready(const char *mode);
+
+/**
+ * @brief Copy the phases, e.g. for the API
+ * @param copy Filled with a consistent copy, its lock is not initialized
+ */
+void xenoflow_startup_get(XenoFlowStartup *copy);
+
+#endif /* STARTUP_H */
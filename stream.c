@@ -0,0 +1,365 @@
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stream.h"
+
+typedef struct {
+	char *data;
+	size_t len;
+	size_t cap;
+	int failed;
+} FrameBuf;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void buf_reserve(FrameBuf *buf, size_t len)
+{
+	char *data;
+	size_t cap;
+
+	if (buf->failed || buf->len + len <= buf->cap)
+		return;
+	cap = buf->cap > 0 ? buf->cap : 4096;
+	while (cap < buf->len + len)
+		cap *= 2;
+	data = realloc(buf->data, cap);
+	if (data == NULL) {
+		buf->failed = 1;
+		return;
+	}
+	buf->data = data;
+	buf->cap = cap;
+}
+
+static void buf_printf(FrameBuf *buf, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	buf_reserve(buf, len + 1);
+	if (buf->failed)
+		return;
+	va_start(ap, fmt);
+	vsnprintf(buf->data + buf->len, len + 1, fmt, ap);
+	va_end(ap);
+	buf->len += len;
+}
+
+/* Names come from the config and the API, so they are escaped for JSON */
+static void buf_string(FrameBuf *buf, const char *str)
+{
+	buf_reserve(buf, strlen(str) * 6 + 2);
+	if (buf->failed)
+		return;
+	buf->data[buf->len++] = '"';
+	for (; *str != '\0'; str++) {
+		unsigned char c = (unsigned char)*str;
+
+		if (c == '"' || c == '\\') {
+			buf->data[buf->len++] = '\\';
+			buf->data[buf->len++] = c;
+		} else if (c < 0x20) {
+			buf->len += sprintf(buf->data + buf->len, "\\u%04x", c);
+		} else {
+			buf->data[buf->len++] = c;
+		}
+	}
+	buf->data[buf->len++] = '"';
+}
+
+static void frame_release(XenoFlowStreamFrame *frame)
+{
+	if (frame != NULL && --frame->refs == 0)
+		free(frame);
+}
+
+void xenoflow_stream_init(XenoFlowStream *stream)
+{
+	memset(stream, 0, sizeof(*stream));
+	pthread_mutex_init(&stream->lock, NULL);
+}
+
+uint32_t xenoflow_stream_subscribers(XenoFlowStream *stream)
+{
+	uint32_t nb_subs;
+
+	pthread_mutex_lock(&stream->lock);
+	nb_subs = stream->nb_subs;
+	pthread_mutex_unlock(&stream->lock);
+	return nb_subs;
+}
+
+static int layout_changed(const XenoFlowStream *stream, const XenoFlowStreamSample *samples, uint32_t nb_samples)
+{
+	if (nb_samples != stream->nb_samples)
+		return 1;
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		/* A counter going back is a backend that was replaced in place */
+		if (samples[i].key != stream->keys[i] || samples[i].pkts < stream->pkts[i] ||
+		    samples[i].bytes < stream->bytes[i])
+			return 1;
+	}
+	return 0;
+}
+
+static void encode_full(FrameBuf *buf, uint64_t seq, double dt_ms, const XenoFlowStreamSample *samples,
+			uint32_t nb_samples)
+{
+	buf_printf(buf, "id: %" PRIu64 "\nevent: full\ndata: {\"seq\":%" PRIu64 ",\"dt\":%.1f,\"backends\":[", seq,
+		   seq, dt_ms);
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		buf_printf(buf, "%s{\"service\":", i > 0 ? "," : "");
+		buf_string(buf, samples[i].service);
+		buf_printf(buf, ",\"name\":");
+		buf_string(buf, samples[i].name);
+		buf_printf(buf, ",\"pkts\":%" PRIu64 ",\"bytes\":%" PRIu64 "}", samples[i].pkts, samples[i].bytes);
+	}
+	buf_printf(buf, "]}\n\n");
+}
+
+/* Only the backends whose counters moved, as [index, packets, bytes] since the frame before */
+static void encode_delta(FrameBuf *buf, const XenoFlowStream *stream, uint64_t seq, double dt_ms,
+			 const XenoFlowStreamSample *samples, uint32_t nb_samples)
+{
+	int first = 1;
+
+	buf_printf(buf, "id: %" PRIu64 "\nevent: delta\ndata: {\"seq\":%" PRIu64 ",\"dt\":%.1f,\"d\":[", seq, seq,
+		   dt_ms);
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		uint64_t pkts = samples[i].pkts - stream->pkts[i];
+		uint64_t bytes = samples[i].bytes - stream->bytes[i];
+
+		if (pkts == 0 && bytes == 0)
+			continue;
+		buf_printf(buf, "%s[%u,%" PRIu64 ",%" PRIu64 "]", first ? "" : ",", i, pkts, bytes);
+		first = 0;
+	}
+	buf_printf(buf, "]}\n\n");
+}
+
+static int remember_samples(XenoFlowStream *stream, const XenoFlowStreamSample *samples, uint32_t nb_samples)
+{
+	if (nb_samples != stream->nb_samples) {
+		size_t n = nb_samples > 0 ? nb_samples : 1;
+		const void **keys = realloc(stream->keys, n * sizeof(*keys));
+		uint64_t *pkts, *bytes;
+
+		if (keys != NULL)
+			stream->keys = keys;
+		pkts = realloc(stream->pkts, n * sizeof(*pkts));
+		if (pkts != NULL)
+			stream->pkts = pkts;
+		bytes = realloc(stream->bytes, n * sizeof(*bytes));
+		if (bytes != NULL)
+			stream->bytes = bytes;
+		if (keys == NULL || pkts == NULL || bytes == NULL) {
+			stream->nb_samples = 0;
+			return -1;
+		}
+		stream->nb_samples = nb_samples;
+	}
+	for (uint32_t i = 0; i < nb_samples; i++) {
+		stream->keys[i] = samples[i].key;
+		stream->pkts[i] = samples[i].pkts;
+		stream->bytes[i] = samples[i].bytes;
+	}
+	return 0;
+}
+
+int xenoflow_stream_publish(XenoFlowStream *stream, const XenoFlowStreamSample *samples, uint32_t nb_samples)
+{
+	FrameBuf buf = {0};
+	XenoFlowStreamFrame *frame, **slot;
+	uint64_t now = now_ns(), seq;
+	double dt_ms;
+	int full;
+
+	/* Only this thread publishes, so the previous counters are read without the lock */
+	pthread_mutex_lock(&stream->lock);
+	seq = stream->seq + 1;
+	full = stream->want_full || stream->seq == 0;
+	stream->want_full = 0;
+	pthread_mutex_unlock(&stream->lock);
+
+	dt_ms = stream->last_ns != 0 ? (now - stream->last_ns) / 1e6 : 0;
+	if (full || layout_changed(stream, samples, nb_samples)) {
+		full = 1;
+		encode_full(&buf, seq, dt_ms, samples, nb_samples);
+	} else {
+		encode_delta(&buf, stream, seq, dt_ms, samples, nb_samples);
+	}
+
+	frame = buf.failed ? NULL : malloc(sizeof(*frame) + buf.len);
+	if (frame == NULL || remember_samples(stream, samples, nb_samples) != 0) {
+		free(frame);
+		free(buf.data);
+		/* Whoever waits for a full frame still gets one next time */
+		pthread_mutex_lock(&stream->lock);
+		stream->want_full |= full;
+		pthread_mutex_unlock(&stream->lock);
+		return -1;
+	}
+	frame->seq = seq;
+	frame->full = full;
+	frame->refs = 1;
+	frame->len = buf.len;
+	memcpy(frame->data, buf.data, buf.len);
+	free(buf.data);
+	stream->last_ns = now;
+
+	pthread_mutex_lock(&stream->lock);
+	slot = &stream->ring[seq % XENOFLOW_STREAM_FRAMES];
+	frame_release(*slot);
+	*slot = frame;
+	stream->seq = seq;
+	stream->nb_frames++;
+	if (full)
+		stream->nb_full_frames++;
+	for (XenoFlowStreamSub *sub = stream->subs; sub != NULL; sub = sub->next) {
+		if (sub->waiting) {
+			sub->waiting = 0;
+			sub->wake(sub->arg);
+		}
+	}
+	pthread_mutex_unlock(&stream->lock);
+	return 0;
+}
+
+void xenoflow_stream_subscribe(XenoFlowStream *stream, XenoFlowStreamSub *sub)
+{
+	pthread_mutex_lock(&stream->lock);
+	sub->frame = NULL;
+	sub->offset = 0;
+	sub->waiting = 0;
+	sub->need_full = 1;
+	sub->joined_seq = stream->seq;
+	sub->next = stream->subs;
+	stream->subs = sub;
+	stream->nb_subs++;
+	stream->want_full = 1;
+	pthread_mutex_unlock(&stream->lock);
+}
+
+static void sub_wait(XenoFlowStreamSub *sub)
+{
+	sub->waiting = 1;
+	sub->wait(sub->arg);
+}
+
+/* Newest full frame after the one the subscriber joined at, NULL if it was not published yet */
+static XenoFlowStreamFrame *find_full_frame(XenoFlowStream *stream, uint64_t after)
+{
+	uint64_t oldest = stream->seq >= XENOFLOW_STREAM_FRAMES ? stream->seq - XENOFLOW_STREAM_FRAMES + 1 : 1;
+
+	for (uint64_t seq = stream->seq; seq > after && seq >= oldest; seq--) {
+		XenoFlowStreamFrame *frame = stream->ring[seq % XENOFLOW_STREAM_FRAMES];
+
+		if (frame != NULL && frame->full)
+			return frame;
+	}
+	return NULL;
+}
+
+ssize_t xenoflow_stream_read(XenoFlowStream *stream, XenoFlowStreamSub *sub, char *buf, size_t max)
+{
+	XenoFlowStreamFrame *frame;
+	uint64_t oldest;
+	size_t len;
+
+	pthread_mutex_lock(&stream->lock);
+	if (stream->closed) {
+		pthread_mutex_unlock(&stream->lock);
+		return -1;
+	}
+
+	if (sub->frame == NULL) {
+		oldest = stream->seq >= XENOFLOW_STREAM_FRAMES ? stream->seq - XENOFLOW_STREAM_FRAMES + 1 : 1;
+		if (!sub->need_full && sub->next_seq < oldest) {
+			/* Fell behind the ring, its totals are rebuilt from a full frame */
+			sub->need_full = 1;
+			sub->joined_seq = stream->seq;
+		}
+		if (sub->need_full) {
+			frame = find_full_frame(stream, sub->joined_seq);
+			if (frame == NULL) {
+				stream->want_full = 1;
+				sub_wait(sub);
+				pthread_mutex_unlock(&stream->lock);
+				return 0;
+			}
+			sub->need_full = 0;
+			sub->next_seq = frame->seq;
+		} else if (sub->next_seq > stream->seq) {
+			sub_wait(sub);
+			pthread_mutex_unlock(&stream->lock);
+			return 0;
+		}
+		sub->frame = stream->ring[sub->next_seq % XENOFLOW_STREAM_FRAMES];
+		sub->frame->refs++;
+		sub->offset = 0;
+	}
+
+	frame = sub->frame;
+	len = frame->len - sub->offset < max ? frame->len - sub->offset : max;
+	memcpy(buf, frame->data + sub->offset, len);
+	sub->offset += len;
+	if (sub->offset == frame->len) {
+		frame_release(frame);
+		sub->frame = NULL;
+		sub->next_seq++;
+	}
+	pthread_mutex_unlock(&stream->lock);
+	return len;
+}
+
+void xenoflow_stream_unsubscribe(XenoFlowStream *stream, XenoFlowStreamSub *sub)
+{
+	pthread_mutex_lock(&stream->lock);
+	for (XenoFlowStreamSub **it = &stream->subs; *it != NULL; it = &(*it)->next) {
+		if (*it == sub) {
+			*it = sub->next;
+			stream->nb_subs--;
+			break;
+		}
+	}
+	frame_release(sub->frame);
+	sub->frame = NULL;
+	pthread_mutex_unlock(&stream->lock);
+}
+
+void xenoflow_stream_close(XenoFlowStream *stream)
+{
+	pthread_mutex_lock(&stream->lock);
+	stream->closed = 1;
+	for (XenoFlowStreamSub *sub = stream->subs; sub != NULL; sub = sub->next) {
+		if (sub->waiting) {
+			sub->waiting = 0;
+			sub->wake(sub->arg);
+		}
+	}
+	pthread_mutex_unlock(&stream->lock);
+}
+
+void xenoflow_stream_destroy(XenoFlowStream *stream)
+{
+	for (int i = 0; i < XENOFLOW_STREAM_FRAMES; i++)
+		frame_release(stream->ring[i]);
+	free(stream->keys);
+	free(stream->pkts);
+	free(stream->bytes);
+	pthread_mutex_destroy(&stream->lock);
+	memset(stream, 0, sizeof(*stream));
+}
@@ -0,0 +1,141 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Live counter stream behind /api/stream. Every interval the event loop hands
+ * the counters of all backends to xenoflow_stream_publish(), which encodes one
+ * Server-Sent Event for all subscribers: a "delta" frame with the backends
+ * whose counters moved, or a "full" frame with every backend's name and totals
+ * when a subscriber joins or falls behind, or when the backends changed. The
+ * last frames are kept in a ring, and each subscriber copies from the shared
+ * frames at its own pace.
+ */
+
+/* Frames kept for subscribers that are behind, one falling further back gets a full frame */
+#define XENOFLOW_STREAM_FRAMES 16
+
+#define DEFAULT_STREAM_INTERVAL_MS 500
+
+/**
+ * @brief Counters of one backend handed to the stream
+ */
+typedef struct {
+	const void *key;		/* the backend, tells layout changes apart */
+	const char *service;
+	const char *name;
+	uint64_t pkts;
+	uint64_t bytes;
+} XenoFlowStreamSample;
+
+/**
+ * @brief One encoded event, shared by all subscribers sending it
+ */
+typedef struct {
+	uint64_t seq;
+	int full;
+	int refs;			/* the ring and every subscriber in the middle of it */
+	size_t len;
+	char data[];
+} XenoFlowStreamFrame;
+
+/**
+ * @brief One /api/stream connection
+ */
+typedef struct XenoFlowStreamSub {
+	struct XenoFlowStreamSub *next;
+	uint64_t next_seq;		/* frame to send next */
+	int need_full;			/* waits for a full frame after joined_seq */
+	uint64_t joined_seq;
+	XenoFlowStreamFrame *frame;	/* frame being sent, NULL between frames */
+	size_t offset;			/* bytes of it already sent */
+	int waiting;			/* suspended until the next frame */
+	void (*wait)(void *arg);	/* suspend the connection, called with the stream lock held */
+	void (*wake)(void *arg);	/* resume it, also with the lock held */
+	void *arg;
+} XenoFlowStreamSub;
+
+typedef struct {
+	pthread_mutex_t lock;
+	XenoFlowStreamFrame *ring[XENOFLOW_STREAM_FRAMES];
+	uint64_t seq;			/* of the last frame published, 0 before the first */
+	XenoFlowStreamSub *subs;
+	uint32_t nb_subs;
+	int want_full;			/* a subscriber waits for a full frame */
+	int closed;
+	uint64_t last_ns;		/* CLOCK_MONOTONIC of the last frame */
+	uint32_t nb_samples;		/* layout of the last frame */
+	const void **keys;
+	uint64_t *pkts;
+	uint64_t *bytes;
+	uint64_t nb_frames;
+	uint64_t nb_full_frames;
+} XenoFlowStream;
+
+/**
+ * @brief Initialize a stream without subscribers
+ * @param stream The stream
+ */
+void xenoflow_stream_init(XenoFlowStream *stream);
+
+/**
+ * @brief Whether anyone listens, publishing is skipped otherwise
+ * @param stream The stream
+ * @return Number of subscribers
+ */
+uint32_t xenoflow_stream_subscribers(XenoFlowStream *stream);
+
+/**
+ * @brief Encode the counters as the next frame and wake the subscribers waiting for it
+ * @param stream The stream
+ * @param samples Counters of every backend, in the same order as long as the backends do not change
+ * @param nb_samples Number of backends
+ * @return 0 on success, -1 if out of memory
+ */
+int xenoflow_stream_publish(XenoFlowStream *stream, const XenoFlowStreamSample *samples, uint32_t nb_samples);
+
+/**
+ * @brief Add a subscriber, its first frame is a full one
+ * @param stream The stream
+ * @param sub Subscriber with wait, wake and arg set
+ */
+void xenoflow_stream_subscribe(XenoFlowStream *stream, XenoFlowStreamSub *sub);
+
+/**
+ * @brief Copy the next bytes of the subscriber's frames
+ *
+ * Without a new frame the subscriber's wait callback is called and 0 returned;
+ * its wake callback is called once there is one.
+ *
+ * @param stream The stream
+ * @param sub The subscriber
+ * @param buf Buffer to fill
+ * @param max Size of buf
+ * @return Bytes copied, 0 to wait, -1 once the stream is closed
+ */
+ssize_t xenoflow_stream_read(XenoFlowStream *stream, XenoFlowStreamSub *sub, char *buf, size_t max);
+
+/**
+ * @brief Remove a subscriber
+ * @param stream The stream
+ * @param sub The subscriber
+ */
+void xenoflow_stream_unsubscribe(XenoFlowStream *stream, XenoFlowStreamSub *sub);
+
+/**
+ * @brief End the stream: waiting subscribers are woken and every read returns -1
+ * @param stream The stream
+ */
+void xenoflow_stream_close(XenoFlowStream *stream);
+
+/**
+ * @brief Free the frames, all subscribers must be gone
+ * @param stream The stream
+ */
+void xenoflow_stream_destroy(XenoFlowStream *stream);
+
+#endif /* STREAM_H */
@@ -0,0 +1,719 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xeno_apibench.h"
+
+#define NS_PER_S 1000000000ull
+
+/* Reconnect attempts of a refused connection wait for the next report */
+#define REPORT_NS NS_PER_S
+
+enum conn_state {
+	CONN_CLOSED,
+	CONN_CONNECTING,
+	CONN_IDLE,
+	CONN_BUSY,
+};
+
+/*
+ * One keep-alive connection. A request is written out in full and its response
+ * read before the next one is sent, as browsers and scrapers do; pipelining
+ * would hide the server's per-request latency.
+ */
+struct conn {
+	int fd;
+	enum conn_state state;
+	enum xeno_apibench_kind kind;	/* of the request in flight */
+	uint64_t scheduled_ns;		/* when the request was due, latency is counted from here */
+	char req[1024];
+	size_t req_len;
+	size_t req_off;			/* bytes written */
+	char *rx;
+	size_t rx_len;
+	size_t rx_cap;
+	size_t header_len;		/* 0 until the headers are complete */
+	long content_length;		/* -1 if not given */
+	bool chunked;
+	bool close;			/* server closes after this response */
+	int status;
+};
+
+struct request {
+	enum xeno_apibench_kind kind;
+	uint64_t scheduled_ns;
+};
+
+struct bench {
+	const struct xeno_apibench_cfg *cfg;
+	struct sockaddr_in addr;
+	int epfd;
+	int timerfd;
+	struct conn *conns;
+	struct conn **idle;		/* stack of idle connections */
+	uint32_t nb_idle;
+	struct request *queue;		/* ring of requests waiting for a connection */
+	uint32_t queue_head;
+	uint32_t queue_len;
+	uint64_t measure_from_ns;	/* end of the warmup */
+	uint64_t post_seq;
+	struct xeno_apibench_stats stats[XENO_APIBENCH_KINDS];
+	uint64_t completed[XENO_APIBENCH_KINDS];	/* including the warmup, for the per-second report */
+};
+
+static const char *const kind_names[XENO_APIBENCH_KINDS] = {
+	[XENO_APIBENCH_API] = "api",
+	[XENO_APIBENCH_SERVICES] = "services",
+	[XENO_APIBENCH_RESOURCES] = "resources",
+	[XENO_APIBENCH_POST] = "post",
+};
+
+static const char *const kind_paths[XENO_APIBENCH_KINDS] = {
+	[XENO_APIBENCH_API] = "/api",
+	[XENO_APIBENCH_SERVICES] = "/api/services",
+	[XENO_APIBENCH_RESOURCES] = "/api/resources",
+	[XENO_APIBENCH_POST] = "/api",
+};
+
+static volatile sig_atomic_t stop_requested;
+
+void xeno_apibench_cfg_init(struct xeno_apibench_cfg *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	snprintf(cfg->host, sizeof(cfg->host), "127.0.0.1");
+	cfg->port = 8080;
+	cfg->nb_conns = 32;
+	cfg->duration_s = 10;
+	cfg->post_names = 64;
+	cfg->mock_query_ns = 1000;
+}
+
+int xeno_apibench_parse_kind(const char *name, enum xeno_apibench_kind *kind)
+{
+	for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+		if (strcmp(name, kind_names[k]) == 0) {
+			*kind = k;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void xeno_apibench_stop(void)
+{
+	stop_requested = 1;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static uint32_t hist_index(uint64_t us)
+{
+	uint32_t shift, idx;
+
+	if (us < XENO_APIBENCH_HIST_SUB)
+		return us;
+	shift = 63 - __builtin_clzll(us) - 4;
+	idx = (shift + 1) * XENO_APIBENCH_HIST_SUB + (uint32_t)(us >> shift) - XENO_APIBENCH_HIST_SUB;
+	return idx < XENO_APIBENCH_HIST_BUCKETS ? idx : XENO_APIBENCH_HIST_BUCKETS - 1;
+}
+
+/* Lowest latency in us of a bucket */
+static uint64_t hist_lower(uint32_t idx)
+{
+	uint32_t shift;
+
+	if (idx < XENO_APIBENCH_HIST_SUB)
+		return idx;
+	shift = idx / XENO_APIBENCH_HIST_SUB - 1;
+	return (uint64_t)(XENO_APIBENCH_HIST_SUB + idx % XENO_APIBENCH_HIST_SUB) << shift;
+}
+
+static void hist_add(struct xeno_apibench_hist *hist, uint64_t ns)
+{
+	hist->count++;
+	hist->sum_ns += ns;
+	if (ns > hist->max_ns)
+		hist->max_ns = ns;
+	hist->buckets[hist_index(ns / 1000)]++;
+}
+
+/* Upper end of the bucket holding quantile q, in us, the maximum for the last one */
+static double hist_quantile(const struct xeno_apibench_hist *hist, double q)
+{
+	uint64_t rank = (uint64_t)(q * hist->count + 0.5), seen = 0;
+
+	if (hist->count == 0)
+		return 0;
+	if (rank == 0)
+		rank = 1;
+	for (uint32_t i = 0; i < XENO_APIBENCH_HIST_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			double upper = i + 1 < XENO_APIBENCH_HIST_BUCKETS ? hist_lower(i + 1) : hist->max_ns / 1e3;
+
+			return upper < hist->max_ns / 1e3 ? upper : hist->max_ns / 1e3;
+		}
+	}
+	return hist->max_ns / 1e3;
+}
+
+static int conn_connect(struct bench *bench, struct conn *conn)
+{
+	struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP, .data.ptr = conn};
+	int one = 1;
+
+	conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (conn->fd < 0)
+		return -errno;
+	setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(conn->fd, (struct sockaddr *)&bench->addr, sizeof(bench->addr)) != 0 && errno != EINPROGRESS) {
+		int err = -errno;
+
+		close(conn->fd);
+		conn->fd = -1;
+		return err;
+	}
+	if (epoll_ctl(bench->epfd, EPOLL_CTL_ADD, conn->fd, &ev) != 0) {
+		int err = -errno;
+
+		close(conn->fd);
+		conn->fd = -1;
+		return err;
+	}
+	conn->state = CONN_CONNECTING;
+	conn->rx_len = 0;
+	conn->header_len = 0;
+	return 0;
+}
+
+static void conn_idle(struct bench *bench, struct conn *conn)
+{
+	conn->state = CONN_IDLE;
+	bench->idle[bench->nb_idle++] = conn;
+}
+
+/* Drop the connection; a request in flight counts as failed. Reconnected right away unless refused */
+static void conn_reset(struct bench *bench, struct conn *conn, bool reconnect)
+{
+	if (conn->state == CONN_BUSY && conn->scheduled_ns >= bench->measure_from_ns)
+		bench->stats[conn->kind].failed++;
+	if (conn->state == CONN_IDLE) {
+		for (uint32_t i = 0; i < bench->nb_idle; i++) {
+			if (bench->idle[i] == conn) {
+				bench->idle[i] = bench->idle[--bench->nb_idle];
+				break;
+			}
+		}
+	}
+	if (conn->fd >= 0)
+		close(conn->fd);
+	conn->fd = -1;
+	conn->state = CONN_CLOSED;
+	if (reconnect)
+		conn_connect(bench, conn);
+}
+
+static void build_request(struct bench *bench, struct conn *conn)
+{
+	const struct xeno_apibench_cfg *cfg = bench->cfg;
+	char body[512];
+	int body_len;
+
+	if (conn->kind != XENO_APIBENCH_POST) {
+		conn->req_len = snprintf(conn->req, sizeof(conn->req),
+					 "GET %s HTTP/1.1\r\nHost: %s:%u\r\nAccept: application/json\r\n\r\n",
+					 kind_paths[conn->kind], cfg->host, cfg->port);
+		return;
+	}
+
+	/* Names repeat after post_names POSTs, the server then rejects them as duplicates */
+	uint32_t n = cfg->post_names > 0 ? bench->post_seq++ % cfg->post_names : bench->post_seq++;
+
+	if (cfg->post_service[0] != '\0')
+		body_len = snprintf(body, sizeof(body),
+				    "{\"service\":\"%s\",\"backends\":[{\"name\":\"bench-%u\","
+				    "\"mac_address\":\"02:be:00:%02x:%02x:%02x\"}]}",
+				    cfg->post_service, n, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+	else
+		body_len = snprintf(body, sizeof(body),
+				    "{\"backends\":[{\"name\":\"bench-%u\",\"mac_address\":\"02:be:00:%02x:%02x:%02x\"}]}",
+				    n, (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+	conn->req_len = snprintf(conn->req, sizeof(conn->req),
+				 "POST /api HTTP/1.1\r\nHost: %s:%u\r\nContent-Type: application/json\r\n"
+				 "Content-Length: %d\r\n\r\n%s",
+				 cfg->host, cfg->port, body_len, body);
+}
+
+/* Write what is left of the request, 0 once sent or blocked, -1 on errors */
+static int conn_write(struct conn *conn)
+{
+	while (conn->req_off < conn->req_len) {
+		ssize_t n = send(conn->fd, conn->req + conn->req_off, conn->req_len - conn->req_off, MSG_NOSIGNAL);
+
+		if (n < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+		conn->req_off += n;
+	}
+	return 0;
+}
+
+static void conn_send(struct bench *bench, struct conn *conn, const struct request *req)
+{
+	conn->state = CONN_BUSY;
+	conn->kind = req->kind;
+	conn->scheduled_ns = req->scheduled_ns;
+	conn->req_off = 0;
+	conn->header_len = 0;
+	build_request(bench, conn);
+	if (req->scheduled_ns >= bench->measure_from_ns)
+		bench->stats[req->kind].sent++;
+	if (conn_write(conn) != 0)
+		conn_reset(bench, conn, true);
+}
+
+static void enqueue(struct bench *bench, enum xeno_apibench_kind kind, uint64_t scheduled_ns)
+{
+	if (bench->queue_len == XENO_APIBENCH_QUEUE_SIZE) {
+		if (scheduled_ns >= bench->measure_from_ns)
+			bench->stats[kind].dropped++;
+		return;
+	}
+	bench->queue[(bench->queue_head + bench->queue_len++) % XENO_APIBENCH_QUEUE_SIZE] =
+		(struct request){.kind = kind, .scheduled_ns = scheduled_ns};
+}
+
+/* Requests waiting the longest go out first, on any idle connection */
+static void dispatch(struct bench *bench)
+{
+	while (bench->queue_len > 0 && bench->nb_idle > 0) {
+		struct request req = bench->queue[bench->queue_head];
+
+		bench->queue_head = (bench->queue_head + 1) % XENO_APIBENCH_QUEUE_SIZE;
+		bench->queue_len--;
+		conn_send(bench, bench->idle[--bench->nb_idle], &req);
+	}
+}
+
+static void parse_headers(struct conn *conn, const char *end)
+{
+	const char *line = memchr(conn->rx, '\n', end - conn->rx);
+
+	conn->status = 0;
+	conn->content_length = -1;
+	conn->chunked = false;
+	conn->close = false;
+	sscanf(conn->rx, "HTTP/%*d.%*d %d", &conn->status);
+	while (line != NULL && line < end) {
+		line++;
+		if (strncasecmp(line, "Content-Length:", 15) == 0)
+			conn->content_length = strtol(line + 15, NULL, 10);
+		else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0)
+			conn->chunked = strstr(line, "chunked") != NULL;
+		else if (strncasecmp(line, "Connection:", 11) == 0)
+			conn->close = strncasecmp(line + 11 + strspn(line + 11, " "), "close", 5) == 0;
+		line = memchr(line, '\n', end - line);
+	}
+	/* Responses that never have a body */
+	if (conn->status == 204 || conn->status == 304 || conn->status / 100 == 1)
+		conn->content_length = 0;
+}
+
+/* Length of a complete chunked body at p, 0 if more is needed */
+static size_t chunked_length(const char *p, size_t len)
+{
+	size_t off = 0;
+
+	for (;;) {
+		const char *eol = memmem(p + off, len - off, "\r\n", 2);
+		unsigned long size;
+
+		if (eol == NULL)
+			return 0;
+		size = strtoul(p + off, NULL, 16);
+		off = eol - p + 2;
+		if (size == 0) {
+			/* No trailers are sent, the last chunk ends with an empty line */
+			return len - off >= 2 ? off + 2 : 0;
+		}
+		if (len - off < size + 2)
+			return 0;
+		off += size + 2;
+	}
+}
+
+static void complete(struct bench *bench, struct conn *conn, size_t body_len)
+{
+	struct xeno_apibench_stats *stats = &bench->stats[conn->kind];
+
+	bench->completed[conn->kind]++;
+	if (conn->scheduled_ns >= bench->measure_from_ns) {
+		if (conn->status / 100 == 2)
+			stats->ok++;
+		else
+			stats->http_errors++;
+		stats->bytes += body_len;
+		hist_add(&stats->latency, now_ns() - conn->scheduled_ns);
+	}
+}
+
+/* Take complete responses off the receive buffer */
+static void conn_parse(struct bench *bench, struct conn *conn)
+{
+	for (;;) {
+		size_t body_len, total;
+
+		if (conn->state != CONN_BUSY || conn->req_off < conn->req_len)
+			return;
+		if (conn->header_len == 0) {
+			char *end = memmem(conn->rx, conn->rx_len, "\r\n\r\n", 4);
+
+			if (end == NULL)
+				return;
+			conn->header_len = end - conn->rx + 4;
+			parse_headers(conn, end);
+		}
+		if (conn->chunked) {
+			body_len = chunked_length(conn->rx + conn->header_len, conn->rx_len - conn->header_len);
+			if (body_len == 0)
+				return;
+		} else if (conn->content_length >= 0) {
+			body_len = conn->content_length;
+			if (conn->rx_len - conn->header_len < body_len)
+				return;
+		} else {
+			/* Body up to the close */
+			return;
+		}
+		total = conn->header_len + body_len;
+		complete(bench, conn, body_len);
+		memmove(conn->rx, conn->rx + total, conn->rx_len - total);
+		conn->rx_len -= total;
+		conn->header_len = 0;
+		if (conn->close) {
+			conn->state = CONN_IDLE;
+			conn_reset(bench, conn, true);
+			return;
+		}
+		conn_idle(bench, conn);
+	}
+}
+
+static void conn_read(struct bench *bench, struct conn *conn)
+{
+	for (;;) {
+		ssize_t n;
+
+		if (conn->rx_cap - conn->rx_len < 4096) {
+			size_t cap = conn->rx_cap > 0 ? conn->rx_cap * 2 : 65536;
+			char *rx = realloc(conn->rx, cap + 1);
+
+			if (rx == NULL) {
+				conn_reset(bench, conn, true);
+				return;
+			}
+			conn->rx = rx;
+			conn->rx_cap = cap;
+		}
+		n = recv(conn->fd, conn->rx + conn->rx_len, conn->rx_cap - conn->rx_len, 0);
+		if (n > 0) {
+			conn->rx_len += n;
+			conn->rx[conn->rx_len] = '\0';
+			conn_parse(bench, conn);
+			if (conn->fd < 0)
+				return;
+			continue;
+		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return;
+		/* Closed: a body without a length ends here */
+		if (conn->state == CONN_BUSY && conn->header_len > 0 && !conn->chunked && conn->content_length < 0) {
+			complete(bench, conn, conn->rx_len - conn->header_len);
+			conn->state = CONN_IDLE;
+		}
+		conn_reset(bench, conn, true);
+		return;
+	}
+}
+
+static void conn_event(struct bench *bench, struct conn *conn, uint32_t events)
+{
+	if (conn->state == CONN_CONNECTING) {
+		int err = 0;
+		socklen_t len = sizeof(err);
+
+		if ((events & (EPOLLERR | EPOLLHUP)) != 0 ||
+		    getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+			/* Refused: retried at the next report instead of spinning */
+			conn_reset(bench, conn, false);
+			return;
+		}
+		if ((events & EPOLLOUT) == 0)
+			return;
+		conn_idle(bench, conn);
+		return;
+	}
+	if ((events & EPOLLOUT) != 0 && conn->state == CONN_BUSY && conn_write(conn) != 0) {
+		conn_reset(bench, conn, true);
+		return;
+	}
+	if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0)
+		conn_read(bench, conn);
+}
+
+static void arm_timer(struct bench *bench, uint64_t at_ns)
+{
+	struct itimerspec its = {
+		.it_value = {.tv_sec = at_ns / NS_PER_S, .tv_nsec = at_ns % NS_PER_S},
+	};
+
+	timerfd_settime(bench->timerfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void print_report(struct bench *bench, uint64_t elapsed_s, const uint64_t *last)
+{
+	uint32_t busy = 0, closed = 0;
+
+	for (uint32_t i = 0; i < bench->cfg->nb_conns; i++) {
+		busy += bench->conns[i].state == CONN_BUSY;
+		closed += bench->conns[i].state == CONN_CLOSED;
+	}
+	printf("[%3lus]", elapsed_s);
+	for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+		if (bench->completed[k] > 0 || bench->cfg->rate[k] > 0)
+			printf(" %s %lu/s", kind_names[k], bench->completed[k] - last[k]);
+	}
+	printf(" | busy %u queued %u closed %u%s\n", busy, bench->queue_len, closed,
+	       bench->measure_from_ns > now_ns() ? " (warmup)" : "");
+	fflush(stdout);
+}
+
+static void print_results(const struct bench *bench, double seconds)
+{
+	const struct xeno_apibench_cfg *cfg = bench->cfg;
+
+	printf("\n%-10s %9s %9s %7s %7s %7s %9s %9s %9s %9s %9s %9s\n", "kind", "sent", "ok", "errors", "failed",
+	       "dropped", "req/s", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+	for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+		const struct xeno_apibench_stats *s = &bench->stats[k];
+		const struct xeno_apibench_hist *h = &s->latency;
+
+		if (s->sent == 0 && s->dropped == 0)
+			continue;
+		printf("%-10s %9lu %9lu %7lu %7lu %7lu %9.1f %9.0f %9.0f %9.0f %9.0f %9.0f\n", kind_names[k], s->sent,
+		       s->ok, s->http_errors, s->failed, s->dropped, h->count / seconds, hist_quantile(h, 0.5),
+		       hist_quantile(h, 0.9), hist_quantile(h, 0.99), hist_quantile(h, 0.999), h->max_ns / 1e3);
+	}
+
+	/* Histograms by power of two, the percentiles above use the finer buckets */
+	for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+		const struct xeno_apibench_hist *h = &bench->stats[k].latency;
+		uint64_t peak = 0;
+
+		if (h->count == 0)
+			continue;
+		printf("\n%s latency (%lu responses, mean %.0f us)\n", kind_names[k], h->count,
+		       h->sum_ns / 1e3 / h->count);
+		for (int p = 0; p < XENO_APIBENCH_HIST_POW; p++) {
+			uint64_t n = 0;
+
+			for (int i = 0; i < XENO_APIBENCH_HIST_SUB; i++)
+				n += h->buckets[p * XENO_APIBENCH_HIST_SUB + i];
+			peak = n > peak ? n : peak;
+		}
+		for (int p = 0; p < XENO_APIBENCH_HIST_POW; p++) {
+			uint64_t n = 0;
+
+			for (int i = 0; i < XENO_APIBENCH_HIST_SUB; i++)
+				n += h->buckets[p * XENO_APIBENCH_HIST_SUB + i];
+			if (n == 0)
+				continue;
+			printf("  < %9lu us %9lu %6.2f%% ", hist_lower((p + 1) * XENO_APIBENCH_HIST_SUB), n,
+			       100.0 * n / h->count);
+			for (uint64_t i = 0; i < (n * 40 + peak - 1) / peak; i++)
+				putchar('#');
+			putchar('\n');
+		}
+	}
+
+	if (cfg->csv) {
+		printf("\nkind,sent,ok,http_errors,failed,dropped,rps,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n");
+		for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+			const struct xeno_apibench_stats *s = &bench->stats[k];
+			const struct xeno_apibench_hist *h = &s->latency;
+
+			if (s->sent == 0 && s->dropped == 0)
+				continue;
+			printf("%s,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%.0f,%.0f,%.0f,%.0f,%.1f\n", kind_names[k], s->sent,
+			       s->ok, s->http_errors, s->failed, s->dropped, h->count / seconds,
+			       h->count > 0 ? h->sum_ns / 1e3 / h->count : 0.0, hist_quantile(h, 0.5),
+			       hist_quantile(h, 0.9), hist_quantile(h, 0.99), hist_quantile(h, 0.999),
+			       h->max_ns / 1e3);
+		}
+	}
+}
+
+static int bench_init(struct bench *bench, const struct xeno_apibench_cfg *cfg)
+{
+	memset(bench, 0, sizeof(*bench));
+	bench->cfg = cfg;
+	bench->epfd = -1;
+	bench->timerfd = -1;
+	bench->addr.sin_family = AF_INET;
+	bench->addr.sin_port = htons(cfg->port);
+	if (inet_pton(AF_INET, cfg->host, &bench->addr.sin_addr) != 1) {
+		fprintf(stderr, "Invalid address '%s'\n", cfg->host);
+		return -EINVAL;
+	}
+	if (cfg->nb_conns == 0 || cfg->nb_conns > XENO_APIBENCH_MAX_CONNS) {
+		fprintf(stderr, "Connections must be 1 to %d\n", XENO_APIBENCH_MAX_CONNS);
+		return -EINVAL;
+	}
+	bench->conns = calloc(cfg->nb_conns, sizeof(*bench->conns));
+	bench->idle = calloc(cfg->nb_conns, sizeof(*bench->idle));
+	bench->queue = calloc(XENO_APIBENCH_QUEUE_SIZE, sizeof(*bench->queue));
+	if (bench->conns == NULL || bench->idle == NULL || bench->queue == NULL)
+		return -ENOMEM;
+	bench->epfd = epoll_create1(EPOLL_CLOEXEC);
+	bench->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (bench->epfd < 0 || bench->timerfd < 0)
+		return -errno;
+	struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+
+	if (epoll_ctl(bench->epfd, EPOLL_CTL_ADD, bench->timerfd, &ev) != 0)
+		return -errno;
+	for (uint32_t i = 0; i < cfg->nb_conns; i++) {
+		bench->conns[i].fd = -1;
+		if (conn_connect(bench, &bench->conns[i]) != 0)
+			bench->conns[i].state = CONN_CLOSED;
+	}
+	return 0;
+}
+
+static void bench_fini(struct bench *bench)
+{
+	for (uint32_t i = 0; bench->conns != NULL && i < bench->cfg->nb_conns; i++) {
+		if (bench->conns[i].fd >= 0)
+			close(bench->conns[i].fd);
+		free(bench->conns[i].rx);
+	}
+	if (bench->timerfd >= 0)
+		close(bench->timerfd);
+	if (bench->epfd >= 0)
+		close(bench->epfd);
+	free(bench->conns);
+	free(bench->idle);
+	free(bench->queue);
+}
+
+int xeno_apibench_run(const struct xeno_apibench_cfg *cfg)
+{
+	struct bench bench;
+	struct epoll_event events[256];
+	uint64_t next_due[XENO_APIBENCH_KINDS], period[XENO_APIBENCH_KINDS];
+	uint64_t last[XENO_APIBENCH_KINDS] = {0};
+	uint64_t start, end, next_report, now;
+	bool open_loop = false;
+	int ret;
+
+	ret = bench_init(&bench, cfg);
+	if (ret != 0) {
+		bench_fini(&bench);
+		return ret;
+	}
+
+	start = now_ns();
+	bench.measure_from_ns = start + cfg->warmup_s * NS_PER_S;
+	end = cfg->duration_s > 0 ? bench.measure_from_ns + cfg->duration_s * NS_PER_S : UINT64_MAX;
+	next_report = start + REPORT_NS;
+	for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+		period[k] = cfg->rate[k] > 0 ? (uint64_t)(NS_PER_S / cfg->rate[k]) : 0;
+		next_due[k] = start;
+		open_loop |= period[k] > 0;
+	}
+	printf("%u connections to %s:%u, %s, %u s", cfg->nb_conns, cfg->host, cfg->port,
+	       open_loop ? "open loop" : "closed loop (GET /api)", cfg->duration_s);
+	if (cfg->warmup_s > 0)
+		printf(" after %u s warmup", cfg->warmup_s);
+	printf("\n");
+
+	while (!stop_requested) {
+		uint64_t wake = next_report < end ? next_report : end;
+		int n;
+
+		now = now_ns();
+		if (now >= end)
+			break;
+		if (now >= next_report) {
+			print_report(&bench, (now - start) / NS_PER_S, last);
+			memcpy(last, bench.completed, sizeof(last));
+			next_report += REPORT_NS;
+			for (uint32_t i = 0; i < cfg->nb_conns; i++) {
+				if (bench.conns[i].state == CONN_CLOSED)
+					conn_connect(&bench, &bench.conns[i]);
+			}
+		}
+
+		/*
+		 * Open loop: requests are due at fixed times whatever the server does, and a
+		 * late one waits in the queue. Its latency counts from when it was due, so a
+		 * stalled server shows up in the percentiles instead of slowing the load.
+		 */
+		if (open_loop) {
+			for (int k = 0; k < XENO_APIBENCH_KINDS; k++) {
+				for (; period[k] > 0 && next_due[k] <= now; next_due[k] += period[k])
+					enqueue(&bench, k, next_due[k]);
+				if (period[k] > 0 && next_due[k] < wake)
+					wake = next_due[k];
+			}
+		} else {
+			while (bench.queue_len < bench.nb_idle)
+				enqueue(&bench, XENO_APIBENCH_API, now);
+		}
+		dispatch(&bench);
+
+		arm_timer(&bench, wake);
+		n = epoll_wait(bench.epfd, events, 256, -1);
+		if (n < 0 && errno != EINTR) {
+			ret = -errno;
+			break;
+		}
+		for (int i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL) {
+				uint64_t expirations;
+
+				/* Only wakes the loop, which looks at the clock itself */
+				if (read(bench.timerfd, &expirations, sizeof(expirations)) < 0)
+					expirations = 0;
+				continue;
+			}
+			conn_event(&bench, (struct conn *)events[i].data.ptr, events[i].events);
+		}
+	}
+
+	now = now_ns() < end ? now_ns() : end;
+	if (now > bench.measure_from_ns)
+		print_results(&bench, (now - bench.measure_from_ns) / 1e9);
+	else
+		printf("Stopped during the warmup, no results\n");
+	bench_fini(&bench);
+	return ret;
+}
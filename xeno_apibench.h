@@ -0,0 +1,116 @@
+#ifndef XENO_APIBENCH_H
+#define XENO_APIBENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most keep-alive connections the load generator opens */
+#define XENO_APIBENCH_MAX_CONNS 4096
+
+/* Requests waiting for a free connection; more are counted as dropped */
+#define XENO_APIBENCH_QUEUE_SIZE 65536
+
+/* Latency histogram: 16 linear sub-buckets per power of two of microseconds, up to ~2^26 us */
+#define XENO_APIBENCH_HIST_SUB 16
+#define XENO_APIBENCH_HIST_POW 27
+#define XENO_APIBENCH_HIST_BUCKETS (XENO_APIBENCH_HIST_POW * XENO_APIBENCH_HIST_SUB)
+
+/**
+ * @brief Request kinds of the mix
+ */
+enum xeno_apibench_kind {
+	XENO_APIBENCH_API,	 /* GET /api: every backend with counters queried from hardware */
+	XENO_APIBENCH_SERVICES,	 /* GET /api/services: the same per service */
+	XENO_APIBENCH_RESOURCES, /* GET /api/resources: the metrics scrape, no counter queries */
+	XENO_APIBENCH_POST,	 /* POST /api: add a backend */
+	XENO_APIBENCH_KINDS,
+};
+
+/**
+ * @brief Load generator configuration, filled from the command line
+ */
+struct xeno_apibench_cfg {
+	char host[64];			      /* API address, IPv4 */
+	uint16_t port;			      /* API port */
+	uint32_t nb_conns;		      /* keep-alive connections */
+	double rate[XENO_APIBENCH_KINDS];     /* requests per second of each kind, all 0 for closed loop */
+	uint32_t duration_s;		      /* seconds to run, 0 is until stopped */
+	uint32_t warmup_s;		      /* seconds left out of the results */
+	char post_service[64];		      /* service of the POSTed backends, empty for the default one */
+	uint32_t post_names;		      /* POSTs cycle through this many backend names */
+	bool csv;			      /* end with a CSV summary */
+	uint32_t mock_backends;		      /* serve a mocked API with this many backends, 0 for none */
+	uint32_t mock_query_ns;		      /* time the mock spends per backend counter query */
+};
+
+/**
+ * @brief Log-linear latency histogram
+ */
+struct xeno_apibench_hist {
+	uint64_t count;
+	uint64_t max_ns;
+	uint64_t sum_ns;
+	uint64_t buckets[XENO_APIBENCH_HIST_BUCKETS];
+};
+
+/**
+ * @brief Results of one request kind
+ */
+struct xeno_apibench_stats {
+	uint64_t sent;
+	uint64_t ok;			      /* 2xx responses */
+	uint64_t http_errors;		      /* other responses */
+	uint64_t failed;		      /* connection lost before the response */
+	uint64_t dropped;		      /* not sent, the queue was full */
+	uint64_t bytes;			      /* response bodies */
+	struct xeno_apibench_hist latency;    /* from the scheduled send time to the end of the response */
+};
+
+/**
+ * @brief Set the defaults: 32 connections to 127.0.0.1:8080 in closed loop, 10 s
+ * @param cfg Configuration to initialize
+ */
+void xeno_apibench_cfg_init(struct xeno_apibench_cfg *cfg);
+
+/**
+ * @brief Parse a request kind name ("api", "services", "resources" or "post")
+ * @param name Kind name
+ * @param kind Parsed kind
+ * @return 0 on success, -1 on unknown names
+ */
+int xeno_apibench_parse_kind(const char *name, enum xeno_apibench_kind *kind);
+
+/**
+ * @brief Run the load until the duration is over or xeno_apibench_stop() is called
+ *
+ * Prints the completed requests every second and, at the end, the latency
+ * percentiles and histogram of every kind.
+ *
+ * @param cfg Load generator configuration
+ * @return 0 on success, negative errno otherwise
+ */
+int xeno_apibench_run(const struct xeno_apibench_cfg *cfg);
+
+/**
+ * @brief Ask a running load generator to stop, safe to call from a signal handler
+ */
+void xeno_apibench_stop(void);
+
+/**
+ * @brief Serve a mocked XenoFlow API on cfg->host:cfg->port
+ *
+ * Answers the endpoints of the mix like xeno_flow does, with cfg->mock_backends
+ * backends behind one lock and cfg->mock_query_ns of work per counter query,
+ * so the load generator runs without a DPU.
+ *
+ * @param cfg Load generator configuration
+ * @return 0 on success, negative errno otherwise
+ */
+int xeno_apibench_mock_start(const struct xeno_apibench_cfg *cfg);
+
+/**
+ * @brief Stop the mocked API
+ */
+void xeno_apibench_mock_stop(void);
+
+#endif /* XENO_APIBENCH_H */
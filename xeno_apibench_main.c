@@ -0,0 +1,144 @@
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xeno_apibench.h"
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options]\n"
+	       "  --host ADDR          API address (default 127.0.0.1)\n"
+	       "  --port N             API port (default 8080)\n"
+	       "  --conns N            keep-alive connections (default 32)\n"
+	       "  --rate KIND=RPS      requests per second of KIND: api, services, resources or post,\n"
+	       "                       repeatable; without any, every connection sends GET /api back to back\n"
+	       "  --duration S         seconds to measure, 0 until interrupted (default 10)\n"
+	       "  --warmup S           seconds to run before measuring (default 0)\n"
+	       "  --post-service NAME  service the POSTed backends are added to (default: the default service)\n"
+	       "  --post-names N       POSTs cycle through N backend names, 0 never repeats (default 64)\n"
+	       "  --csv                end with a CSV summary\n"
+	       "  --mock BACKENDS      serve a mocked API with BACKENDS backends on --host/--port\n"
+	       "  --mock-query-ns NS   time the mock spends per counter query (default 1000)\n",
+	       prog);
+}
+
+static int parse_rate(const char *arg, struct xeno_apibench_cfg *cfg)
+{
+	enum xeno_apibench_kind kind;
+	const char *eq = strchr(arg, '=');
+	char name[16];
+	char *end;
+	double rate;
+
+	if (eq == NULL || (size_t)(eq - arg) >= sizeof(name))
+		return -1;
+	memcpy(name, arg, eq - arg);
+	name[eq - arg] = '\0';
+	if (xeno_apibench_parse_kind(name, &kind) != 0)
+		return -1;
+	rate = strtod(eq + 1, &end);
+	if (end == eq + 1 || *end != '\0' || rate < 0)
+		return -1;
+	cfg->rate[kind] = rate;
+	return 0;
+}
+
+static int parse_args(int argc, char **argv, struct xeno_apibench_cfg *cfg)
+{
+	enum {
+		OPT_HOST = 256, OPT_PORT, OPT_CONNS, OPT_RATE, OPT_DURATION, OPT_WARMUP, OPT_POST_SERVICE,
+		OPT_POST_NAMES, OPT_CSV, OPT_MOCK, OPT_MOCK_QUERY_NS, OPT_HELP,
+	};
+	static const struct option long_opts[] = {
+		{"host", required_argument, NULL, OPT_HOST},
+		{"port", required_argument, NULL, OPT_PORT},
+		{"conns", required_argument, NULL, OPT_CONNS},
+		{"rate", required_argument, NULL, OPT_RATE},
+		{"duration", required_argument, NULL, OPT_DURATION},
+		{"warmup", required_argument, NULL, OPT_WARMUP},
+		{"post-service", required_argument, NULL, OPT_POST_SERVICE},
+		{"post-names", required_argument, NULL, OPT_POST_NAMES},
+		{"csv", no_argument, NULL, OPT_CSV},
+		{"mock", required_argument, NULL, OPT_MOCK},
+		{"mock-query-ns", required_argument, NULL, OPT_MOCK_QUERY_NS},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case OPT_HOST:
+			snprintf(cfg->host, sizeof(cfg->host), "%s", optarg);
+			break;
+		case OPT_PORT:
+			cfg->port = atoi(optarg);
+			break;
+		case OPT_CONNS:
+			cfg->nb_conns = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_RATE:
+			if (parse_rate(optarg, cfg) != 0) {
+				fprintf(stderr, "Invalid rate '%s', expected KIND=RPS\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_DURATION:
+			cfg->duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_WARMUP:
+			cfg->warmup_s = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_POST_SERVICE:
+			snprintf(cfg->post_service, sizeof(cfg->post_service), "%s", optarg);
+			break;
+		case OPT_POST_NAMES:
+			cfg->post_names = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_CSV:
+			cfg->csv = true;
+			break;
+		case OPT_MOCK:
+			cfg->mock_backends = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_MOCK_QUERY_NS:
+			cfg->mock_query_ns = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void signal_handler(int signum)
+{
+	(void)signum;
+	xeno_apibench_stop();
+}
+
+int main(int argc, char **argv)
+{
+	struct xeno_apibench_cfg cfg;
+	int ret;
+
+	xeno_apibench_cfg_init(&cfg);
+	if (parse_args(argc, argv, &cfg) != 0)
+		return EXIT_FAILURE;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	if (cfg.mock_backends > 0) {
+		ret = xeno_apibench_mock_start(&cfg);
+		if (ret != 0)
+			return EXIT_FAILURE;
+	}
+	ret = xeno_apibench_run(&cfg);
+	if (cfg.mock_backends > 0)
+		xeno_apibench_mock_stop();
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
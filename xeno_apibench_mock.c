@@ -0,0 +1,290 @@
+/*
+ * Mocked XenoFlow API for xeno_apibench: the same daemon flags, endpoints and
+ * response shapes as http_server.c, with a software backend table instead of
+ * DOCA Flow. Every request holds one lock like xeno->lock and spends
+ * mock_query_ns per backend where xeno_flow queries a hardware counter.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cjson/cJSON.h>
+#include <microhttpd.h>
+
+#include "xeno_apibench.h"
+
+/* Most backends POSTs can add on top of the mocked ones */
+#define MOCK_MAX_ADDED 65536
+
+struct mock_backend {
+	char name[64];
+	char mac[18];
+	uint64_t pkts;
+	uint64_t bytes;
+};
+
+struct post_data {
+	char *data;
+	size_t size;
+};
+
+static struct {
+	struct MHD_Daemon *daemon;
+	pthread_mutex_t lock;
+	struct mock_backend *backends;
+	uint32_t nb_backends;
+	uint32_t max_backends;
+	uint32_t query_ns;
+} mock;
+
+/* Stands in for doca_flow_resource_query_entry(): busy for query_ns, then the counters moved on */
+static void query_counter(struct mock_backend *backend)
+{
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ((uint64_t)(now.tv_sec - start.tv_sec) * 1000000000ull + now.tv_nsec - start.tv_nsec < mock.query_ns);
+	backend->pkts += 1000;
+	backend->bytes += 1000 * 512;
+}
+
+static void add_traffic_stats(cJSON *info, const struct mock_backend *backend)
+{
+	cJSON_AddNumberToObject(info, "packetsProcessed", backend->pkts);
+	cJSON_AddNumberToObject(info, "bytesProcessed", backend->bytes);
+	cJSON_AddNumberToObject(info, "packetsPerSecond", 2000);
+	cJSON_AddNumberToObject(info, "bitsPerSecond", 2000 * 512 * 8);
+}
+
+static char *api_response(void)
+{
+	cJSON *root = cJSON_CreateObject();
+	cJSON *backends = cJSON_CreateArray();
+	cJSON *entries = cJSON_CreateArray();
+	char *str;
+
+	cJSON_AddStringToObject(root, "message", "XenoFlow REST API is running.");
+	cJSON_AddStringToObject(root, "status", "ok");
+	cJSON_AddNumberToObject(root, "version", 1.0);
+	for (uint32_t i = 0; i < mock.nb_backends; i++) {
+		struct mock_backend *backend = &mock.backends[i];
+		cJSON *info = cJSON_CreateObject();
+		cJSON *entry = cJSON_CreateObject();
+
+		query_counter(backend);
+		cJSON_AddStringToObject(info, "name", backend->name);
+		cJSON_AddStringToObject(info, "service", "default");
+		cJSON_AddStringToObject(info, "mac_address", backend->mac);
+		add_traffic_stats(info, backend);
+		cJSON_AddItemToArray(backends, info);
+
+		cJSON_AddNumberToObject(entry, "index", i);
+		cJSON_AddStringToObject(entry, "service", "default");
+		cJSON_AddStringToObject(entry, "backend", backend->name);
+		add_traffic_stats(entry, backend);
+		cJSON_AddItemToArray(entries, entry);
+	}
+	cJSON_AddItemToObject(root, "backends", backends);
+	cJSON_AddItemToObject(root, "entries", entries);
+	cJSON_AddNumberToObject(root, "serviceNumber", 1);
+	cJSON_AddNumberToObject(root, "backendNumber", mock.nb_backends);
+	str = cJSON_Print(root);
+	cJSON_Delete(root);
+	return str;
+}
+
+static char *services_response(void)
+{
+	cJSON *root = cJSON_CreateObject();
+	cJSON *list = cJSON_CreateArray();
+	cJSON *service = cJSON_CreateObject();
+	cJSON *backends = cJSON_CreateArray();
+	char *str;
+
+	cJSON_AddStringToObject(service, "name", "default");
+	cJSON_AddBoolToObject(service, "default", 1);
+	cJSON_AddStringToObject(service, "protocol", "any");
+	for (uint32_t i = 0; i < mock.nb_backends; i++) {
+		struct mock_backend *backend = &mock.backends[i];
+		cJSON *info = cJSON_CreateObject();
+
+		query_counter(backend);
+		cJSON_AddStringToObject(info, "name", backend->name);
+		cJSON_AddStringToObject(info, "mac_address", backend->mac);
+		cJSON_AddNumberToObject(info, "index", i);
+		cJSON_AddBoolToObject(info, "host", 0);
+		add_traffic_stats(info, backend);
+		cJSON_AddItemToArray(backends, info);
+	}
+	cJSON_AddItemToObject(service, "backends", backends);
+	cJSON_AddItemToArray(list, service);
+	cJSON_AddItemToObject(root, "services", list);
+	str = cJSON_Print(root);
+	cJSON_Delete(root);
+	return str;
+}
+
+static char *resources_response(void)
+{
+	cJSON *root = cJSON_CreateObject();
+	cJSON *counters = cJSON_CreateObject();
+	char *str;
+
+	cJSON_AddNumberToObject(counters, "used", mock.nb_backends);
+	cJSON_AddNumberToObject(counters, "total", mock.max_backends);
+	cJSON_AddItemToObject(root, "counters", counters);
+	cJSON_AddItemToObject(root, "pipes", cJSON_CreateArray());
+	str = cJSON_Print(root);
+	cJSON_Delete(root);
+	return str;
+}
+
+static char *add_backends(const char *body, unsigned int *status)
+{
+	cJSON *root = cJSON_Parse(body);
+	cJSON *backends = cJSON_GetObjectItem(root, "backends");
+	cJSON *response, *results;
+	int failed = 0;
+	char *str;
+
+	if (!cJSON_IsArray(backends)) {
+		cJSON_Delete(root);
+		*status = MHD_HTTP_BAD_REQUEST;
+		return strdup("{\"status\": \"error\", \"error\": \"Missing backends array\"}");
+	}
+	response = cJSON_CreateObject();
+	results = cJSON_CreateArray();
+	for (int i = 0; i < cJSON_GetArraySize(backends); i++) {
+		cJSON *name = cJSON_GetObjectItem(cJSON_GetArrayItem(backends, i), "name");
+		cJSON *mac = cJSON_GetObjectItem(cJSON_GetArrayItem(backends, i), "mac_address");
+		cJSON *info = cJSON_CreateObject();
+		const char *error = NULL;
+
+		if (!cJSON_IsString(name) || !cJSON_IsString(mac))
+			error = "Invalid input";
+		for (uint32_t b = 0; error == NULL && b < mock.nb_backends; b++) {
+			if (strcmp(mock.backends[b].name, name->valuestring) == 0)
+				error = "Resource already exists";
+		}
+		if (error == NULL && mock.nb_backends == mock.max_backends)
+			error = "No more resources";
+		if (error == NULL) {
+			struct mock_backend *backend = &mock.backends[mock.nb_backends++];
+
+			memset(backend, 0, sizeof(*backend));
+			snprintf(backend->name, sizeof(backend->name), "%s", name->valuestring);
+			snprintf(backend->mac, sizeof(backend->mac), "%s", mac->valuestring);
+		}
+		cJSON_AddStringToObject(info, "name", cJSON_IsString(name) ? name->valuestring : "");
+		cJSON_AddStringToObject(info, "status", error == NULL ? "ok" : "error");
+		if (error != NULL) {
+			cJSON_AddStringToObject(info, "error", error);
+			failed++;
+		}
+		cJSON_AddItemToArray(results, info);
+	}
+	cJSON_AddStringToObject(response, "status", failed ? "error" : "ok");
+	cJSON_AddItemToObject(response, "backends", results);
+	str = cJSON_Print(response);
+	cJSON_Delete(response);
+	cJSON_Delete(root);
+	*status = MHD_HTTP_OK;
+	return str;
+}
+
+static enum MHD_Result mock_request(void *cls, struct MHD_Connection *connection, const char *url,
+				    const char *method, const char *version, const char *upload_data,
+				    size_t *upload_data_size, void **con_cls)
+{
+	struct MHD_Response *response;
+	unsigned int status = MHD_HTTP_OK;
+	enum MHD_Result ret;
+	char *str = NULL;
+
+	(void)cls;
+	(void)version;
+	if (strcmp(method, "POST") == 0 && strcmp(url, "/api") == 0) {
+		struct post_data *post = *con_cls;
+
+		if (post == NULL) {
+			*con_cls = calloc(1, sizeof(*post));
+			return *con_cls != NULL ? MHD_YES : MHD_NO;
+		}
+		if (*upload_data_size > 0) {
+			char *data = realloc(post->data, post->size + *upload_data_size + 1);
+
+			if (data == NULL)
+				return MHD_NO;
+			memcpy(data + post->size, upload_data, *upload_data_size);
+			post->data = data;
+			post->size += *upload_data_size;
+			post->data[post->size] = '\0';
+			*upload_data_size = 0;
+			return MHD_YES;
+		}
+		pthread_mutex_lock(&mock.lock);
+		str = add_backends(post->data != NULL ? post->data : "", &status);
+		pthread_mutex_unlock(&mock.lock);
+		free(post->data);
+		free(post);
+		*con_cls = NULL;
+	} else if (strcmp(method, "GET") == 0) {
+		pthread_mutex_lock(&mock.lock);
+		if (strcmp(url, "/api") == 0)
+			str = api_response();
+		else if (strcmp(url, "/api/services") == 0)
+			str = services_response();
+		else if (strcmp(url, "/api/resources") == 0)
+			str = resources_response();
+		pthread_mutex_unlock(&mock.lock);
+	}
+	if (str == NULL) {
+		str = strdup("{\"error\": \"Not Found\"}");
+		status = MHD_HTTP_NOT_FOUND;
+	}
+
+	response = MHD_create_response_from_buffer(strlen(str), (void *)str, MHD_RESPMEM_MUST_FREE);
+	MHD_add_response_header(response, "Content-Type", "application/json");
+	ret = MHD_queue_response(connection, status, response);
+	MHD_destroy_response(response);
+	return ret;
+}
+
+int xeno_apibench_mock_start(const struct xeno_apibench_cfg *cfg)
+{
+	pthread_mutex_init(&mock.lock, NULL);
+	mock.query_ns = cfg->mock_query_ns;
+	mock.nb_backends = cfg->mock_backends;
+	mock.max_backends = cfg->mock_backends + MOCK_MAX_ADDED;
+	mock.backends = calloc(mock.max_backends, sizeof(*mock.backends));
+	if (mock.backends == NULL)
+		return -ENOMEM;
+	for (uint32_t i = 0; i < mock.nb_backends; i++) {
+		snprintf(mock.backends[i].name, sizeof(mock.backends[i].name), "backend-%u", i);
+		snprintf(mock.backends[i].mac, sizeof(mock.backends[i].mac), "02:00:00:%02x:%02x:%02x", (i >> 16) & 0xff,
+			 (i >> 8) & 0xff, i & 0xff);
+	}
+
+	/* One polling thread like xeno_flow's server, so requests are served one at a time there too */
+	mock.daemon = MHD_start_daemon(MHD_USE_SELECT_INTERNALLY, cfg->port, NULL, NULL, &mock_request, NULL,
+				       MHD_OPTION_END);
+	if (mock.daemon == NULL) {
+		fprintf(stderr, "Failed to start the mocked API on port %u\n", cfg->port);
+		free(mock.backends);
+		return -EADDRINUSE;
+	}
+	printf("Mocked API with %u backends, %u ns per counter query\n", mock.nb_backends, mock.query_ns);
+	return 0;
+}
+
+void xeno_apibench_mock_stop(void)
+{
+	MHD_stop_daemon(mock.daemon);
+	free(mock.backends);
+	mock.backends = NULL;
+}
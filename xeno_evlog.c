@@ -0,0 +1,224 @@
+/*
+ * Offline decoder of the binary event log written by xeno_flow --evlog
+ */
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "evlog.h"
+
+static const char *const type_names[XENOFLOW_EV_MAX] = {
+	[XENOFLOW_EV_BACKEND_ADD] = "backend_add",
+	[XENOFLOW_EV_BACKEND_ADD_FAILED] = "backend_add_failed",
+	[XENOFLOW_EV_BACKEND_REMOVE] = "backend_remove",
+	[XENOFLOW_EV_BACKEND_NAME] = "backend_name",
+	[XENOFLOW_EV_VIP_ADD] = "vip_add",
+	[XENOFLOW_EV_COUNTER_SAMPLE] = "counter_sample",
+	[XENOFLOW_EV_API_CALL] = "api_call",
+	[XENOFLOW_EV_OPS_BATCH] = "ops_batch",
+	[XENOFLOW_EV_RELOAD] = "reload",
+	[XENOFLOW_EV_BUCKET_MOVE] = "bucket_move",
+};
+
+static const char *const endpoint_names[XENOFLOW_EVLOG_API_MAX] = {
+	[XENOFLOW_EVLOG_API_OTHER] = "other",
+	[XENOFLOW_EVLOG_API_BASE] = "/api",
+	[XENOFLOW_EVLOG_API_SERVICES] = "/api/services",
+	[XENOFLOW_EVLOG_API_RESOURCES] = "/api/resources",
+	[XENOFLOW_EVLOG_API_RELOAD] = "/api/reload",
+	[XENOFLOW_EVLOG_API_STARTUP] = "/api/startup",
+	[XENOFLOW_EVLOG_API_STREAM] = "/api/stream",
+	[XENOFLOW_EVLOG_API_HISTORY] = "/api/history",
+	[XENOFLOW_EVLOG_API_LOOKUP] = "/api/lookup",
+};
+
+/* Names by counter index, learnt from XENOFLOW_EV_BACKEND_NAME records */
+static char (*names)[17];
+static uint32_t nb_names;
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options] FILE\n"
+	       "  --csv                one CSV row per event instead of text\n"
+	       "  --type NAME          only print events of this type, e.g. backend_add\n",
+	       prog);
+}
+
+static void set_name(uint32_t id, const XenoFlowEvent *ev)
+{
+	if (id >= nb_names) {
+		uint32_t n = id + 1 > nb_names * 2 ? id + 1 : nb_names * 2;
+		char (*grown)[17] = realloc(names, n * sizeof(*names));
+
+		if (grown == NULL)
+			return;
+		memset(grown + nb_names, 0, (n - nb_names) * sizeof(*names));
+		names = grown;
+		nb_names = n;
+	}
+	memcpy(names[id], &ev->b, 8);
+	memcpy(names[id] + 8, &ev->c, 8);
+	names[id][16] = '\0';
+}
+
+static const char *get_name(uint32_t id)
+{
+	return id < nb_names && names[id][0] != '\0' ? names[id] : "-";
+}
+
+static void format_mac(uint64_t mac, char *buf, size_t len)
+{
+	snprintf(buf, len, "%02x:%02x:%02x:%02x:%02x:%02x", (unsigned)(mac >> 40) & 0xff,
+		 (unsigned)(mac >> 32) & 0xff, (unsigned)(mac >> 24) & 0xff, (unsigned)(mac >> 16) & 0xff,
+		 (unsigned)(mac >> 8) & 0xff, (unsigned)mac & 0xff);
+}
+
+static void format_time(uint64_t wall_ns, char *buf, size_t len)
+{
+	time_t sec = (time_t)(wall_ns / 1000000000ULL);
+	struct tm tm;
+	size_t n;
+
+	localtime_r(&sec, &tm);
+	n = strftime(buf, len, "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buf + n, len - n, ".%09" PRIu64, (uint64_t)(wall_ns % 1000000000ULL));
+}
+
+static void print_text(const XenoFlowEvent *ev, uint64_t wall_ns)
+{
+	char when[48], mac[18];
+	struct in_addr vip;
+
+	format_time(wall_ns, when, sizeof(when));
+	printf("%s [%u] %-18s ", when, ev->thread, type_names[ev->type]);
+
+	switch (ev->type) {
+	case XENOFLOW_EV_BACKEND_ADD:
+	case XENOFLOW_EV_BACKEND_REMOVE:
+		format_mac(ev->b, mac, sizeof(mac));
+		printf("counter=%u name=%s mac=%s latency_us=%.1f\n", ev->a, get_name(ev->a), mac, ev->c / 1e3);
+		break;
+	case XENOFLOW_EV_BACKEND_ADD_FAILED:
+		format_mac(ev->b, mac, sizeof(mac));
+		printf("counter=%u name=%s mac=%s error=%" PRIu64 "\n", ev->a, get_name(ev->a), mac, ev->c);
+		break;
+	case XENOFLOW_EV_BACKEND_NAME:
+		printf("counter=%u name=%s\n", ev->a, get_name(ev->a));
+		break;
+	case XENOFLOW_EV_VIP_ADD:
+		vip.s_addr = (uint32_t)ev->b;
+		printf("service=%u vip=%s protocol=%u port=%u\n", ev->a, inet_ntoa(vip), (unsigned)(ev->c >> 16),
+		       (unsigned)(ev->c & 0xffff));
+		break;
+	case XENOFLOW_EV_COUNTER_SAMPLE:
+		printf("counter=%u name=%s packets=%" PRIu64 " bytes=%" PRIu64 "\n", ev->a, get_name(ev->a), ev->b,
+		       ev->c);
+		break;
+	case XENOFLOW_EV_API_CALL:
+		printf("endpoint=%s method=%s duration_us=%.1f\n",
+		       ev->a < XENOFLOW_EVLOG_API_MAX ? endpoint_names[ev->a] : "?", ev->b ? "POST" : "GET", ev->c / 1e3);
+		break;
+	case XENOFLOW_EV_OPS_BATCH:
+		printf("ops=%u window_us=%" PRIu64 "\n", ev->a, ev->b);
+		break;
+	case XENOFLOW_EV_RELOAD:
+		printf("queued=%u\n", ev->a);
+		break;
+	case XENOFLOW_EV_BUCKET_MOVE:
+		printf("counter=%u from=%s to=%s\n", ev->a, get_name((uint32_t)ev->b), get_name((uint32_t)ev->c));
+		break;
+	}
+}
+
+static void print_csv(const XenoFlowEvent *ev, uint64_t wall_ns)
+{
+	const char *name = ev->type == XENOFLOW_EV_API_CALL || ev->type == XENOFLOW_EV_OPS_BATCH ||
+					   ev->type == XENOFLOW_EV_RELOAD || ev->type == XENOFLOW_EV_VIP_ADD
+				   ? ""
+				   : get_name(ev->a);
+
+	printf("%" PRIu64 ",%" PRIu64 ",%u,%s,%u,%s,%" PRIu64 ",%" PRIu64 "\n", wall_ns, ev->ts_ns, ev->thread,
+	       type_names[ev->type], ev->a, name, ev->b, ev->c);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{"csv", no_argument, NULL, 'c'},
+		{"type", required_argument, NULL, 't'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	XenoFlowEvlogHeader header;
+	XenoFlowEvent ev;
+	const char *only = NULL;
+	uint64_t nb_events = 0;
+	int csv = 0, opt;
+	FILE *file;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case 'c':
+			csv = 1;
+			break;
+		case 't':
+			only = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	file = fopen(argv[optind], "rb");
+	if (file == NULL) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header.magic, XENOFLOW_EVLOG_MAGIC, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "%s: not a XenoFlow event log\n", argv[optind]);
+		fclose(file);
+		return EXIT_FAILURE;
+	}
+	if (header.version != XENOFLOW_EVLOG_VERSION || header.record_size != sizeof(XenoFlowEvent)) {
+		fprintf(stderr, "%s: unsupported version %u (record size %u)\n", argv[optind], header.version,
+			header.record_size);
+		fclose(file);
+		return EXIT_FAILURE;
+	}
+
+	if (csv)
+		printf("wall_ns,mono_ns,thread,event,id,name,b,c\n");
+
+	while (fread(&ev, sizeof(ev), 1, file) == 1) {
+		uint64_t wall_ns = header.real_start_ns + (ev.ts_ns - header.mono_start_ns);
+
+		if (ev.type == 0 || ev.type >= XENOFLOW_EV_MAX)
+			continue;
+		if (ev.type == XENOFLOW_EV_BACKEND_NAME)
+			set_name(ev.a, &ev);
+		if (only != NULL && strcmp(only, type_names[ev.type]) != 0)
+			continue;
+
+		if (csv)
+			print_csv(&ev, wall_ns);
+		else
+			print_text(&ev, wall_ns);
+		nb_events++;
+	}
+
+	fclose(file);
+	free(names);
+	fprintf(stderr, "%" PRIu64 " events\n", nb_events);
+	return EXIT_SUCCESS;
+}
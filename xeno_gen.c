@@ -0,0 +1,692 @@
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_random.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+
+#include "xeno_gen.h"
+
+#define RTE_LOGTYPE_XENO_GEN RTE_LOGTYPE_USER1
+
+#define NB_MBUFS 8191
+#define MBUF_CACHE_SIZE 256
+#define NB_RX_DESC 1024
+#define SRC_PORT_BASE 10000
+#define SRC_PORT_RANGE 50000
+#define DRAIN_MS 500
+
+static volatile bool force_quit;
+static volatile bool rx_quit;
+static volatile bool tx_done;
+static struct xeno_gen_stats stats;
+static struct rte_mempool *mbuf_pool;
+static uint32_t *sample_table;
+static bool tx_cksum_offload;
+
+/* Header lengths of the configured packet layout */
+static uint16_t l3_len;
+static uint16_t l4_len;
+
+void xeno_gen_cfg_init(struct xeno_gen_cfg *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->dist = XENO_GEN_DIST_UNIFORM;
+	cfg->nb_sources = 1024;
+	cfg->zipf_s = 1.0;
+	cfg->nat_sources = 4;
+	cfg->nat_share = 0.8;
+	cfg->pkt_size = 64;
+	cfg->burst = 32;
+	cfg->src_ip4 = RTE_IPV4(10, 1, 0, 1);
+	cfg->dst_ip4 = RTE_IPV4(10, 0, 0, 100);
+	cfg->src_ip6[0] = 0xfd;
+	cfg->src_ip6[1] = 0x01;
+	cfg->src_ip6[15] = 0x01;
+	cfg->dst_ip6[0] = 0xfd;
+	cfg->dst_ip6[15] = 0x64;
+	cfg->dst_port = 53;
+	memset(cfg->dst_mac.addr_bytes, 0xff, RTE_ETHER_ADDR_LEN);
+	cfg->seed = 1;
+}
+
+int xeno_gen_parse_dist(const char *name, enum xeno_gen_dist *dist)
+{
+	if (strcmp(name, "uniform") == 0)
+		*dist = XENO_GEN_DIST_UNIFORM;
+	else if (strcmp(name, "zipf") == 0)
+		*dist = XENO_GEN_DIST_ZIPF;
+	else if (strcmp(name, "nat") == 0)
+		*dist = XENO_GEN_DIST_NAT;
+	else
+		return -1;
+	return 0;
+}
+
+void xeno_gen_stop(void)
+{
+	force_quit = true;
+}
+
+static double rand_unit(void)
+{
+	return (double)(rte_rand() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * Pre-draw XENO_GEN_SAMPLE_TABLE_SIZE source indices so the TX loop only has to
+ * step through a table; zipf sampling by binary search over the CDF is far too
+ * slow to do per packet at line rate.
+ */
+static int build_sample_table(const struct xeno_gen_cfg *cfg)
+{
+	double *cdf = NULL;
+	uint32_t n = cfg->nb_sources;
+	uint32_t heavy = RTE_MIN(cfg->nat_sources, n);
+
+	sample_table = rte_zmalloc("xeno_gen_samples", XENO_GEN_SAMPLE_TABLE_SIZE * sizeof(uint32_t), 0);
+	if (sample_table == NULL)
+		return -ENOMEM;
+
+	rte_srand(cfg->seed);
+
+	if (cfg->dist == XENO_GEN_DIST_ZIPF) {
+		double sum = 0;
+
+		cdf = malloc(n * sizeof(double));
+		if (cdf == NULL)
+			return -ENOMEM;
+		for (uint32_t i = 0; i < n; i++) {
+			sum += 1.0 / pow((double)(i + 1), cfg->zipf_s);
+			cdf[i] = sum;
+		}
+		for (uint32_t i = 0; i < n; i++)
+			cdf[i] /= sum;
+	}
+
+	for (uint32_t i = 0; i < XENO_GEN_SAMPLE_TABLE_SIZE; i++) {
+		uint32_t idx;
+
+		switch (cfg->dist) {
+		case XENO_GEN_DIST_ZIPF: {
+			double u = rand_unit();
+			uint32_t lo = 0, hi = n - 1;
+
+			while (lo < hi) {
+				uint32_t mid = lo + (hi - lo) / 2;
+
+				if (cdf[mid] < u)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			idx = lo;
+			break;
+		}
+		case XENO_GEN_DIST_NAT:
+			if (heavy == n || rand_unit() < cfg->nat_share)
+				idx = rte_rand_max(heavy);
+			else
+				idx = heavy + rte_rand_max(n - heavy);
+			break;
+		default:
+			idx = rte_rand_max(n);
+			break;
+		}
+		sample_table[i] = idx;
+	}
+
+	free(cdf);
+	return 0;
+}
+
+/* Share of the sample table taken by the 10 most frequent sources, to document the generated skew */
+static double top_sources_share(const struct xeno_gen_cfg *cfg)
+{
+	uint32_t *hist = calloc(cfg->nb_sources, sizeof(uint32_t));
+	uint32_t top[10] = {0};
+	uint64_t sum = 0;
+
+	if (hist == NULL)
+		return 0;
+	for (uint32_t i = 0; i < XENO_GEN_SAMPLE_TABLE_SIZE; i++)
+		hist[sample_table[i]]++;
+	for (uint32_t i = 0; i < cfg->nb_sources; i++) {
+		uint32_t v = hist[i];
+
+		for (int k = 0; k < 10; k++) {
+			if (v > top[k]) {
+				uint32_t tmp = top[k];
+
+				top[k] = v;
+				v = tmp;
+			}
+		}
+	}
+	for (int k = 0; k < 10; k++)
+		sum += top[k];
+	free(hist);
+	return (double)sum / XENO_GEN_SAMPLE_TABLE_SIZE;
+}
+
+static int port_init(uint16_t port_id, bool want_tx_offload)
+{
+	struct rte_eth_conf port_conf;
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_txconf txconf;
+	int ret;
+
+	memset(&port_conf, 0, sizeof(port_conf));
+
+	ret = rte_eth_dev_info_get(port_id, &dev_info);
+	if (ret != 0)
+		return ret;
+
+	if (want_tx_offload) {
+		uint64_t needed = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | RTE_ETH_TX_OFFLOAD_UDP_CKSUM |
+				  RTE_ETH_TX_OFFLOAD_TCP_CKSUM;
+
+		tx_cksum_offload = (dev_info.tx_offload_capa & needed) == needed;
+		if (tx_cksum_offload)
+			port_conf.txmode.offloads |= needed;
+	}
+
+	ret = rte_eth_dev_configure(port_id, 1, 1, &port_conf);
+	if (ret != 0)
+		return ret;
+
+	ret = rte_eth_rx_queue_setup(port_id, 0, NB_RX_DESC, rte_eth_dev_socket_id(port_id), NULL, mbuf_pool);
+	if (ret < 0)
+		return ret;
+
+	memset(&txconf, 0, sizeof(txconf));
+	txconf.offloads = port_conf.txmode.offloads;
+	ret = rte_eth_tx_queue_setup(port_id, 0, XENO_GEN_TX_DESC, rte_eth_dev_socket_id(port_id), &txconf);
+	if (ret < 0)
+		return ret;
+
+	ret = rte_eth_dev_start(port_id);
+	if (ret < 0)
+		return ret;
+
+	/* vdevs like net_pcap do not support promiscuous mode, that is fine */
+	rte_eth_promiscuous_enable(port_id);
+	return 0;
+}
+
+int xeno_gen_ports_init(struct xeno_gen_cfg *cfg)
+{
+	int ret;
+
+	if (!rte_eth_dev_is_valid_port(cfg->tx_port)) {
+		RTE_LOG(ERR, XENO_GEN, "TX port %u is not a valid DPDK port\n", cfg->tx_port);
+		return -EINVAL;
+	}
+	if (cfg->has_rx_port && !rte_eth_dev_is_valid_port(cfg->rx_port)) {
+		RTE_LOG(ERR, XENO_GEN, "RX port %u is not a valid DPDK port\n", cfg->rx_port);
+		return -EINVAL;
+	}
+
+	mbuf_pool = rte_pktmbuf_pool_create("xeno_gen_mbufs", NB_MBUFS * 2, MBUF_CACHE_SIZE, 0,
+					    RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (mbuf_pool == NULL) {
+		RTE_LOG(ERR, XENO_GEN, "Failed to create mbuf pool\n");
+		return -ENOMEM;
+	}
+	if (cfg->pkt_size > rte_pktmbuf_data_room_size(mbuf_pool) - RTE_PKTMBUF_HEADROOM) {
+		RTE_LOG(ERR, XENO_GEN, "Frame size %u does not fit an mbuf of %u bytes\n", cfg->pkt_size,
+			rte_pktmbuf_data_room_size(mbuf_pool) - RTE_PKTMBUF_HEADROOM);
+		return -EINVAL;
+	}
+
+	ret = port_init(cfg->tx_port, true);
+	if (ret != 0) {
+		RTE_LOG(ERR, XENO_GEN, "Failed to init TX port %u: %s\n", cfg->tx_port, rte_strerror(-ret));
+		return ret;
+	}
+
+	if (cfg->has_rx_port && cfg->rx_port != cfg->tx_port) {
+		ret = port_init(cfg->rx_port, false);
+		if (ret != 0) {
+			RTE_LOG(ERR, XENO_GEN, "Failed to init RX port %u: %s\n", cfg->rx_port, rte_strerror(-ret));
+			return ret;
+		}
+	}
+
+	if (!cfg->has_src_mac)
+		rte_eth_macaddr_get(cfg->tx_port, &cfg->src_mac);
+
+	RTE_LOG(INFO, XENO_GEN, "TX port %u ready, checksum offload %s\n", cfg->tx_port,
+		tx_cksum_offload ? "on" : "off (software checksums)");
+	return 0;
+}
+
+void xeno_gen_ports_fini(struct xeno_gen_cfg *cfg)
+{
+	rte_eth_dev_stop(cfg->tx_port);
+	rte_eth_dev_close(cfg->tx_port);
+	if (cfg->has_rx_port && cfg->rx_port != cfg->tx_port) {
+		rte_eth_dev_stop(cfg->rx_port);
+		rte_eth_dev_close(cfg->rx_port);
+	}
+	rte_free(sample_table);
+	sample_table = NULL;
+}
+
+static void build_template(const struct xeno_gen_cfg *cfg, uint8_t *tmpl)
+{
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)tmpl;
+	uint16_t l3_payload = cfg->pkt_size - sizeof(*eth) - l3_len;
+	uint8_t proto = cfg->tcp ? IPPROTO_TCP : IPPROTO_UDP;
+	uint8_t *l4 = tmpl + sizeof(*eth) + l3_len;
+
+	memset(tmpl, 0, cfg->pkt_size);
+	rte_ether_addr_copy(&cfg->dst_mac, &eth->dst_addr);
+	rte_ether_addr_copy(&cfg->src_mac, &eth->src_addr);
+
+	if (cfg->ipv6) {
+		struct rte_ipv6_hdr *ip6 = (struct rte_ipv6_hdr *)(eth + 1);
+
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6);
+		ip6->vtc_flow = rte_cpu_to_be_32(6u << 28);
+		ip6->payload_len = rte_cpu_to_be_16(l3_payload);
+		ip6->proto = proto;
+		ip6->hop_limits = 64;
+		memcpy(ip6->src_addr, cfg->src_ip6, 16);
+		memcpy(ip6->dst_addr, cfg->dst_ip6, 16);
+	} else {
+		struct rte_ipv4_hdr *ip4 = (struct rte_ipv4_hdr *)(eth + 1);
+
+		eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+		ip4->version_ihl = RTE_IPV4_VHL_DEF;
+		ip4->total_length = rte_cpu_to_be_16(l3_len + l3_payload);
+		ip4->time_to_live = 64;
+		ip4->next_proto_id = proto;
+		ip4->src_addr = rte_cpu_to_be_32(cfg->src_ip4);
+		ip4->dst_addr = rte_cpu_to_be_32(cfg->dst_ip4);
+	}
+
+	if (cfg->tcp) {
+		struct rte_tcp_hdr *tcp = (struct rte_tcp_hdr *)l4;
+
+		tcp->dst_port = rte_cpu_to_be_16(cfg->dst_port);
+		tcp->data_off = (sizeof(*tcp) / 4) << 4;
+		tcp->tcp_flags = RTE_TCP_ACK_FLAG | RTE_TCP_PSH_FLAG;
+		tcp->rx_win = rte_cpu_to_be_16(65535);
+	} else {
+		struct rte_udp_hdr *udp = (struct rte_udp_hdr *)l4;
+
+		udp->dst_port = rte_cpu_to_be_16(cfg->dst_port);
+		udp->dgram_len = rte_cpu_to_be_16(l3_payload);
+	}
+}
+
+/*
+ * Patch source address, port, sequence number and checksums into a copy of the template,
+ * -1 if the frame does not fit the mbuf
+ */
+static int fill_packet(const struct xeno_gen_cfg *cfg, struct rte_mbuf *m, const uint8_t *tmpl, uint32_t source,
+		       uint64_t seq, uint64_t tsc)
+{
+	uint8_t *pkt = (uint8_t *)rte_pktmbuf_append(m, cfg->pkt_size);
+	uint8_t *l3, *l4;
+	struct xeno_gen_payload *payload;
+	uint16_t src_port = rte_cpu_to_be_16(SRC_PORT_BASE + source % SRC_PORT_RANGE);
+	uint16_t *l4_cksum;
+
+	if (pkt == NULL)
+		return -1;
+	l3 = pkt + sizeof(struct rte_ether_hdr);
+	l4 = l3 + l3_len;
+	payload = (struct xeno_gen_payload *)(l4 + l4_len);
+
+	memcpy(pkt, tmpl, cfg->pkt_size);
+
+	payload->magic = XENO_GEN_MAGIC;
+	payload->source = source;
+	payload->seq = seq;
+	payload->tsc = tsc;
+
+	if (cfg->tcp) {
+		struct rte_tcp_hdr *tcp = (struct rte_tcp_hdr *)l4;
+
+		tcp->src_port = src_port;
+		tcp->sent_seq = rte_cpu_to_be_32((uint32_t)seq);
+		l4_cksum = &tcp->cksum;
+	} else {
+		struct rte_udp_hdr *udp = (struct rte_udp_hdr *)l4;
+
+		udp->src_port = src_port;
+		l4_cksum = &udp->dgram_cksum;
+	}
+
+	m->l2_len = sizeof(struct rte_ether_hdr);
+	m->l3_len = l3_len;
+
+	if (cfg->ipv6) {
+		struct rte_ipv6_hdr *ip6 = (struct rte_ipv6_hdr *)l3;
+		uint32_t low = ((uint32_t)ip6->src_addr[12] << 24 | (uint32_t)ip6->src_addr[13] << 16 |
+				(uint32_t)ip6->src_addr[14] << 8 | ip6->src_addr[15]) + source;
+
+		ip6->src_addr[12] = low >> 24;
+		ip6->src_addr[13] = low >> 16;
+		ip6->src_addr[14] = low >> 8;
+		ip6->src_addr[15] = low;
+		if (tx_cksum_offload) {
+			m->ol_flags |= RTE_MBUF_F_TX_IPV6 | (cfg->tcp ? RTE_MBUF_F_TX_TCP_CKSUM : RTE_MBUF_F_TX_UDP_CKSUM);
+			*l4_cksum = rte_ipv6_phdr_cksum(ip6, m->ol_flags);
+		} else {
+			*l4_cksum = rte_ipv6_udptcp_cksum(ip6, l4);
+		}
+	} else {
+		struct rte_ipv4_hdr *ip4 = (struct rte_ipv4_hdr *)l3;
+
+		ip4->src_addr = rte_cpu_to_be_32(cfg->src_ip4 + source);
+		ip4->packet_id = rte_cpu_to_be_16((uint16_t)seq);
+		if (tx_cksum_offload) {
+			m->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM |
+				       (cfg->tcp ? RTE_MBUF_F_TX_TCP_CKSUM : RTE_MBUF_F_TX_UDP_CKSUM);
+			*l4_cksum = rte_ipv4_phdr_cksum(ip4, m->ol_flags);
+		} else {
+			ip4->hdr_checksum = rte_ipv4_cksum(ip4);
+			*l4_cksum = rte_ipv4_udptcp_cksum(ip4, l4);
+		}
+	}
+	return 0;
+}
+
+static int tx_loop(void *arg)
+{
+	const struct xeno_gen_cfg *cfg = arg;
+	struct rte_mbuf *pkts[cfg->burst];
+	uint8_t tmpl[cfg->pkt_size];
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t seq = 0;
+	uint32_t sample = 0;
+	double cycles_per_pkt = cfg->rate_pps ? (double)hz / cfg->rate_pps : 0;
+	double next_tsc = rte_rdtsc();
+
+	build_template(cfg, tmpl);
+	RTE_LOG(INFO, XENO_GEN, "TX loop running on lcore %u\n", rte_lcore_id());
+
+	while (!force_quit) {
+		uint16_t n = cfg->burst;
+		uint16_t sent = 0;
+		uint64_t now;
+
+		if (cfg->count != 0) {
+			if (seq >= cfg->count)
+				break;
+			n = RTE_MIN((uint64_t)n, cfg->count - seq);
+		}
+
+		if (cycles_per_pkt > 0) {
+			while ((double)rte_rdtsc() < next_tsc && !force_quit)
+				rte_pause();
+			next_tsc += cycles_per_pkt * n;
+		}
+
+		if (rte_pktmbuf_alloc_bulk(mbuf_pool, pkts, n) != 0)
+			continue;
+
+		now = rte_rdtsc();
+		for (uint16_t i = 0; i < n; i++) {
+			if (fill_packet(cfg, pkts[i], tmpl, sample_table[sample], seq + i, now) != 0) {
+				RTE_LOG(ERR, XENO_GEN, "Frame of %u bytes does not fit an mbuf\n", cfg->pkt_size);
+				rte_pktmbuf_free_bulk(pkts, n);
+				goto out;
+			}
+			sample = (sample + 1) & (XENO_GEN_SAMPLE_TABLE_SIZE - 1);
+		}
+
+		/* Retry instead of dropping so sequence numbers only go missing on the wire */
+		while (sent < n && !force_quit)
+			sent += rte_eth_tx_burst(cfg->tx_port, 0, pkts + sent, n - sent);
+		if (sent < n)
+			rte_pktmbuf_free_bulk(pkts + sent, n - sent);
+
+		seq += sent;
+		stats.tx_pkts += sent;
+		stats.tx_bytes += (uint64_t)sent * cfg->pkt_size;
+	}
+
+out:
+	tx_done = true;
+	return 0;
+}
+
+static void account_mac(const struct rte_ether_addr *mac)
+{
+	uint32_t n = stats.rx_nb_macs;
+
+	for (uint32_t i = 0; i < n; i++) {
+		if (memcmp(&stats.rx_macs[i], mac, sizeof(*mac)) == 0) {
+			stats.rx_mac_pkts[i]++;
+			return;
+		}
+	}
+	if (n < XENO_GEN_MAX_RX_MACS) {
+		stats.rx_macs[n] = *mac;
+		stats.rx_mac_pkts[n] = 1;
+		stats.rx_nb_macs = n + 1;
+	}
+}
+
+static void rx_packet(struct rte_mbuf *m, uint64_t now)
+{
+	uint8_t *pkt = rte_pktmbuf_mtod(m, uint8_t *);
+	struct rte_ether_hdr *eth = (struct rte_ether_hdr *)pkt;
+	uint16_t ether_type = rte_be_to_cpu_16(eth->ether_type);
+	uint16_t off = sizeof(*eth);
+	struct xeno_gen_payload *payload;
+	uint8_t proto;
+
+	if (ether_type == RTE_ETHER_TYPE_IPV4) {
+		struct rte_ipv4_hdr *ip4 = (struct rte_ipv4_hdr *)(pkt + off);
+
+		proto = ip4->next_proto_id;
+		off += (ip4->version_ihl & 0x0f) * 4;
+	} else if (ether_type == RTE_ETHER_TYPE_IPV6) {
+		proto = ((struct rte_ipv6_hdr *)(pkt + off))->proto;
+		off += sizeof(struct rte_ipv6_hdr);
+	} else {
+		goto foreign;
+	}
+
+	if (proto == IPPROTO_UDP)
+		off += sizeof(struct rte_udp_hdr);
+	else if (proto == IPPROTO_TCP)
+		off += (((struct rte_tcp_hdr *)(pkt + off))->data_off >> 4) * 4;
+	else
+		goto foreign;
+
+	if (off + sizeof(*payload) > m->data_len)
+		goto foreign;
+	payload = (struct xeno_gen_payload *)(pkt + off);
+	if (payload->magic != XENO_GEN_MAGIC)
+		goto foreign;
+
+	stats.rx_pkts++;
+	stats.rx_bytes += m->pkt_len;
+	stats.rx_latency_cycles += now - payload->tsc;
+	if (payload->seq + 1 <= stats.rx_max_seq)
+		stats.rx_reordered++;
+	else
+		stats.rx_max_seq = payload->seq + 1;
+	account_mac(&eth->dst_addr);
+	return;
+
+foreign:
+	stats.rx_foreign++;
+}
+
+static int rx_loop(void *arg)
+{
+	const struct xeno_gen_cfg *cfg = arg;
+	struct rte_mbuf *pkts[cfg->burst];
+
+	RTE_LOG(INFO, XENO_GEN, "RX loop running on lcore %u\n", rte_lcore_id());
+
+	while (!rx_quit) {
+		uint16_t nb = rte_eth_rx_burst(cfg->rx_port, 0, pkts, cfg->burst);
+		uint64_t now;
+
+		if (nb == 0)
+			continue;
+		now = rte_rdtsc();
+		for (uint16_t i = 0; i < nb; i++)
+			rx_packet(pkts[i], now);
+		rte_pktmbuf_free_bulk(pkts, nb);
+	}
+	return 0;
+}
+
+static void print_distribution(void)
+{
+	uint64_t total = stats.rx_pkts;
+	uint32_t n = stats.rx_nb_macs;
+	double min_share = 1.0, max_share = 0.0;
+
+	if (total == 0 || n == 0)
+		return;
+
+	printf("  Distribution over %u destination MACs:\n", n);
+	for (uint32_t i = 0; i < n; i++) {
+		char mac[RTE_ETHER_ADDR_FMT_SIZE];
+		double share = (double)stats.rx_mac_pkts[i] / total;
+
+		rte_ether_format_addr(mac, sizeof(mac), &stats.rx_macs[i]);
+		printf("    %s: %lu packets (%.2f%%)\n", mac, stats.rx_mac_pkts[i], share * 100);
+		min_share = RTE_MIN(min_share, share);
+		max_share = RTE_MAX(max_share, share);
+	}
+	printf("  Imbalance (max/min share): %.3f\n", min_share > 0 ? max_share / min_share : 0.0);
+}
+
+static void print_summary(const struct xeno_gen_cfg *cfg, double elapsed)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t tx = stats.tx_pkts;
+	uint64_t rx = stats.rx_pkts;
+
+	printf("==== xeno_gen summary ====\n");
+	printf("  Duration: %.2f s\n", elapsed);
+	printf("  TX: %lu packets, %.3f Mpps, %.3f Gbit/s\n", tx, tx / elapsed / 1e6,
+	       stats.tx_bytes * 8 / elapsed / 1e9);
+	if (!cfg->has_rx_port)
+		return;
+	printf("  RX: %lu packets, %.3f Mpps, %lu foreign, %lu reordered\n", rx, rx / elapsed / 1e6,
+	       stats.rx_foreign, stats.rx_reordered);
+	printf("  Loss: %lu packets (%.4f%%)\n", tx > rx ? tx - rx : 0,
+	       tx ? (tx > rx ? (double)(tx - rx) / tx * 100 : 0.0) : 0.0);
+	if (rx)
+		printf("  Mean one-way latency: %.2f us\n", (double)stats.rx_latency_cycles / rx / hz * 1e6);
+	print_distribution();
+}
+
+int xeno_gen_run(struct xeno_gen_cfg *cfg)
+{
+	const char *dist_names[] = {"uniform", "zipf", "nat"};
+	uint16_t min_size = sizeof(struct rte_ether_hdr) + sizeof(struct xeno_gen_payload);
+	unsigned int tx_lcore, rx_lcore = RTE_MAX_LCORE;
+	uint64_t hz = rte_get_tsc_hz();
+	uint64_t start, last, last_tx = 0, last_rx = 0;
+	int ret;
+
+	l3_len = cfg->ipv6 ? sizeof(struct rte_ipv6_hdr) : sizeof(struct rte_ipv4_hdr);
+	l4_len = cfg->tcp ? sizeof(struct rte_tcp_hdr) : sizeof(struct rte_udp_hdr);
+	min_size += l3_len + l4_len;
+	if (cfg->pkt_size < min_size) {
+		RTE_LOG(INFO, XENO_GEN, "Packet size %u too small for headers and payload, using %u\n",
+			cfg->pkt_size, min_size);
+		cfg->pkt_size = min_size;
+	}
+	if (cfg->nb_sources == 0 || cfg->burst == 0) {
+		RTE_LOG(ERR, XENO_GEN, "Number of sources and burst size must be positive\n");
+		return -EINVAL;
+	}
+	if (cfg->burst > XENO_GEN_MAX_BURST) {
+		RTE_LOG(ERR, XENO_GEN, "Burst size %u is above %d\n", cfg->burst, XENO_GEN_MAX_BURST);
+		return -EINVAL;
+	}
+	if (cfg->dist == XENO_GEN_DIST_NAT && cfg->nat_sources == 0) {
+		RTE_LOG(ERR, XENO_GEN, "The nat distribution needs at least 1 NAT source\n");
+		return -EINVAL;
+	}
+
+	ret = build_sample_table(cfg);
+	if (ret != 0)
+		return ret;
+
+	RTE_LOG(INFO, XENO_GEN, "%s/%s, %u sources (%s), top 10 sources carry %.1f%% of packets\n",
+		cfg->ipv6 ? "IPv6" : "IPv4", cfg->tcp ? "TCP" : "UDP", cfg->nb_sources, dist_names[cfg->dist],
+		top_sources_share(cfg) * 100);
+
+	tx_lcore = rte_get_next_lcore(-1, 1, 0);
+	if (tx_lcore >= RTE_MAX_LCORE) {
+		RTE_LOG(ERR, XENO_GEN, "Need at least 2 lcores (main + TX)\n");
+		return -EINVAL;
+	}
+	if (cfg->has_rx_port) {
+		rx_lcore = rte_get_next_lcore(tx_lcore, 1, 0);
+		if (rx_lcore >= RTE_MAX_LCORE) {
+			RTE_LOG(ERR, XENO_GEN, "Need at least 3 lcores (main + TX + RX) when receiving\n");
+			return -EINVAL;
+		}
+		rte_eal_remote_launch(rx_loop, cfg, rx_lcore);
+	}
+	rte_eal_remote_launch(tx_loop, cfg, tx_lcore);
+
+	start = last = rte_rdtsc();
+	while (!force_quit) {
+		uint64_t now, tx, rx;
+		double dt;
+
+		rte_delay_us_sleep(100000);
+		now = rte_rdtsc();
+
+		if (tx_done || (cfg->duration_s != 0 && now - start >= cfg->duration_s * hz))
+			break;
+		if (now - last < hz)
+			continue;
+
+		tx = stats.tx_pkts;
+		rx = stats.rx_pkts;
+		dt = (double)(now - last) / hz;
+		if (cfg->has_rx_port)
+			printf("TX %.3f Mpps | RX %.3f Mpps | total TX %lu RX %lu lost %lu\n",
+			       (tx - last_tx) / dt / 1e6, (rx - last_rx) / dt / 1e6, tx, rx, tx > rx ? tx - rx : 0);
+		else
+			printf("TX %.3f Mpps | total TX %lu\n", (tx - last_tx) / dt / 1e6, tx);
+		last_tx = tx;
+		last_rx = rx;
+		last = now;
+	}
+
+	/* Stop transmitting, then give packets still in flight time to arrive */
+	force_quit = true;
+	rte_eal_wait_lcore(tx_lcore);
+	if (cfg->has_rx_port) {
+		rte_delay_us_sleep(DRAIN_MS * 1000);
+		rx_quit = true;
+		rte_eal_wait_lcore(rx_lcore);
+	}
+
+	print_summary(cfg, (double)(rte_rdtsc() - start) / hz);
+	return 0;
+}
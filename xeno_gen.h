@@ -0,0 +1,137 @@
+#ifndef XENO_GEN_H
+#define XENO_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <rte_ether.h>
+#include <rte_mbuf.h>
+
+/* Marks generator payloads so the receive side can tell them apart from other traffic */
+#define XENO_GEN_MAGIC 0x58454e4fu /* "XENO" */
+
+/* Number of pre-drawn source indices; the TX loop cycles through them instead of sampling per packet */
+#define XENO_GEN_SAMPLE_TABLE_SIZE (1 << 16)
+
+/* Number of distinct destination MACs the receive side keeps a histogram for */
+#define XENO_GEN_MAX_RX_MACS 64
+
+/* Largest frame the generator sends: frames are single mbufs of its pool's data room */
+#define XENO_GEN_MAX_PKT_SIZE (RTE_MBUF_DEFAULT_BUF_SIZE - RTE_PKTMBUF_HEADROOM)
+
+/* Descriptors of the TX ring */
+#define XENO_GEN_TX_DESC 1024
+
+/* Largest burst: it sizes the mbuf arrays on the lcore stacks and must fit in the TX ring */
+#define XENO_GEN_MAX_BURST (XENO_GEN_TX_DESC < 512 ? XENO_GEN_TX_DESC : 512)
+
+/**
+ * @brief Source address distribution of the generated flows
+ */
+enum xeno_gen_dist {
+	XENO_GEN_DIST_UNIFORM,	/* every source equally likely */
+	XENO_GEN_DIST_ZIPF,	/* source i drawn with probability ~ 1 / (i + 1)^s */
+	XENO_GEN_DIST_NAT,	/* a few heavy sources carry a fixed share of traffic, the rest is uniform */
+};
+
+/**
+ * @brief Payload written right after the L4 header of every generated packet
+ */
+struct xeno_gen_payload {
+	uint32_t magic;	 /* XENO_GEN_MAGIC */
+	uint32_t source; /* index of the source address the packet was sent from */
+	uint64_t seq;	 /* per-generator sequence number, starting at 0 */
+	uint64_t tsc;	 /* TSC value at transmit time */
+} __attribute__((packed));
+
+/**
+ * @brief Generator configuration, filled from the command line
+ */
+struct xeno_gen_cfg {
+	uint16_t tx_port;	    /* DPDK port to transmit on */
+	uint16_t rx_port;	    /* DPDK port to receive on, only used if has_rx_port */
+	bool has_rx_port;	    /* count returning packets for loss/distribution */
+	bool ipv6;		    /* generate IPv6 instead of IPv4 */
+	bool tcp;		    /* generate TCP (ACK|PSH) instead of UDP */
+	enum xeno_gen_dist dist;    /* source address distribution */
+	uint32_t nb_sources;	    /* size of the source address population */
+	double zipf_s;		    /* zipf exponent */
+	uint32_t nat_sources;	    /* number of heavy NAT sources */
+	double nat_share;	    /* share of traffic sent from the heavy NAT sources */
+	uint64_t rate_pps;	    /* target rate, 0 sends as fast as possible */
+	uint64_t count;		    /* packets to send, 0 is unlimited */
+	uint32_t duration_s;	    /* seconds to run, 0 is unlimited */
+	uint16_t pkt_size;	    /* frame size without CRC */
+	uint16_t burst;		    /* TX/RX burst size */
+	uint32_t src_ip4;	    /* first IPv4 source address, host order */
+	uint32_t dst_ip4;	    /* IPv4 destination address (the VIP), host order */
+	uint8_t src_ip6[16];	    /* first IPv6 source address */
+	uint8_t dst_ip6[16];	    /* IPv6 destination address */
+	uint16_t dst_port;	    /* L4 destination port */
+	struct rte_ether_addr dst_mac; /* destination MAC of generated frames */
+	bool has_src_mac;	    /* use src_mac instead of the port MAC */
+	struct rte_ether_addr src_mac; /* source MAC of generated frames */
+	uint64_t seed;		    /* seed for the source sampling */
+};
+
+/**
+ * @brief Counters shared between the TX, RX and reporting lcores
+ */
+struct xeno_gen_stats {
+	volatile uint64_t tx_pkts;
+	volatile uint64_t tx_bytes;
+	volatile uint64_t rx_pkts;	 /* generator packets received back */
+	volatile uint64_t rx_bytes;
+	volatile uint64_t rx_foreign;	 /* received packets without the generator magic */
+	volatile uint64_t rx_reordered;	 /* received with a sequence number below the highest seen */
+	volatile uint64_t rx_max_seq;	 /* highest sequence number seen + 1 */
+	volatile uint64_t rx_latency_cycles; /* sum of TSC deltas for rx_pkts */
+	volatile uint32_t rx_nb_macs;
+	struct rte_ether_addr rx_macs[XENO_GEN_MAX_RX_MACS];
+	volatile uint64_t rx_mac_pkts[XENO_GEN_MAX_RX_MACS];
+};
+
+/**
+ * @brief Set the generator defaults (IPv4/UDP, uniform over 1024 sources, 64B frames, unlimited rate)
+ * @param cfg Configuration to initialize
+ */
+void xeno_gen_cfg_init(struct xeno_gen_cfg *cfg);
+
+/**
+ * @brief Parse a distribution name ("uniform", "zipf" or "nat")
+ * @param name Distribution name
+ * @param dist Parsed distribution
+ * @return 0 on success, -1 on unknown names
+ */
+int xeno_gen_parse_dist(const char *name, enum xeno_gen_dist *dist);
+
+/**
+ * @brief Configure and start the TX (and optional RX) port
+ * @param cfg Generator configuration
+ * @return 0 on success, negative errno otherwise
+ */
+int xeno_gen_ports_init(struct xeno_gen_cfg *cfg);
+
+/**
+ * @brief Stop and close the ports started by xeno_gen_ports_init()
+ * @param cfg Generator configuration
+ */
+void xeno_gen_ports_fini(struct xeno_gen_cfg *cfg);
+
+/**
+ * @brief Run the generator until the count/duration limit is hit or xeno_gen_stop() is called
+ *
+ * Launches the TX loop (and RX loop if configured) on worker lcores and prints
+ * per-second rates, loss and the per-destination-MAC distribution on the main lcore.
+ *
+ * @param cfg Generator configuration
+ * @return 0 on success, negative errno otherwise
+ */
+int xeno_gen_run(struct xeno_gen_cfg *cfg);
+
+/**
+ * @brief Ask a running generator to stop, safe to call from a signal handler
+ */
+void xeno_gen_stop(void);
+
+#endif /* XENO_GEN_H */
@@ -0,0 +1,223 @@
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_eal.h>
+#include <rte_ether.h>
+
+#include "xeno_gen.h"
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [EAL options] -- [options]\n"
+	       "  --tx-port N          DPDK port to transmit on (default 0)\n"
+	       "  --rx-port N          DPDK port to count returning packets on (loss, distribution)\n"
+	       "  --ipv6               generate IPv6 instead of IPv4\n"
+	       "  --tcp                generate TCP instead of UDP\n"
+	       "  --dist NAME          source distribution: uniform, zipf or nat (default uniform)\n"
+	       "  --sources N          number of distinct source addresses (default 1024)\n"
+	       "  --zipf-s S           zipf exponent (default 1.0)\n"
+	       "  --nat-sources N      number of heavy NAT sources, at least 1 (default 4)\n"
+	       "  --nat-share F        share of traffic from the NAT sources, 0..1 (default 0.8)\n"
+	       "  --rate PPS           packets per second, 0 is line rate (default 0)\n"
+	       "  --count N            stop after N packets\n"
+	       "  --duration S         stop after S seconds\n"
+	       "  --size BYTES         frame size without CRC, at most one mbuf (default 64)\n"
+	       "  --burst N            burst size, at most 512 (default 32)\n"
+	       "  --src-ip ADDR        first source address, IPv4 or IPv6\n"
+	       "  --dst-ip ADDR        destination address (the VIP), IPv4 or IPv6\n"
+	       "  --dst-port N         destination L4 port (default 53)\n"
+	       "  --src-mac MAC        source MAC (default: TX port MAC)\n"
+	       "  --dst-mac MAC        destination MAC (default: broadcast)\n"
+	       "  --seed N             seed for source sampling (default 1)\n",
+	       prog);
+}
+
+static int parse_ip(const char *str, struct xeno_gen_cfg *cfg, bool src)
+{
+	struct in_addr ip4;
+
+	if (inet_pton(AF_INET, str, &ip4) == 1) {
+		if (src)
+			cfg->src_ip4 = ntohl(ip4.s_addr);
+		else
+			cfg->dst_ip4 = ntohl(ip4.s_addr);
+		return 0;
+	}
+	if (inet_pton(AF_INET6, str, src ? cfg->src_ip6 : cfg->dst_ip6) == 1)
+		return 0;
+	return -1;
+}
+
+static int parse_args(int argc, char **argv, struct xeno_gen_cfg *cfg)
+{
+	enum {
+		OPT_TX_PORT = 256, OPT_RX_PORT, OPT_IPV6, OPT_TCP, OPT_DIST, OPT_SOURCES, OPT_ZIPF_S,
+		OPT_NAT_SOURCES, OPT_NAT_SHARE, OPT_RATE, OPT_COUNT, OPT_DURATION, OPT_SIZE, OPT_BURST,
+		OPT_SRC_IP, OPT_DST_IP, OPT_DST_PORT, OPT_SRC_MAC, OPT_DST_MAC, OPT_SEED, OPT_HELP,
+	};
+	static const struct option long_opts[] = {
+		{"tx-port", required_argument, NULL, OPT_TX_PORT},
+		{"rx-port", required_argument, NULL, OPT_RX_PORT},
+		{"ipv6", no_argument, NULL, OPT_IPV6},
+		{"tcp", no_argument, NULL, OPT_TCP},
+		{"dist", required_argument, NULL, OPT_DIST},
+		{"sources", required_argument, NULL, OPT_SOURCES},
+		{"zipf-s", required_argument, NULL, OPT_ZIPF_S},
+		{"nat-sources", required_argument, NULL, OPT_NAT_SOURCES},
+		{"nat-share", required_argument, NULL, OPT_NAT_SHARE},
+		{"rate", required_argument, NULL, OPT_RATE},
+		{"count", required_argument, NULL, OPT_COUNT},
+		{"duration", required_argument, NULL, OPT_DURATION},
+		{"size", required_argument, NULL, OPT_SIZE},
+		{"burst", required_argument, NULL, OPT_BURST},
+		{"src-ip", required_argument, NULL, OPT_SRC_IP},
+		{"dst-ip", required_argument, NULL, OPT_DST_IP},
+		{"dst-port", required_argument, NULL, OPT_DST_PORT},
+		{"src-mac", required_argument, NULL, OPT_SRC_MAC},
+		{"dst-mac", required_argument, NULL, OPT_DST_MAC},
+		{"seed", required_argument, NULL, OPT_SEED},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case OPT_TX_PORT:
+			cfg->tx_port = atoi(optarg);
+			break;
+		case OPT_RX_PORT:
+			cfg->rx_port = atoi(optarg);
+			cfg->has_rx_port = true;
+			break;
+		case OPT_IPV6:
+			cfg->ipv6 = true;
+			break;
+		case OPT_TCP:
+			cfg->tcp = true;
+			break;
+		case OPT_DIST:
+			if (xeno_gen_parse_dist(optarg, &cfg->dist) != 0) {
+				fprintf(stderr, "Unknown distribution '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_SOURCES:
+			cfg->nb_sources = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_ZIPF_S:
+			cfg->zipf_s = atof(optarg);
+			break;
+		case OPT_NAT_SOURCES:
+			cfg->nat_sources = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_NAT_SHARE:
+			cfg->nat_share = atof(optarg);
+			break;
+		case OPT_RATE:
+			cfg->rate_pps = strtoull(optarg, NULL, 0);
+			break;
+		case OPT_COUNT:
+			cfg->count = strtoull(optarg, NULL, 0);
+			break;
+		case OPT_DURATION:
+			cfg->duration_s = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_SIZE: {
+			int size = atoi(optarg);
+
+			if (size <= 0 || size > XENO_GEN_MAX_PKT_SIZE) {
+				fprintf(stderr, "Frame size must be between 1 and %d bytes, got '%s'\n",
+					XENO_GEN_MAX_PKT_SIZE, optarg);
+				return -1;
+			}
+			cfg->pkt_size = size;
+			break;
+		}
+		case OPT_BURST: {
+			char *end;
+			unsigned long burst = strtoul(optarg, &end, 0);
+
+			if (*optarg == '\0' || *end != '\0' || burst == 0 || burst > XENO_GEN_MAX_BURST) {
+				fprintf(stderr, "Burst size must be between 1 and %d, got '%s'\n", XENO_GEN_MAX_BURST,
+					optarg);
+				return -1;
+			}
+			cfg->burst = burst;
+			break;
+		}
+		case OPT_SRC_IP:
+		case OPT_DST_IP:
+			if (parse_ip(optarg, cfg, opt == OPT_SRC_IP) != 0) {
+				fprintf(stderr, "Invalid address '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_DST_PORT:
+			cfg->dst_port = atoi(optarg);
+			break;
+		case OPT_SRC_MAC:
+			if (rte_ether_unformat_addr(optarg, &cfg->src_mac) != 0) {
+				fprintf(stderr, "Invalid MAC '%s'\n", optarg);
+				return -1;
+			}
+			cfg->has_src_mac = true;
+			break;
+		case OPT_DST_MAC:
+			if (rte_ether_unformat_addr(optarg, &cfg->dst_mac) != 0) {
+				fprintf(stderr, "Invalid MAC '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_SEED:
+			cfg->seed = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void signal_handler(int signum)
+{
+	(void)signum;
+	xeno_gen_stop();
+}
+
+int main(int argc, char **argv)
+{
+	struct xeno_gen_cfg cfg;
+	int ret;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to init EAL\n");
+		return EXIT_FAILURE;
+	}
+	argc -= ret;
+	argv += ret;
+
+	xeno_gen_cfg_init(&cfg);
+	if (parse_args(argc, argv, &cfg) != 0) {
+		rte_eal_cleanup();
+		return EXIT_FAILURE;
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	ret = xeno_gen_ports_init(&cfg);
+	if (ret == 0) {
+		ret = xeno_gen_run(&cfg);
+		xeno_gen_ports_fini(&cfg);
+	}
+
+	rte_eal_cleanup();
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
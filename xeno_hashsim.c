@@ -0,0 +1,556 @@
+/*
+ * Offline hash distribution simulator: how a capture or a list of client
+ * addresses would spread over the backends of a services config, and how
+ * many clients a new config moves away from the backend they have now.
+ *
+ * Each service is laid out like xeno_flow lays out its hash pipe at startup
+ * (hashsim.h), so backends added at runtime or buckets the rebalancer moved
+ * are not in the picture.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hashsim.h"
+#include "services_json.h"
+
+/* Classic pcap, microsecond and nanosecond timestamps */
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_LINKTYPE_ETHERNET 1
+#define PCAP_LINKTYPE_RAW 101
+
+#define ETH_TYPE_IPV4 0x0800
+#define ETH_TYPE_VLAN 0x8100
+#define ETH_TYPE_QINQ 0x88a8
+
+/**
+ * @brief Traffic of one client address
+ */
+struct source {
+	uint32_t addr;		/* network order */
+	uint64_t pkts;		/* 0 for a free slot */
+	uint64_t bytes;
+};
+
+/**
+ * @brief Client addresses of one service, open addressing on the address
+ */
+struct source_table {
+	struct source *slots;
+	uint32_t mask;
+	uint32_t count;
+};
+
+struct sim_cfg {
+	const char *config;
+	const char *current;
+	const char *pcap;
+	const char *sources;
+	const char *service;
+	enum XenoFlowHashAlgo algo;
+	uint8_t key[XENOFLOW_HASH_KEY_LEN];
+	bool has_key;
+	bool csv;
+};
+
+struct sim {
+	XenoFlowServicesFile services;
+	XenoFlowServicesFile current;
+	struct source_table *tables;	/* per service of services */
+	uint64_t unmatched;		/* packets of the capture no service takes */
+};
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s --config FILE (--pcap FILE | --sources FILE) [options]\n"
+	       "  --config FILE        services config to simulate\n"
+	       "  --current FILE       config running now, to count the clients the new one moves\n"
+	       "  --pcap FILE          capture of the client traffic, IPv4 over Ethernet or raw IP\n"
+	       "  --sources FILE       client addresses, one per line, optionally followed by a packet count\n"
+	       "  --service NAME       only this service; --sources go to it, or to the default service\n"
+	       "  --hash NAME          crc32, crc32c, toeplitz or fmix32 (default crc32)\n"
+	       "  --toeplitz-key HEX   40-byte Toeplitz key (default: mlx5's)\n"
+	       "  --csv                end with a CSV summary\n",
+	       prog);
+}
+
+static uint32_t source_slot(uint32_t addr)
+{
+	addr ^= addr >> 16;
+	addr *= 0x85ebca6b;
+	addr ^= addr >> 13;
+	return addr;
+}
+
+static int table_grow(struct source_table *table)
+{
+	uint32_t size = table->mask == 0 ? 1024 : (table->mask + 1) * 2;
+	struct source *slots = calloc(size, sizeof(*slots));
+
+	if (slots == NULL)
+		return -ENOMEM;
+	for (uint32_t i = 0; table->slots != NULL && i <= table->mask; i++) {
+		uint32_t s;
+
+		if (table->slots[i].pkts == 0)
+			continue;
+		for (s = source_slot(table->slots[i].addr) & (size - 1); slots[s].pkts != 0; s = (s + 1) & (size - 1))
+			;
+		slots[s] = table->slots[i];
+	}
+	free(table->slots);
+	table->slots = slots;
+	table->mask = size - 1;
+	return 0;
+}
+
+static int table_add(struct source_table *table, uint32_t addr, uint64_t pkts, uint64_t bytes)
+{
+	uint32_t s;
+
+	if ((table->count + 1) * 2 > table->mask + 1 && table_grow(table) != 0)
+		return -ENOMEM;
+	for (s = source_slot(addr) & table->mask; table->slots[s].pkts != 0; s = (s + 1) & table->mask) {
+		if (table->slots[s].addr == addr)
+			break;
+	}
+	if (table->slots[s].pkts == 0) {
+		table->slots[s].addr = addr;
+		table->count++;
+	}
+	table->slots[s].pkts += pkts;
+	table->slots[s].bytes += bytes;
+	return 0;
+}
+
+/* The service a packet would take: its VIP, else the default service */
+static int classify(const struct sim *sim, uint32_t dst, uint8_t protocol, uint16_t port)
+{
+	const XenoFlowServicesFile *services = &sim->services;
+	int fallback = -1;
+
+	for (int s = 0; s < services->nb_services; s++) {
+		const XenoFlowServiceDesc *service = &services->services[s];
+
+		if (service->protocol == 0)
+			fallback = s;
+		else if (service->vip == dst && service->protocol == protocol && service->port == port)
+			return s;
+	}
+	return fallback;
+}
+
+static int load_pcap(struct sim *sim, const struct sim_cfg *cfg, int only)
+{
+	FILE *f = fopen(cfg->pcap, "rb");
+	uint32_t header[6], record[4];
+	uint8_t frame[65536];
+	bool swapped;
+	uint32_t linktype;
+	uint64_t nb_packets = 0;
+	int ret = 0;
+
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", cfg->pcap, strerror(errno));
+		return -errno;
+	}
+	if (fread(header, sizeof(header), 1, f) != 1) {
+		fprintf(stderr, "%s is not a pcap file\n", cfg->pcap);
+		fclose(f);
+		return -EINVAL;
+	}
+	swapped = header[0] == __builtin_bswap32(PCAP_MAGIC) || header[0] == __builtin_bswap32(PCAP_MAGIC_NS);
+	if (!swapped && header[0] != PCAP_MAGIC && header[0] != PCAP_MAGIC_NS) {
+		fprintf(stderr, "%s is not a pcap file (pcapng is not supported)\n", cfg->pcap);
+		fclose(f);
+		return -EINVAL;
+	}
+	linktype = swapped ? __builtin_bswap32(header[5]) : header[5];
+	if (linktype != PCAP_LINKTYPE_ETHERNET && linktype != PCAP_LINKTYPE_RAW) {
+		fprintf(stderr, "%s has link type %u, only Ethernet and raw IP are supported\n", cfg->pcap, linktype);
+		fclose(f);
+		return -EINVAL;
+	}
+
+	while (ret == 0 && fread(record, sizeof(record), 1, f) == 1) {
+		uint32_t caplen = swapped ? __builtin_bswap32(record[2]) : record[2];
+		uint32_t len = swapped ? __builtin_bswap32(record[3]) : record[3];
+		const uint8_t *ip = frame;
+		uint32_t left = caplen;
+		uint32_t src, dst;
+		uint16_t port = 0;
+		int s;
+
+		if (caplen > sizeof(frame) || fread(frame, caplen, 1, f) != 1) {
+			fprintf(stderr, "%s is truncated after %lu packets\n", cfg->pcap, nb_packets);
+			break;
+		}
+		nb_packets++;
+		if (linktype == PCAP_LINKTYPE_ETHERNET) {
+			uint16_t type;
+
+			if (left < 14)
+				continue;
+			type = (frame[12] << 8) | frame[13];
+			ip += 14;
+			left -= 14;
+			while ((type == ETH_TYPE_VLAN || type == ETH_TYPE_QINQ) && left >= 4) {
+				type = (ip[2] << 8) | ip[3];
+				ip += 4;
+				left -= 4;
+			}
+			if (type != ETH_TYPE_IPV4)
+				continue;
+		}
+		if (left < 20 || (ip[0] >> 4) != 4)
+			continue;
+		memcpy(&src, ip + 12, sizeof(src));
+		memcpy(&dst, ip + 16, sizeof(dst));
+		/* Ports are only in the first fragment, and the hash pipe only looks at the source address anyway */
+		if ((ip[9] == IPPROTO_TCP || ip[9] == IPPROTO_UDP) && (((ip[6] & 0x1f) << 8) | ip[7]) == 0 &&
+		    left >= (uint32_t)(ip[0] & 0xf) * 4 + 4)
+			port = (ip[(ip[0] & 0xf) * 4 + 2] << 8) | ip[(ip[0] & 0xf) * 4 + 3];
+
+		s = classify(sim, dst, ip[9], port);
+		if (s < 0 || (only >= 0 && s != only)) {
+			sim->unmatched++;
+			continue;
+		}
+		ret = table_add(&sim->tables[s], src, 1, len);
+	}
+	fclose(f);
+	printf("%lu packets read from %s, %lu taken by no simulated service\n", nb_packets, cfg->pcap,
+	       sim->unmatched);
+	return ret;
+}
+
+static int load_sources(struct sim *sim, const struct sim_cfg *cfg, int s)
+{
+	FILE *f = fopen(cfg->sources, "r");
+	char line[256];
+	uint64_t nb_lines = 0;
+	int ret = 0;
+
+	if (f == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", cfg->sources, strerror(errno));
+		return -errno;
+	}
+	while (ret == 0 && fgets(line, sizeof(line), f) != NULL) {
+		char addr_str[64];
+		unsigned long long pkts = 1;
+		struct in_addr addr;
+		int fields;
+
+		nb_lines++;
+		fields = sscanf(line, "%63s %llu", addr_str, &pkts);
+		if (fields < 1 || addr_str[0] == '#')
+			continue;
+		if (inet_pton(AF_INET, addr_str, &addr) != 1 || pkts == 0) {
+			fprintf(stderr, "%s:%lu: expected an IPv4 address and a packet count above 0\n", cfg->sources,
+				nb_lines);
+			ret = -EINVAL;
+			break;
+		}
+		ret = table_add(&sim->tables[s], addr.s_addr, pkts, 0);
+	}
+	fclose(f);
+	return ret;
+}
+
+/* Layout of a service: the owner of every entry, as backend positions in its config */
+static int32_t *layout(const XenoFlowServiceDesc *service, uint32_t *nb_entries)
+{
+	int *host = calloc(service->nb_backends + 1, sizeof(*host));
+	int32_t *owners;
+
+	*nb_entries = xenoflow_hashsim_entries(service->nb_backends, service->buckets);
+	owners = calloc(*nb_entries, sizeof(*owners));
+	if (host == NULL || owners == NULL) {
+		free(host);
+		free(owners);
+		return NULL;
+	}
+	for (int i = 0; i < service->nb_backends; i++)
+		host[i] = service->backends[i].host;
+	xenoflow_hashsim_layout(host, service->nb_backends, service->buckets, owners, *nb_entries);
+	free(host);
+	return owners;
+}
+
+static const char *owner_name(const XenoFlowServiceDesc *service, const int32_t *owners, uint32_t nb_entries,
+			      uint32_t hash)
+{
+	int32_t owner = owners[hash & (nb_entries - 1)];
+
+	return owner < 0 ? NULL : service->backends[owner].name;
+}
+
+static const XenoFlowServiceDesc *find_service(const XenoFlowServicesFile *services, const char *name)
+{
+	for (int s = 0; s < services->nb_services; s++) {
+		if (strcmp(services->services[s].name, name) == 0)
+			return &services->services[s];
+	}
+	return NULL;
+}
+
+static int report_service(const struct sim *sim, const struct sim_cfg *cfg, const XenoFlowHasher *hasher, int s)
+{
+	const XenoFlowServiceDesc *service = &sim->services.services[s];
+	const struct source_table *table = &sim->tables[s];
+	const XenoFlowServiceDesc *current = find_service(&sim->current, service->name);
+	uint32_t nb_entries, nb_current = 0, n = 0;
+	int32_t *owners, *current_owners = NULL;
+	uint32_t *addrs, *hashes, *buckets;
+	uint64_t *sources, *pkts, *bytes;
+	uint64_t total_pkts = 0, dropped_pkts = 0, dropped_sources = 0, moved_pkts = 0, moved_sources = 0;
+	uint32_t owned = 0, nb_loaded = 0;
+	double max_share = 0, sum_share = 0;
+	int ret = -ENOMEM;
+
+	owners = layout(service, &nb_entries);
+	if (current != NULL)
+		current_owners = layout(current, &nb_current);
+	addrs = malloc((table->count + 1) * sizeof(*addrs));
+	hashes = malloc((table->count + 1) * sizeof(*hashes));
+	buckets = calloc(service->nb_backends + 1, sizeof(*buckets));
+	sources = calloc(service->nb_backends + 1, sizeof(*sources));
+	pkts = calloc(service->nb_backends + 1, sizeof(*pkts));
+	bytes = calloc(service->nb_backends + 1, sizeof(*bytes));
+	if (owners == NULL || (current != NULL && current_owners == NULL) || addrs == NULL || hashes == NULL ||
+	    buckets == NULL || sources == NULL || pkts == NULL || bytes == NULL)
+		goto out;
+
+	for (uint32_t i = 0; table->slots != NULL && i <= table->mask; i++) {
+		if (table->slots[i].pkts != 0)
+			addrs[n++] = table->slots[i].addr;
+	}
+	xenoflow_hash_batch(hasher, addrs, hashes, n);
+	for (uint32_t e = 0; e < nb_entries; e++) {
+		if (owners[e] >= 0) {
+			buckets[owners[e]]++;
+			owned++;
+		}
+	}
+
+	/* Slots were read in table order, the same order again finds each address's traffic */
+	n = 0;
+	for (uint32_t i = 0; table->slots != NULL && i <= table->mask; i++) {
+		const struct source *src = &table->slots[i];
+		uint32_t hash;
+		int32_t owner;
+
+		if (src->pkts == 0)
+			continue;
+		hash = hashes[n++];
+		owner = owners[hash & (nb_entries - 1)];
+		total_pkts += src->pkts;
+		if (owner < 0) {
+			dropped_pkts += src->pkts;
+			dropped_sources++;
+		} else {
+			sources[owner]++;
+			pkts[owner] += src->pkts;
+			bytes[owner] += src->bytes;
+		}
+		if (current != NULL) {
+			const char *now = owner_name(current, current_owners, nb_current, hash);
+			const char *next = owner < 0 ? NULL : service->backends[owner].name;
+
+			if (now != NULL && (next == NULL || strcmp(now, next) != 0)) {
+				moved_sources++;
+				moved_pkts += src->pkts;
+			}
+		}
+	}
+
+	printf("\nService %s: %u entries, %d backends, %u sources, %lu packets (%s hash)\n", service->name,
+	       nb_entries, service->nb_backends, table->count, total_pkts, xenoflow_hash_name(hasher->algo));
+	printf("%-24s %8s %8s %10s %12s %14s %8s %8s\n", "backend", "entries", "expected", "sources", "packets",
+	       "bytes", "share", "load");
+	for (int b = 0; b < service->nb_backends; b++) {
+		double expected = owned > 0 ? 100.0 * buckets[b] / owned : 0;
+		double share = total_pkts > 0 ? 100.0 * pkts[b] / total_pkts : 0;
+		uint64_t delivered = total_pkts - dropped_pkts;
+
+		/* Load against what its entries should get of the delivered packets, 1.00 is exactly its fair share */
+		printf("%-24s %8u %7.2f%% %10lu %12lu %14lu %7.2f%% %8.2f\n", service->backends[b].name, buckets[b],
+		       expected, sources[b], pkts[b], bytes[b], share,
+		       expected > 0 && delivered > 0 ? 100.0 * pkts[b] / delivered / expected : 0);
+		if (buckets[b] > 0 && !service->backends[b].host) {
+			double per_entry = share / buckets[b];
+
+			max_share = per_entry > max_share ? per_entry : max_share;
+			sum_share += share;
+			nb_loaded += buckets[b];
+		}
+	}
+	if (dropped_pkts > 0)
+		printf("Dropped on empty entries: %lu sources, %lu packets (%.2f%%)\n", dropped_sources, dropped_pkts,
+		       100.0 * dropped_pkts / total_pkts);
+	/* Per entry so that a backend with more buckets is not counted as overloaded */
+	if (nb_loaded > 0 && sum_share > 0)
+		printf("Imbalance: busiest backend at %.2fx its fair share\n", max_share / (sum_share / nb_loaded));
+	if (current != NULL)
+		printf("Moved from the current config: %lu of %u sources (%.2f%%), %lu packets (%.2f%%)\n",
+		       moved_sources, table->count, table->count ? 100.0 * moved_sources / table->count : 0,
+		       moved_pkts, total_pkts ? 100.0 * moved_pkts / total_pkts : 0);
+	else if (cfg->current != NULL)
+		printf("Not in the current config, nothing moves\n");
+
+	if (cfg->csv) {
+		printf("\nservice,backend,entries,sources,packets,bytes,share\n");
+		for (int b = 0; b < service->nb_backends; b++)
+			printf("%s,%s,%u,%lu,%lu,%lu,%.4f\n", service->name, service->backends[b].name, buckets[b],
+			       sources[b], pkts[b], bytes[b], total_pkts > 0 ? (double)pkts[b] / total_pkts : 0);
+	}
+	ret = 0;
+out:
+	if (ret != 0)
+		fprintf(stderr, "Out of memory simulating service %s\n", service->name);
+	free(owners);
+	free(current_owners);
+	free(addrs);
+	free(hashes);
+	free(buckets);
+	free(sources);
+	free(pkts);
+	free(bytes);
+	return ret;
+}
+
+static int parse_key(const char *hex, uint8_t *key)
+{
+	if (strlen(hex) != 2 * XENOFLOW_HASH_KEY_LEN)
+		return -1;
+	for (int i = 0; i < XENOFLOW_HASH_KEY_LEN; i++) {
+		if (sscanf(hex + 2 * i, "%2hhx", &key[i]) != 1)
+			return -1;
+	}
+	return 0;
+}
+
+static int parse_args(int argc, char **argv, struct sim_cfg *cfg)
+{
+	enum {
+		OPT_CONFIG = 256, OPT_CURRENT, OPT_PCAP, OPT_SOURCES, OPT_SERVICE, OPT_HASH, OPT_TOEPLITZ_KEY, OPT_CSV,
+		OPT_HELP,
+	};
+	static const struct option long_opts[] = {
+		{"config", required_argument, NULL, OPT_CONFIG},
+		{"current", required_argument, NULL, OPT_CURRENT},
+		{"pcap", required_argument, NULL, OPT_PCAP},
+		{"sources", required_argument, NULL, OPT_SOURCES},
+		{"service", required_argument, NULL, OPT_SERVICE},
+		{"hash", required_argument, NULL, OPT_HASH},
+		{"toeplitz-key", required_argument, NULL, OPT_TOEPLITZ_KEY},
+		{"csv", no_argument, NULL, OPT_CSV},
+		{"help", no_argument, NULL, OPT_HELP},
+		{NULL, 0, NULL, 0},
+	};
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case OPT_CONFIG:
+			cfg->config = optarg;
+			break;
+		case OPT_CURRENT:
+			cfg->current = optarg;
+			break;
+		case OPT_PCAP:
+			cfg->pcap = optarg;
+			break;
+		case OPT_SOURCES:
+			cfg->sources = optarg;
+			break;
+		case OPT_SERVICE:
+			cfg->service = optarg;
+			break;
+		case OPT_HASH:
+			if (xenoflow_hash_parse(optarg, &cfg->algo) != 0) {
+				fprintf(stderr, "Unknown hash '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_TOEPLITZ_KEY:
+			if (parse_key(optarg, cfg->key) != 0) {
+				fprintf(stderr, "Toeplitz key must be %d hex digits\n", 2 * XENOFLOW_HASH_KEY_LEN);
+				return -1;
+			}
+			cfg->has_key = true;
+			break;
+		case OPT_CSV:
+			cfg->csv = true;
+			break;
+		default:
+			usage(argv[0]);
+			return -1;
+		}
+	}
+	if (cfg->config == NULL || (cfg->pcap == NULL) == (cfg->sources == NULL)) {
+		usage(argv[0]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct sim_cfg cfg = {.algo = XENOFLOW_HASH_CRC32};
+	struct sim sim = {0};
+	XenoFlowHasher hasher;
+	char err[256];
+	int only = -1, ret = -1;
+
+	if (parse_args(argc, argv, &cfg) != 0)
+		return EXIT_FAILURE;
+
+	if (xenoflow_services_parse(cfg.config, &sim.services, err, sizeof(err)) != 0 ||
+	    (cfg.current != NULL && xenoflow_services_parse(cfg.current, &sim.current, err, sizeof(err)) != 0)) {
+		fprintf(stderr, "%s\n", err);
+		goto out;
+	}
+	sim.tables = calloc(sim.services.nb_services + 1, sizeof(*sim.tables));
+	if (sim.tables == NULL)
+		goto out;
+
+	for (int s = 0; s < sim.services.nb_services; s++) {
+		if (cfg.service != NULL ? strcmp(sim.services.services[s].name, cfg.service) == 0
+					: sim.services.services[s].protocol == 0)
+			only = s;
+	}
+	if (cfg.service != NULL && only < 0) {
+		fprintf(stderr, "No service %s in %s\n", cfg.service, cfg.config);
+		goto out;
+	}
+	if (cfg.sources != NULL) {
+		if (only < 0) {
+			fprintf(stderr, "%s has no default service, pick one with --service\n", cfg.config);
+			goto out;
+		}
+		ret = load_sources(&sim, &cfg, only);
+	} else {
+		ret = load_pcap(&sim, &cfg, cfg.service != NULL ? only : -1);
+	}
+	if (ret != 0)
+		goto out;
+
+	xenoflow_hasher_init(&hasher, cfg.algo, cfg.has_key ? cfg.key : NULL);
+	for (int s = 0; s < sim.services.nb_services && ret == 0; s++) {
+		if (sim.tables[s].count > 0)
+			ret = report_service(&sim, &cfg, &hasher, s);
+	}
+out:
+	for (int s = 0; sim.tables != NULL && s < sim.services.nb_services; s++)
+		free(sim.tables[s].slots);
+	free(sim.tables);
+	xenoflow_services_file_free(&sim.services);
+	xenoflow_services_file_free(&sim.current);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
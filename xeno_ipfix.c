@@ -0,0 +1,204 @@
+/*
+ * Minimal IPFIX collector: listens on a UDP port and prints the records xeno_flow --ipfix exports
+ */
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "ipfix.h"
+
+#define MAX_TEMPLATES 16
+#define MAX_FIELDS 32
+
+typedef struct {
+	uint16_t id;		/* 0 if unused */
+	uint16_t nb_fields;
+	uint16_t ie[MAX_FIELDS];
+	uint16_t len[MAX_FIELDS];
+	uint32_t record_len;
+} Template;
+
+static Template templates[MAX_TEMPLATES];
+
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static uint64_t get_uint(const uint8_t *p, uint16_t len)
+{
+	uint64_t v = 0;
+
+	for (uint16_t i = 0; i < len && i < 8; i++)
+		v = v << 8 | p[i];
+	return v;
+}
+
+static const char *ie_name(uint16_t ie)
+{
+#define IE_NAME(id, len, name) \
+	case id:               \
+		return name;
+	switch (ie) {
+		XENOFLOW_IPFIX_FIELDS(IE_NAME)
+	}
+#undef IE_NAME
+	return NULL;
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options] PORT\n"
+	       "  --count N            exit after N data records\n",
+	       prog);
+}
+
+static Template *find_template(uint16_t id, int create)
+{
+	for (int i = 0; i < MAX_TEMPLATES; i++)
+		if (templates[i].id == id)
+			return &templates[i];
+	if (!create)
+		return NULL;
+	for (int i = 0; i < MAX_TEMPLATES; i++)
+		if (templates[i].id == 0)
+			return &templates[i];
+	return NULL;
+}
+
+static void parse_templates(const uint8_t *p, const uint8_t *end)
+{
+	while (end - p >= 4) {
+		uint16_t id = get16(p), nb = get16(p + 2);
+		Template *t = find_template(id, 1);
+
+		p += 4;
+		if (t == NULL || nb > MAX_FIELDS || end - p < 4 * nb) {
+			fprintf(stderr, "skipping template %u with %u fields\n", id, nb);
+			return;
+		}
+		t->id = id;
+		t->nb_fields = nb;
+		t->record_len = 0;
+		for (uint16_t i = 0; i < nb; i++, p += 4) {
+			/* Enterprise-specific fields are not used by XenoFlow */
+			t->ie[i] = get16(p) & 0x7fff;
+			t->len[i] = get16(p + 2);
+			t->record_len += t->len[i];
+		}
+	}
+}
+
+static uint64_t print_records(const Template *t, const uint8_t *p, const uint8_t *end)
+{
+	uint64_t nb = 0;
+
+	while (t->record_len > 0 && (size_t)(end - p) >= t->record_len) {
+		for (uint16_t i = 0; i < t->nb_fields; i++) {
+			const char *name = ie_name(t->ie[i]);
+			char addr[INET_ADDRSTRLEN];
+
+			if (name != NULL)
+				printf("%s%s=", i ? " " : "", name);
+			else
+				printf("%sie%u=", i ? " " : "", t->ie[i]);
+			if ((t->ie[i] == 8 || t->ie[i] == 12) && t->len[i] == 4)
+				printf("%s", inet_ntop(AF_INET, p, addr, sizeof(addr)));
+			else
+				printf("%" PRIu64, get_uint(p, t->len[i]));
+			p += t->len[i];
+		}
+		printf("\n");
+		nb++;
+	}
+	return nb;
+}
+
+static uint64_t parse_message(const uint8_t *buf, size_t len)
+{
+	const uint8_t *p = buf + sizeof(XenoFlowIpfixHeader);
+	const uint8_t *end;
+	uint64_t nb = 0;
+
+	if (len < sizeof(XenoFlowIpfixHeader) || get16(buf) != XENOFLOW_IPFIX_VERSION) {
+		fprintf(stderr, "ignoring a message that is not IPFIX\n");
+		return 0;
+	}
+	end = buf + (get16(buf + 2) < len ? get16(buf + 2) : len);
+
+	while (end - p >= 4) {
+		uint16_t set_id = get16(p), set_len = get16(p + 2);
+		const Template *t;
+
+		if (set_len < 4 || set_len > end - p)
+			break;
+		if (set_id == XENOFLOW_IPFIX_SET_TEMPLATE) {
+			parse_templates(p + 4, p + set_len);
+		} else if (set_id >= 256) {
+			t = find_template(set_id, 0);
+			if (t != NULL)
+				nb += print_records(t, p + 4, p + set_len);
+			else
+				fprintf(stderr, "no template %u yet, skipping its records\n", set_id);
+		}
+		p += set_len;
+	}
+	return nb;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_opts[] = {
+		{"count", required_argument, NULL, 'n'},
+		{"help", no_argument, NULL, 'h'},
+		{NULL, 0, NULL, 0},
+	};
+	struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_ANY)};
+	uint64_t count = 0, nb_records = 0;
+	uint8_t buf[65536];
+	int fd, opt;
+
+	while ((opt = getopt_long(argc, argv, "", long_opts, NULL)) != -1) {
+		switch (opt) {
+		case 'n':
+			count = strtoull(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	addr.sin_port = htons((uint16_t)atoi(argv[optind]));
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		perror("bind");
+		return EXIT_FAILURE;
+	}
+	fprintf(stderr, "listening on UDP port %s\n", argv[optind]);
+
+	while (count == 0 || nb_records < count) {
+		ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+		if (len < 0) {
+			perror("recv");
+			break;
+		}
+		nb_records += parse_message(buf, (size_t)len);
+		fflush(stdout);
+	}
+
+	close(fd);
+	fprintf(stderr, "%" PRIu64 " records\n", nb_records);
+	return EXIT_SUCCESS;
+}